@@ -61,6 +61,7 @@
 #include "nifty-primitives.h"
 #include "nifty-array.h"
 #include "niftyprefs-obj.h"
+#include "niftyprefs-node-prop.h"
 
 
 
@@ -76,11 +77,67 @@ typedef NftArray                NftPrefsClasses;
 typedef struct _NftPrefsClass   NftPrefsClass;
 
 
+/** kind of struct member described by NftPrefsFieldDesc */
+typedef enum
+{
+        /** member is stored as property (s. NftPrefsFieldDesc.prop) */
+        NFT_PREFS_FIELD_PROP = 0,
+        /** member is a struct of class NftPrefsFieldDesc.child that is 
+            stored as child node */
+        NFT_PREFS_FIELD_CHILD,
+        /** member is a pointer to an array of structs of class 
+            NftPrefsFieldDesc.child that are stored as child nodes. The amount
+            of elements is kept in the size_t member at NftPrefsFieldDesc.count */
+        NFT_PREFS_FIELD_ARRAY,
+} NftPrefsFieldKind;
+
+
+/** binding of a struct member to a property or to child nodes 
+    (s. nft_prefs_class_register_struct()) */
+typedef struct
+{
+        /** property & member (only offset & size are used for nested 
+            members) */
+        NftPrefsPropDesc prop;
+        /** kind of member */
+        NftPrefsFieldKind kind;
+        /** class of nested struct or of array elements (registered with
+            nft_prefs_class_register_struct()) or NULL */
+        const char *child;
+        /** offset of member holding amount of array elements */
+        size_t count;
+} NftPrefsFieldDesc;
+
+
+/** descriptor for member of struct type s that is stored as property, e.g.
+    NFT_PREFS_FIELD("age", NFT_PREFS_PROP_INT, struct Person, age, "0") */
+#define NFT_PREFS_FIELD(name, type, s, member, def) \
+        { NFT_PREFS_PROP_DESC(name, type, s, member, def), \
+          NFT_PREFS_FIELD_PROP, NULL, 0 }
+
+/** descriptor for struct member of struct type s that is stored as child 
+    node of class childClass, e.g. 
+    NFT_PREFS_FIELD_CHILD(struct Person, address, "address") */
+#define NFT_PREFS_FIELD_CHILD(s, member, childClass) \
+        { { NULL, 0, offsetof(s, member), sizeof(((s *) 0)->member), NULL }, \
+          NFT_PREFS_FIELD_CHILD, childClass, 0 }
+
+/** descriptor for pointer member of struct type s to an array whose 
+    elements are stored as child nodes of class childClass. The amount of 
+    elements is kept in the size_t member countMember, e.g.
+    NFT_PREFS_FIELD_ARRAY(struct People, people, people_count, "person") */
+#define NFT_PREFS_FIELD_ARRAY(s, member, countMember, childClass) \
+        { { NULL, 0, offsetof(s, member), sizeof(((s *) 0)->member), NULL }, \
+          NFT_PREFS_FIELD_ARRAY, childClass, offsetof(s, countMember) }
+
+
 
 
 
 NftResult                       nft_prefs_class_register(NftPrefs * p, const char *className, NftPrefsToObjFunc * toObj, NftPrefsFromObjFunc * fromObj);
 void                            nft_prefs_class_unregister(NftPrefs * p, const char *className);
+NftResult                       nft_prefs_class_register_struct(NftPrefs * p, const char *className, size_t size, const NftPrefsFieldDesc fields[], size_t count);
+void                            nft_prefs_class_free_struct(NftPrefs * p, const char *className, void *obj);
 
 
 
@@ -0,0 +1,127 @@
+/*
+ * libniftyprefs - lightweight modelless preferences management library
+ * Copyright (C) 2006-2014 Daniel Hiepler <daniel@niftylight.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/**
+ * @file niftyprefs-diff.h
+ */
+
+/**
+ * @addtogroup prefs_node
+ * @{
+ * @defgroup prefs_diff NftPrefsDiff
+ * @brief structural differences between two trees of NftPrefsNodes.
+ * Children are matched by their name and the value of their key property
+ * (NFT_PREFS_DIFF_KEY), subtrees with equal content are skipped. A diff
+ * can be applied to the old tree (or a copy of it) to turn it into the new
+ * one.
+ * @{
+ */
+
+#ifndef _NIFTYPREFS_DIFF_H
+#define _NIFTYPREFS_DIFF_H
+
+#include "nifty-primitives.h"
+#include "niftyprefs-node.h"
+
+
+
+/** property that identifies a child among siblings of the same name */
+#define NFT_PREFS_DIFF_KEY      "name"
+
+
+/** list of changes between an old and a new tree */
+typedef struct _NftPrefsDiff NftPrefsDiff;
+
+
+/** kind of change */
+typedef enum
+{
+        /** child was added (from: parent, to: added child) */
+        NFT_PREFS_DIFF_ADD,
+        /** child was removed (from: removed child, to: parent) */
+        NFT_PREFS_DIFF_REMOVE,
+        /** child changed its position among its siblings (from: child in old 
+            tree, to: child in new tree) */
+        NFT_PREFS_DIFF_MOVE,
+        /** node was replaced by a node of other name or text content */
+        NFT_PREFS_DIFF_REPLACE,
+        /** property was added or changed */
+        NFT_PREFS_DIFF_PROP_SET,
+        /** property was removed */
+        NFT_PREFS_DIFF_PROP_UNSET,
+} NftPrefsDiffOp;
+
+
+/** one change */
+typedef struct
+{
+        /** kind of change */
+        NftPrefsDiffOp op;
+        /** affected node of the old tree */
+        NftPrefsNode *from;
+        /** affected node of the new tree */
+        NftPrefsNode *to;
+        /** name of property (NFT_PREFS_DIFF_PROP_SET/_UNSET only) */
+        const char *prop;
+        /** position among element children of the parent in the new tree
+            (NFT_PREFS_DIFF_ADD/_MOVE only) */
+        size_t index;
+} NftPrefsDiffEntry;
+
+
+
+NftPrefsDiff *                  nft_prefs_node_diff(NftPrefsNode * a, NftPrefsNode * b);
+NftResult                       nft_prefs_node_patch(NftPrefsNode * tree, NftPrefsDiff * d);
+void                            nft_prefs_diff_free(NftPrefsDiff * d);
+size_t                          nft_prefs_diff_length(NftPrefsDiff * d);
+const NftPrefsDiffEntry *       nft_prefs_diff_get(NftPrefsDiff * d, size_t i);
+
+
+#endif /** _NIFTYPREFS_DIFF_H */
+
+
+/**
+ * @}
+ * @}
+ */
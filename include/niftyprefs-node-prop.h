@@ -59,10 +59,61 @@
 #define _NIFTYPREFS_NODE_PROP_H
 
 
+#include <stddef.h>
+#include <stdint.h>
+
+
+
+/** maximum amount of descriptors per nft_prefs_node_props_get() call */
+#define NFT_PREFS_PROPS_MAX     64
+
+
+/** type of struct member described by NftPrefsPropDesc */
+typedef enum
+{
+        /** char array of NftPrefsPropDesc.size bytes */
+        NFT_PREFS_PROP_STRING = 0,
+        /** char * (free with nft_prefs_free()) */
+        NFT_PREFS_PROP_STRING_ALLOC,
+        /** int */
+        NFT_PREFS_PROP_INT,
+        /** long int */
+        NFT_PREFS_PROP_LONG_INT,
+        /** double */
+        NFT_PREFS_PROP_DOUBLE,
+        /** bool */
+        NFT_PREFS_PROP_BOOLEAN,
+} NftPrefsPropType;
+
+
+/** binding of a property to a member of a struct */
+typedef struct
+{
+        /** name of property */
+        const char *name;
+        /** type of struct member */
+        NftPrefsPropType type;
+        /** offset of member in struct */
+        size_t offset;
+        /** size of member */
+        size_t size;
+        /** value used if property is missing or invalid, formatted like a 
+            property value (e.g. "0.5", "true") or NULL for none */
+        const char *def;
+} NftPrefsPropDesc;
+
+
+/** descriptor for member of struct type s, e.g.
+    NFT_PREFS_PROP_DESC("age", NFT_PREFS_PROP_INT, struct Person, age, "0") */
+#define NFT_PREFS_PROP_DESC(name, type, s, member, def) \
+        { name, type, offsetof(s, member), sizeof(((s *) 0)->member), def }
+
+
 
 NftResult                       nft_prefs_node_prop_unset(NftPrefsNode * n, const char *name);
 NftResult                       nft_prefs_node_prop_string_set(NftPrefsNode * n, const char *name, char *value);
 char                          * nft_prefs_node_prop_string_get(NftPrefsNode * n, const char *name);
+const char *                    nft_prefs_node_prop_string_borrow(NftPrefsNode * n, const char *name, size_t * length);
 NftResult                       nft_prefs_node_prop_int_set(NftPrefsNode * n, const char *name, int val);
 NftResult                       nft_prefs_node_prop_int_get(NftPrefsNode * n, const char *name, int *val);
 NftResult                       nft_prefs_node_prop_long_int_set(NftPrefsNode * n, const char *name, long int val);
@@ -71,6 +122,19 @@ NftResult                       nft_prefs_node_prop_double_set(NftPrefsNode * n,
 NftResult                       nft_prefs_node_prop_double_get(NftPrefsNode * n, const char *name, double *val);
 NftResult                       nft_prefs_node_prop_boolean_set(NftPrefsNode * n, const char *name, bool val);
 NftResult                       nft_prefs_node_prop_boolean_get(NftPrefsNode * n, const char *name, bool * val);
+NftResult                       nft_prefs_node_prop_int_array_set(NftPrefsNode * n, const char *name, const int *values, size_t count);
+NftResult                       nft_prefs_node_prop_int_array_get(NftPrefsNode * n, const char *name, int *values, size_t * count);
+NftResult                       nft_prefs_node_prop_double_array_set(NftPrefsNode * n, const char *name, const double *values, size_t count);
+NftResult                       nft_prefs_node_prop_double_array_get(NftPrefsNode * n, const char *name, double *values, size_t * count);
+NftResult                       nft_prefs_node_prop_u8_array_set(NftPrefsNode * n, const char *name, const uint8_t * values, size_t count);
+NftResult                       nft_prefs_node_prop_u8_array_get(NftPrefsNode * n, const char *name, uint8_t * values, size_t * count);
+NftResult                       nft_prefs_node_set_value_cache(NftPrefsNode * n, bool enable);
+bool                            nft_prefs_node_get_value_cache(NftPrefsNode * n);
+NftResult                       nft_prefs_node_set_deferred_values(NftPrefsNode * n, bool enable);
+bool                            nft_prefs_node_get_deferred_values(NftPrefsNode * n);
+NftResult                       nft_prefs_node_column_get(NftPrefsNode * n, const char *child, const NftPrefsPropDesc * desc, void *dst, size_t stride, size_t * count);
+uint64_t                        nft_prefs_node_props_get(NftPrefsNode * n, const NftPrefsPropDesc desc[], size_t count, void *dst);
+uint64_t                        nft_prefs_node_props_set(NftPrefsNode * n, const NftPrefsPropDesc desc[], size_t count, const void *src);
 
 
 
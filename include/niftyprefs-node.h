@@ -78,11 +78,46 @@
 typedef xmlNode                 NftPrefsNode;
 
 
+/**
+ * function that receives one chunk of serialized preferences
+ *
+ * @param ctx arbitrary pointer passed to nft_prefs_node_to_sink()
+ * @param buffer chunk of serialized preferences
+ * @param len length of chunk in bytes
+ * @result amount of bytes written or -1 upon error
+ */
+typedef int                     (NftPrefsSinkWriteFunc) (void *ctx, const char *buffer, int len);
+
+/**
+ * function that is called after the last chunk was written to a sink
+ *
+ * @param ctx arbitrary pointer passed to nft_prefs_node_to_sink()
+ * @result 0 on success or -1 upon error
+ */
+typedef int                     (NftPrefsSinkCloseFunc) (void *ctx);
+
+
+/** compression of preferences files, s. nft_prefs_node_to_file_compressed() */
+typedef enum
+{
+        /** plain XML */
+        NFT_PREFS_COMPRESSION_NONE = 0,
+        /** gzip (levels 0-9) */
+        NFT_PREFS_COMPRESSION_GZIP,
+        /** zstd (levels 1-22) */
+        NFT_PREFS_COMPRESSION_ZSTD,
+} NftPrefsCompression;
+
+
 
 NftResult                       nft_prefs_node_add_child(NftPrefsNode * parent, NftPrefsNode * cur);
 NftPrefsNode                   *nft_prefs_node_get_first_child(NftPrefsNode * n);
 NftPrefsNode                   *nft_prefs_node_get_next(NftPrefsNode * n);
 NftPrefsNode *                  nft_prefs_node_get_next_with_name(NftPrefsNode * n, const char *name);
+NftPrefsNode *                  nft_prefs_node_get_child_by_name(NftPrefsNode * n, const char *name);
+NftPrefsNode **                 nft_prefs_node_get_children_by_name(NftPrefsNode * n, const char *name, size_t * count);
+NftPrefsNode *                  nft_prefs_node_get_nth_child(NftPrefsNode * n, size_t i);
+size_t                          nft_prefs_node_get_child_count(NftPrefsNode * n);
 const char                     *nft_prefs_node_get_name(NftPrefsNode * n);
 const char                     *nft_prefs_node_get_uri(NftPrefsNode * p);
 
@@ -91,12 +126,19 @@ char                           *nft_prefs_node_to_buffer(NftPrefs *p, NftPrefsNo
 char                           *nft_prefs_node_to_buffer_minimal(NftPrefs *p, NftPrefsNode * n);
 NftResult                       nft_prefs_node_to_file(NftPrefs *p, NftPrefsNode * n, const char *filename, bool overwrite);
 NftResult                       nft_prefs_node_to_file_minimal(NftPrefs *p, NftPrefsNode * n, const char *filename, bool overwrite);
+NftResult                       nft_prefs_node_to_file_compressed(NftPrefs *p, NftPrefsNode * n, const char *filename, bool overwrite, NftPrefsCompression compression, int level);
+bool                            nft_prefs_compression_supported(NftPrefsCompression type);
+NftResult                       nft_prefs_node_to_sink(NftPrefs *p, NftPrefsNode * n, NftPrefsSinkWriteFunc * write_cb, NftPrefsSinkCloseFunc * close_cb, void *ctx);
 NftPrefsNode                   *nft_prefs_node_from_buffer(NftPrefs *p, char *buffer, size_t bufsize);
 NftPrefsNode                   *nft_prefs_node_from_file(NftPrefs *p, const char *filename);
+NftResult                       nft_prefs_node_to_file_binary(NftPrefs *p, NftPrefsNode * n, const char *filename, bool overwrite);
+NftPrefsNode                   *nft_prefs_node_from_file_binary(NftPrefs *p, const char *filename);
+NftResult                       nft_prefs_load_many(NftPrefs *p, const char *const paths[], size_t n, NftPrefsNode *results[]);
 
 
 NftPrefsNode                   *nft_prefs_node_alloc(const char *name);
 void                            nft_prefs_node_free(NftPrefsNode * n);
+void                            nft_prefs_node_free_async(NftPrefs * p, NftPrefsNode * n);
 
 
 #endif /** _NIFTYPREFS_NODE_H */
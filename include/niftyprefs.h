@@ -87,7 +87,7 @@
  *  - create NftPrefsNode:
  *    prefsNode = nft_prefs_obj_to_node(obj);
  *  - dump:
- *    nft_prefs_node_to_file/buffer(prefsNode, ...);
+ *    nft_prefs_node_to_file/buffer/sink(prefsNode, ...);
  *    ...
  *  - [free object]
  *
@@ -109,6 +109,7 @@
 #define _NIFTYPREFS_H
 
 #include <sys/types.h>
+#include <libxml/parser.h>
 
 
 
@@ -121,14 +122,40 @@ typedef struct _NftPrefs        NftPrefs;
 #include "niftyprefs-version.h"
 #include "niftyprefs-node.h"
 #include "niftyprefs-node-prop.h"
+#include "niftyprefs-parser.h"
 #include "niftyprefs-updater.h"
 #include "niftyprefs-obj.h"
 #include "niftyprefs-class.h"
+#include "niftyprefs-diff.h"
+#include "niftyprefs-watch.h"
+#include "niftyprefs-query.h"
 
 
 
-
-
+/** options for parsing preferences, s. nft_prefs_set_parse_options() */
+typedef enum
+{
+        /** remove blank nodes */
+        NFT_PREFS_PARSE_NOBLANKS = XML_PARSE_NOBLANKS,
+        /** compact small text nodes (saves memory for trees that aren't modified) */
+        NFT_PREFS_PARSE_COMPACT = XML_PARSE_COMPACT,
+        /** don't use a dictionary to share names between nodes */
+        NFT_PREFS_PARSE_NODICT = XML_PARSE_NODICT,
+        /** relax any hardcoded limit of the parser (very large documents) */
+        NFT_PREFS_PARSE_HUGE = XML_PARSE_HUGE,
+        /** forbid network access */
+        NFT_PREFS_PARSE_NONET = XML_PARSE_NONET,
+        /** merge CDATA sections as text nodes */
+        NFT_PREFS_PARSE_NOCDATA = XML_PARSE_NOCDATA,
+        /** don't generate XInclude start/end marker nodes */
+        NFT_PREFS_PARSE_NOXINCNODE = XML_PARSE_NOXINCNODE,
+        /** don't fixup xml:base URIs of included content */
+        NFT_PREFS_PARSE_NOBASEFIX = XML_PARSE_NOBASEFIX,
+        /** suppress warnings */
+        NFT_PREFS_PARSE_NOWARNING = XML_PARSE_NOWARNING,
+        /** suppress errors */
+        NFT_PREFS_PARSE_NOERROR = XML_PARSE_NOERROR,
+} NftPrefsParseOption;
 
 
 
@@ -137,6 +164,20 @@ typedef struct _NftPrefs        NftPrefs;
 
 NftPrefs                       *nft_prefs_init(unsigned int version);
 void                            nft_prefs_deinit(NftPrefs * prefs);
+void                            nft_prefs_set_parse_options(NftPrefs * p, int options);
+int                             nft_prefs_get_parse_options(NftPrefs * p);
+NftResult                       nft_prefs_set_arena(NftPrefs * p, bool enable);
+bool                            nft_prefs_get_arena(NftPrefs * p);
+void                            nft_prefs_set_cache(NftPrefs * p, bool enable);
+bool                            nft_prefs_get_cache(NftPrefs * p);
+void                            nft_prefs_set_include_cache(NftPrefs * p, bool enable);
+bool                            nft_prefs_get_include_cache(NftPrefs * p);
+void                            nft_prefs_set_lazy_xinclude(NftPrefs * p, bool enable);
+bool                            nft_prefs_get_lazy_xinclude(NftPrefs * p);
+void                            nft_prefs_set_columnar(NftPrefs * p, bool enable);
+bool                            nft_prefs_get_columnar(NftPrefs * p);
+void                            nft_prefs_set_deferred_values(NftPrefs * p, bool enable);
+bool                            nft_prefs_get_deferred_values(NftPrefs * p);
 void                            nft_prefs_free(void *p);
 
 
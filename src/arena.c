@@ -0,0 +1,1218 @@
+/*
+ * libniftyprefs - lightweight modelless preferences management library
+ * Copyright (C) 2006-2014 Daniel Hiepler <daniel@niftylight.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/**
+ * @file arena.c
+ */
+
+/**
+ * @addtogroup prefs_node
+ * @{
+ *
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <libxml/tree.h>
+#include <libxml/valid.h>
+#include <niftylog.h>
+#include "arena.h"
+#include "node.h"
+
+
+
+/** alignment of every block of an arena */
+#define ARENA_ALIGN             8
+/** round up to ARENA_ALIGN */
+#define ARENA_ROUND(s)          (((s) + ARENA_ALIGN - 1) & ~((size_t) ARENA_ALIGN - 1))
+
+
+
+/** one block of memory a complete tree has been copied into */
+struct _NftPrefsArena
+{
+        /** start of block */
+        char *base;
+        /** size of block */
+        size_t size;
+        /** references held by documents that contain nodes of this arena */
+        unsigned int refs;
+};
+
+
+/** information about a document (stored in xmlDoc->_private) */
+typedef struct
+{
+        /** arena the tree of the document has been copied into (or NULL) */
+        NftPrefsArena *arena;
+        /** arena document also contains memory that has not been allocated
+            from an arena, so the tree has to be walked when freeing it */
+        bool mixed;
+        /** all arenas nodes of this document may come from (sorted by 
+            address) */
+        NftPrefsArena **arenas;
+        /** amount of arenas */
+        size_t arenas_count;
+        /** space in arenas */
+        size_t arenas_size;
+        /** protects arenas (nodes may be freed by another thread) */
+        pthread_mutex_t mutex;
+        /** the document is freed when this drops to 0. The owner of the
+            document holds one reference, nodes that are still waiting to 
+            be freed by another thread hold one each */
+        unsigned int holds;
+        /** indexes of nodes of this document */
+        NftPrefsNodeIndexes *indexes;
+        /** id of the context that resolves XInclude placeholders of this
+            document (0 if XIncludes are not resolved lazily) */
+        unsigned long xinclude;
+} DocInfo;
+
+
+/** namespace declaration and its copy */
+typedef struct
+{
+        xmlNs *from;
+        xmlNs *to;
+} CompactNs;
+
+
+/** state of copying a tree into an arena */
+typedef struct
+{
+        /** document that is copied */
+        xmlDoc *doc;
+        /** strings owned by this dictionary are not copied (or NULL) */
+        xmlDict *dict;
+        /** bytes needed */
+        size_t size;
+        /** next free byte of the arena */
+        char *pos;
+        /** all namespace declarations and their copies */
+        CompactNs *ns;
+        size_t ns_count;
+        size_t ns_size;
+        /** copied ID attributes, registered again once the original tree 
+            is gone */
+        xmlAttr **ids;
+        size_t ids_count;
+        size_t ids_size;
+} Compact;
+
+
+/** memory a node is freed from */
+typedef struct
+{
+        /** information about the document of the node */
+        DocInfo *info;
+        /** dictionary of the document (or NULL) */
+        xmlDict *dict;
+} Walk;
+
+
+
+
+/******************************************************************************/
+/**************************** STATIC FUNCTIONS ********************************/
+/******************************************************************************/
+
+/** get information about a document */
+static DocInfo *_doc_info(xmlDoc * doc, bool create)
+{
+        if(!doc)
+                return NULL;
+
+        /* nodes of one document may be read by several threads */
+        DocInfo *i;
+        if((i = __atomic_load_n(&doc->_private, __ATOMIC_ACQUIRE)) || !create)
+                return i;
+
+        if(!(i = calloc(1, sizeof(DocInfo))))
+        {
+                NFT_LOG_PERROR("calloc");
+                return NULL;
+        }
+
+        if(pthread_mutex_init(&i->mutex, NULL) != 0)
+        {
+                NFT_LOG(L_ERROR, "Failed to initialize mutex");
+                free(i);
+                return NULL;
+        }
+
+        i->holds = 1;
+
+        /* another thread was faster */
+        void *other = NULL;
+        if(!__atomic_compare_exchange_n(&doc->_private, &other, i, false,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+                pthread_mutex_destroy(&i->mutex);
+                free(i);
+                return other;
+        }
+
+        return i;
+}
+
+
+/** drop reference to arena. The block is released with the last reference */
+static void _arena_unref(NftPrefsArena * a)
+{
+        if(!a)
+                return;
+
+        if(__atomic_sub_fetch(&a->refs, 1, __ATOMIC_ACQ_REL) == 0)
+        {
+                free(a->base);
+                free(a);
+        }
+}
+
+
+/** keep an arena alive as long as a document exists (mutex of document must
+    be held if other threads may access it) */
+static NftResult _doc_retain(DocInfo * i, NftPrefsArena * a)
+{
+        /* position in sorted list */
+        size_t lo = 0, hi = i->arenas_count;
+        while(lo < hi)
+        {
+                size_t mid = (lo + hi) / 2;
+                if(i->arenas[mid] == a)
+                        return NFT_SUCCESS;
+                if(i->arenas[mid]->base < a->base)
+                        lo = mid + 1;
+                else
+                        hi = mid;
+        }
+
+        if(i->arenas_count >= i->arenas_size)
+        {
+                size_t size = i->arenas_size ? i->arenas_size * 2 : 4;
+                NftPrefsArena **arenas;
+                if(!(arenas = realloc(i->arenas, size * sizeof(NftPrefsArena *))))
+                {
+                        NFT_LOG_PERROR("realloc");
+                        return NFT_FAILURE;
+                }
+                i->arenas = arenas;
+                i->arenas_size = size;
+        }
+
+        memmove(&i->arenas[lo + 1], &i->arenas[lo],
+                (i->arenas_count - lo) * sizeof(NftPrefsArena *));
+        i->arenas[lo] = a;
+        i->arenas_count++;
+        __atomic_add_fetch(&a->refs, 1, __ATOMIC_RELAXED);
+
+        return NFT_SUCCESS;
+}
+
+
+/** true if memory belongs to one of the arenas of a document */
+static bool _in_arena(const DocInfo * i, const void *ptr)
+{
+        const char *p = ptr;
+        size_t lo = 0, hi = i->arenas_count;
+        while(lo < hi)
+        {
+                size_t mid = (lo + hi) / 2;
+                const NftPrefsArena *a = i->arenas[mid];
+                if(p < a->base)
+                        hi = mid;
+                else if(p >= a->base + a->size)
+                        lo = mid + 1;
+                else
+                        return true;
+        }
+
+        return false;
+}
+
+
+/** free memory unless it belongs to an arena */
+static void _walk_release(const Walk * w, void *ptr)
+{
+        if(ptr && (!w->info || !_in_arena(w->info, ptr)))
+                xmlFree(ptr);
+}
+
+
+/** free string unless it belongs to an arena or the dictionary */
+static void _walk_release_string(const Walk * w, const xmlChar * s)
+{
+        if(!s || (w->dict && xmlDictOwns(w->dict, s) == 1))
+                return;
+
+        _walk_release(w, (void *) s);
+}
+
+
+static void _walk_free_list(const Walk * w, xmlNode * n);
+
+
+/** free property like xmlFreeProp() does */
+static void _walk_free_prop(const Walk * w, xmlAttr * a)
+{
+        if(a->atype == XML_ATTRIBUTE_ID && a->doc && a->doc->ids)
+                xmlRemoveID(a->doc, a);
+
+        _walk_free_list(w, a->children);
+        _walk_release_string(w, a->name);
+        _walk_release(w, a);
+}
+
+
+/** free node like xmlFreeNode() does, skipping memory of arenas */
+static void _walk_free(const Walk * w, xmlNode * n)
+{
+        switch (n->type)
+        {
+                case XML_DTD_NODE:
+                {
+                        xmlFreeDtd((xmlDtd *) n);
+                        return;
+                }
+
+                case XML_ATTRIBUTE_NODE:
+                {
+                        _walk_free_prop(w, (xmlAttr *) n);
+                        return;
+                }
+
+                case XML_ELEMENT_NODE:
+                case XML_XINCLUDE_START:
+                case XML_XINCLUDE_END:
+                {
+                        _walk_free_list(w, n->children);
+
+                        xmlAttr *a = n->properties;
+                        while(a)
+                        {
+                                xmlAttr *next = a->next;
+                                _walk_free_prop(w, a);
+                                a = next;
+                        }
+
+                        xmlNs *ns = n->nsDef;
+                        while(ns)
+                        {
+                                xmlNs *next = ns->next;
+                                _walk_release_string(w, ns->href);
+                                _walk_release_string(w, ns->prefix);
+                                _walk_release(w, ns);
+                                ns = next;
+                        }
+                        break;
+                }
+
+                /* children & content belong to the entity */
+                case XML_ENTITY_REF_NODE:
+                {
+                        break;
+                }
+
+                default:
+                {
+                        _walk_free_list(w, n->children);
+
+                        /* content stored inside the node itself 
+                           (XML_PARSE_COMPACT) */
+                        if(n->content != (xmlChar *) & (n->properties))
+                                _walk_release_string(w, n->content);
+                        break;
+                }
+        }
+
+        /* names of text & comment nodes are static strings */
+        if(n->type != XML_TEXT_NODE && n->type != XML_COMMENT_NODE)
+                _walk_release_string(w, n->name);
+
+        _walk_release(w, n);
+}
+
+
+/** free list of siblings */
+static void _walk_free_list(const Walk * w, xmlNode * n)
+{
+        while(n)
+        {
+                xmlNode *next = n->next;
+                _walk_free(w, n);
+                n = next;
+        }
+}
+
+
+/** drop pointer to a string of the dictionary (if dict is not NULL) */
+static void _detach_string(xmlDict * dict, const xmlChar ** s)
+{
+        if(dict && *s && xmlDictOwns(dict, *s) == 1)
+                *s = NULL;
+}
+
+
+static void _detach_list(xmlDoc * doc, xmlDict * dict, xmlNode * n);
+
+
+/** remove IDs of a node and drop its strings of the dictionary */
+static void _detach(xmlDoc * doc, xmlDict * dict, xmlNode * n)
+{
+        switch (n->type)
+        {
+                case XML_ELEMENT_NODE:
+                case XML_XINCLUDE_START:
+                case XML_XINCLUDE_END:
+                {
+                        for(xmlAttr * a = n->properties; a; a = a->next)
+                        {
+                                if(a->atype == XML_ATTRIBUTE_ID)
+                                {
+                                        if(doc->ids)
+                                                xmlRemoveID(doc, a);
+                                        a->atype = 0;
+                                }
+
+                                _detach_string(dict, &a->name);
+                                _detach_list(doc, dict, a->children);
+                        }
+
+                        for(xmlNs * ns = n->nsDef; ns; ns = ns->next)
+                        {
+                                _detach_string(dict, &ns->href);
+                                _detach_string(dict, &ns->prefix);
+                        }
+                        break;
+                }
+
+                /* children & content belong to the entity */
+                case XML_ENTITY_REF_NODE:
+                {
+                        _detach_string(dict, &n->name);
+                        return;
+                }
+
+                default:
+                {
+                        if(n->content != (xmlChar *) & (n->properties))
+                                _detach_string(dict, (const xmlChar **) &n->content);
+                        break;
+                }
+        }
+
+        if(n->type != XML_TEXT_NODE && n->type != XML_COMMENT_NODE)
+                _detach_string(dict, &n->name);
+
+        _detach_list(doc, dict, n->children);
+}
+
+
+/** detach list of siblings */
+static void _detach_list(xmlDoc * doc, xmlDict * dict, xmlNode * n)
+{
+        for(; n; n = n->next)
+                _detach(doc, dict, n);
+}
+
+
+/** add size of a string copied into an arena */
+static void _compact_size_string(Compact * c, const xmlChar * s)
+{
+        if(s && !(c->dict && xmlDictOwns(c->dict, s) == 1))
+                c->size += ARENA_ROUND((size_t) xmlStrlen(s) + 1);
+}
+
+
+/** add size of list of siblings copied into an arena. Returns false if the
+    list contains nodes that can't be copied */
+static bool _compact_size(Compact * c, xmlNode * n)
+{
+        for(; n; n = n->next)
+        {
+                c->size += ARENA_ROUND(sizeof(xmlNode));
+                if(n->type != XML_TEXT_NODE && n->type != XML_COMMENT_NODE)
+                        _compact_size_string(c, n->name);
+
+                switch (n->type)
+                {
+                        case XML_ELEMENT_NODE:
+                        case XML_XINCLUDE_START:
+                        case XML_XINCLUDE_END:
+                        {
+                                for(xmlNs * ns = n->nsDef; ns; ns = ns->next)
+                                {
+                                        c->size += ARENA_ROUND(sizeof(xmlNs));
+                                        _compact_size_string(c, ns->href);
+                                        _compact_size_string(c, ns->prefix);
+                                        c->ns_size++;
+                                }
+
+                                for(xmlAttr * a = n->properties; a; a = a->next)
+                                {
+                                        c->size += ARENA_ROUND(sizeof(xmlAttr));
+                                        _compact_size_string(c, a->name);
+                                        if(a->atype == XML_ATTRIBUTE_ID)
+                                                c->ids_size++;
+                                        if(!_compact_size(c, a->children))
+                                                return false;
+                                }
+                                break;
+                        }
+
+                        case XML_ENTITY_REF_NODE:
+                        {
+                                continue;
+                        }
+
+                        case XML_TEXT_NODE:
+                        case XML_CDATA_SECTION_NODE:
+                        case XML_COMMENT_NODE:
+                        case XML_PI_NODE:
+                        {
+                                if(n->content != (xmlChar *) & (n->properties))
+                                        _compact_size_string(c, n->content);
+                                break;
+                        }
+
+                        default:
+                        {
+                                return false;
+                        }
+                }
+
+                if(!_compact_size(c, n->children))
+                        return false;
+        }
+
+        return true;
+}
+
+
+/** take block from arena */
+static void *_compact_alloc(Compact * c, size_t size)
+{
+        void *r = c->pos;
+        c->pos += ARENA_ROUND(size);
+        return r;
+}
+
+
+/** copy string into arena (unless it's owned by the dictionary) */
+static xmlChar *_compact_string(Compact * c, const xmlChar * s)
+{
+        if(!s || (c->dict && xmlDictOwns(c->dict, s) == 1))
+                return (xmlChar *) s;
+
+        size_t length = (size_t) xmlStrlen(s) + 1;
+        xmlChar *r = _compact_alloc(c, length);
+        memcpy(r, s, length);
+        return r;
+}
+
+
+static xmlNode *_compact_list(Compact * c, xmlNode * n, xmlNode * parent);
+
+
+/** copy node into arena. Namespaces still refer to the original 
+    declarations (s. _compact_ns()) */
+static xmlNode *_compact_node(Compact * c, xmlNode * n, xmlNode * parent)
+{
+        xmlNode *copy = _compact_alloc(c, sizeof(xmlNode));
+        memcpy(copy, n, sizeof(xmlNode));
+        copy->parent = parent;
+        copy->prev = copy->next = NULL;
+        copy->psvi = NULL;
+
+        if(n->type != XML_TEXT_NODE && n->type != XML_COMMENT_NODE)
+                copy->name = _compact_string(c, n->name);
+
+        switch (n->type)
+        {
+                case XML_ELEMENT_NODE:
+                case XML_XINCLUDE_START:
+                case XML_XINCLUDE_END:
+                {
+                        xmlNs **ns = &copy->nsDef;
+                        for(xmlNs * d = n->nsDef; d; d = d->next)
+                        {
+                                *ns = _compact_alloc(c, sizeof(xmlNs));
+                                memcpy(*ns, d, sizeof(xmlNs));
+                                (*ns)->href = _compact_string(c, d->href);
+                                (*ns)->prefix = _compact_string(c, d->prefix);
+                                c->ns[c->ns_count].from = d;
+                                c->ns[c->ns_count++].to = *ns;
+                                ns = &(*ns)->next;
+                        }
+                        *ns = NULL;
+
+                        xmlAttr *prev = NULL;
+                        copy->properties = NULL;
+                        for(xmlAttr * a = n->properties; a; a = a->next)
+                        {
+                                xmlAttr *p = _compact_alloc(c, sizeof(xmlAttr));
+                                memcpy(p, a, sizeof(xmlAttr));
+                                p->parent = copy;
+                                p->prev = prev;
+                                p->next = NULL;
+                                p->psvi = NULL;
+                                p->name = _compact_string(c, a->name);
+                                p->children = _compact_list(c, a->children,
+                                                            (xmlNode *) p);
+                                if(a->atype == XML_ATTRIBUTE_ID)
+                                        c->ids[c->ids_count++] = p;
+
+                                if(prev)
+                                        prev->next = p;
+                                else
+                                        copy->properties = p;
+                                prev = p;
+                        }
+                        break;
+                }
+
+                /* children & content belong to the entity */
+                case XML_ENTITY_REF_NODE:
+                {
+                        return copy;
+                }
+
+                default:
+                {
+                        if(n->content == (xmlChar *) & (n->properties))
+                                copy->content = (xmlChar *) & (copy->properties);
+                        else
+                                copy->content = _compact_string(c, n->content);
+                        break;
+                }
+        }
+
+        copy->children = _compact_list(c, n->children, copy);
+
+        return copy;
+}
+
+
+/** copy list of siblings into arena */
+static xmlNode *_compact_list(Compact * c, xmlNode * n, xmlNode * parent)
+{
+        xmlNode *first = NULL, *last = NULL;
+        for(; n; n = n->next)
+        {
+                xmlNode *copy = _compact_node(c, n, parent);
+                copy->prev = last;
+                if(last)
+                        last->next = copy;
+                else
+                        first = copy;
+                last = copy;
+        }
+
+        /* xmlAttr has children & last at the same place */
+        parent->last = last;
+
+        return first;
+}
+
+
+/** order of namespace declarations */
+static int _compact_ns_cmp(const void *a, const void *b)
+{
+        const xmlNs *x = ((const CompactNs *) a)->from;
+        const xmlNs *y = ((const CompactNs *) b)->from;
+
+        return (x > y) - (x < y);
+}
+
+
+/** make namespace of a copied node refer to the copied declaration */
+static bool _compact_ns_fix(Compact * c, xmlNs ** ns)
+{
+        if(!*ns)
+                return true;
+
+        CompactNs key = { *ns, NULL }, *found;
+        if((found = bsearch(&key, c->ns, c->ns_count, sizeof(CompactNs),
+                            _compact_ns_cmp)))
+        {
+                *ns = found->to;
+                return true;
+        }
+
+        /* declarations of the document itself are kept */
+        for(xmlNs * d = c->doc->oldNs; d; d = d->next)
+        {
+                if(d == *ns)
+                        return true;
+        }
+
+        return false;
+}
+
+
+/** fix namespaces of all copied nodes */
+static bool _compact_ns(Compact * c, xmlNode * n)
+{
+        for(; n; n = n->next)
+        {
+                if(n->type != XML_ELEMENT_NODE && n->type != XML_XINCLUDE_START &&
+                   n->type != XML_XINCLUDE_END)
+                        continue;
+
+                if(!_compact_ns_fix(c, &n->ns))
+                        return false;
+
+                for(xmlAttr * a = n->properties; a; a = a->next)
+                {
+                        if(!_compact_ns_fix(c, &a->ns))
+                                return false;
+                }
+
+                if(!_compact_ns(c, n->children))
+                        return false;
+        }
+
+        return true;
+}
+
+
+/** move indexes of original nodes to their copies */
+static void _compact_indexes(xmlNode * from, xmlNode * to)
+{
+        for(; from; from = from->next, to = to->next)
+        {
+                if(from->type != XML_ELEMENT_NODE)
+                        continue;
+
+                _node_index_rekey(from, to);
+                _compact_indexes(from->children, to->children);
+        }
+}
+
+
+/** free document and drop all arena references held by it */
+static void _doc_destroy(xmlDoc * doc, DocInfo * i)
+{
+        /* tree is freed here, DTDs by xmlFreeDoc() */
+        if(i->arenas_count)
+        {
+                Walk w = { i, doc->dict };
+                xmlNode *n = doc->children;
+                doc->children = doc->last = NULL;
+                while(n)
+                {
+                        xmlNode *next = n->next;
+                        n->prev = n->next = NULL;
+
+                        /* only walk the tree if it contains memory that
+                           isn't released together with the arenas */
+                        if(n->type != XML_DTD_NODE && (!i->arena || i->mixed))
+                                _walk_free(&w, n);
+                        n = next;
+                }
+        }
+
+        doc->_private = NULL;
+        xmlFreeDoc(doc);
+
+        for(size_t a = 0; a < i->arenas_count; a++)
+                _arena_unref(i->arenas[a]);
+
+        _node_index_free_all(i->indexes);
+        pthread_mutex_destroy(&i->mutex);
+        free(i->arenas);
+        free(i);
+}
+
+
+/******************************************************************************/
+/**************************** PRIVATE FUNCTIONS *******************************/
+/******************************************************************************/
+
+/** copy the complete tree of a document into an arena of its own and free 
+    the original nodes. Afterwards the tree must only be modified by functions
+    that are aware of arenas. Pointers to nodes of the original tree become
+    invalid, so this is done once a tree has been created. Documents that 
+    already contain nodes of an arena are left as they are */
+NftResult _arena_doc_compact(xmlDoc * doc)
+{
+        if(!doc || _arena_doc_needs_tracking(doc))
+                return NFT_SUCCESS;
+
+        /* bytes needed */
+        Compact c = { .doc = doc, .dict = doc->dict };
+        for(xmlNode * n = doc->children; n; n = n->next)
+        {
+                if(n->type == XML_DTD_NODE)
+                        continue;
+
+                xmlNode *next = n->next;
+                n->next = NULL;
+                bool ok = _compact_size(&c, n);
+                n->next = next;
+                if(!ok)
+                {
+                        NFT_LOG(L_DEBUG, "Tree contains nodes that can't be copied to an arena");
+                        return NFT_SUCCESS;
+                }
+        }
+
+        if(c.size == 0)
+                return NFT_SUCCESS;
+
+        NftResult r = NFT_FAILURE;
+        NftPrefsArena *a;
+        if(!(a = calloc(1, sizeof(NftPrefsArena))))
+        {
+                NFT_LOG_PERROR("calloc");
+                return NFT_FAILURE;
+        }
+
+        DocInfo *i;
+        if(!(i = _doc_info(doc, true)))
+                goto _adc_exit;
+
+        if(!(a->base = malloc(c.size)) ||
+           !(c.ns = malloc((c.ns_size ? c.ns_size : 1) * sizeof(CompactNs))) ||
+           !(c.ids = malloc((c.ids_size ? c.ids_size : 1) * sizeof(xmlAttr *))))
+        {
+                NFT_LOG_PERROR("malloc");
+                goto _adc_exit;
+        }
+        a->size = c.size;
+        c.pos = a->base;
+
+        /* copy all nodes (except the DTD) */
+        xmlNode *first = NULL, *last = NULL;
+        for(xmlNode * n = doc->children; n; n = n->next)
+        {
+                if(n->type == XML_DTD_NODE)
+                        continue;
+
+                xmlNode *copy = _compact_node(&c, n, (xmlNode *) doc);
+                copy->prev = last;
+                if(last)
+                        last->next = copy;
+                else
+                        first = copy;
+                last = copy;
+        }
+
+        qsort(c.ns, c.ns_count, sizeof(CompactNs), _compact_ns_cmp);
+        if(!_compact_ns(&c, first))
+        {
+                NFT_LOG(L_DEBUG, "Tree refers to namespaces declared outside of it");
+                r = NFT_SUCCESS;
+                goto _adc_exit;
+        }
+
+        if(!_doc_retain(i, a))
+                goto _adc_exit;
+        i->arena = a;
+
+        /* replace original nodes by their copies, the DTD stays */
+        xmlNode *n = doc->children, *copy = first, *orig = NULL;
+        doc->children = doc->last = NULL;
+        while(n)
+        {
+                xmlNode *next = n->next, *k = n;
+                if(n->type != XML_DTD_NODE)
+                {
+                        n->next = NULL;
+                        if(i->indexes)
+                                _compact_indexes(n, copy);
+
+                        n->next = orig;
+                        orig = n;
+                        k = copy;
+                        copy = copy->next;
+                }
+
+                k->prev = doc->last;
+                if(doc->last)
+                        doc->last->next = k;
+                else
+                        doc->children = k;
+                doc->last = k;
+                n = next;
+        }
+        doc->last->next = NULL;
+
+        /* free original nodes */
+        while(orig)
+        {
+                xmlNode *next = orig->next;
+                xmlFreeNode(orig);
+                orig = next;
+        }
+
+        /* IDs declared by the DTD */
+        for(size_t id = 0; id < c.ids_count; id++)
+        {
+                xmlChar *value;
+                if((value = xmlNodeListGetString(doc, c.ids[id]->children, 1)))
+                {
+                        xmlAddID(NULL, doc, value, c.ids[id]);
+                        xmlFree(value);
+                }
+        }
+
+        r = NFT_SUCCESS;
+
+_adc_exit:
+        free(c.ns);
+        free(c.ids);
+        if(!i || i->arena != a)
+        {
+                free(a->base);
+                free(a);
+        }
+        return r;
+}
+
+
+/** nodes are moved from one document to another - make sure "to" keeps all
+    arenas used by "from" alive */
+NftResult _arena_doc_adopt(xmlDoc * to, xmlDoc * from)
+{
+        DocInfo *fi = _doc_info(from, false);
+        DocInfo *ti = _doc_info(to, false);
+
+        /* placeholders are resolved by the context of their new document */
+        if(fi && fi->xinclude && !(ti && ti->xinclude))
+        {
+                if(!(ti = _doc_info(to, true)))
+                        return NFT_FAILURE;
+                ti->xinclude = fi->xinclude;
+        }
+
+        /* memory not allocated from an arena ends up in an arena document */
+        if(ti && ti->arena && (!fi || !fi->arena || fi->mixed))
+                ti->mixed = true;
+
+        if(!fi || !fi->arenas_count)
+                return NFT_SUCCESS;
+
+        if(!(ti = _doc_info(to, true)))
+                return NFT_FAILURE;
+
+        NftResult r = NFT_SUCCESS;
+        pthread_mutex_lock(&ti->mutex);
+        for(size_t a = 0; r && a < fi->arenas_count; a++)
+                r = _doc_retain(ti, fi->arenas[a]);
+        pthread_mutex_unlock(&ti->mutex);
+
+        return r;
+}
+
+
+/** true if nodes of this document contain memory allocated from arenas */
+bool _arena_doc_needs_tracking(xmlDoc * doc)
+{
+        DocInfo *i = _doc_info(doc, false);
+
+        return i && i->arenas_count;
+}
+
+
+/** memory not allocated from an arena is added to a document */
+void _arena_doc_modified(xmlDoc * doc)
+{
+        DocInfo *i = _doc_info(doc, false);
+
+        if(i && i->arena)
+                i->mixed = true;
+}
+
+
+/** free node (or property) that has already been unlinked from its 
+    document. Unlike xmlFreeNode() this never frees memory of arenas */
+void _arena_node_free(xmlNode * n)
+{
+        DocInfo *i = _doc_info(n->doc, false);
+
+        if(!i || !i->arenas_count)
+        {
+                if(n->type == XML_ATTRIBUTE_NODE)
+                        xmlFreeProp((xmlAttr *) n);
+                else
+                        xmlFreeNode(n);
+                return;
+        }
+
+        pthread_mutex_lock(&i->mutex);
+
+        /* memory is released together with the arena (IDs have to be 
+           removed though) */
+        if(!i->arena || i->mixed || n->doc->ids || !_in_arena(i, n))
+        {
+                Walk w = { i, n->doc->dict };
+                _walk_free(&w, n);
+        }
+
+        pthread_mutex_unlock(&i->mutex);
+}
+
+
+/** prepare an unlinked node to be freed by another thread with 
+    _arena_node_free_detached(). IDs are removed and strings of the 
+    dictionary are dropped from the node, since neither the dictionary nor
+    the ID table may be used by two threads at once. Returns false if 
+    nothing of the node has to be freed (it's released with its arena) */
+bool _arena_node_detach(xmlNode * n)
+{
+        xmlDoc *doc;
+        if(!(doc = n->doc))
+                return true;
+
+        DocInfo *i = _doc_info(doc, false);
+        bool heap = !i || !i->arena || i->mixed || !_in_arena(i, n);
+        if(heap || doc->ids)
+                _detach(doc, heap ? doc->dict : NULL, n);
+
+        return heap;
+}
+
+
+/** free node prepared by _arena_node_detach() (the dictionary & ID table 
+    of its document are not accessed) */
+void _arena_node_free_detached(xmlNode * n)
+{
+        DocInfo *i = _doc_info(n->doc, false);
+        Walk w = { i, NULL };
+
+        if(i)
+                pthread_mutex_lock(&i->mutex);
+
+        _walk_free(&w, n);
+
+        if(i)
+                pthread_mutex_unlock(&i->mutex);
+}
+
+
+/** prepare document to be freed by another thread. DTDs and ID tables are
+    freed right away, strings of the dictionary are dropped from the tree 
+    and the reference to the dictionary is released */
+void _arena_doc_detach(xmlDoc * doc)
+{
+        xmlDict *dict;
+        if(!(dict = doc->dict))
+                return;
+
+        /* like xmlFreeDoc() does */
+        xmlDtd *ext = doc->extSubset, *in = doc->intSubset;
+        if(ext == in)
+                ext = NULL;
+        if(ext)
+        {
+                xmlUnlinkNode((xmlNode *) ext);
+                doc->extSubset = NULL;
+                xmlFreeDtd(ext);
+        }
+        if(in)
+        {
+                xmlUnlinkNode((xmlNode *) in);
+                doc->intSubset = NULL;
+                xmlFreeDtd(in);
+        }
+
+        if(doc->ids)
+        {
+                xmlFreeIDTable(doc->ids);
+                doc->ids = NULL;
+        }
+        if(doc->refs)
+        {
+                xmlFreeRefTable(doc->refs);
+                doc->refs = NULL;
+        }
+
+        /* trees kept in an arena only are not walked when freed */
+        DocInfo *i = _doc_info(doc, false);
+        if(!i || !i->arena || i->mixed)
+                _detach_list(doc, dict, doc->children);
+
+        _detach_string(dict, &doc->version);
+        _detach_string(dict, &doc->encoding);
+        _detach_string(dict, &doc->URL);
+        _detach_string(dict, (const xmlChar **) &doc->name);
+
+        doc->dict = NULL;
+        xmlDictFree(dict);
+}
+
+
+/** free string of a node of a document unless it belongs to an arena or 
+    the dictionary of the document */
+void _arena_string_free(xmlDoc * doc, const xmlChar * s)
+{
+        Walk w = { _doc_info(doc, false), doc ? doc->dict : NULL };
+
+        if(!s || (w.dict && xmlDictOwns(w.dict, s) == 1))
+                return;
+
+        if(!w.info || !w.info->arenas_count)
+                xmlFree((xmlChar *) s);
+        else
+                _walk_release(&w, (void *) s);
+}
+
+
+/** replace content of text node like xmlNodeSetContent() does. Ownership of
+    content (allocated with xmlMalloc() or owned by the dictionary of the 
+    document) is taken over */
+void _arena_node_set_content(xmlNode * n, xmlChar * content)
+{
+        /* content stored inside the node itself (XML_PARSE_COMPACT) */
+        if(n->content != (xmlChar *) & (n->properties))
+                _arena_string_free(n->doc, n->content);
+
+        n->content = content;
+        n->properties = NULL;
+
+        _arena_doc_modified(n->doc);
+}
+
+
+/** replace name of node like xmlNodeSetName() does */
+NftResult _arena_node_set_name(xmlNode * n, const xmlChar * name)
+{
+        xmlDict *dict = n->doc ? n->doc->dict : NULL;
+        const xmlChar *copy;
+        if(!(copy = dict ? xmlDictLookup(dict, name, -1) : xmlStrdup(name)))
+                return NFT_FAILURE;
+
+        _arena_string_free(n->doc, n->name);
+        n->name = copy;
+
+        _arena_doc_modified(n->doc);
+
+        return NFT_SUCCESS;
+}
+
+
+/** free document (or drop the reference of its owner if nodes of the 
+    document are still waiting to be freed) */
+void _arena_doc_free(xmlDoc * doc)
+{
+        DocInfo *i;
+        if(!(i = _doc_info(doc, false)))
+        {
+                xmlFreeDoc(doc);
+                return;
+        }
+
+        /* nodes that are still waiting to be freed by the reclaimer 
+           (s. reclaim.c) might let that thread free the document */
+        if(__atomic_load_n(&i->holds, __ATOMIC_ACQUIRE) > 1)
+                _arena_doc_detach(doc);
+
+        _arena_doc_release(doc);
+}
+
+
+/** keep document alive until _arena_doc_release() is called */
+NftResult _arena_doc_hold(xmlDoc * doc)
+{
+        DocInfo *i;
+        if(!(i = _doc_info(doc, true)))
+                return NFT_FAILURE;
+
+        __atomic_add_fetch(&i->holds, 1, __ATOMIC_RELAXED);
+
+        return NFT_SUCCESS;
+}
+
+
+/** drop reference to document acquired by _arena_doc_hold() */
+void _arena_doc_release(xmlDoc * doc)
+{
+        DocInfo *i = _doc_info(doc, false);
+
+        if(__atomic_sub_fetch(&i->holds, 1, __ATOMIC_ACQ_REL) == 0)
+                _doc_destroy(doc, i);
+}
+
+
+/** let context resolve XInclude placeholders of a document 
+    (s. _xinclude_defer()) */
+NftResult _arena_doc_set_xinclude(xmlDoc * doc, unsigned long context)
+{
+        DocInfo *i;
+        if(!(i = _doc_info(doc, true)))
+                return NFT_FAILURE;
+
+        i->xinclude = context;
+
+        return NFT_SUCCESS;
+}
+
+
+/** get id of context that resolves XInclude placeholders of a document 
+    (0 if there is none) */
+unsigned long _arena_doc_get_xinclude(xmlDoc * doc)
+{
+        DocInfo *i = _doc_info(doc, false);
+
+        return i ? i->xinclude : 0;
+}
+
+
+/** get indexes of the nodes of a document (or NULL) */
+NftPrefsNodeIndexes **_arena_doc_indexes(xmlDoc * doc, bool create)
+{
+        DocInfo *i;
+        if(!(i = _doc_info(doc, create)))
+                return NULL;
+
+        return &i->indexes;
+}
+
+
+/**
+ * @}
+ */
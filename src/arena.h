@@ -0,0 +1,81 @@
+/*
+ * libniftyprefs - lightweight modelless preferences management library
+ * Copyright (C) 2006-2014 Daniel Hiepler <daniel@niftylight.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _ARENA_H
+#define _ARENA_H
+
+
+#include <libxml/tree.h>
+#include "niftyprefs.h"
+
+
+/** block of memory the nodes & strings of a complete tree are copied into */
+typedef struct _NftPrefsArena NftPrefsArena;
+
+/** index of the children of a node (s. node-index.c) */
+typedef struct _NftPrefsNodeIndex NftPrefsNodeIndex;
+
+/** indexes of all nodes of a document (s. node-index.c) */
+typedef struct _NftPrefsNodeIndexes NftPrefsNodeIndexes;
+
+
+NftResult                       _arena_doc_compact(xmlDoc * doc);
+NftResult                       _arena_doc_adopt(xmlDoc * to, xmlDoc * from);
+bool                            _arena_doc_needs_tracking(xmlDoc * doc);
+void                            _arena_doc_modified(xmlDoc * doc);
+void                            _arena_node_free(xmlNode * n);
+bool                            _arena_node_detach(xmlNode * n);
+void                            _arena_node_free_detached(xmlNode * n);
+void                            _arena_doc_detach(xmlDoc * doc);
+void                            _arena_string_free(xmlDoc * doc, const xmlChar * s);
+void                            _arena_node_set_content(xmlNode * n, xmlChar * content);
+NftResult                       _arena_node_set_name(xmlNode * n, const xmlChar * name);
+void                            _arena_doc_free(xmlDoc * doc);
+NftResult                       _arena_doc_hold(xmlDoc * doc);
+void                            _arena_doc_release(xmlDoc * doc);
+NftResult                       _arena_doc_set_xinclude(xmlDoc * doc, unsigned long context);
+unsigned long                   _arena_doc_get_xinclude(xmlDoc * doc);
+NftPrefsNodeIndexes **          _arena_doc_indexes(xmlDoc * doc, bool create);
+
+
+#endif /** _ARENA_H */
@@ -0,0 +1,367 @@
+/*
+ * libniftyprefs - lightweight modelless preferences management library
+ * Copyright (C) 2006-2014 Daniel Hiepler <daniel@niftylight.de>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/**
+ * @file base64.c
+ *
+ * base64 (RFC 4648, with padding) encoding & decoding of array properties.
+ * Decoding translates & validates 32 (AVX2) or 16 (SSE2) characters at 
+ * once and falls back to a lookup table for the rest of the input and for
+ * blocks with invalid characters (which are reported by the table lookup 
+ * then). AVX2 is used if the CPU supports it at runtime.
+ */
+
+/**
+ * @addtogroup prefs_node
+ * @{
+ *
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "base64.h"
+
+#if defined(__SSE2__)
+#define BASE64_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BASE64_AVX2
+#include <immintrin.h>
+#endif
+
+
+
+/** characters of encoded 6-bit values */
+static const char _alphabet[64] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/** 6-bit values of characters (255 for invalid characters) */
+static const unsigned char _values[256] =
+{
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,  62, 255, 255, 255,  63,
+         52,  53,  54,  55,  56,  57,  58,  59,  60,  61, 255, 255, 255, 255, 255, 255,
+        255,   0,   1,   2,   3,   4,   5,   6,   7,   8,   9,  10,  11,  12,  13,  14,
+         15,  16,  17,  18,  19,  20,  21,  22,  23,  24,  25, 255, 255, 255, 255, 255,
+        255,  26,  27,  28,  29,  30,  31,  32,  33,  34,  35,  36,  37,  38,  39,  40,
+         41,  42,  43,  44,  45,  46,  47,  48,  49,  50,  51, 255, 255, 255, 255, 255,
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255
+};
+
+
+
+/******************************************************************************/
+/**************************** STATIC FUNCTIONS ********************************/
+/******************************************************************************/
+
+/** decode blocks of 4 characters, returns false on invalid characters */
+static bool _decode_scalar(const unsigned char *s, size_t blocks,
+                           unsigned char *out)
+{
+        for(size_t i = 0; i < blocks; i++, s += 4, out += 3)
+        {
+                uint32_t a = _values[s[0]], b = _values[s[1]];
+                uint32_t c = _values[s[2]], d = _values[s[3]];
+                if((a | b | c | d) & 0x80)
+                        return false;
+
+                uint32_t v = a << 18 | b << 12 | c << 6 | d;
+                out[0] = (unsigned char) (v >> 16);
+                out[1] = (unsigned char) (v >> 8);
+                out[2] = (unsigned char) v;
+        }
+
+        return true;
+}
+
+
+#ifdef BASE64_SSE2
+/** decode 16 characters at once as long as they're valid. Returns amount of
+    characters decoded */
+static size_t _decode_sse2(const unsigned char *s, size_t length,
+                           unsigned char *out)
+{
+        size_t done = 0;
+        for(; done + 16 <= length; done += 16, out += 12)
+        {
+                __m128i v = _mm_loadu_si128((const __m128i *) &s[done]);
+
+                /* character classes (bytes >= 0x80 are negative and match 
+                   none of them) */
+                __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('A' - 1)),
+                                              _mm_cmplt_epi8(v, _mm_set1_epi8('Z' + 1)));
+                __m128i lower = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('a' - 1)),
+                                              _mm_cmplt_epi8(v, _mm_set1_epi8('z' + 1)));
+                __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)),
+                                              _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+                __m128i plus = _mm_cmpeq_epi8(v, _mm_set1_epi8('+'));
+                __m128i slash = _mm_cmpeq_epi8(v, _mm_set1_epi8('/'));
+
+                __m128i valid = _mm_or_si128(_mm_or_si128(upper, lower),
+                                             _mm_or_si128(digit, _mm_or_si128(plus, slash)));
+                if(_mm_movemask_epi8(valid) != 0xffff)
+                        break;
+
+                /* translate characters to 6-bit values */
+                __m128i offset = _mm_or_si128(
+                        _mm_or_si128(_mm_and_si128(upper, _mm_set1_epi8(-'A')),
+                                     _mm_and_si128(lower, _mm_set1_epi8(26 - 'a'))),
+                        _mm_or_si128(_mm_and_si128(digit, _mm_set1_epi8(52 - '0')),
+                                     _mm_or_si128(_mm_and_si128(plus, _mm_set1_epi8(62 - '+')),
+                                                  _mm_and_si128(slash, _mm_set1_epi8(63 - '/')))));
+                v = _mm_add_epi8(v, offset);
+
+                /* merge 4 x 6 bits of every 32 bit lane to 24 bits */
+                __m128i pairs = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(v, _mm_set1_epi16(0xff)), 6),
+                                             _mm_srli_epi16(v, 8));
+                __m128i merged = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+
+                uint32_t lanes[4];
+                _mm_storeu_si128((__m128i *) lanes, merged);
+                for(int i = 0; i < 4; i++)
+                {
+                        out[3 * i] = (unsigned char) (lanes[i] >> 16);
+                        out[3 * i + 1] = (unsigned char) (lanes[i] >> 8);
+                        out[3 * i + 2] = (unsigned char) lanes[i];
+                }
+        }
+
+        return done;
+}
+#endif
+
+
+#ifdef BASE64_AVX2
+/** decode 32 characters at once as long as they're valid and at least 32 
+    bytes of output space are left. Returns amount of characters decoded */
+__attribute__((target("avx2")))
+static size_t _decode_avx2(const unsigned char *s, size_t length,
+                           unsigned char *out, size_t space)
+{
+        size_t done = 0;
+        for(; done + 32 <= length && space >= 32; done += 32, out += 24, space -= 24)
+        {
+                __m256i v = _mm256_loadu_si256((const __m256i *) &s[done]);
+
+                /* character classes (bytes >= 0x80 are negative and match 
+                   none of them) */
+                __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('A' - 1)),
+                                                 _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), v));
+                __m256i lower = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('a' - 1)),
+                                                 _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), v));
+                __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('0' - 1)),
+                                                 _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), v));
+                __m256i plus = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('+'));
+                __m256i slash = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('/'));
+
+                __m256i valid = _mm256_or_si256(_mm256_or_si256(upper, lower),
+                                                _mm256_or_si256(digit, _mm256_or_si256(plus, slash)));
+                if(_mm256_movemask_epi8(valid) != -1)
+                        break;
+
+                /* translate characters to 6-bit values */
+                __m256i offset = _mm256_or_si256(
+                        _mm256_or_si256(_mm256_and_si256(upper, _mm256_set1_epi8(-'A')),
+                                        _mm256_and_si256(lower, _mm256_set1_epi8(26 - 'a'))),
+                        _mm256_or_si256(_mm256_and_si256(digit, _mm256_set1_epi8(52 - '0')),
+                                        _mm256_or_si256(_mm256_and_si256(plus, _mm256_set1_epi8(62 - '+')),
+                                                        _mm256_and_si256(slash, _mm256_set1_epi8(63 - '/')))));
+                v = _mm256_add_epi8(v, offset);
+
+                /* merge 4 x 6 bits of every 32 bit lane to 24 bits */
+                __m256i pairs = _mm256_maddubs_epi16(v, _mm256_set1_epi32(0x01400140));
+                __m256i merged = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+
+                /* 3 bytes of every lane in big endian order, 12 bytes per 
+                   128 bit half, then both halves next to each other */
+                __m256i bytes = _mm256_shuffle_epi8(merged, _mm256_setr_epi8(
+                        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+                bytes = _mm256_permutevar8x32_epi32(bytes, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+
+                _mm256_storeu_si256((__m256i *) out, bytes);
+        }
+
+        return done;
+}
+
+
+/** whether the CPU supports AVX2 */
+static bool _have_avx2(void)
+{
+        static int have = -1;
+        if(have < 0)
+        {
+                __builtin_cpu_init();
+                have = __builtin_cpu_supports("avx2") ? 1 : 0;
+        }
+
+        return have;
+}
+#endif
+
+
+
+/******************************************************************************/
+/**************************** PRIVATE FUNCTIONS *******************************/
+/******************************************************************************/
+
+/** length of base64 representation of length bytes (without '\0') */
+size_t _base64_encoded_length(size_t length)
+{
+        return (length + 2) / 3 * 4;
+}
+
+
+/** encode bytes (out must hold _base64_encoded_length() + 1 chars) */
+void _base64_encode(const unsigned char *data, size_t length, char *out)
+{
+        size_t i = 0;
+        for(; i + 3 <= length; i += 3, out += 4)
+        {
+                uint32_t v = (uint32_t) data[i] << 16 |
+                        (uint32_t) data[i + 1] << 8 | data[i + 2];
+                out[0] = _alphabet[v >> 18];
+                out[1] = _alphabet[(v >> 12) & 0x3f];
+                out[2] = _alphabet[(v >> 6) & 0x3f];
+                out[3] = _alphabet[v & 0x3f];
+        }
+
+        if(i < length)
+        {
+                uint32_t v = (uint32_t) data[i] << 16;
+                if(i + 1 < length)
+                        v |= (uint32_t) data[i + 1] << 8;
+
+                out[0] = _alphabet[v >> 18];
+                out[1] = _alphabet[(v >> 12) & 0x3f];
+                out[2] = i + 1 < length ? _alphabet[(v >> 6) & 0x3f] : '=';
+                out[3] = '=';
+                out += 4;
+        }
+
+        *out = '\0';
+}
+
+
+/** get amount of bytes encoded by base64 string, false if its length is 
+    invalid */
+bool _base64_decoded_length(const char *s, size_t length, size_t * decoded)
+{
+        if(length % 4)
+                return false;
+
+        size_t padding = 0;
+        if(length && s[length - 1] == '=')
+                padding = (length >= 2 && s[length - 2] == '=') ? 2 : 1;
+
+        *decoded = length / 4 * 3 - padding;
+
+        return true;
+}
+
+
+/** decode base64 string (out must hold _base64_decoded_length() bytes),
+    false if it's invalid */
+bool _base64_decode(const char *s, size_t length, unsigned char *out)
+{
+        size_t decoded;
+        if(!_base64_decoded_length(s, length, &decoded))
+                return false;
+
+        /* last block with padding is decoded separately */
+        size_t full = decoded / 3 * 4;
+        const unsigned char *in = (const unsigned char *) s;
+        size_t done = 0;
+
+#ifdef BASE64_AVX2
+        if(_have_avx2())
+                done = _decode_avx2(in, full, out, decoded);
+#endif
+#ifdef BASE64_SSE2
+        done += _decode_sse2(&in[done], full - done, &out[done / 4 * 3]);
+#endif
+
+        if(!_decode_scalar(&in[done], (full - done) / 4, &out[done / 4 * 3]))
+                return false;
+
+        /* remaining 1 or 2 bytes */
+        size_t rest = decoded - full / 4 * 3;
+        if(rest)
+        {
+                unsigned char block[4], bytes[3];
+                memcpy(block, &in[full], 4);
+                block[3] = 'A';
+                if(rest == 1)
+                        block[2] = 'A';
+                else if(in[full + 2] == '=')
+                        return false;
+
+                if(!_decode_scalar(block, 1, bytes))
+                        return false;
+
+                /* unused bits must be zero */
+                if(bytes[rest] != 0)
+                        return false;
+
+                memcpy(&out[full / 4 * 3], bytes, rest);
+        }
+
+        return true;
+}
+
+
+/**
+ * @}
+ */
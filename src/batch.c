@@ -0,0 +1,192 @@
+/*
+ * libniftyprefs - lightweight modelless preferences management library
+ * Copyright (C) 2006-2014 Daniel Hiepler <daniel@niftylight.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/**
+ * @file batch.c
+ *
+ * loading of many preferences files by a pool of worker threads
+ */
+
+/**
+ * @addtogroup prefs_node
+ * @{
+ *
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <niftylog.h>
+#include "prefs.h"
+
+
+
+/** maximum amount of threads used by nft_prefs_load_many() */
+#define BATCH_MAX_THREADS       64
+
+
+/** state of one nft_prefs_load_many() call */
+typedef struct
+{
+        NftPrefs *p;
+        const char *const *paths;
+        NftPrefsNode **results;
+        size_t n;
+        /** index of next file to load */
+        size_t next;
+} NftPrefsBatch;
+
+
+
+
+/******************************************************************************/
+/**************************** STATIC FUNCTIONS ********************************/
+/******************************************************************************/
+
+/** load files until there are no more left */
+static void *_batch_worker(void *arg)
+{
+        NftPrefsBatch *b = arg;
+
+        if(!_prefs_worker_begin(b->p, true))
+                return NULL;
+
+        size_t i;
+        while((i = __atomic_fetch_add(&b->next, 1, __ATOMIC_RELAXED)) < b->n)
+                b->results[i] = nft_prefs_node_from_file(b->p, b->paths[i]);
+
+        _prefs_worker_end(b->p);
+
+        return NULL;
+}
+
+
+
+/******************************************************************************/
+/**************************** API FUNCTIONS ***********************************/
+/******************************************************************************/
+
+/**
+ * load many preferences files concurrently
+ *
+ * Every file is loaded like nft_prefs_node_from_file() would do it 
+ * (reading, parsing, XInclude processing & updating), but the files are 
+ * distributed among one thread per CPU core.
+ *
+ * @param p NftPrefs context
+ * @param paths array of n full paths of files to load
+ * @param n amount of files
+ * @param results array of n NftPrefsNodes. results[i] will be the node 
+ * loaded from paths[i] or NULL if loading that file failed
+ * @result NFT_SUCCESS if all files were loaded, NFT_FAILURE otherwise
+ * @note registering or unregistering classes and updaters waits until all
+ * files are loaded (and fails if attempted by an updater function). 
+ * Updater functions may be called from multiple threads at the same time.
+ */
+NftResult nft_prefs_load_many(NftPrefs * p, const char *const paths[],
+                              size_t n, NftPrefsNode * results[])
+{
+        if(!p || (n > 0 && (!paths || !results)))
+                NFT_LOG_NULL(NFT_FAILURE);
+
+        for(size_t i = 0; i < n; i++)
+                results[i] = NULL;
+
+        NftPrefsBatch b = {
+                .p = p,
+                .paths = paths,
+                .results = results,
+                .n = n,
+        };
+
+        /* one thread per core (the calling thread is one of them) */
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        size_t threads = cores > 0 ? (size_t) cores : 1;
+        if(threads > n)
+                threads = n;
+        if(threads > BATCH_MAX_THREADS)
+                threads = BATCH_MAX_THREADS;
+
+        /* registry must not change while workers use it */
+        _prefs_batch_begin(p);
+
+        pthread_t tids[BATCH_MAX_THREADS];
+        size_t started = 0;
+        for(; started + 1 < threads; started++)
+        {
+                if(pthread_create(&tids[started], NULL, _batch_worker, &b) != 0)
+                {
+                        NFT_LOG(L_WARNING, "Failed to start worker thread");
+                        break;
+                }
+        }
+
+        _batch_worker(&b);
+
+        for(size_t t = 0; t < started; t++)
+                pthread_join(tids[t], NULL);
+
+        _prefs_batch_end(p);
+
+        /* count files that failed to load */
+        size_t missing = 0;
+        for(size_t i = 0; i < n; i++)
+        {
+                if(!results[i])
+                        missing++;
+        }
+
+        if(missing > 0)
+        {
+                NFT_LOG(L_ERROR, "Failed to load %zu of %zu files", missing, n);
+                return NFT_FAILURE;
+        }
+
+        return NFT_SUCCESS;
+}
+
+
+/**
+ * @}
+ */
@@ -0,0 +1,316 @@
+/*
+ * libniftyprefs - lightweight modelless preferences management library
+ * Copyright (C) 2006-2014 Daniel Hiepler <daniel@niftylight.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/**
+ * @file cache.c
+ *
+ * parse caches of nft_prefs_node_from_file() (s. nft_prefs_set_cache()).
+ * A cache file consists of a header that identifies the XML file and the
+ * context it was parsed with, followed by the binary representation
+ * of the processed tree and a checksum of it (FNV-1a):
+ *
+ * @verbatim
+   cache := magic("NFTC") version:u8 device:le64 inode:le64 size:le64 
+            mtime:le64 mtime_nsec:le64 context_version:le64 options:le64
+            path_length:le32 path checksum:le64 tree
+   @endverbatim
+ */
+
+/**
+ * @addtogroup prefs_node
+ * @{
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <niftylog.h>
+#include "prefs.h"
+#include "node.h"
+#include "cache.h"
+
+
+
+/** first bytes of every cache file */
+#define CACHE_MAGIC             "NFTC"
+/** version of cache format */
+#define CACHE_VERSION           1
+/** amount of le64 fields in header */
+#define CACHE_FIELDS            7
+/** size of header without path */
+#define CACHE_HEADER_SIZE       (4 + 1 + CACHE_FIELDS * 8 + 4)
+
+
+
+
+/******************************************************************************/
+/**************************** STATIC FUNCTIONS ********************************/
+/******************************************************************************/
+
+/** build path of cache file: "<dir>/.<file>.cache" (must be freed) */
+static char *_cache_path(const char *filename)
+{
+        const char *base = strrchr(filename, '/');
+        base = base ? base + 1 : filename;
+        size_t dirlen = base - filename;
+
+        char *path;
+        size_t size = strlen(filename) + sizeof(".") + sizeof(".cache");
+        if(!(path = malloc(size)))
+        {
+                NFT_LOG_PERROR("malloc");
+                return NULL;
+        }
+
+        snprintf(path, size, "%.*s.%s.cache", (int) dirlen, filename, base);
+
+        return path;
+}
+
+
+/** build header identifying XML file & context */
+static void _cache_header(NftPrefs * p, const char *filename,
+                          const struct stat *sts,
+                          unsigned char header[CACHE_HEADER_SIZE])
+{
+        uint64_t fields[CACHE_FIELDS] =
+        {
+                (uint64_t) sts->st_dev,
+                (uint64_t) sts->st_ino,
+                (uint64_t) sts->st_size,
+                (uint64_t) sts->st_mtime,
+#ifdef WIN32
+                0,
+#else
+                (uint64_t) sts->st_mtim.tv_nsec,
+#endif
+                (uint64_t) _prefs_get_version(p),
+                (uint64_t) (unsigned int) _prefs_get_parse_options(p),
+        };
+
+        memcpy(header, CACHE_MAGIC, 4);
+        header[4] = CACHE_VERSION;
+
+        unsigned char *pos = &header[5];
+        for(int f = 0; f < CACHE_FIELDS; f++)
+        {
+                for(int b = 0; b < 8; b++)
+                        *pos++ = (unsigned char) (fields[f] >> (8 * b));
+        }
+
+        uint32_t length = (uint32_t) strlen(filename);
+        for(int b = 0; b < 4; b++)
+                *pos++ = (unsigned char) (length >> (8 * b));
+}
+
+
+
+/** FNV-1a hash of buffer */
+static uint64_t _cache_checksum(const unsigned char *data, size_t length)
+{
+        uint64_t h = 0xcbf29ce484222325ULL;
+        for(size_t i = 0; i < length; i++)
+        {
+                h ^= data[i];
+                h *= 0x100000001b3ULL;
+        }
+
+        return h;
+}
+
+
+/******************************************************************************/
+/**************************** PRIVATE FUNCTIONS *******************************/
+/******************************************************************************/
+
+/** load tree from cache of XML file (sts is the result of stat() on the XML 
+    file). Returns NULL if there's no valid cache */
+NftPrefsNode *_cache_load(NftPrefs * p, const char *filename,
+                          const struct stat *sts)
+{
+        char *path;
+        if(!(path = _cache_path(filename)))
+                return NULL;
+
+        NftPrefsNode *node = NULL;
+        unsigned char *data = NULL;
+
+        int fd;
+#ifdef WIN32
+        if((fd = open(path, O_RDONLY | O_BINARY)) == -1)
+#else
+        if((fd = open(path, O_RDONLY)) == -1)
+#endif
+        {
+                if(errno != ENOENT)
+                        NFT_LOG(L_DEBUG, "Failed to open cache \"%s\" - %s",
+                                path, strerror(errno));
+                goto _cl_exit;
+        }
+
+        size_t length;
+        data = _node_binary_read_fd(fd, &length);
+        close(fd);
+        if(!data)
+                goto _cl_exit;
+
+        /* cache must belong to this file & context */
+        unsigned char header[CACHE_HEADER_SIZE];
+        _cache_header(p, filename, sts, header);
+        size_t pathlen = strlen(filename);
+        if(length < CACHE_HEADER_SIZE + pathlen + 8 ||
+           memcmp(data, header, CACHE_HEADER_SIZE) != 0 ||
+           memcmp(&data[CACHE_HEADER_SIZE], filename, pathlen) != 0)
+        {
+                NFT_LOG(L_DEBUG, "Cache \"%s\" is stale", path);
+                goto _cl_exit;
+        }
+
+        /* tree must be intact */
+        const unsigned char *tree = &data[CACHE_HEADER_SIZE + pathlen + 8];
+        size_t treelen = length - CACHE_HEADER_SIZE - pathlen - 8;
+        uint64_t checksum = 0;
+        for(int b = 0; b < 8; b++)
+                checksum |= (uint64_t) data[CACHE_HEADER_SIZE + pathlen + b] << (8 * b);
+
+        if(checksum != _cache_checksum(tree, treelen) ||
+           !(node = _node_binary_decode(p, tree, treelen, filename, false)))
+        {
+                NFT_LOG(L_WARNING, "Ignoring corrupt cache \"%s\"", path);
+                goto _cl_exit;
+        }
+
+        NFT_LOG(L_DEBUG, "Loaded \"%s\" from cache \"%s\"", filename, path);
+
+_cl_exit:
+        free(data);
+        free(path);
+        return node;
+}
+
+
+/** store processed tree in cache of XML file (sts is the result of stat()
+    on the XML file before it was parsed) */
+void _cache_store(NftPrefs * p, const char *filename,
+                  const struct stat *sts, NftPrefsNode * n)
+{
+        char *path = NULL, *tmp = NULL;
+        unsigned char *data = NULL;
+        int fd = -1;
+
+        if(!(path = _cache_path(filename)))
+                return;
+
+        size_t length;
+        if(!_node_binary_encode(n, &data, &length))
+                goto _cs_exit;
+
+        /* write to temporary file and rename it afterwards, so readers never
+           see partial caches */
+        size_t size = strlen(path) + sizeof(".XXXXXX");
+        if(!(tmp = malloc(size)))
+        {
+                NFT_LOG_PERROR("malloc");
+                goto _cs_exit;
+        }
+        snprintf(tmp, size, "%s.XXXXXX", path);
+
+        if((fd = mkstemp(tmp)) == -1)
+        {
+                NFT_LOG(L_DEBUG, "Failed to create cache \"%s\" - %s",
+                        path, strerror(errno));
+                goto _cs_exit;
+        }
+
+        unsigned char header[CACHE_HEADER_SIZE];
+        _cache_header(p, filename, sts, header);
+        uint64_t checksum = _cache_checksum(data, length);
+        unsigned char le[8];
+        for(int b = 0; b < 8; b++)
+                le[b] = (unsigned char) (checksum >> (8 * b));
+
+        if(!_node_binary_write_fd(fd, header, sizeof(header)) ||
+           !_node_binary_write_fd(fd, (const unsigned char *) filename,
+                                  strlen(filename)) ||
+           !_node_binary_write_fd(fd, le, sizeof(le)) ||
+           !_node_binary_write_fd(fd, data, length))
+                goto _cs_error;
+
+        if(close(fd) == -1)
+        {
+                fd = -1;
+                NFT_LOG_PERROR("close");
+                goto _cs_error;
+        }
+        fd = -1;
+
+        if(rename(tmp, path) == -1)
+        {
+                NFT_LOG(L_DEBUG, "Failed to rename \"%s\" - %s", tmp,
+                        strerror(errno));
+                goto _cs_error;
+        }
+
+        goto _cs_exit;
+
+_cs_error:
+        if(fd != -1)
+                close(fd);
+        unlink(tmp);
+
+_cs_exit:
+        free(tmp);
+        free(data);
+        free(path);
+}
+
+
+/**
+ * @}
+ */
@@ -53,6 +53,7 @@
  */
 
 
+#include <stdlib.h>
 #include <niftylog.h>
 #include "class.h"
 #include "updater.h"
@@ -67,6 +68,8 @@ struct _NftPrefsClass
 {
         /** name of object class */
         char name[NFT_PREFS_MAX_CLASSNAME + 1];
+        /** name of object class as stored in the context dictionary */
+        const xmlChar *dictname;
         /** callback to create a new object from preferences (or NULL) */
         NftPrefsToObjFunc *toObj;
         /** callback to create preferences from the current object state (or NULL) */
@@ -75,6 +78,8 @@ struct _NftPrefsClass
         NftArraySlot slot;
         /** updaters of this class another */
         NftPrefsUpdaters updaters;
+        /** struct bound to this class instead of callbacks (or NULL) */
+        NftPrefsStruct *binding;
 };
 
 
@@ -91,9 +96,112 @@ static bool _find_by_name(void *element, void *criterion, void *userptr)
 
 
         NftPrefsClass *c = element;
-        const char *name = criterion;
 
-        return (strcmp(c->name, name) == 0);
+        /* names are interned in the context dictionary */
+        return (c->dictname == criterion);
+}
+
+
+
+/** foreach helper binding a registered class to the new class userptr 
+    and the other way round (s. _struct_bind()) */
+static bool _bind_helper(void *element, void *userptr)
+{
+        NftPrefsClass *c = element, *n = userptr;
+
+        if(c->binding)
+                _struct_bind(c->binding, (const char *) n->dictname,
+                             n->binding);
+        if(n->binding && c->binding)
+                _struct_bind(n->binding, (const char *) c->dictname,
+                             c->binding);
+
+        return true;
+}
+
+
+/** foreach helper unbinding registered classes from class userptr */
+static bool _unbind_helper(void *element, void *userptr)
+{
+        NftPrefsClass *c = element, *n = userptr;
+
+        if(c != n && c->binding)
+                _struct_bind(c->binding, (const char *) n->dictname, NULL);
+
+        return true;
+}
+
+
+/** register object class (s. nft_prefs_class_register()) */
+static NftResult _class_register(NftPrefs * p, const char *className,
+                                 NftPrefsToObjFunc * toObj,
+                                 NftPrefsFromObjFunc * fromObj,
+                                 NftPrefsStruct * binding)
+{
+        if(strlen(className) == 0)
+        {
+                NFT_LOG(L_ERROR, "class name may not be empty");
+                return NFT_FAILURE;
+        }
+
+        /* check if class is already registered */
+        NFT_LOG(L_DEBUG,
+                "Checking if another class \"%s\" is already registered...",
+                className);
+        if(_class_find_by_name(p, className))
+        {
+                NFT_LOG(L_ERROR, "class named \"%s\" already registered",
+                        className);
+                return NFT_FAILURE;
+        }
+
+        /* allocate new slot in class array */
+        NftArraySlot s;
+        if(!(nft_array_slot_alloc(_prefs_classes(p), &s)))
+        {
+                NFT_LOG(L_ERROR, "Failed to allocate new array slot");
+                return NFT_FAILURE;
+        }
+
+        /* get empty array element */
+        NftPrefsClass *n;
+        if(!(n = nft_array_get_element(_prefs_classes(p), s)))
+        {
+                NFT_LOG(L_ERROR, "Failed to get element from array slot");
+                goto _pcr_error;
+        }
+
+        /* allocate new array for updater functions */
+        if(!_updater_init_array(&n->updaters))
+        {
+                NFT_LOG(L_ERROR, "Failed to init updater array");
+                goto _pcr_error;
+        }
+
+        /* intern class name */
+        if(!(n->dictname = xmlDictLookup(_prefs_dict(p), BAD_CAST className, -1)))
+        {
+                NFT_LOG(L_ERROR, "Failed to add class name to dictionary");
+                nft_array_deinit(&n->updaters);
+                goto _pcr_error;
+        }
+
+        /* register new class */
+        strncpy(n->name, className, NFT_PREFS_MAX_CLASSNAME);
+        n->toObj = toObj;
+        n->fromObj = fromObj;
+        n->binding = binding;
+        n->slot = s;
+
+        /* resolve nested members once instead of per converted object (the
+           new class itself is in the array already) */
+        nft_array_foreach_element(_prefs_classes(p), _bind_helper, n);
+
+        return NFT_SUCCESS;
+
+_pcr_error:
+        nft_array_slot_free(_prefs_classes(p), s);
+        return NFT_FAILURE;
 }
 
 
@@ -111,18 +219,26 @@ NftResult _class_init_array(NftPrefsClasses * a)
 
 
 /** find class by name */
-NftPrefsClass *_class_find_by_name(NftPrefsClasses * c, const char *name)
+NftPrefsClass *_class_find_by_name(NftPrefs * p, const char *name)
 {
+        /* every registered class name is in the dictionary */
+        const xmlChar *dictname;
+        if(!(dictname = xmlDictExists(_prefs_dict(p), BAD_CAST name, -1)))
+        {
+                NFT_LOG(L_DEBUG, "Class \"%s\" not found", name);
+                return NULL;
+        }
+
         /* find class in array */
         NftArraySlot slot;
         if(!nft_array_find_slot
-           (c, &slot, _find_by_name, (void *) name, NULL))
+           (_prefs_classes(p), &slot, _find_by_name, (void *) dictname, NULL))
         {
                 NFT_LOG(L_DEBUG, "Class \"%s\" not found", name);
                 return NULL;
         }
 
-        return nft_array_get_element(c, slot);
+        return nft_array_get_element(_prefs_classes(p), slot);
 }
 
 
@@ -135,13 +251,21 @@ void _class_free(NftPrefs * p, NftPrefsClass * klass)
         /* free updater array */
         nft_array_deinit(&klass->updaters);
 
+        /* nested members of other classes lose this class */
+        nft_array_foreach_element(_prefs_classes(p), _unbind_helper, klass);
+
+        /* free struct binding */
+        _struct_free(klass->binding);
+
         /* free array slot */
         nft_array_slot_free(_prefs_classes(p), klass->slot);
 
         /* invalidate class */
         klass->name[0] = '\0';
+        klass->dictname = NULL;
         klass->fromObj = NULL;
         klass->toObj = NULL;
+        klass->binding = NULL;
 }
 
 
@@ -166,6 +290,13 @@ NftPrefsUpdaters *_class_updaters(NftPrefsClass * c)
 }
 
 
+/** getter */
+NftPrefsStruct *_class_struct(NftPrefsClass * c)
+{
+        return c->binding;
+}
+
+
 
 /******************************************************************************/
 /**************************** API FUNCTIONS ***********************************/
@@ -187,58 +318,98 @@ NftResult nft_prefs_class_register(NftPrefs * p, const char *className,
         if(!p || !className)
                 NFT_LOG_NULL(NFT_FAILURE);
 
-
-        if(strlen(className) == 0)
-        {
-                NFT_LOG(L_ERROR, "class name may not be empty");
+        /* waits while other threads load files */
+        if(!_prefs_registry_lock(p))
                 return NFT_FAILURE;
-        }
 
-        /* check if class is already registered */
-        NFT_LOG(L_DEBUG,
-                "Checking if another class \"%s\" is already registered...",
-                className);
-        if(_class_find_by_name(_prefs_classes(p), className))
-        {
-                NFT_LOG(L_ERROR, "class named \"%s\" already registered",
-                        className);
+        NftResult r = _class_register(p, className, toObj, fromObj, NULL);
+
+        _prefs_registry_unlock(p);
+
+        return r;
+}
+
+
+/**
+ * register object class that is bound to a struct. Objects are converted 
+ * by the library: members stored as properties are read & written by 
+ * table driven loops (s. nft_prefs_node_props_get() & 
+ * nft_prefs_node_props_set()), nested structs & arrays of structs become 
+ * child nodes of their own class. Objects created by 
+ * nft_prefs_obj_from_node() start as a copy of a struct holding the 
+ * defaults of all members. Free them with nft_prefs_class_free_struct().
+ *
+ * @param p NftPrefs context where new class should be registered to
+ * @param className unique name of new class
+ * @param size size of struct (sizeof())
+ * @param fields descriptors of struct members (s. NFT_PREFS_FIELD(), 
+ * NFT_PREFS_FIELD_CHILD() & NFT_PREFS_FIELD_ARRAY()). They are copied.
+ * @param count amount of descriptors
+ * @result NFT_SUCCESS or NFT_FAILURE
+ * @note classes of nested members must be registered with this function
+ * as well (before objects are converted, but in any order relative to 
+ * this class). Several nested members of the 
+ * same class are matched with child nodes in order, an array member takes
+ * all remaining children of its class.
+ */
+NftResult nft_prefs_class_register_struct(NftPrefs * p, const char *className,
+                                          size_t size,
+                                          const NftPrefsFieldDesc fields[],
+                                          size_t count)
+{
+        if(!p || !className || (count && !fields))
+                NFT_LOG_NULL(NFT_FAILURE);
+
+        NftPrefsStruct *s;
+        if(!(s = _struct_new(className, size, fields, count)))
                 return NFT_FAILURE;
-        }
 
-        /* allocate new slot in class array */
-        NftArraySlot s;
-        if(!(nft_array_slot_alloc(_prefs_classes(p), &s)))
+        /* waits while other threads load files */
+        if(!_prefs_registry_lock(p))
         {
-                NFT_LOG(L_ERROR, "Failed to allocate new array slot");
+                _struct_free(s);
                 return NFT_FAILURE;
         }
 
-        /* get empty array element */
-        NftPrefsClass *n;
-        if(!(n = nft_array_get_element(_prefs_classes(p), s)))
-        {
-                NFT_LOG(L_ERROR, "Failed to get element from array slot");
-                goto _pcr_error;
-        }
+        NftResult r = _class_register(p, className, NULL, NULL, s);
 
-        /* allocate new array for updater functions */
-        if(!_updater_init_array(&n->updaters))
-        {
-                NFT_LOG(L_ERROR, "Failed to init updater array");
-                goto _pcr_error;
-        }
+        _prefs_registry_unlock(p);
 
-        /* register new class */
-        strncpy(n->name, className, NFT_PREFS_MAX_CLASSNAME);
-        n->toObj = toObj;
-        n->fromObj = fromObj;
-        n->slot = s;
+        if(!r)
+                _struct_free(s);
 
-        return NFT_SUCCESS;
+        return r;
+}
 
-_pcr_error:
-        nft_array_slot_free(_prefs_classes(p), s);
-        return NFT_FAILURE;
+
+/**
+ * free object created by nft_prefs_obj_from_node() for a class registered 
+ * with nft_prefs_class_register_struct(), including its string members, 
+ * nested arrays & their elements
+ *
+ * @param p NftPrefs context
+ * @param className name of class
+ * @param obj object to free
+ */
+void nft_prefs_class_free_struct(NftPrefs * p, const char *className,
+                                 void *obj)
+{
+        if(!p || !className)
+                NFT_LOG_NULL();
+
+        if(!obj)
+                return;
+
+        NftPrefsClass *c;
+        if(!(c = _class_find_by_name(p, className)) || !c->binding)
+        {
+                NFT_LOG(L_ERROR, "class \"%s\" isn't bound to a struct",
+                        className);
+                return;
+        }
+
+        _struct_clear(p, c->binding, obj);
+        free(obj);
 }
 
 
@@ -255,13 +426,18 @@ void nft_prefs_class_unregister(NftPrefs * p, const char *className)
 
 
 
+        /* waits while other threads load files */
+        if(!_prefs_registry_lock(p))
+                return;
+
         /* find class */
         NftPrefsClass *klass;
-        if(!(klass = _class_find_by_name(_prefs_classes(p), className)))
+        if(!(klass = _class_find_by_name(p, className)))
         {
                 NFT_LOG(L_ERROR,
                         "tried to unregister class \"%s\" that is not registered.",
                         className);
+                _prefs_registry_unlock(p);
                 return;
         }
 
@@ -269,6 +445,8 @@ void nft_prefs_class_unregister(NftPrefs * p, const char *className)
         /* free class */
         _class_free(p, klass);
 
+        _prefs_registry_unlock(p);
+
 }
 
 /**
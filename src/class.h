@@ -46,13 +46,15 @@
 
 
 #include "niftyprefs-class.h"
+#include "struct.h"
 
 
 NftResult                       _class_init_array(NftArray * a);
 void                            _class_free(NftPrefs * p, NftPrefsClass * klass);
-NftPrefsClass                  *_class_find_by_name(NftPrefsClasses * c, const char *name);
+NftPrefsClass                  *_class_find_by_name(NftPrefs * p, const char *name);
 NftPrefsFromObjFunc            *_class_fromObj(NftPrefsClass * c);
 NftPrefsToObjFunc              *_class_toObj(NftPrefsClass * c);
 NftPrefsUpdaters *              _class_updaters(NftPrefsClass * c);
+NftPrefsStruct *                _class_struct(NftPrefsClass * c);
 
 #endif /** _CLASS_H */
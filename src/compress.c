@@ -0,0 +1,729 @@
+/*
+ * libniftyprefs - lightweight modelless preferences management library
+ * Copyright (C) 2006-2014 Daniel Hiepler <daniel@niftylight.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/**
+ * @file compress.c
+ *
+ * streaming (de)compression of preferences files. Compressed data is
+ * processed in chunks while libxml2 parses or serializes, so there's
+ * never a complete copy of the uncompressed file in memory.
+ */
+
+/**
+ * @addtogroup prefs_node
+ * @{
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <niftylog.h>
+#include "config.h"
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#include "compress.h"
+
+
+
+/** size of buffer holding compressed data */
+#define COMPRESS_CHUNK_SIZE     (64*1024)
+
+
+/** compression stream */
+struct _NftPrefsCompressStream
+{
+        /** file descriptor of compressed file */
+        int fd;
+        /** compression of file */
+        NftPrefsCompression type;
+        /** true after an error occured */
+        bool failed;
+        /** true when all input was read */
+        bool eof;
+        /** true if the last gzip member or zstd frame read is complete */
+        bool complete;
+        /** buffer for compressed data */
+        unsigned char buffer[COMPRESS_CHUNK_SIZE];
+        /** amount of valid bytes in buffer */
+        size_t length;
+        /** position of next unread byte in buffer */
+        size_t pos;
+#ifdef HAVE_ZLIB
+        z_stream z;
+#endif
+#ifdef HAVE_ZSTD
+        ZSTD_CStream *zc;
+        ZSTD_DStream *zd;
+#endif
+};
+
+
+
+
+/******************************************************************************/
+/**************************** STATIC FUNCTIONS ********************************/
+/******************************************************************************/
+
+/** write whole buffer to file */
+static bool _write_all(NftPrefsCompressStream * s, const void *data,
+                       size_t length)
+{
+        const unsigned char *d = data;
+        for(size_t written = 0; written < length;)
+        {
+                ssize_t w;
+                if((w = write(s->fd, &d[written], length - written)) < 0)
+                {
+                        if(errno == EINTR)
+                                continue;
+
+                        NFT_LOG_PERROR("write");
+                        s->failed = true;
+                        return false;
+                }
+                written += w;
+        }
+
+        return true;
+}
+
+
+/** fill buffer with compressed data if it's empty */
+static bool _fill(NftPrefsCompressStream * s)
+{
+        if(s->pos < s->length || s->eof)
+                return true;
+
+        ssize_t r;
+        while((r = read(s->fd, s->buffer, sizeof(s->buffer))) < 0)
+        {
+                if(errno == EINTR)
+                        continue;
+
+                NFT_LOG_PERROR("read");
+                s->failed = true;
+                return false;
+        }
+
+        s->pos = 0;
+        s->length = (size_t) r;
+        s->eof = (r == 0);
+
+        return true;
+}
+
+
+#if defined(HAVE_ZLIB) || defined(HAVE_ZSTD)
+/** check that the input didn't end in the middle of a gzip member or 
+    zstd frame */
+static bool _complete(NftPrefsCompressStream * s)
+{
+        if(s->complete)
+                return true;
+
+        NFT_LOG(L_ERROR, "Compressed file is truncated");
+        s->failed = true;
+        return false;
+}
+#endif
+
+
+#ifdef HAVE_ZLIB
+/** compress data (flush == Z_FINISH to finish stream) */
+static bool _gzip_write(NftPrefsCompressStream * s, const char *data,
+                        size_t length, int flush)
+{
+        s->z.next_in = (Bytef *) data;
+        s->z.avail_in = (uInt) length;
+
+        int res;
+        do
+        {
+                s->z.next_out = s->buffer;
+                s->z.avail_out = sizeof(s->buffer);
+                if((res = deflate(&s->z, flush)) == Z_STREAM_ERROR)
+                {
+                        NFT_LOG(L_ERROR, "deflate() failed");
+                        s->failed = true;
+                        return false;
+                }
+
+                if(!_write_all(s, s->buffer, sizeof(s->buffer) - s->z.avail_out))
+                        return false;
+        }
+        while(s->z.avail_out == 0 || (flush == Z_FINISH && res != Z_STREAM_END));
+
+        return true;
+}
+
+
+/** decompress data */
+static int _gzip_read(NftPrefsCompressStream * s, char *data, int length)
+{
+        s->z.next_out = (Bytef *) data;
+        s->z.avail_out = (uInt) length;
+
+        while(s->z.avail_out > 0)
+        {
+                if(!_fill(s))
+                        return -1;
+
+                if(s->eof && s->pos >= s->length)
+                {
+                        if(!_complete(s))
+                                return -1;
+                        break;
+                }
+
+                s->z.next_in = &s->buffer[s->pos];
+                s->z.avail_in = (uInt) (s->length - s->pos);
+
+                int res = inflate(&s->z, Z_NO_FLUSH);
+                s->pos = s->length - s->z.avail_in;
+                s->complete = false;
+
+                /* files may consist of multiple gzip members */
+                if(res == Z_STREAM_END)
+                {
+                        if(inflateReset(&s->z) != Z_OK)
+                                return -1;
+                        s->complete = true;
+                }
+                else if(res != Z_OK && res != Z_BUF_ERROR)
+                {
+                        NFT_LOG(L_ERROR, "inflate() failed: %s",
+                                s->z.msg ? s->z.msg : "unknown error");
+                        s->failed = true;
+                        return -1;
+                }
+        }
+
+        return length - (int) s->z.avail_out;
+}
+#endif
+
+
+#ifdef HAVE_ZSTD
+/** compress data (end == true to finish stream) */
+static bool _zstd_write(NftPrefsCompressStream * s, const char *data,
+                        size_t length, bool end)
+{
+        ZSTD_inBuffer in = { data, length, 0 };
+
+        size_t remaining;
+        do
+        {
+                ZSTD_outBuffer out = { s->buffer, sizeof(s->buffer), 0 };
+                remaining = ZSTD_compressStream2(s->zc, &out, &in,
+                                                 end ? ZSTD_e_end : ZSTD_e_continue);
+                if(ZSTD_isError(remaining))
+                {
+                        NFT_LOG(L_ERROR, "ZSTD_compressStream2() failed: %s",
+                                ZSTD_getErrorName(remaining));
+                        s->failed = true;
+                        return false;
+                }
+
+                if(!_write_all(s, s->buffer, out.pos))
+                        return false;
+        }
+        while(in.pos < in.size || (end && remaining != 0));
+
+        return true;
+}
+
+
+/** decompress data */
+static int _zstd_read(NftPrefsCompressStream * s, char *data, int length)
+{
+        ZSTD_outBuffer out = { data, (size_t) length, 0 };
+
+        while(out.pos < out.size)
+        {
+                if(!_fill(s))
+                        return -1;
+
+                if(s->eof && s->pos >= s->length)
+                {
+                        if(!_complete(s))
+                                return -1;
+                        break;
+                }
+
+                ZSTD_inBuffer in = { s->buffer, s->length, s->pos };
+                size_t res = ZSTD_decompressStream(s->zd, &out, &in);
+                s->pos = in.pos;
+                if(ZSTD_isError(res))
+                {
+                        NFT_LOG(L_ERROR, "ZSTD_decompressStream() failed: %s",
+                                ZSTD_getErrorName(res));
+                        s->failed = true;
+                        return -1;
+                }
+
+                /* 0 once a frame is decoded & flushed completely */
+                s->complete = (res == 0);
+        }
+
+        return (int) out.pos;
+}
+#endif
+
+
+/** allocate stream */
+static NftPrefsCompressStream *_stream_new(int fd, NftPrefsCompression type)
+{
+        if(!nft_prefs_compression_supported(type) ||
+           type == NFT_PREFS_COMPRESSION_NONE)
+        {
+                NFT_LOG(L_ERROR, "Compression %d not supported by this build",
+                        type);
+                return NULL;
+        }
+
+        NftPrefsCompressStream *s;
+        if(!(s = calloc(1, sizeof(*s))))
+        {
+                NFT_LOG_PERROR("calloc");
+                return NULL;
+        }
+
+        s->fd = fd;
+        s->type = type;
+
+        return s;
+}
+
+
+
+/******************************************************************************/
+/**************************** PRIVATE FUNCTIONS *******************************/
+/******************************************************************************/
+
+/** detect compression of file by its first bytes */
+NftPrefsCompression _compress_detect(const unsigned char *data, size_t length)
+{
+        if(length >= 2 && data[0] == 0x1f && data[1] == 0x8b)
+                return NFT_PREFS_COMPRESSION_GZIP;
+
+        if(length >= 4 && data[0] == 0x28 && data[1] == 0xb5 &&
+           data[2] == 0x2f && data[3] == 0xfd)
+                return NFT_PREFS_COMPRESSION_ZSTD;
+
+        return NFT_PREFS_COMPRESSION_NONE;
+}
+
+
+/** create stream that compresses data written to fd. A negative level 
+    selects the default level of the compression */
+NftPrefsCompressStream *_compress_writer_new(int fd, NftPrefsCompression type,
+                                             int level)
+{
+        NftPrefsCompressStream *s;
+        if(!(s = _stream_new(fd, type)))
+                return NULL;
+
+        switch (type)
+        {
+#ifdef HAVE_ZLIB
+                case NFT_PREFS_COMPRESSION_GZIP:
+                {
+                        /* 15 + 16: gzip header instead of zlib header */
+                        if(deflateInit2(&s->z, level < 0 ? Z_DEFAULT_COMPRESSION :
+                                        (level > 9 ? 9 : level), Z_DEFLATED,
+                                        15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+                        {
+                                NFT_LOG(L_ERROR, "deflateInit2() failed");
+                                goto _cwn_error;
+                        }
+                        break;
+                }
+#endif
+
+#ifdef HAVE_ZSTD
+                case NFT_PREFS_COMPRESSION_ZSTD:
+                {
+                        if(!(s->zc = ZSTD_createCStream()) ||
+                           ZSTD_isError(ZSTD_CCtx_setParameter(s->zc, ZSTD_c_compressionLevel,
+                                                               level < 0 ? ZSTD_CLEVEL_DEFAULT :
+                                                               (level > ZSTD_maxCLevel() ?
+                                                                ZSTD_maxCLevel() : level))))
+                        {
+                                NFT_LOG(L_ERROR, "Failed to initialize zstd compression");
+                                ZSTD_freeCStream(s->zc);
+                                goto _cwn_error;
+                        }
+                        break;
+                }
+#endif
+
+                default:
+                {
+                        goto _cwn_error;
+                }
+        }
+
+        return s;
+
+_cwn_error:
+        free(s);
+        return NULL;
+}
+
+
+/** compress chunk of data (NftPrefsSinkWriteFunc) */
+int _compress_write(void *ctx, const char *buffer, int len)
+{
+        NftPrefsCompressStream *s = ctx;
+
+        if(s->failed)
+                return -1;
+
+        switch (s->type)
+        {
+#ifdef HAVE_ZLIB
+                case NFT_PREFS_COMPRESSION_GZIP:
+                {
+                        if(!_gzip_write(s, buffer, (size_t) len, Z_NO_FLUSH))
+                                return -1;
+                        break;
+                }
+#endif
+
+#ifdef HAVE_ZSTD
+                case NFT_PREFS_COMPRESSION_ZSTD:
+                {
+                        if(!_zstd_write(s, buffer, (size_t) len, false))
+                                return -1;
+                        break;
+                }
+#endif
+
+                default:
+                {
+                        return -1;
+                }
+        }
+
+        return len;
+}
+
+
+/** finish compressed stream & close file (NftPrefsSinkCloseFunc). 
+    The stream must be freed with _compress_writer_free() afterwards */
+int _compress_writer_close(void *ctx)
+{
+        NftPrefsCompressStream *s = ctx;
+
+        switch (s->type)
+        {
+#ifdef HAVE_ZLIB
+                case NFT_PREFS_COMPRESSION_GZIP:
+                {
+                        if(!s->failed)
+                                _gzip_write(s, NULL, 0, Z_FINISH);
+                        deflateEnd(&s->z);
+                        break;
+                }
+#endif
+
+#ifdef HAVE_ZSTD
+                case NFT_PREFS_COMPRESSION_ZSTD:
+                {
+                        if(!s->failed)
+                                _zstd_write(s, NULL, 0, true);
+                        ZSTD_freeCStream(s->zc);
+                        s->zc = NULL;
+                        break;
+                }
+#endif
+
+                default:
+                {
+                        break;
+                }
+        }
+
+        if(s->fd != STDOUT_FILENO && close(s->fd) == -1)
+        {
+                NFT_LOG_PERROR("close");
+                s->failed = true;
+        }
+        s->fd = -1;
+
+        return s->failed ? -1 : 0;
+}
+
+
+/** free stream (closes it if _compress_writer_close() wasn't called). 
+    Returns false if any error occured while compressing */
+bool _compress_writer_free(NftPrefsCompressStream * s)
+{
+        /* stream was never finished */
+        if(s->fd != -1)
+        {
+                s->failed = true;
+                _compress_writer_close(s);
+        }
+
+        bool result = !s->failed;
+
+        free(s);
+
+        return result;
+}
+
+
+/** create stream that decompresses data read from fd */
+NftPrefsCompressStream *_compress_reader_new(int fd, NftPrefsCompression type)
+{
+        NftPrefsCompressStream *s;
+        if(!(s = _stream_new(fd, type)))
+                return NULL;
+
+        switch (type)
+        {
+#ifdef HAVE_ZLIB
+                case NFT_PREFS_COMPRESSION_GZIP:
+                {
+                        /* 15 + 32: detect gzip/zlib header */
+                        if(inflateInit2(&s->z, 15 + 32) != Z_OK)
+                        {
+                                NFT_LOG(L_ERROR, "inflateInit2() failed");
+                                goto _crn_error;
+                        }
+                        break;
+                }
+#endif
+
+#ifdef HAVE_ZSTD
+                case NFT_PREFS_COMPRESSION_ZSTD:
+                {
+                        if(!(s->zd = ZSTD_createDStream()))
+                        {
+                                NFT_LOG(L_ERROR, "ZSTD_createDStream() failed");
+                                goto _crn_error;
+                        }
+                        break;
+                }
+#endif
+
+                default:
+                {
+                        goto _crn_error;
+                }
+        }
+
+        return s;
+
+_crn_error:
+        free(s);
+        return NULL;
+}
+
+
+/** read chunk of decompressed data (xmlInputReadCallback) */
+int _compress_read(void *ctx, char *buffer, int len)
+{
+        NftPrefsCompressStream *s = ctx;
+
+        if(s->failed)
+                return -1;
+
+        switch (s->type)
+        {
+#ifdef HAVE_ZLIB
+                case NFT_PREFS_COMPRESSION_GZIP:
+                {
+                        return _gzip_read(s, buffer, len);
+                }
+#endif
+
+#ifdef HAVE_ZSTD
+                case NFT_PREFS_COMPRESSION_ZSTD:
+                {
+                        return _zstd_read(s, buffer, len);
+                }
+#endif
+
+                default:
+                {
+                        return -1;
+                }
+        }
+}
+
+
+/** close file & free stream (xmlInputCloseCallback) */
+int _compress_reader_close(void *ctx)
+{
+        NftPrefsCompressStream *s = ctx;
+
+        switch (s->type)
+        {
+#ifdef HAVE_ZLIB
+                case NFT_PREFS_COMPRESSION_GZIP:
+                {
+                        inflateEnd(&s->z);
+                        break;
+                }
+#endif
+
+#ifdef HAVE_ZSTD
+                case NFT_PREFS_COMPRESSION_ZSTD:
+                {
+                        ZSTD_freeDStream(s->zd);
+                        break;
+                }
+#endif
+
+                default:
+                {
+                        break;
+                }
+        }
+
+        close(s->fd);
+        free(s);
+
+        return 0;
+}
+
+
+/** parse preferences file, decompress it on the fly if needed */
+xmlDocPtr _compress_read_file(xmlParserCtxtPtr ctxt, const char *filename,
+                              int options)
+{
+        /* peek at first bytes of file */
+        int fd;
+        unsigned char magic[4];
+        ssize_t length = 0;
+#ifdef WIN32
+        if((fd = open(filename, O_RDONLY | O_BINARY)) != -1)
+#else
+        if((fd = open(filename, O_RDONLY)) != -1)
+#endif
+        {
+                length = read(fd, magic, sizeof(magic));
+        }
+
+        NftPrefsCompression type = length > 0 ?
+                _compress_detect(magic, (size_t) length) : NFT_PREFS_COMPRESSION_NONE;
+
+        /* plain files (or files libxml2 might handle itself) */
+        if(type == NFT_PREFS_COMPRESSION_NONE ||
+           !nft_prefs_compression_supported(type) ||
+           lseek(fd, 0, SEEK_SET) == -1)
+        {
+                if(fd != -1)
+                        close(fd);
+                return xmlCtxtReadFile(ctxt, filename, NULL, options);
+        }
+
+        NftPrefsCompressStream *s;
+        if(!(s = _compress_reader_new(fd, type)))
+        {
+                close(fd);
+                return NULL;
+        }
+
+        /* stream is closed by parser in any case */
+        return xmlCtxtReadIO(ctxt, _compress_read, _compress_reader_close, s,
+                             filename, NULL, options);
+}
+
+
+
+/******************************************************************************/
+/**************************** API FUNCTIONS ***********************************/
+/******************************************************************************/
+
+/**
+ * check whether a compression is supported by this build of the library
+ *
+ * @param type compression
+ * @result true if files can be written & read with this compression
+ */
+bool nft_prefs_compression_supported(NftPrefsCompression type)
+{
+        switch (type)
+        {
+                case NFT_PREFS_COMPRESSION_NONE:
+                {
+                        return true;
+                }
+
+                case NFT_PREFS_COMPRESSION_GZIP:
+                {
+#ifdef HAVE_ZLIB
+                        return true;
+#else
+                        return false;
+#endif
+                }
+
+                case NFT_PREFS_COMPRESSION_ZSTD:
+                {
+#ifdef HAVE_ZSTD
+                        return true;
+#else
+                        return false;
+#endif
+                }
+        }
+
+        return false;
+}
+
+
+/**
+ * @}
+ */
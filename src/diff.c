@@ -0,0 +1,1159 @@
+/*
+ * libniftyprefs - lightweight modelless preferences management library
+ * Copyright (C) 2006-2014 Daniel Hiepler <daniel@niftylight.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/**
+ * @file diff.c
+ *
+ * structural differences between two trees. Every element of both trees 
+ * gets a content hash first (name, properties regardless of their order, 
+ * text & children in order). Matching nodes with equal hashes are skipped,
+ * all others are compared property by property and their children are 
+ * matched by name & key property. Matched children that aren't part of the 
+ * longest sequence of children keeping their relative order are moved.
+ *
+ * Every change remembers the path (element child indices) of its node in the
+ * old tree, so a diff can be applied to any copy of that tree. All nodes are
+ * looked up before the first modification.
+ */
+
+/**
+ * @addtogroup prefs_diff
+ * @{
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <niftylog.h>
+#include "prefs.h"
+#include "arena.h"
+#include "node.h"
+#include "number.h"
+#include "diff.h"
+
+
+
+/** FNV-1a parameters */
+#define FNV_OFFSET              0xcbf29ce484222325ULL
+#define FNV_PRIME               0x100000001b3ULL
+
+/** no child index */
+#define NO_INDEX                SIZE_MAX
+
+
+/** content hash of one element */
+typedef struct
+{
+        const xmlNode *node;
+        uint64_t hash;
+} DiffHash;
+
+
+/** node of the old tree a change applies to */
+typedef struct
+{
+        /** offset of path in NftPrefsDiff.paths */
+        size_t offset;
+        /** length of path */
+        size_t depth;
+} DiffTarget;
+
+
+/** list of changes */
+struct _NftPrefsDiff
+{
+        /** changes in document order of the new tree */
+        NftPrefsDiffEntry *entries;
+        /** node in old tree for every change */
+        DiffTarget *targets;
+        /** amount of changes */
+        size_t length;
+        /** amount of allocated entries */
+        size_t size;
+        /** element child indices of all targets */
+        size_t *paths;
+        /** amount of used path indices */
+        size_t pathslength;
+        /** amount of allocated path indices */
+        size_t pathssize;
+};
+
+
+/** slot of index of unmatched children */
+typedef struct
+{
+        /** hash of name & key */
+        uint64_t id;
+        /** a child with that name & key (NULL if slot is empty) */
+        xmlNode *node;
+        /** index + 1 of first unmatched child with that name & key */
+        size_t head;
+} DiffSlot;
+
+
+/** children of an element of the old tree */
+typedef struct
+{
+        /** element children */
+        xmlNode **children;
+        /** amount of children */
+        size_t n;
+        /** child has been matched */
+        bool *used;
+        /** open addressing table (built only if children aren't matched 
+            in order) */
+        DiffSlot *slots;
+        /** size of table (power of 2) */
+        size_t size;
+        /** index + 1 of next child with same name & key */
+        size_t *next;
+} DiffIndex;
+
+
+/** state of one diff run */
+typedef struct
+{
+        NftPrefsDiff *d;
+        /** open addressing table of content hashes */
+        DiffHash *hashes;
+        /** size of table (power of 2) */
+        size_t size;
+        /** amount of used slots */
+        size_t used;
+        /** element child indices leading from the old root to current node */
+        size_t *path;
+        /** length of path */
+        size_t depth;
+        /** amount of allocated path indices */
+        size_t pathsize;
+} DiffState;
+
+
+
+
+/******************************************************************************/
+/**************************** STATIC FUNCTIONS ********************************/
+/******************************************************************************/
+
+/** add bytes to FNV-1a hash */
+static uint64_t _fnv(uint64_t h, const void *data, size_t length)
+{
+        const unsigned char *b = data;
+        for(size_t i = 0; i < length; i++)
+        {
+                h ^= b[i];
+                h *= FNV_PRIME;
+        }
+
+        return h;
+}
+
+
+/** add string (including terminator) to FNV-1a hash */
+static uint64_t _fnv_string(uint64_t h, const xmlChar * s)
+{
+        return s ? _fnv(h, s, (size_t) xmlStrlen(s) + 1) : _fnv(h, "", 1);
+}
+
+
+/** slot of node in hash table */
+static DiffHash *_slot(DiffState * s, const xmlNode * n)
+{
+        size_t i = (((uintptr_t) n >> 4) * 0x9e3779b97f4a7c15ULL) & (s->size - 1);
+        while(s->hashes[i].node && s->hashes[i].node != n)
+                i = (i + 1) & (s->size - 1);
+
+        return &s->hashes[i];
+}
+
+
+/** remember content hash of node */
+static NftResult _hash_put(DiffState * s, const xmlNode * n, uint64_t hash)
+{
+        /* keep table at most half full */
+        if((s->used + 1) * 2 > s->size)
+        {
+                DiffHash *old = s->hashes;
+                size_t oldsize = s->size;
+
+                s->size = oldsize ? oldsize * 2 : 256;
+                if(!(s->hashes = calloc(s->size, sizeof(DiffHash))))
+                {
+                        NFT_LOG_PERROR("calloc");
+                        s->hashes = old;
+                        s->size = oldsize;
+                        return NFT_FAILURE;
+                }
+
+                for(size_t i = 0; i < oldsize; i++)
+                {
+                        if(old[i].node)
+                                *_slot(s, old[i].node) = old[i];
+                }
+                free(old);
+        }
+
+        DiffHash *h = _slot(s, n);
+        h->node = n;
+        h->hash = hash;
+        s->used++;
+
+        return NFT_SUCCESS;
+}
+
+
+/** get content hash of node */
+static uint64_t _hash_get(DiffState * s, const xmlNode * n)
+{
+        return _slot(s, n)->hash;
+}
+
+
+/** value of property (without copying it if possible) */
+static const xmlChar *_prop_value(xmlAttr * a, xmlChar ** copy)
+{
+        *copy = NULL;
+
+        xmlNode *t = a->children;
+        if(!t)
+                return BAD_CAST "";
+        if(!t->next && t->type == XML_TEXT_NODE)
+                return t->content;
+
+        return (*copy = xmlNodeListGetString(a->doc, t, 1));
+}
+
+
+/** check whether node is text or CDATA */
+static bool _is_text(const xmlNode * n)
+{
+        return n->type == XML_TEXT_NODE || n->type == XML_CDATA_SECTION_NODE;
+}
+
+
+/** calculate content hashes of element and all its descendants */
+static NftResult _hash_tree(DiffState * s, xmlNode * n, uint64_t * result)
+{
+        uint64_t h = _fnv_string(FNV_OFFSET, n->name);
+
+        /* properties in any order */
+        uint64_t props = 0;
+        for(xmlAttr * a = n->properties; a; a = a->next)
+        {
+                xmlChar *copy;
+                const xmlChar *value = _prop_value(a, &copy);
+                uint64_t p = _fnv_string(_fnv_string(FNV_OFFSET, a->name), value);
+                xmlFree(copy);
+
+                props += p * FNV_PRIME;
+        }
+
+        /* pending values in binary form (never equal to text) */
+        size_t i = 0;
+        const xmlChar *name;
+        NftPrefsPropType type;
+        NftPrefsNodeValue v;
+        while(_node_index_value_next(n, &i, &name, &type, &v))
+        {
+                uint64_t p = _fnv(_fnv_string(FNV_OFFSET, name), &type, sizeof(type));
+                p = _fnv(p, &v, sizeof(v));
+
+                props += p * FNV_PRIME;
+        }
+        h = _fnv(h, &props, sizeof(props));
+
+        /* text & children in order */
+        for(xmlNode * c = n->children; c; c = c->next)
+        {
+                uint64_t ch;
+                if(c->type == XML_ELEMENT_NODE)
+                {
+                        if(!_hash_tree(s, c, &ch))
+                                return NFT_FAILURE;
+                }
+                else if(_is_text(c))
+                {
+                        ch = _fnv_string(FNV_OFFSET, c->content);
+                }
+                else
+                {
+                        /* comments, PIs & XInclude markers don't matter */
+                        continue;
+                }
+
+                h = _fnv(h, &ch, sizeof(ch));
+        }
+
+        *result = h;
+        return _hash_put(s, n, h);
+}
+
+
+/** hash of text content of an element (not of its children) */
+static uint64_t _text_hash(const xmlNode * n)
+{
+        uint64_t h = FNV_OFFSET;
+        for(xmlNode * c = n->children; c; c = c->next)
+        {
+                if(_is_text(c))
+                        h = _fnv_string(h, c->content);
+        }
+
+        return h;
+}
+
+
+/** make sure array has room for one more element */
+static NftResult _grow(void **array, size_t *size, size_t length, size_t elemsize)
+{
+        if(length < *size)
+                return NFT_SUCCESS;
+
+        size_t n = *size ? *size * 2 : 16;
+        void *a;
+        if(!(a = realloc(*array, n * elemsize)))
+        {
+                NFT_LOG_PERROR("realloc");
+                return NFT_FAILURE;
+        }
+        *array = a;
+        *size = n;
+
+        return NFT_SUCCESS;
+}
+
+
+/** enter child of current node */
+static NftResult _push(DiffState * s, size_t child)
+{
+        if(!_grow((void **) &s->path, &s->pathsize, s->depth, sizeof(size_t)))
+                return NFT_FAILURE;
+
+        s->path[s->depth++] = child;
+        return NFT_SUCCESS;
+}
+
+
+/** append change. The node of the old tree it applies to is the current
+    node or its element child of index "child" (unless NO_INDEX) */
+static NftResult _add(DiffState * s, NftPrefsDiffOp op, xmlNode * from,
+                      xmlNode * to, const xmlChar * prop, size_t child,
+                      size_t index)
+{
+        NftPrefsDiff *d = s->d;
+
+        if(d->length == d->size)
+        {
+                size_t size = d->size ? d->size * 2 : 16;
+                NftPrefsDiffEntry *e;
+                DiffTarget *t;
+                if(!(e = realloc(d->entries, size * sizeof(NftPrefsDiffEntry))))
+                {
+                        NFT_LOG_PERROR("realloc");
+                        return NFT_FAILURE;
+                }
+                d->entries = e;
+                if(!(t = realloc(d->targets, size * sizeof(DiffTarget))))
+                {
+                        NFT_LOG_PERROR("realloc");
+                        return NFT_FAILURE;
+                }
+                d->targets = t;
+                d->size = size;
+        }
+
+        /* remember path of target */
+        size_t depth = s->depth + (child != NO_INDEX ? 1 : 0);
+        while(d->pathslength + depth > d->pathssize)
+        {
+                if(!_grow((void **) &d->paths, &d->pathssize, d->pathssize, sizeof(size_t)))
+                        return NFT_FAILURE;
+        }
+        size_t *path = &d->paths[d->pathslength];
+        if(s->depth)
+                memcpy(path, s->path, s->depth * sizeof(size_t));
+        if(child != NO_INDEX)
+                path[s->depth] = child;
+
+        d->targets[d->length] = (DiffTarget)
+        {
+                .offset = d->pathslength,
+                .depth = depth,
+        };
+        d->pathslength += depth;
+
+        d->entries[d->length++] = (NftPrefsDiffEntry)
+        {
+                .op = op,
+                .from = from,
+                .to = to,
+                .prop = (const char *) prop,
+                .index = index,
+        };
+
+        return NFT_SUCCESS;
+}
+
+
+/** compare property of two matching elements that is pending in one of 
+    them. Values are only formatted if they can't be compared directly */
+static NftResult _diff_pending(DiffState * s, xmlNode * from, xmlNode * to,
+                               xmlNode * other, const xmlChar * name,
+                               NftPrefsPropType type,
+                               const NftPrefsNodeValue * v)
+{
+        /* same typed value */
+        if(_node_index_value_equal(other, name, type, v))
+                return NFT_SUCCESS;
+
+        char tmp[NUMBER_MAXLEN], othertmp[NUMBER_MAXLEN];
+        _node_prop_format(type, v, tmp);
+
+        const xmlChar *value;
+        xmlChar *copy = NULL;
+        NftPrefsPropType t;
+        NftPrefsNodeValue o;
+        xmlAttr *a;
+        if(_node_index_value_pending(other, name, &t, &o))
+        {
+                /* both pending as same type but different */
+                if(t == type)
+                        return _add(s, NFT_PREFS_DIFF_PROP_SET, from, to, name, NO_INDEX, 0);
+
+                _node_prop_format(t, &o, othertmp);
+                value = BAD_CAST othertmp;
+        }
+        else if((a = xmlHasProp(other, name)))
+        {
+                value = _prop_value(a, &copy);
+        }
+        else
+        {
+                /* added or removed */
+                return _add(s, other == to ? NFT_PREFS_DIFF_PROP_UNSET :
+                            NFT_PREFS_DIFF_PROP_SET, from, to, name, NO_INDEX, 0);
+        }
+
+        NftResult r = NFT_SUCCESS;
+        if(!xmlStrEqual(value, BAD_CAST tmp))
+                r = _add(s, NFT_PREFS_DIFF_PROP_SET, from, to, name, NO_INDEX, 0);
+        xmlFree(copy);
+
+        return r;
+}
+
+
+/** compare properties of two matching elements */
+static NftResult _diff_props(DiffState * s, xmlNode * from, xmlNode * to)
+{
+        NftResult r = NFT_SUCCESS;
+
+        size_t i;
+        const xmlChar *name;
+        NftPrefsPropType type;
+        NftPrefsNodeValue v;
+
+        /* pending values of new tree */
+        for(i = 0; r && _node_index_value_next(to, &i, &name, &type, &v);)
+                r = _diff_pending(s, from, to, from, name, type, &v);
+
+        /* pending values of old tree that aren't pending in new tree */
+        for(i = 0; r && _node_index_value_next(from, &i, &name, &type, &v);)
+        {
+                if(!_node_index_value_pending(to, name, NULL, NULL))
+                        r = _diff_pending(s, from, to, to, name, type, &v);
+        }
+
+        /* changed or removed */
+        for(xmlAttr * a = from->properties; a && r; a = a->next)
+        {
+                if(_node_index_value_pending(to, a->name, NULL, NULL))
+                        continue;
+
+                xmlAttr *b;
+                if(!(b = xmlHasProp(to, a->name)))
+                {
+                        r = _add(s, NFT_PREFS_DIFF_PROP_UNSET, from, to, a->name, NO_INDEX, 0);
+                        continue;
+                }
+
+                xmlChar *ca, *cb;
+                const xmlChar *va = _prop_value(a, &ca);
+                const xmlChar *vb = _prop_value(b, &cb);
+                if(!xmlStrEqual(va, vb))
+                        r = _add(s, NFT_PREFS_DIFF_PROP_SET, from, to, b->name, NO_INDEX, 0);
+                xmlFree(ca);
+                xmlFree(cb);
+        }
+
+        /* added */
+        for(xmlAttr * b = to->properties; b && r; b = b->next)
+        {
+                if(!xmlHasProp(from, b->name) &&
+                   !_node_index_value_pending(from, b->name, NULL, NULL))
+                        r = _add(s, NFT_PREFS_DIFF_PROP_SET, from, to, b->name, NO_INDEX, 0);
+        }
+
+        return r;
+}
+
+
+/** key of child among its siblings */
+static const xmlChar *_key(xmlNode * n, xmlChar ** copy)
+{
+        /* keys are compared as text */
+        _node_prop_flush(n, BAD_CAST NFT_PREFS_DIFF_KEY);
+
+        xmlAttr *a;
+        if(!(a = xmlHasProp(n, BAD_CAST NFT_PREFS_DIFF_KEY)))
+        {
+                *copy = NULL;
+                return NULL;
+        }
+
+        return _prop_value(a, copy);
+}
+
+
+/** hash of name & key of child */
+static uint64_t _id(xmlNode * n)
+{
+        xmlChar *copy;
+        const xmlChar *key = _key(n, &copy);
+
+        uint64_t h = _fnv_string(FNV_OFFSET, n->name);
+        h = key ? _fnv_string(h, key) : _fnv(h, "\1", 1);
+        xmlFree(copy);
+
+        return h;
+}
+
+
+/** check whether two children have the same name & key */
+static bool _same(xmlNode * a, xmlNode * b)
+{
+        if(!xmlStrEqual(a->name, b->name))
+                return false;
+
+        xmlChar *ca, *cb;
+        const xmlChar *ka = _key(a, &ca);
+        const xmlChar *kb = _key(b, &cb);
+        bool result = (!ka && !kb) || (ka && kb && xmlStrEqual(ka, kb));
+        xmlFree(ca);
+        xmlFree(cb);
+
+        return result;
+}
+
+
+/** build index of unmatched children of "from" by name & key. Children with
+    the same name & key are chained in order */
+static NftResult _index_build(DiffIndex * x)
+{
+        for(x->size = 16; x->size < x->n * 2; x->size *= 2);
+        if(!(x->slots = calloc(x->size, sizeof(DiffSlot))) ||
+           !(x->next = malloc(x->n * sizeof(size_t))))
+        {
+                NFT_LOG_PERROR("malloc");
+                return NFT_FAILURE;
+        }
+
+        for(size_t i = x->n; i-- > 0;)
+        {
+                if(x->used[i])
+                        continue;
+
+                uint64_t id = _id(x->children[i]);
+                size_t k = id & (x->size - 1);
+                while(x->slots[k].node &&
+                      (x->slots[k].id != id || !_same(x->slots[k].node, x->children[i])))
+                        k = (k + 1) & (x->size - 1);
+
+                x->next[i] = x->slots[k].head;
+                x->slots[k] = (DiffSlot)
+                {
+                        .id = id,
+                        .node = x->children[i],
+                        .head = i + 1,
+                };
+        }
+
+        return NFT_SUCCESS;
+}
+
+
+/** find (and take) first unmatched child of "from" with same name & key */
+static size_t _index_take(DiffIndex * x, xmlNode * n)
+{
+        uint64_t id = _id(n);
+        size_t k = id & (x->size - 1);
+        while(x->slots[k].node &&
+              (x->slots[k].id != id || !_same(x->slots[k].node, n)))
+                k = (k + 1) & (x->size - 1);
+
+        /* skip children matched after building the index */
+        DiffSlot *slot = &x->slots[k];
+        while(slot->head && x->used[slot->head - 1])
+                slot->head = x->next[slot->head - 1];
+
+        if(!slot->head)
+                return NO_INDEX;
+
+        size_t i = slot->head - 1;
+        slot->head = x->next[i];
+        return i;
+}
+
+
+static NftResult _diff_node(DiffState * s, xmlNode * from, xmlNode * to);
+
+
+/** mark children of "to" that keep their relative order (longest 
+    increasing sequence of the indices of their matches) */
+static void _keep(const size_t * match, size_t n, size_t * tails,
+                  size_t * prev, bool * keep)
+{
+        size_t length = 0;
+        for(size_t j = 0; j < n; j++)
+        {
+                keep[j] = false;
+                if(match[j] == NO_INDEX)
+                        continue;
+
+                /* first sequence whose last match is greater */
+                size_t lo = 0, hi = length;
+                while(lo < hi)
+                {
+                        size_t mid = (lo + hi) / 2;
+                        if(match[tails[mid]] < match[j])
+                                lo = mid + 1;
+                        else
+                                hi = mid;
+                }
+
+                prev[j] = lo > 0 ? tails[lo - 1] : NO_INDEX;
+                tails[lo] = j;
+                if(lo == length)
+                        length++;
+        }
+
+        for(size_t j = length ? tails[length - 1] : NO_INDEX; j != NO_INDEX; j = prev[j])
+                keep[j] = true;
+}
+
+
+/** match element children of two matching elements and compare them */
+static NftResult _diff_children(DiffState * s, xmlNode * from, xmlNode * to)
+{
+        NftResult r = NFT_FAILURE;
+
+        DiffIndex x = {.n = xmlChildElementCount(from) };
+        size_t nto = xmlChildElementCount(to);
+
+        /* index of matching child of "from" for every child of "to" */
+        size_t *match = NULL, *tails = NULL, *prev = NULL;
+        bool *keep = NULL;
+        if((x.n > 0 &&
+            (!(x.children = malloc(x.n * sizeof(xmlNode *))) ||
+             !(x.used = calloc(x.n, sizeof(bool))))) ||
+           (nto > 0 &&
+            (!(match = malloc(nto * sizeof(size_t))) ||
+             !(tails = malloc(nto * sizeof(size_t))) ||
+             !(prev = malloc(nto * sizeof(size_t))) ||
+             !(keep = malloc(nto * sizeof(bool))))))
+        {
+                NFT_LOG(L_ERROR, "Failed to allocate diff index");
+                goto _dc_exit;
+        }
+
+        size_t i = 0;
+        for(xmlNode * c = xmlFirstElementChild(from); c; c = xmlNextElementSibling(c))
+                x.children[i++] = c;
+
+        /* match children of "to" in order. Usually most children stay where 
+           they are, so the index is only built once that's not the case */
+        size_t j = 0, cursor = 0;
+        for(xmlNode * c = xmlFirstElementChild(to); c; c = xmlNextElementSibling(c), j++)
+        {
+                match[j] = NO_INDEX;
+                if(cursor < x.n && !x.used[cursor] &&
+                   (_hash_get(s, x.children[cursor]) == _hash_get(s, c) ||
+                    _same(x.children[cursor], c)))
+                {
+                        match[j] = cursor;
+                }
+                else
+                {
+                        if(!x.slots && x.n > 0 && !_index_build(&x))
+                                goto _dc_exit;
+                        if(x.slots)
+                                match[j] = _index_take(&x, c);
+                }
+
+                if(match[j] != NO_INDEX)
+                {
+                        x.used[match[j]] = true;
+                        cursor = match[j] + 1;
+                }
+        }
+
+        if(nto > 0)
+                _keep(match, nto, tails, prev, keep);
+
+        /* changes in order of "to" */
+        j = 0;
+        for(xmlNode * c = xmlFirstElementChild(to); c; c = xmlNextElementSibling(c), j++)
+        {
+                if(match[j] == NO_INDEX)
+                {
+                        if(!_add(s, NFT_PREFS_DIFF_ADD, from, c, NULL, NO_INDEX, j))
+                                goto _dc_exit;
+                        continue;
+                }
+
+                xmlNode *m = x.children[match[j]];
+                if(!keep[j] &&
+                   !_add(s, NFT_PREFS_DIFF_MOVE, m, c, NULL, match[j], j))
+                        goto _dc_exit;
+
+                if(!_push(s, match[j]))
+                        goto _dc_exit;
+                NftResult res = _diff_node(s, m, c);
+                s->depth--;
+                if(!res)
+                        goto _dc_exit;
+        }
+
+        /* removed */
+        for(i = 0; i < x.n; i++)
+        {
+                if(!x.used[i] &&
+                   !_add(s, NFT_PREFS_DIFF_REMOVE, x.children[i], to, NULL, i, 0))
+                        goto _dc_exit;
+        }
+
+        r = NFT_SUCCESS;
+
+_dc_exit:
+        free(x.children);
+        free(x.used);
+        free(x.slots);
+        free(x.next);
+        free(match);
+        free(tails);
+        free(prev);
+        free(keep);
+        return r;
+}
+
+
+/** compare two matching elements */
+static NftResult _diff_node(DiffState * s, xmlNode * from, xmlNode * to)
+{
+        /* equal content */
+        if(_hash_get(s, from) == _hash_get(s, to))
+                return NFT_SUCCESS;
+
+        if(!xmlStrEqual(from->name, to->name) ||
+           _text_hash(from) != _text_hash(to))
+                return _add(s, NFT_PREFS_DIFF_REPLACE, from, to, NULL, NO_INDEX, 0);
+
+        return _diff_props(s, from, to) && _diff_children(s, from, to);
+}
+
+
+
+/** find node of tree a change applies to */
+static xmlNode *_resolve(xmlNode * tree, NftPrefsDiff * d, size_t i)
+{
+        DiffTarget *t = &d->targets[i];
+
+        xmlNode *n = tree;
+        for(size_t k = 0; n && k < t->depth; k++)
+        {
+                size_t child = d->paths[t->offset + k];
+                for(n = xmlFirstElementChild(n); n && child > 0; child--)
+                        n = xmlNextElementSibling(n);
+        }
+
+        /* tree doesn't match the old tree of the diff */
+        if(!n || !xmlStrEqual(n->name, d->entries[i].from->name))
+                return NULL;
+
+        return n;
+}
+
+
+/** turn node into a copy of another one (keeping the node itself) */
+static NftResult _replace(xmlNode * n, xmlNode * to)
+{
+        _node_index_drop(n);
+        if(!_arena_node_set_name(n, to->name))
+                return NFT_FAILURE;
+
+        xmlAttr *a;
+        while((a = n->properties))
+        {
+                xmlUnlinkNode((xmlNode *) a);
+                _arena_node_free((xmlNode *) a);
+        }
+        xmlNode *c;
+        while((c = n->children))
+        {
+                xmlUnlinkNode(c);
+                _arena_node_free(c);
+        }
+
+        if(to->properties && !(n->properties = xmlCopyPropList(n, to->properties)))
+                return NFT_FAILURE;
+
+        xmlNode *children;
+        if(to->children &&
+           (!(children = xmlDocCopyNodeList(n->doc, to->children)) ||
+            !xmlAddChildList(n, children)))
+                return NFT_FAILURE;
+
+        return NFT_SUCCESS;
+}
+
+
+/** insert node as element child of given index */
+static NftResult _insert(xmlNode * parent, xmlNode * n, size_t index)
+{
+        _node_index_invalidate(parent);
+
+        xmlNode *before = xmlFirstElementChild(parent);
+        for(; before && index > 0; index--)
+                before = xmlNextElementSibling(before);
+
+        if(before)
+                return xmlAddPrevSibling(before, n) ? NFT_SUCCESS : NFT_FAILURE;
+
+        return xmlAddChild(parent, n) ? NFT_SUCCESS : NFT_FAILURE;
+}
+
+
+
+/******************************************************************************/
+/**************************** PRIVATE FUNCTIONS *******************************/
+/******************************************************************************/
+
+/** FNV-1a hash of buffer */
+uint64_t _diff_hash_bytes(const void *data, size_t length)
+{
+        return _fnv(FNV_OFFSET, data, length);
+}
+
+
+/** determine changes from one tree to another */
+NftPrefsDiff *_diff_new(NftPrefsNode * from, NftPrefsNode * to)
+{
+        if(!from || !to)
+                NFT_LOG_NULL(NULL);
+
+        DiffState s = { 0 };
+        if(!(s.d = calloc(1, sizeof(NftPrefsDiff))))
+        {
+                NFT_LOG_PERROR("calloc");
+                return NULL;
+        }
+
+        uint64_t h;
+        if(!_hash_tree(&s, from, &h) || !_hash_tree(&s, to, &h) ||
+           !_diff_node(&s, from, to))
+        {
+                _diff_free(s.d);
+                s.d = NULL;
+        }
+
+        free(s.hashes);
+        free(s.path);
+        return s.d;
+}
+
+
+/** free list of changes */
+void _diff_free(NftPrefsDiff * d)
+{
+        if(!d)
+                return;
+
+        free(d->entries);
+        free(d->targets);
+        free(d->paths);
+        free(d);
+}
+
+
+
+/******************************************************************************/
+/**************************** API FUNCTIONS ***********************************/
+/******************************************************************************/
+
+/**
+ * determine changes needed to turn one tree into another. Children are 
+ * matched by name and key property (NFT_PREFS_DIFF_KEY), subtrees with 
+ * equal content are skipped. Formatting & comments are ignored.
+ *
+ * @param a old tree
+ * @param b new tree
+ * @result list of changes (free with nft_prefs_diff_free()) or NULL upon 
+ * error
+ * @note the changes refer to nodes of both trees, so they must not be 
+ * modified or freed while the diff is in use
+ */
+NftPrefsDiff *nft_prefs_node_diff(NftPrefsNode * a, NftPrefsNode * b)
+{
+        if(!a || !b)
+                NFT_LOG_NULL(NULL);
+
+        return _diff_new(a, b);
+}
+
+
+/**
+ * apply changes to a tree. Added or replaced nodes are copied from the new 
+ * tree of the diff, removed nodes are freed.
+ *
+ * @param tree old tree of the diff or a copy of it
+ * @param d diff created by nft_prefs_node_diff()
+ * @result NFT_SUCCESS or NFT_FAILURE. If tree doesn't match the old tree of
+ * the diff, it's left unchanged. If applying a change fails (e.g. out of 
+ * memory), tree is left partially patched: changes applied so far are kept 
+ * and moved nodes not yet inserted are appended to their old parent, so no
+ * node is lost
+ * @note when patching the old tree itself, the diff must be freed afterwards
+ * since it refers to removed nodes.
+ */
+NftResult nft_prefs_node_patch(NftPrefsNode * tree, NftPrefsDiff * d)
+{
+        if(!tree || !d)
+                NFT_LOG_NULL(NFT_FAILURE);
+
+        if(d->length == 0)
+                return NFT_SUCCESS;
+
+        NftResult r = NFT_FAILURE;
+
+        /* target & (for moves) parent of every change */
+        xmlNode **nodes;
+        if(!(nodes = calloc(d->length * 2, sizeof(xmlNode *))))
+        {
+                NFT_LOG_PERROR("calloc");
+                return NFT_FAILURE;
+        }
+        xmlNode **parents = &nodes[d->length];
+
+        /* look up all nodes before anything changes */
+        for(size_t i = 0; i < d->length; i++)
+        {
+                if(!(nodes[i] = _resolve(tree, d, i)))
+                {
+                        NFT_LOG(L_ERROR, "Tree doesn't match diff (change %zu)", i);
+                        goto _np_exit;
+                }
+
+                /* pending values of new tree are copied as text */
+                NftPrefsDiffEntry *e = &d->entries[i];
+                if(e->op == NFT_PREFS_DIFF_PROP_SET)
+                        _node_prop_flush(e->to, BAD_CAST e->prop);
+                else if(e->op == NFT_PREFS_DIFF_REPLACE || e->op == NFT_PREFS_DIFF_ADD)
+                        _node_index_flush(e->to);
+        }
+
+        /* nodes are changed in place */
+        _arena_doc_modified(tree->doc);
+
+        /* properties & replaced nodes */
+        for(size_t i = 0; i < d->length; i++)
+        {
+                NftPrefsDiffEntry *e = &d->entries[i];
+                switch (e->op)
+                {
+                        case NFT_PREFS_DIFF_PROP_SET:
+                        {
+                                xmlChar *value = xmlGetProp(e->to, BAD_CAST e->prop);
+                                xmlAttr *attr = value ? _node_prop_set(nodes[i], BAD_CAST e->prop, value) : NULL;
+                                if(attr)
+                                        _node_prop_intern(attr, (size_t) xmlStrlen(value));
+                                xmlFree(value);
+                                if(!attr)
+                                        goto _np_leave;
+                                break;
+                        }
+
+                        case NFT_PREFS_DIFF_PROP_UNSET:
+                                _node_prop_unset(nodes[i], BAD_CAST e->prop);
+                                break;
+
+                        case NFT_PREFS_DIFF_REPLACE:
+                                if(!_replace(nodes[i], e->to))
+                                        goto _np_leave;
+                                break;
+
+                        default:
+                                break;
+                }
+        }
+
+        /* take removed & moved children out */
+        for(size_t i = 0; i < d->length; i++)
+        {
+                if(d->entries[i].op == NFT_PREFS_DIFF_REMOVE)
+                {
+                        _node_index_invalidate(nodes[i]->parent);
+                        _node_index_drop(nodes[i]);
+                        xmlUnlinkNode(nodes[i]);
+                        _arena_node_free(nodes[i]);
+                }
+                else if(d->entries[i].op == NFT_PREFS_DIFF_MOVE)
+                {
+                        parents[i] = nodes[i]->parent;
+                        _node_index_invalidate(parents[i]);
+                        xmlUnlinkNode(nodes[i]);
+                }
+        }
+
+        /* insert added & moved children (in ascending order of their new 
+           index for every parent) */
+        for(size_t i = 0; i < d->length; i++)
+        {
+                NftPrefsDiffEntry *e = &d->entries[i];
+                if(e->op == NFT_PREFS_DIFF_ADD)
+                {
+                        xmlNode *copy;
+                        if(!(copy = xmlDocCopyNode(e->to, nodes[i]->doc, 1)))
+                                goto _np_leave;
+                        if(!_insert(nodes[i], copy, e->index))
+                        {
+                                xmlFreeNode(copy);
+                                goto _np_leave;
+                        }
+                }
+                else if(e->op == NFT_PREFS_DIFF_MOVE)
+                {
+                        if(!_insert(parents[i], nodes[i], e->index))
+                                goto _np_leave;
+                }
+        }
+
+        r = NFT_SUCCESS;
+
+_np_leave:
+        if(!r)
+        {
+                NFT_LOG(L_ERROR, "Failed to apply diff");
+
+                /* moved nodes that weren't inserted yet go back to their 
+                   old parent (at the end) instead of getting lost */
+                for(size_t i = 0; i < d->length; i++)
+                {
+                        if(d->entries[i].op != NFT_PREFS_DIFF_MOVE ||
+                           !parents[i] || nodes[i]->parent)
+                                continue;
+
+                        _node_index_invalidate(parents[i]);
+                        xmlAddChild(parents[i], nodes[i]);
+                }
+        }
+
+_np_exit:
+        free(nodes);
+        return r;
+}
+
+
+/**
+ * free list of changes
+ *
+ * @param d NftPrefsDiff created by nft_prefs_node_diff()
+ */
+void nft_prefs_diff_free(NftPrefsDiff * d)
+{
+        if(!d)
+                NFT_LOG_NULL();
+
+        _diff_free(d);
+}
+
+
+/**
+ * get amount of changes
+ *
+ * @param d NftPrefsDiff
+ * @result amount of changes
+ */
+size_t nft_prefs_diff_length(NftPrefsDiff * d)
+{
+        if(!d)
+                NFT_LOG_NULL(0);
+
+        return d->length;
+}
+
+
+/**
+ * get one change
+ *
+ * @param d NftPrefsDiff
+ * @param i index of change (< nft_prefs_diff_length())
+ * @result change or NULL
+ */
+const NftPrefsDiffEntry *nft_prefs_diff_get(NftPrefsDiff * d, size_t i)
+{
+        if(!d)
+                NFT_LOG_NULL(NULL);
+
+        if(i >= d->length)
+        {
+                NFT_LOG(L_ERROR, "Change %zu requested but diff has only %zu", i, d->length);
+                return NULL;
+        }
+
+        return &d->entries[i];
+}
+
+
+/**
+ * @}
+ */
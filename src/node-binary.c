@@ -0,0 +1,1188 @@
+/*
+ * libniftyprefs - lightweight modelless preferences management library
+ * Copyright (C) 2006-2014 Daniel Hiepler <daniel@niftylight.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/**
+ * @file node-binary.c
+ *
+ * compact binary representation of preference trees:
+ *
+ * @verbatim
+   file     := magic("NFTB") version:u8 strings node
+   strings  := count:varint (length:varint bytes)*
+   node     := kind:u8 (element | text | pi)
+   element  := name:str nsdefs ns props children
+   nsdefs   := count:varint (prefix:optstr href:str)*
+   ns       := 0 (none) | 1 (default namespace) | 2 + prefix:str
+   props    := count:varint (name:str ns type:u8 value)*
+   value    := str (string) | zigzag:varint (integer) | ieee754:le64 (double)
+   children := length:le32 count:varint node*
+   text     := content:str
+   pi       := name:str content:optstr
+   str      := index into string table:varint
+   optstr   := 0 (NULL) | 1 + index into string table:varint
+   @endverbatim
+ *
+ * Integers and doubles are only stored in binary form if formatting them 
+ * again results in exactly the same string as stored in the tree, so 
+ * binary and XML representation always produce identical trees.
+ */
+
+/**
+ * @addtogroup prefs_node
+ * @{
+ *
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <libxml/hash.h>
+#include <libxml/uri.h>
+#include <niftylog.h>
+#include "prefs.h"
+#include "updater.h"
+#include "node.h"
+#include "number.h"
+
+
+
+/** first bytes of every binary preferences file */
+#define BINARY_MAGIC            "NFTB"
+/** version of binary format */
+#define BINARY_VERSION          2
+/** maximum nesting depth accepted when decoding */
+#define BINARY_MAX_DEPTH        1024
+
+
+/** kind of node */
+typedef enum
+{
+        KIND_ELEMENT = 0,
+        KIND_TEXT,
+        KIND_CDATA,
+        KIND_COMMENT,
+        KIND_PI,
+} BinaryKind;
+
+
+/** type of property value */
+typedef enum
+{
+        VALUE_STRING = 0,
+        VALUE_INT,
+        VALUE_DOUBLE,
+} BinaryValue;
+
+
+/** growing output buffer */
+typedef struct
+{
+        unsigned char *data;
+        size_t length;
+        size_t size;
+        bool failed;
+} BinaryWriter;
+
+
+/** encoder state */
+typedef struct
+{
+        /** string -> index + 1 */
+        xmlHashTablePtr index;
+        /** all strings in order of their index */
+        const xmlChar **strings;
+        size_t strings_count;
+        size_t strings_size;
+        BinaryWriter out;
+} BinaryEncoder;
+
+
+/** decoder state */
+typedef struct
+{
+        const unsigned char *pos;
+        const unsigned char *end;
+        xmlDoc *doc;
+        /** strings of string table */
+        xmlChar **strings;
+        /** lengths of strings */
+        size_t *lengths;
+        size_t strings_count;
+        /** short strings are owned by this dictionary, all others were 
+            allocated by us (or NULL) */
+        xmlDict *dict;
+} BinaryDecoder;
+
+
+
+
+/******************************************************************************/
+/**************************** STATIC FUNCTIONS ********************************/
+/******************************************************************************/
+
+/** parse integer in canonical form ("0", "-12", no leading zeros etc.) */
+static bool _parse_canonical_int(const xmlChar * s, int64_t * v)
+{
+        const xmlChar *p = s;
+        bool negative = (*p == '-');
+        if(negative)
+                p++;
+
+        /* no empty string, no leading zeros, no "-0" */
+        if(*p < '0' || *p > '9' || (p[0] == '0' && (p[1] || negative)))
+                return false;
+
+        uint64_t r = 0;
+        for(; *p; p++)
+        {
+                if(*p < '0' || *p > '9')
+                        return false;
+
+                if(r > (UINT64_MAX - 9) / 10)
+                        return false;
+
+                r = r * 10 + (*p - '0');
+        }
+
+        if(r > (negative ? (uint64_t) INT64_MAX + 1 : (uint64_t) INT64_MAX))
+                return false;
+
+        *v = negative ? (int64_t) (0 - r) : (int64_t) r;
+
+        return true;
+}
+
+
+/** parse double formatted by _number_format_double() ("-12.345") */
+static bool _parse_canonical_double(const xmlChar * s, double *v)
+{
+        if(!_number_parse_double((const char *) s, v))
+                return false;
+
+        /* make sure we get the same string again */
+        char tmp[NUMBER_MAXLEN];
+        _number_format_double(*v, tmp);
+        return strcmp(tmp, (const char *) s) == 0;
+}
+
+
+/** make sure n more bytes fit into buffer */
+static bool _writer_reserve(BinaryWriter * w, size_t n)
+{
+        if(w->failed)
+                return false;
+
+        if(w->length + n <= w->size)
+                return true;
+
+        size_t size = w->size ? w->size : 4096;
+        while(size < w->length + n)
+                size *= 2;
+
+        unsigned char *data;
+        if(!(data = realloc(w->data, size)))
+        {
+                NFT_LOG_PERROR("realloc");
+                w->failed = true;
+                return false;
+        }
+
+        w->data = data;
+        w->size = size;
+
+        return true;
+}
+
+
+/** append bytes */
+static void _writer_put(BinaryWriter * w, const void *data, size_t n)
+{
+        if(!_writer_reserve(w, n))
+                return;
+
+        memcpy(&w->data[w->length], data, n);
+        w->length += n;
+}
+
+
+/** append variable length unsigned integer (7 bits per byte) */
+static void _writer_varint(BinaryWriter * w, uint64_t v)
+{
+        if(!_writer_reserve(w, 10))
+                return;
+
+        while(v >= 0x80)
+        {
+                w->data[w->length++] = (unsigned char) (v | 0x80);
+                v >>= 7;
+        }
+        w->data[w->length++] = (unsigned char) v;
+}
+
+
+/** append one byte */
+static void _writer_byte(BinaryWriter * w, unsigned char b)
+{
+        _writer_put(w, &b, 1);
+}
+
+
+/** write 32 bit little endian integer at position */
+static void _writer_le32_at(BinaryWriter * w, size_t pos, uint32_t v)
+{
+        if(w->failed)
+                return;
+
+        for(int i = 0; i < 4; i++)
+                w->data[pos + i] = (unsigned char) (v >> (8 * i));
+}
+
+
+/** add string to string table of encoder */
+static void _encoder_add(BinaryEncoder * e, const xmlChar * s)
+{
+        if(!s || xmlHashLookup(e->index, s))
+                return;
+
+        if(e->strings_count >= e->strings_size)
+        {
+                size_t size = e->strings_size ? e->strings_size * 2 : 64;
+                const xmlChar **strings;
+                if(!(strings = realloc(e->strings, size * sizeof(xmlChar *))))
+                {
+                        NFT_LOG_PERROR("realloc");
+                        e->out.failed = true;
+                        return;
+                }
+                e->strings = strings;
+                e->strings_size = size;
+        }
+
+        if(xmlHashAddEntry(e->index, s,
+                           (void *) (uintptr_t) (e->strings_count + 1)) != 0)
+        {
+                NFT_LOG(L_ERROR, "Failed to xmlHashAddEntry()");
+                e->out.failed = true;
+                return;
+        }
+
+        e->strings[e->strings_count++] = s;
+}
+
+
+/** get string table index of string */
+static uint64_t _encoder_index(BinaryEncoder * e, const xmlChar * s)
+{
+        return (uint64_t) (uintptr_t) xmlHashLookup(e->index, s) - 1;
+}
+
+
+/** get value of a property if it's stored in one text node */
+static const xmlChar *_attr_value(xmlAttr * a)
+{
+        xmlNode *t = a->children;
+        if(!t)
+                return BAD_CAST "";
+
+        if(t->next || t->type != XML_TEXT_NODE)
+                return NULL;
+
+        return t->content;
+}
+
+
+/** collect all strings of a tree */
+static void _encoder_collect(BinaryEncoder * e, xmlNode * n)
+{
+        switch (n->type)
+        {
+                case XML_ELEMENT_NODE:
+                {
+                        _encoder_add(e, n->name);
+
+                        for(xmlNs * ns = n->nsDef; ns; ns = ns->next)
+                        {
+                                _encoder_add(e, ns->prefix);
+                                _encoder_add(e, ns->href);
+                        }
+                        if(n->ns)
+                                _encoder_add(e, n->ns->prefix);
+
+                        for(xmlAttr * a = n->properties; a; a = a->next)
+                        {
+                                _encoder_add(e, a->name);
+                                if(a->ns)
+                                        _encoder_add(e, a->ns->prefix);
+
+                                const xmlChar *value = _attr_value(a);
+                                int64_t i;
+                                double d;
+                                if(value && !_parse_canonical_int(value, &i) &&
+                                   !_parse_canonical_double(value, &d))
+                                        _encoder_add(e, value);
+                        }
+
+                        for(xmlNode * c = n->children; c; c = c->next)
+                                _encoder_collect(e, c);
+                        break;
+                }
+
+                case XML_PI_NODE:
+                {
+                        _encoder_add(e, n->name);
+                        _encoder_add(e, n->content);
+                        break;
+                }
+
+                case XML_TEXT_NODE:
+                case XML_CDATA_SECTION_NODE:
+                case XML_COMMENT_NODE:
+                {
+                        _encoder_add(e, n->content ? n->content : BAD_CAST "");
+                        break;
+                }
+
+                default:
+                {
+                        break;
+                }
+        }
+}
+
+
+/** write namespace reference */
+static void _encoder_ns(BinaryEncoder * e, xmlNs * ns)
+{
+        if(!ns)
+                _writer_varint(&e->out, 0);
+        else if(!ns->prefix)
+                _writer_varint(&e->out, 1);
+        else
+                _writer_varint(&e->out, 2 + _encoder_index(e, ns->prefix));
+}
+
+
+/** write node */
+static void _encoder_node(BinaryEncoder * e, xmlNode * n)
+{
+        BinaryWriter *w = &e->out;
+
+        switch (n->type)
+        {
+                case XML_ELEMENT_NODE:
+                {
+                        _writer_byte(w, KIND_ELEMENT);
+                        _writer_varint(w, _encoder_index(e, n->name));
+
+                        /* namespace definitions & namespace */
+                        uint64_t count = 0;
+                        for(xmlNs * ns = n->nsDef; ns; ns = ns->next)
+                                count++;
+                        _writer_varint(w, count);
+                        for(xmlNs * ns = n->nsDef; ns; ns = ns->next)
+                        {
+                                _writer_varint(w, ns->prefix ?
+                                               1 + _encoder_index(e, ns->prefix) : 0);
+                                _writer_varint(w, _encoder_index(e, ns->href));
+                        }
+                        _encoder_ns(e, n->ns);
+
+                        /* properties */
+                        count = 0;
+                        for(xmlAttr * a = n->properties; a; a = a->next)
+                                count++;
+                        _writer_varint(w, count);
+                        for(xmlAttr * a = n->properties; a; a = a->next)
+                        {
+                                _writer_varint(w, _encoder_index(e, a->name));
+                                _encoder_ns(e, a->ns);
+
+                                const xmlChar *value;
+                                if(!(value = _attr_value(a)))
+                                {
+                                        NFT_LOG(L_ERROR, "Property \"%s\" contains entity references",
+                                                a->name);
+                                        w->failed = true;
+                                        return;
+                                }
+
+                                int64_t i;
+                                double d;
+                                if(_parse_canonical_int(value, &i))
+                                {
+                                        _writer_byte(w, VALUE_INT);
+                                        _writer_varint(w, ((uint64_t) i << 1) ^
+                                                       (uint64_t) (i >> 63));
+                                }
+                                else if(_parse_canonical_double(value, &d))
+                                {
+                                        uint64_t bits;
+                                        memcpy(&bits, &d, sizeof(bits));
+                                        unsigned char le[8];
+                                        for(int b = 0; b < 8; b++)
+                                                le[b] = (unsigned char) (bits >> (8 * b));
+                                        _writer_byte(w, VALUE_DOUBLE);
+                                        _writer_put(w, le, sizeof(le));
+                                }
+                                else
+                                {
+                                        _writer_byte(w, VALUE_STRING);
+                                        _writer_varint(w, _encoder_index(e, value));
+                                }
+                        }
+
+                        /* children (length-prefixed so they can be skipped) */
+                        size_t start = w->length;
+                        _writer_put(w, "\0\0\0\0", 4);
+                        count = 0;
+                        for(xmlNode * c = n->children; c; c = c->next)
+                        {
+                                if(c->type == XML_ELEMENT_NODE ||
+                                   c->type == XML_TEXT_NODE ||
+                                   c->type == XML_CDATA_SECTION_NODE ||
+                                   c->type == XML_COMMENT_NODE ||
+                                   c->type == XML_PI_NODE)
+                                        count++;
+                        }
+                        _writer_varint(w, count);
+                        for(xmlNode * c = n->children; c; c = c->next)
+                                _encoder_node(e, c);
+
+                        if(w->length - start - 4 > UINT32_MAX)
+                        {
+                                NFT_LOG(L_ERROR, "Node \"%s\" too large", n->name);
+                                w->failed = true;
+                                return;
+                        }
+                        _writer_le32_at(w, start, (uint32_t) (w->length - start - 4));
+                        break;
+                }
+
+                case XML_TEXT_NODE:
+                case XML_CDATA_SECTION_NODE:
+                case XML_COMMENT_NODE:
+                {
+                        _writer_byte(w, n->type == XML_TEXT_NODE ? KIND_TEXT :
+                                     n->type == XML_CDATA_SECTION_NODE ?
+                                     KIND_CDATA : KIND_COMMENT);
+                        _writer_varint(w, _encoder_index(e, n->content ?
+                                                         n->content : BAD_CAST ""));
+                        break;
+                }
+
+                case XML_PI_NODE:
+                {
+                        _writer_byte(w, KIND_PI);
+                        _writer_varint(w, _encoder_index(e, n->name));
+                        _writer_varint(w, n->content ?
+                                       1 + _encoder_index(e, n->content) : 0);
+                        break;
+                }
+
+                /* other nodes (entity references etc.) are dropped */
+                default:
+                {
+                        break;
+                }
+        }
+}
+
+
+/** read one byte */
+static bool _decoder_byte(BinaryDecoder * d, unsigned char *b)
+{
+        if(d->pos >= d->end)
+                return false;
+
+        *b = *d->pos++;
+        return true;
+}
+
+
+/** read variable length unsigned integer */
+static bool _decoder_varint(BinaryDecoder * d, uint64_t * v)
+{
+        uint64_t r = 0;
+        for(int shift = 0; shift < 64; shift += 7)
+        {
+                if(d->pos >= d->end)
+                        return false;
+
+                unsigned char b = *d->pos++;
+                r |= (uint64_t) (b & 0x7f) << shift;
+                if(!(b & 0x80))
+                {
+                        *v = r;
+                        return true;
+                }
+        }
+
+        return false;
+}
+
+
+/** read index into string table (UINT64_MAX for NULL) */
+static bool _decoder_string_index(BinaryDecoder * d, uint64_t * i,
+                                  uint64_t offset)
+{
+        if(!_decoder_varint(d, i))
+                return false;
+
+        if(offset && *i == 0)
+        {
+                *i = UINT64_MAX;
+                return true;
+        }
+
+        *i -= offset;
+
+        return *i < d->strings_count;
+}
+
+
+/** read string table index (if offset is 1, 0 stands for NULL) */
+static bool _decoder_string(BinaryDecoder * d, xmlChar ** s, uint64_t offset)
+{
+        uint64_t i;
+        if(!_decoder_string_index(d, &i, offset))
+                return false;
+
+        *s = (offset && i == UINT64_MAX) ? NULL : d->strings[i];
+        return true;
+}
+
+
+/** read namespace reference of node */
+static bool _decoder_ns(BinaryDecoder * d, xmlNode * n, xmlNs ** ns)
+{
+        uint64_t i;
+        if(!_decoder_varint(d, &i))
+                return false;
+
+        *ns = NULL;
+        if(i == 0)
+                return true;
+
+        xmlChar *prefix = NULL;
+        if(i > 1)
+        {
+                if(i - 2 >= d->strings_count)
+                        return false;
+                prefix = d->strings[i - 2];
+        }
+
+        if(!(*ns = xmlSearchNs(d->doc, n, prefix)))
+        {
+                NFT_LOG(L_ERROR, "Undefined namespace prefix \"%s\"",
+                        prefix ? (char *) prefix : "");
+                return false;
+        }
+
+        return true;
+}
+
+
+/** read node and add it to parent (or make it root of the document) */
+static bool _decoder_node(BinaryDecoder * d, xmlNode * parent, int depth)
+{
+        if(depth > BINARY_MAX_DEPTH)
+                return false;
+
+        unsigned char kind;
+        if(!_decoder_byte(d, &kind))
+                return false;
+
+        xmlNode *n = NULL;
+        xmlChar *s, *c;
+        switch (kind)
+        {
+                case KIND_ELEMENT:
+                {
+                        if(!_decoder_string(d, &s, 0))
+                                return false;
+
+                        if(!(n = xmlNewDocNode(d->doc, NULL, s, NULL)))
+                                return false;
+
+                        /* link node first, so namespaces of parents are found */
+                        if(parent)
+                                xmlAddChild(parent, n);
+                        else
+                                xmlDocSetRootElement(d->doc, n);
+
+                        /* namespace definitions & namespace */
+                        uint64_t count;
+                        if(!_decoder_varint(d, &count))
+                                return false;
+                        for(uint64_t i = 0; i < count; i++)
+                        {
+                                if(!_decoder_string(d, &c, 1) ||
+                                   !_decoder_string(d, &s, 0) ||
+                                   !xmlNewNs(n, s, c))
+                                        return false;
+                        }
+
+                        xmlNs *ns;
+                        if(!_decoder_ns(d, n, &ns))
+                                return false;
+                        xmlSetNs(n, ns);
+
+                        /* properties */
+                        if(!_decoder_varint(d, &count))
+                                return false;
+                        for(uint64_t i = 0; i < count; i++)
+                        {
+                                unsigned char type;
+                                if(!_decoder_string(d, &s, 0) ||
+                                   !_decoder_ns(d, n, &ns) ||
+                                   !_decoder_byte(d, &type))
+                                        return false;
+
+                                char tmp[NUMBER_MAXLEN];
+                                const xmlChar *value;
+                                size_t length;
+                                switch (type)
+                                {
+                                        case VALUE_STRING:
+                                        {
+                                                uint64_t v;
+                                                if(!_decoder_string_index(d, &v, 0))
+                                                        return false;
+                                                value = d->strings[v];
+                                                length = d->lengths[v];
+                                                break;
+                                        }
+
+                                        case VALUE_INT:
+                                        {
+                                                uint64_t v;
+                                                if(!_decoder_varint(d, &v))
+                                                        return false;
+                                                int64_t i = (int64_t) (v >> 1) ^
+                                                        -(int64_t) (v & 1);
+                                                length = _number_format_int(i, tmp);
+                                                value = BAD_CAST tmp;
+                                                break;
+                                        }
+
+                                        case VALUE_DOUBLE:
+                                        {
+                                                if(d->end - d->pos < 8)
+                                                        return false;
+                                                uint64_t bits = 0;
+                                                for(int b = 0; b < 8; b++)
+                                                        bits |= (uint64_t) d->pos[b] << (8 * b);
+                                                d->pos += 8;
+                                                double v;
+                                                memcpy(&v, &bits, sizeof(v));
+                                                length = _number_format_double(v, tmp);
+                                                value = BAD_CAST tmp;
+                                                break;
+                                        }
+
+                                        default:
+                                        {
+                                                return false;
+                                        }
+                                }
+
+                                xmlAttr *a;
+                                if(!(a = xmlNewNsProp(n, ns, s, value)))
+                                        return false;
+                                _node_prop_intern(a, length);
+                        }
+
+                        /* children */
+                        const unsigned char *start;
+                        uint32_t length = 0;
+                        if(d->end - d->pos < 4)
+                                return false;
+                        for(int b = 0; b < 4; b++)
+                                length |= (uint32_t) d->pos[b] << (8 * b);
+                        d->pos += 4;
+                        start = d->pos;
+                        if((size_t) (d->end - start) < length)
+                                return false;
+
+                        if(!_decoder_varint(d, &count))
+                                return false;
+                        for(uint64_t i = 0; i < count; i++)
+                        {
+                                if(!_decoder_node(d, n, depth + 1))
+                                        return false;
+                        }
+
+                        return d->pos == start + length;
+                }
+
+                case KIND_TEXT:
+                case KIND_CDATA:
+                case KIND_COMMENT:
+                {
+                        uint64_t i;
+                        if(!_decoder_string_index(d, &i, 0) || !parent)
+                                return false;
+
+                        s = d->strings[i];
+                        if(kind == KIND_TEXT)
+                                n = xmlNewDocText(d->doc, s);
+                        else if(kind == KIND_CDATA)
+                                n = xmlNewCDataBlock(d->doc, s, (int) d->lengths[i]);
+                        else
+                                n = xmlNewDocComment(d->doc, s);
+                        break;
+                }
+
+                case KIND_PI:
+                {
+                        if(!_decoder_string(d, &s, 0) ||
+                           !_decoder_string(d, &c, 1) || !parent)
+                                return false;
+
+                        n = xmlNewDocPI(d->doc, s, c);
+                        break;
+                }
+
+                default:
+                {
+                        return false;
+                }
+        }
+
+        if(!n)
+                return false;
+
+        /* xmlAddChild() may merge adjacent text nodes */
+        xmlAddChild(parent, n);
+
+        return true;
+}
+
+
+
+/******************************************************************************/
+/**************************** PRIVATE FUNCTIONS *******************************/
+/******************************************************************************/
+
+/** encode node and all children to binary representation. Returned buffer 
+    must be freed using free() */
+NftResult _node_binary_encode(NftPrefsNode * n, unsigned char **data,
+                              size_t * length)
+{
+        /* pending values are encoded as text */
+        _node_index_flush(n);
+
+        BinaryEncoder e;
+        memset(&e, 0, sizeof(e));
+
+        if(!(e.index = xmlHashCreate(256)))
+        {
+                NFT_LOG(L_ERROR, "Failed to xmlHashCreate()");
+                return NFT_FAILURE;
+        }
+
+        /* collect all strings */
+        _encoder_collect(&e, n);
+
+        /* header & string table */
+        _writer_put(&e.out, BINARY_MAGIC, 4);
+        _writer_byte(&e.out, BINARY_VERSION);
+        _writer_varint(&e.out, e.strings_count);
+        for(size_t i = 0; i < e.strings_count; i++)
+        {
+                size_t l = xmlStrlen(e.strings[i]);
+                _writer_varint(&e.out, l);
+                _writer_put(&e.out, e.strings[i], l);
+        }
+
+        /* tree */
+        _encoder_node(&e, n);
+
+        xmlHashFree(e.index, NULL);
+        free(e.strings);
+
+        if(e.out.failed)
+        {
+                free(e.out.data);
+                return NFT_FAILURE;
+        }
+
+        *data = e.out.data;
+        *length = e.out.length;
+
+        return NFT_SUCCESS;
+}
+
+
+/** create node from binary representation. If process is false, the 
+    encoded tree was already processed (XInclude & updaters) */
+NftPrefsNode *_node_binary_decode(NftPrefs * p, const unsigned char *data,
+                                  size_t length, const char *uri, bool process)
+{
+        BinaryDecoder d;
+        memset(&d, 0, sizeof(d));
+        d.pos = data;
+        d.end = data + length;
+
+        /* check header */
+        if(length < 5 || memcmp(data, BINARY_MAGIC, 4) != 0 ||
+           data[4] != BINARY_VERSION)
+        {
+                NFT_LOG(L_ERROR, "Not a binary preferences file (or unsupported version)");
+                return NULL;
+        }
+        d.pos += 5;
+
+        NftPrefsNode *node = NULL;
+
+        /* create document (nodes share the dictionary of the context) */
+        if(!(d.doc = xmlNewDoc(BAD_CAST "1.0")))
+        {
+                NFT_LOG(L_ERROR, "Failed to create new XML doc");
+                return NULL;
+        }
+        d.doc->dict = _prefs_doc_dict(p);
+        xmlDictReference(d.doc->dict);
+        if(uri)
+                d.doc->URL = xmlPathToURI(BAD_CAST uri);
+
+        /* string table */
+        d.dict = d.doc->dict;
+        uint64_t count;
+        if(!_decoder_varint(&d, &count) || count > (uint64_t) (d.end - d.pos))
+                goto _nbd_corrupt;
+
+        if(!(d.strings = calloc(count ? count : 1, sizeof(xmlChar *))) ||
+           !(d.lengths = calloc(count ? count : 1, sizeof(size_t))))
+        {
+                NFT_LOG_PERROR("calloc");
+                goto _nbd_error;
+        }
+
+        for(d.strings_count = 0; d.strings_count < count; d.strings_count++)
+        {
+                uint64_t l;
+                if(!_decoder_varint(&d, &l) || l > (uint64_t) (d.end - d.pos) ||
+                   l > INT_MAX)
+                        goto _nbd_corrupt;
+
+                /* names are interned when nodes are created, so only short
+                   strings that are likely to be repeated values go to the 
+                   dictionary right away (s. _node_prop_intern()) */
+                xmlChar *s = (d.dict && l <= DICT_VALUE_MAXLEN) ?
+                        (xmlChar *) xmlDictLookup(d.dict, d.pos, (int) l) :
+                        xmlStrndup(d.pos, (int) l);
+                if(!s)
+                        goto _nbd_error;
+
+                d.strings[d.strings_count] = s;
+                d.lengths[d.strings_count] = l;
+                d.pos += l;
+        }
+
+        /* tree */
+        if(!_decoder_node(&d, NULL, 0) || d.pos != d.end ||
+           !xmlDocGetRootElement(d.doc))
+                goto _nbd_corrupt;
+
+        goto _nbd_strings_free;
+
+_nbd_corrupt:
+        NFT_LOG(L_ERROR, "Corrupt binary preferences");
+_nbd_error:
+        xmlFreeDoc(d.doc);
+        d.doc = NULL;
+_nbd_strings_free:
+        /* free string table (strings are copied by nodes or owned by dict) */
+        for(size_t i = 0; i < d.strings_count; i++)
+        {
+                if(!d.dict || d.lengths[i] > DICT_VALUE_MAXLEN)
+                        xmlFree(d.strings[i]);
+        }
+        free(d.strings);
+        free(d.lengths);
+
+        /* process document */
+        if(d.doc)
+                node = process ? _node_from_doc(p, d.doc) :
+                        _node_from_doc_processed(d.doc);
+
+        return _node_tree_finish(p, node);
+}
+
+
+
+/** read whole file. Returned buffer must be freed using free() */
+unsigned char *_node_binary_read_fd(int fd, size_t * length)
+{
+        struct stat sts;
+        if(fstat(fd, &sts) == -1)
+        {
+                NFT_LOG_PERROR("fstat");
+                return NULL;
+        }
+
+        unsigned char *data;
+        if(!(data = malloc(sts.st_size ? (size_t) sts.st_size : 1)))
+        {
+                NFT_LOG_PERROR("malloc");
+                return NULL;
+        }
+
+        size_t got;
+        for(got = 0; got < (size_t) sts.st_size;)
+        {
+                ssize_t r;
+                if((r = read(fd, &data[got], (size_t) sts.st_size - got)) <= 0)
+                {
+                        if(r < 0 && errno == EINTR)
+                                continue;
+
+                        if(r < 0)
+                                NFT_LOG_PERROR("read");
+                        free(data);
+                        return NULL;
+                }
+                got += r;
+        }
+
+        *length = got;
+
+        return data;
+}
+
+
+/** write whole buffer to file */
+NftResult _node_binary_write_fd(int fd, const unsigned char *data,
+                                size_t length)
+{
+        for(size_t written = 0; written < length;)
+        {
+                ssize_t w;
+                if((w = write(fd, &data[written], length - written)) < 0)
+                {
+                        if(errno == EINTR)
+                                continue;
+
+                        NFT_LOG_PERROR("write");
+                        return NFT_FAILURE;
+                }
+                written += w;
+        }
+
+        return NFT_SUCCESS;
+}
+
+
+
+/******************************************************************************/
+/**************************** API FUNCTIONS ***********************************/
+/******************************************************************************/
+
+/**
+ * create compact binary preferences file from NftPrefsNode and child nodes
+ *
+ * This is an alternative to nft_prefs_node_to_file(). Names and strings
+ * are stored once in a string table, integers and doubles are stored as 
+ * binary numbers, so neither escaping nor number formatting/parsing is
+ * needed when loading. nft_prefs_node_from_file_binary() creates exactly 
+ * the same tree that nft_prefs_node_from_file() would create from the 
+ * XML representation.
+ *
+ * @param p NftPrefs context
+ * @param n NftPrefsNode
+ * @param filename full path of file to be written
+ * @param overwrite if a file called "filename" already exists, it 
+ * will be overwritten if this is "true", otherwise NFT_FAILURE will be returned 
+ * @result NFT_SUCCESS or NFT_FAILURE
+ */
+NftResult nft_prefs_node_to_file_binary(NftPrefs * p, NftPrefsNode * n,
+                                        const char *filename, bool overwrite)
+{
+        if(!p || !n || !filename)
+                NFT_LOG_NULL(NFT_FAILURE);
+
+        /* file already existing? */
+        struct stat sts;
+        if(stat(filename, &sts) == -1)
+        {
+                /* continue if stat error was caused because file doesn't exist 
+                 */
+                if(errno != ENOENT)
+                {
+                        NFT_LOG(L_ERROR, "Failed to access \"%s\" - %s",
+                                filename, strerror(errno));
+                        return NFT_FAILURE;
+                }
+        }
+        /* stat succeeded, file exists */
+        else if(strcmp("-", filename) != 0)
+        {
+                /* remove old file? */
+                if(!overwrite)
+                        return NFT_FAILURE;
+
+                /* delete existing file */
+                if(unlink(filename) == -1)
+                {
+                        NFT_LOG(L_ERROR,
+                                "Failed to remove old version of \"%s\" - %s",
+                                filename, strerror(errno));
+                        return NFT_FAILURE;
+                }
+        }
+
+        /* add prefs version to node */
+        if(!(_updater_node_add_version(p, n)))
+        {
+                NFT_LOG(L_ERROR, "failed to add version to node \"%s\"",
+                        nft_prefs_node_get_name(n));
+                return NFT_FAILURE;
+        }
+
+        /* encode */
+        unsigned char *data;
+        size_t length;
+        if(!_node_binary_encode(n, &data, &length))
+        {
+                NFT_LOG(L_ERROR, "failed to encode node \"%s\"",
+                        nft_prefs_node_get_name(n));
+                return NFT_FAILURE;
+        }
+
+        NftResult r = NFT_FAILURE;
+
+        /* stdout? */
+        int fd;
+        if(strcmp("-", filename) == 0)
+        {
+                fd = STDOUT_FILENO;
+        }
+        /* open file */
+        else
+        {
+#ifdef WIN32
+                if((fd = open(filename,
+                              O_CREAT | O_WRONLY | O_BINARY, S_IRUSR | S_IWUSR)) == -1)
+#else
+                if((fd = open(filename,
+                              O_CREAT | O_WRONLY,
+                              S_IRUSR | S_IWUSR | S_IWGRP | S_IRGRP)) == -1)
+#endif
+                {
+                        NFT_LOG_PERROR("open");
+                        goto _pntfb_exit;
+                }
+        }
+
+        /* write to file */
+        r = _node_binary_write_fd(fd, data, length);
+
+        if(fd != STDOUT_FILENO)
+                close(fd);
+
+_pntfb_exit:
+        free(data);
+
+        return r;
+}
+
+
+/**
+ * create new NftPrefsNode from binary preferences file created by
+ * nft_prefs_node_to_file_binary()
+ *
+ * @param p NftPrefs context
+ * @param filename full path of file
+ * @result newly created NftPrefsNode or NULL
+ */
+NftPrefsNode *nft_prefs_node_from_file_binary(NftPrefs * p,
+                                              const char *filename)
+{
+        if(!p || !filename)
+                NFT_LOG_NULL(NULL);
+
+        int fd;
+#ifdef WIN32
+        if((fd = open(filename, O_RDONLY | O_BINARY)) == -1)
+#else
+        if((fd = open(filename, O_RDONLY)) == -1)
+#endif
+        {
+                NFT_LOG(L_ERROR, "Failed to open \"%s\" - %s", filename,
+                        strerror(errno));
+                return NULL;
+        }
+
+        NftPrefsNode *node = NULL;
+
+        /* read whole file */
+        size_t length;
+        unsigned char *data;
+        if(!(data = _node_binary_read_fd(fd, &length)))
+        {
+                NFT_LOG(L_ERROR, "Failed to read \"%s\"", filename);
+                goto _pnffb_exit;
+        }
+
+        node = _node_binary_decode(p, data, length, filename, true);
+
+        free(data);
+
+_pnffb_exit:
+        close(fd);
+
+        return node;
+}
+
+
+/**
+ * @}
+ */
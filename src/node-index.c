@@ -0,0 +1,1759 @@
+/*
+ * libniftyprefs - lightweight modelless preferences management library
+ * Copyright (C) 2006-2014 Daniel Hiepler <daniel@niftylight.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/**
+ * @file node-index.c
+ *
+ * index of the element children and of the properties of a node. The 
+ * children are indexed when a node with many children is first accessed by 
+ * position or child name, the properties when a property of a node with 
+ * many properties is looked up. Every document keeps a table of the indexes
+ * of its nodes (keyed by node, the _private field of nodes is left to the 
+ * application), so they can be found and freed together with the document.
+ * The table is locked while an index is looked up or built, so several 
+ * threads may read the same tree at once as long as none of them modifies
+ * it. Modifications of children 
+ * through the API drop the child index of the modified node, properties 
+ * set or unset through the API are added to or removed from the property 
+ * index.
+ *
+ * Nodes can also keep the typed values their properties were parsed to 
+ * (s. nft_prefs_node_set_value_cache()), so numeric properties that are 
+ * read over and over again are only parsed once. Values are dropped when 
+ * their property is set or unset through the API. Cached values have a 
+ * lock of their own per document, so typed getters filling the cache 
+ * don't race with other readers of the tree.
+ *
+ * Nodes that defer their values (s. nft_prefs_node_set_deferred_values()) 
+ * keep values set through the typed setters as pending values instead of 
+ * formatting them. Pending values are written to the properties of their 
+ * node before they're looked at as text (string getters, serialization, 
+ * diff, queries). Those reads modify the tree then, so a tree with pending
+ * values must not be read by several threads at once.
+ */
+
+/**
+ * @addtogroup prefs_node
+ * @{
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <niftylog.h>
+#include "prefs.h"
+#include "arena.h"
+#include "node.h"
+#include "diff.h"
+
+
+/** nodes with less children are searched without an index */
+#define NODE_INDEX_MIN_CHILDREN 16
+/** properties of nodes with less properties are searched without an index */
+#define NODE_INDEX_MIN_PROPS    32
+
+
+/** all children of the same name */
+typedef struct
+{
+        /** name of children (NULL if slot is empty) */
+        const xmlChar *name;
+        /** offset of positions of children in NftPrefsNodeIndex.byname */
+        size_t offset;
+        /** amount of children with this name */
+        size_t count;
+} IndexName;
+
+
+/** one property */
+typedef struct
+{
+        /** property (NULL if slot is empty) */
+        xmlAttr *attr;
+        /** hash of its name */
+        uint64_t hash;
+} IndexProp;
+
+
+/** typed value of one property */
+typedef struct
+{
+        /** name of property (owned by dictionary of document or by us) */
+        const xmlChar *name;
+        /** name is a copy */
+        bool owned;
+        /** value hasn't been written to its property yet */
+        bool pending;
+        /** type of value */
+        NftPrefsPropType type;
+        /** value */
+        NftPrefsNodeValue v;
+} IndexValue;
+
+
+/** index of the element children and properties of one node */
+struct _NftPrefsNodeIndex
+{
+        /** node this index belongs to */
+        xmlNode *parent;
+        /** neighbours in list of indexes of the document */
+        NftPrefsNodeIndex *prev, *next;
+        /** element children in order (NULL if children aren't indexed) */
+        xmlNode **children;
+        /** amount of element children */
+        size_t count;
+        /** positions of children grouped by name (in order) */
+        size_t *byname;
+        /** open addressing table of names */
+        IndexName *names;
+        /** size of table (power of 2) */
+        size_t size;
+        /** open addressing table of properties by name (NULL if properties
+            aren't indexed) */
+        IndexProp *props;
+        /** size of table (power of 2) */
+        size_t props_size;
+        /** amount of properties in table */
+        size_t props_count;
+        /** some properties share a name (different namespaces) */
+        bool props_shared;
+        /** first & last property of node */
+        xmlAttr *props_first, *props_last;
+        /** typed values of properties are cached */
+        bool values_enabled;
+        /** cached values */
+        IndexValue *values;
+        /** amount of cached values */
+        size_t values_count;
+        /** size of values */
+        size_t values_size;
+        /** typed setters store pending values */
+        bool values_deferred;
+        /** amount of pending values */
+        size_t values_pending;
+};
+
+
+/** indexes moved to another document (s. _node_index_move()) */
+typedef struct
+{
+        /** locked indexes of that document */
+        NftPrefsNodeIndexes *dst;
+        /** dictionary of that document */
+        xmlDict *dict;
+} IndexMove;
+
+
+/** indexes of the nodes of one document */
+struct _NftPrefsNodeIndexes
+{
+        /** all indexes */
+        NftPrefsNodeIndex *list;
+        /** open addressing table of indexes by node (NULL if slot is empty) */
+        NftPrefsNodeIndex **table;
+        /** size of table (power of 2) */
+        size_t size;
+        /** amount of indexes in table */
+        size_t count;
+        /** protects table & indexes (recursive, since looking up properties
+            or flushing values nests) */
+        pthread_mutex_t mutex;
+        /** protects cached & pending values of all indexes (taken after 
+            mutex, never the other way round) */
+        pthread_mutex_t values_mutex;
+};
+
+
+
+
+/******************************************************************************/
+/**************************** STATIC FUNCTIONS ********************************/
+/******************************************************************************/
+
+/** drop all cached values */
+static void _drop_values(NftPrefsNodeIndex * x)
+{
+        for(size_t i = 0; i < x->values_count; i++)
+        {
+                if(x->values[i].owned)
+                        free((xmlChar *) x->values[i].name);
+        }
+        x->values_count = 0;
+        x->values_pending = 0;
+}
+
+
+/** free index */
+static void _free(NftPrefsNodeIndex * x)
+{
+        _drop_values(x);
+        free(x->values);
+        free(x->children);
+        free(x->byname);
+        free(x->names);
+        free(x->props);
+        free(x);
+}
+
+
+/** get (or create) indexes of document and lock them. Returns NULL if 
+    the document has no indexes */
+static NftPrefsNodeIndexes *_lock(xmlDoc * doc, bool create)
+{
+        NftPrefsNodeIndexes **slot, *t;
+        if(!doc || !(slot = _arena_doc_indexes(doc, create)))
+                return NULL;
+
+        if(!(t = __atomic_load_n(slot, __ATOMIC_ACQUIRE)) && create)
+        {
+                pthread_mutexattr_t attr;
+                if(!(t = calloc(1, sizeof(NftPrefsNodeIndexes))))
+                {
+                        NFT_LOG_PERROR("calloc");
+                        return NULL;
+                }
+
+                if(pthread_mutexattr_init(&attr) != 0 ||
+                   pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE) != 0 ||
+                   pthread_mutex_init(&t->mutex, &attr) != 0)
+                {
+                        NFT_LOG(L_ERROR, "Failed to initialize mutex");
+                        free(t);
+                        return NULL;
+                }
+                pthread_mutexattr_destroy(&attr);
+
+                if(pthread_mutex_init(&t->values_mutex, NULL) != 0)
+                {
+                        NFT_LOG(L_ERROR, "Failed to initialize mutex");
+                        pthread_mutex_destroy(&t->mutex);
+                        free(t);
+                        return NULL;
+                }
+
+                /* another thread was faster */
+                NftPrefsNodeIndexes *other = NULL;
+                if(!__atomic_compare_exchange_n(slot, &other, t, false,
+                                                __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+                {
+                        pthread_mutex_destroy(&t->values_mutex);
+                        pthread_mutex_destroy(&t->mutex);
+                        free(t);
+                        t = other;
+                }
+        }
+
+        if(t)
+                pthread_mutex_lock(&t->mutex);
+
+        return t;
+}
+
+
+/** unlock indexes of document (if any) */
+static void _unlock(NftPrefsNodeIndexes * t)
+{
+        if(t)
+                pthread_mutex_unlock(&t->mutex);
+}
+
+
+/** home slot of node in table */
+static size_t _home(NftPrefsNodeIndexes * t, const xmlNode * n)
+{
+        uint64_t h = (uint64_t) (uintptr_t) n * 0x9e3779b97f4a7c15ULL;
+        return (size_t) (h ^ (h >> 32)) & (t->size - 1);
+}
+
+
+/** get slot of node in table */
+static NftPrefsNodeIndex **_find(NftPrefsNodeIndexes * t, const xmlNode * n)
+{
+        size_t i = _home(t, n);
+        while(t->table[i] && t->table[i]->parent != n)
+                i = (i + 1) & (t->size - 1);
+
+        return &t->table[i];
+}
+
+
+/** add index to table */
+static bool _put(NftPrefsNodeIndexes * t, NftPrefsNodeIndex * x)
+{
+        /* grow table */
+        if((t->count + 1) * 2 > t->size)
+        {
+                NftPrefsNodeIndex **old = t->table;
+                size_t old_size = t->size;
+                size_t size = old_size ? old_size * 2 : 16;
+
+                NftPrefsNodeIndex **table;
+                if(!(table = calloc(size, sizeof(NftPrefsNodeIndex *))))
+                {
+                        NFT_LOG_PERROR("calloc");
+                        return false;
+                }
+
+                t->table = table;
+                t->size = size;
+                for(size_t i = 0; i < old_size; i++)
+                {
+                        if(old[i])
+                                *_find(t, old[i]->parent) = old[i];
+                }
+                free(old);
+        }
+
+        *_find(t, x->parent) = x;
+        t->count++;
+
+        return true;
+}
+
+
+/** remove index from table (shifting back following entries of the same 
+    cluster like _prop_erase()) */
+static void _erase(NftPrefsNodeIndexes * t, NftPrefsNodeIndex * x)
+{
+        size_t mask = t->size - 1;
+        NftPrefsNodeIndex **s = _find(t, x->parent);
+        if(*s != x)
+                return;
+
+        size_t i = (size_t) (s - t->table);
+        size_t j = i;
+
+        t->table[i] = NULL;
+        t->count--;
+
+        for(;;)
+        {
+                j = (j + 1) & mask;
+                if(!t->table[j])
+                        break;
+
+                size_t home = _home(t, t->table[j]->parent);
+                if(i <= j ? (i < home && home <= j) : (i < home || home <= j))
+                        continue;
+
+                t->table[i] = t->table[j];
+                t->table[j] = NULL;
+                i = j;
+        }
+}
+
+
+/** remove index from its document */
+static void _remove(NftPrefsNodeIndex * x)
+{
+        NftPrefsNodeIndexes *t = _lock(x->parent->doc, false);
+
+        if(t)
+        {
+                _erase(t, x);
+                if(x->prev)
+                        x->prev->next = x->next;
+                else
+                        t->list = x->next;
+        }
+        if(x->next)
+                x->next->prev = x->prev;
+
+        _unlock(t);
+        _free(x);
+}
+
+
+/** get index of node (if any) */
+static NftPrefsNodeIndex *_get(xmlNode * n)
+{
+        if(!n || n->type != XML_ELEMENT_NODE)
+                return NULL;
+
+        NftPrefsNodeIndexes *t;
+        if(!(t = _lock(n->doc, false)))
+                return NULL;
+
+        NftPrefsNodeIndex *x = t->count ? *_find(t, n) : NULL;
+        _unlock(t);
+
+        return x;
+}
+
+
+/** get index of node and lock the values of its document (unlock with 
+    _values_unlock()). Returns NULL (nothing locked) if the node has no 
+    index */
+static NftPrefsNodeIndex *_values_lock(xmlNode * n, NftPrefsNodeIndexes ** t)
+{
+        if(!n || n->type != XML_ELEMENT_NODE || !(*t = _lock(n->doc, false)))
+                return NULL;
+
+        NftPrefsNodeIndex *x = (*t)->count ? *_find(*t, n) : NULL;
+        if(x)
+                pthread_mutex_lock(&(*t)->values_mutex);
+        _unlock(*t);
+
+        return x;
+}
+
+
+/** unlock values locked by _values_lock() */
+static void _values_unlock(NftPrefsNodeIndexes * t)
+{
+        pthread_mutex_unlock(&t->values_mutex);
+}
+
+
+/** get or create (empty) index of node */
+static NftPrefsNodeIndex *_record(xmlNode * n)
+{
+        NftPrefsNodeIndexes *t;
+        if(!n->doc || !(t = _lock(n->doc, true)))
+                return NULL;
+
+        NftPrefsNodeIndex *x;
+        if((x = _get(n)))
+                goto _r_exit;
+
+        if(!(x = calloc(1, sizeof(NftPrefsNodeIndex))))
+        {
+                NFT_LOG_PERROR("calloc");
+                goto _r_exit;
+        }
+        x->parent = n;
+
+        if(!_put(t, x))
+        {
+                free(x);
+                x = NULL;
+                goto _r_exit;
+        }
+
+        /* register */
+        x->next = t->list;
+        if(x->next)
+                x->next->prev = x;
+        t->list = x;
+
+_r_exit:
+        _unlock(t);
+        return x;
+}
+
+
+/** drop child index (and the whole index if nothing else is kept) */
+static void _drop_children(NftPrefsNodeIndex * x)
+{
+        free(x->children);
+        free(x->byname);
+        free(x->names);
+        x->children = NULL;
+        x->byname = NULL;
+        x->names = NULL;
+        x->count = 0;
+        x->size = 0;
+
+        if(!x->props && !x->values_enabled)
+                _remove(x);
+}
+
+
+/** drop property index (and the whole index if nothing else is kept) */
+static void _drop_props(NftPrefsNodeIndex * x)
+{
+        free(x->props);
+        x->props = NULL;
+        x->props_size = 0;
+        x->props_count = 0;
+
+        if(!x->children && !x->values_enabled)
+                _remove(x);
+}
+
+
+/** get slot of name */
+static IndexName *_slot(NftPrefsNodeIndex * x, const xmlChar * name)
+{
+        size_t i = _diff_hash_bytes(name, (size_t) xmlStrlen(name)) & (x->size - 1);
+        while(x->names[i].name && !xmlStrEqual(x->names[i].name, name))
+                i = (i + 1) & (x->size - 1);
+
+        return &x->names[i];
+}
+
+
+/** build child index (lazy XIncludes of the node must be resolved) */
+static bool _build(NftPrefsNodeIndex * x)
+{
+        /* collect children */
+        size_t size = 0;
+        for(xmlNode * c = xmlFirstElementChild(x->parent); c;
+            c = xmlNextElementSibling(c))
+        {
+                if(x->count == size)
+                {
+                        size = size ? size * 2 : NODE_INDEX_MIN_CHILDREN * 2;
+                        xmlNode **children;
+                        if(!(children = realloc(x->children, size * sizeof(xmlNode *))))
+                        {
+                                NFT_LOG_PERROR("realloc");
+                                goto _b_error;
+                        }
+                        x->children = children;
+                }
+                x->children[x->count++] = c;
+        }
+
+        /* group positions by name */
+        for(x->size = 16; x->size < x->count * 2; x->size *= 2);
+        if(!(x->names = calloc(x->size, sizeof(IndexName))) ||
+           (x->count && !(x->byname = malloc(x->count * sizeof(size_t)))))
+        {
+                NFT_LOG_PERROR("malloc");
+                goto _b_error;
+        }
+
+        for(size_t i = 0; i < x->count; i++)
+        {
+                IndexName *s = _slot(x, x->children[i]->name);
+                s->name = x->children[i]->name;
+                s->count++;
+        }
+
+        size_t offset = 0;
+        for(size_t i = 0; i < x->size; i++)
+        {
+                x->names[i].offset = offset;
+                offset += x->names[i].count;
+                x->names[i].count = 0;
+        }
+
+        for(size_t i = 0; i < x->count; i++)
+        {
+                IndexName *s = _slot(x, x->children[i]->name);
+                x->byname[s->offset + s->count++] = i;
+        }
+
+        return true;
+
+_b_error:
+        _drop_children(x);
+        return false;
+}
+
+
+/** get child index of node if it's still valid (first & last child didn't
+    change) */
+static NftPrefsNodeIndex *_valid(xmlNode * n)
+{
+        NftPrefsNodeIndex *x;
+        if(!(x = _get(n)) || !x->children)
+                return NULL;
+
+        xmlNode *first = xmlFirstElementChild(n);
+        xmlNode *last = xmlLastElementChild(n);
+        if(x->count ? (first == x->children[0] &&
+                       last == x->children[x->count - 1]) : !first)
+                return x;
+
+        _drop_children(x);
+        return NULL;
+}
+
+
+/** get (or build) index of node. Returns NULL if the node has only few 
+    children or no index can be built */
+static NftPrefsNodeIndex *_index(xmlNode * n)
+{
+        if(!n->doc)
+                return NULL;
+
+        NftPrefsNodeIndexes *t = _lock(n->doc, false);
+        NftPrefsNodeIndex *x = _valid(n);
+        _unlock(t);
+        if(x)
+                return x;
+
+        /* lazy XIncludes are resolved before the index is built (they 
+           change the children) */
+        size_t count = 0;
+        for(xmlNode * c = nft_prefs_node_get_first_child(n); c;
+            c = nft_prefs_node_get_next(c))
+                count++;
+        if(count < NODE_INDEX_MIN_CHILDREN)
+                return NULL;
+
+        /* another thread might have built it meanwhile */
+        if(!(t = _lock(n->doc, true)))
+                return NULL;
+
+        if(!(x = _valid(n)) && (x = _record(n)) && !_build(x))
+                x = NULL;
+        _unlock(t);
+
+        return x;
+}
+
+
+/** get slot of property name */
+static IndexProp *_prop_slot(NftPrefsNodeIndex * x, const xmlChar * name,
+                             uint64_t hash)
+{
+        size_t i = hash & (x->props_size - 1);
+        while(x->props[i].attr && (x->props[i].hash != hash ||
+                                   !xmlStrEqual(x->props[i].attr->name, name)))
+                i = (i + 1) & (x->props_size - 1);
+
+        return &x->props[i];
+}
+
+
+/** add property to table (unless another one of the same name is in it) */
+static bool _prop_insert(NftPrefsNodeIndex * x, xmlAttr * a)
+{
+        /* grow table */
+        if((x->props_count + 1) * 2 > x->props_size)
+        {
+                IndexProp *old = x->props;
+                size_t old_size = x->props_size;
+                size_t size = old_size ? old_size * 2 : NODE_INDEX_MIN_PROPS * 4;
+
+                IndexProp *props;
+                if(!(props = calloc(size, sizeof(IndexProp))))
+                {
+                        NFT_LOG_PERROR("calloc");
+                        return false;
+                }
+
+                x->props = props;
+                x->props_size = size;
+                for(size_t i = 0; i < old_size; i++)
+                {
+                        if(old[i].attr)
+                                *_prop_slot(x, old[i].attr->name, old[i].hash) = old[i];
+                }
+                free(old);
+        }
+
+        uint64_t hash = _diff_hash_bytes(a->name, (size_t) xmlStrlen(a->name));
+        IndexProp *s = _prop_slot(x, a->name, hash);
+        if(s->attr)
+        {
+                x->props_shared = true;
+                return true;
+        }
+
+        s->attr = a;
+        s->hash = hash;
+        x->props_count++;
+
+        return true;
+}
+
+
+/** remove slot from table (shifting back following entries of the same 
+    cluster, so no tombstones are needed) */
+static void _prop_erase(NftPrefsNodeIndex * x, IndexProp * s)
+{
+        size_t mask = x->props_size - 1;
+        size_t i = (size_t) (s - x->props);
+        size_t j = i;
+
+        x->props[i].attr = NULL;
+        x->props_count--;
+
+        for(;;)
+        {
+                j = (j + 1) & mask;
+                if(!x->props[j].attr)
+                        break;
+
+                /* move entry into the gap unless its home slot lies 
+                   cyclically within (i, j] */
+                size_t home = x->props[j].hash & mask;
+                if(i <= j ? (i < home && home <= j) : (i < home || home <= j))
+                        continue;
+
+                x->props[i] = x->props[j];
+                x->props[j].attr = NULL;
+                i = j;
+        }
+}
+
+
+/** build property index */
+static bool _build_props(NftPrefsNodeIndex * x)
+{
+        x->props_first = x->parent->properties;
+        x->props_last = NULL;
+        x->props_shared = false;
+
+        for(xmlAttr * a = x->parent->properties; a; a = a->next)
+        {
+                if(!_prop_insert(x, a))
+                {
+                        _drop_props(x);
+                        return false;
+                }
+                x->props_last = a;
+        }
+
+        return true;
+}
+
+
+/** get property index of node if it's still valid (properties were only 
+    added & removed through the API) */
+static NftPrefsNodeIndex *_props(xmlNode * n)
+{
+        NftPrefsNodeIndex *x;
+        if(!(x = _get(n)) || !x->props)
+                return NULL;
+
+        if(n->properties == x->props_first &&
+           (!x->props_last || !x->props_last->next))
+                return x;
+
+        _drop_props(x);
+        return NULL;
+}
+
+
+/** size of value of type */
+static size_t _value_size(NftPrefsPropType type)
+{
+        switch (type)
+        {
+                case NFT_PREFS_PROP_INT:
+                        return sizeof(int);
+                case NFT_PREFS_PROP_LONG_INT:
+                        return sizeof(long int);
+                case NFT_PREFS_PROP_DOUBLE:
+                        return sizeof(double);
+                case NFT_PREFS_PROP_BOOLEAN:
+                        return sizeof(bool);
+                default:
+                        return 0;
+        }
+}
+
+
+/** find cached value */
+static IndexValue *_value_find(NftPrefsNodeIndex * x, const xmlChar * name,
+                               NftPrefsPropType type)
+{
+        for(size_t i = 0; i < x->values_count; i++)
+        {
+                IndexValue *v = &x->values[i];
+                if(v->type == type && xmlStrEqual(v->name, name))
+                        return v;
+        }
+
+        return NULL;
+}
+
+
+/** add (uninitialized) value of property */
+static IndexValue *_value_add(NftPrefsNodeIndex * x, const xmlChar * name,
+                              NftPrefsPropType type)
+{
+        if(x->values_count == x->values_size)
+        {
+                size_t size = x->values_size ? x->values_size * 2 : 8;
+                IndexValue *values;
+                if(!(values = realloc(x->values, size * sizeof(IndexValue))))
+                        return NULL;
+                x->values = values;
+                x->values_size = size;
+        }
+
+        /* name is shared with the dictionary of the document */
+        xmlDict *dict = x->parent->doc ? x->parent->doc->dict : NULL;
+        const xmlChar *key;
+        bool owned = !dict;
+        if(!(key = dict ? xmlDictLookup(dict, name, -1) :
+                   (xmlChar *) strdup((const char *) name)))
+                return NULL;
+
+        IndexValue *v = &x->values[x->values_count++];
+        v->name = key;
+        v->owned = owned;
+        v->pending = false;
+        v->type = type;
+
+        return v;
+}
+
+
+/** check whether node is n or one of its descendants */
+static bool _inside(xmlNode * node, xmlNode * n)
+{
+        for(; node && node->type == XML_ELEMENT_NODE; node = node->parent)
+        {
+                if(node == n)
+                        return true;
+        }
+
+        return false;
+}
+
+
+/** next element below root in document order (NULL after the last one) */
+static xmlNode *_subtree_next(xmlNode * node, xmlNode * root)
+{
+        xmlNode *c;
+        if((c = xmlFirstElementChild(node)))
+                return c;
+
+        for(; node && node != root; node = node->parent)
+        {
+                if((c = xmlNextElementSibling(node)))
+                        return c;
+        }
+
+        return NULL;
+}
+
+
+/** check whether node and its descendants are less than max elements */
+static bool _subtree_smaller(xmlNode * n, size_t max)
+{
+        size_t count = 0;
+        for(xmlNode * c = n; c; c = _subtree_next(c, n))
+        {
+                if(++count >= max)
+                        return false;
+        }
+
+        return true;
+}
+
+
+/** call func for the indexes of node and all its descendants (indexes of 
+    the document have to be locked). func may remove the index from the 
+    document. Small subtrees are walked and their nodes looked up, the list
+    of indexes is only scanned if it's shorter than the subtree, so freeing
+    many nodes one after the other doesn't look at all indexes every time.
+    Stops if func returns false */
+static bool _subtree_each(NftPrefsNodeIndexes * t, xmlNode * n,
+                          bool (*func) (NftPrefsNodeIndexes * t,
+                                        NftPrefsNodeIndex * x, void *userptr),
+                          void *userptr)
+{
+        if(!t->count)
+                return true;
+
+        if(_subtree_smaller(n, t->count))
+        {
+                for(xmlNode * c = n; c; c = _subtree_next(c, n))
+                {
+                        NftPrefsNodeIndex *x;
+                        if(t->count && (x = *_find(t, c)) && !func(t, x, userptr))
+                                return false;
+                }
+                return true;
+        }
+
+        for(NftPrefsNodeIndex * x = t->list; x;)
+        {
+                NftPrefsNodeIndex *next = x->next;
+                if(_inside(x->parent, n) && !func(t, x, userptr))
+                        return false;
+                x = next;
+        }
+
+        return true;
+}
+
+
+/** write pending values of index (s. _subtree_each()) */
+static bool _flush_one(NftPrefsNodeIndexes * t, NftPrefsNodeIndex * x,
+                       void *userptr)
+{
+        if(x->values_pending)
+                _node_prop_flush(x->parent, NULL);
+
+        return true;
+}
+
+
+/** remove index (s. _subtree_each()) */
+static bool _drop_one(NftPrefsNodeIndexes * t, NftPrefsNodeIndex * x,
+                      void *userptr)
+{
+        _remove(x);
+        return true;
+}
+
+
+/** move index to another document (s. _subtree_each()) */
+static bool _move_one(NftPrefsNodeIndexes * t, NftPrefsNodeIndex * x,
+                      void *userptr)
+{
+        IndexMove *m = userptr;
+
+        if(m->dict != x->parent->doc->dict)
+        {
+                if(x->children)
+                        _drop_children(x);
+                if(x->props)
+                        _drop_props(x);
+        }
+
+        for(size_t i = 0; i < x->values_count; i++)
+        {
+                IndexValue *v = &x->values[i];
+                if(v->owned || (m->dict && xmlDictOwns(m->dict, v->name) == 1))
+                        continue;
+
+                xmlChar *name;
+                if(!(name = (xmlChar *) strdup((const char *) v->name)))
+                {
+                        NFT_LOG_PERROR("strdup");
+                        return false;
+                }
+                v->name = name;
+                v->owned = true;
+        }
+
+        if(!_put(m->dst, x))
+                return false;
+        _erase(t, x);
+
+        /* unlink from old list */
+        if(x->prev)
+                x->prev->next = x->next;
+        else
+                t->list = x->next;
+        if(x->next)
+                x->next->prev = x->prev;
+
+        /* add to new list */
+        x->prev = NULL;
+        x->next = m->dst->list;
+        if(x->next)
+                x->next->prev = x;
+        m->dst->list = x;
+
+        return true;
+}
+
+
+/******************************************************************************/
+/**************************** PRIVATE FUNCTIONS *******************************/
+/******************************************************************************/
+
+/** drop child index of node (if any) after its children changed */
+void _node_index_invalidate(xmlNode * n)
+{
+        NftPrefsNodeIndex *x;
+        if((x = _get(n)) && x->children)
+                _drop_children(x);
+}
+
+
+/** drop property index of node (if any) after properties were removed 
+    without _node_index_prop_remove() */
+void _node_index_invalidate_props(xmlNode * n)
+{
+        NftPrefsNodeIndex *x;
+        if((x = _get(n)) && x->props)
+                _drop_props(x);
+}
+
+
+/** find first property of node with a name (regardless of its namespace).
+    The properties of nodes with many properties are indexed on first 
+    access. */
+xmlAttr *_node_index_prop_find(xmlNode * n, const xmlChar * name)
+{
+        NftPrefsNodeIndexes *t = _lock(n->doc, false);
+        xmlAttr *result = NULL;
+
+        NftPrefsNodeIndex *x;
+        if((x = _props(n)))
+        {
+                uint64_t hash = _diff_hash_bytes(name, (size_t) xmlStrlen(name));
+                result = _prop_slot(x, name, hash)->attr;
+                goto _pf_exit;
+        }
+
+        size_t i = 0;
+        for(xmlAttr * a = n->properties; a; a = a->next)
+        {
+                if(xmlStrEqual(a->name, name))
+                {
+                        result = a;
+                        goto _pf_exit;
+                }
+
+                /* wide node (another thread might have indexed it before
+                   the indexes were locked) */
+                if(++i != NODE_INDEX_MIN_PROPS ||
+                   (!t && !(t = _lock(n->doc, true))))
+                        continue;
+
+                if(!(x = _props(n)) && (!(x = _record(n)) || !_build_props(x)))
+                        continue;
+
+                uint64_t hash = _diff_hash_bytes(name, (size_t) xmlStrlen(name));
+                result = _prop_slot(x, name, hash)->attr;
+                goto _pf_exit;
+        }
+
+_pf_exit:
+        _unlock(t);
+        return result;
+}
+
+
+/** append new (unlinked) property to the properties of a node */
+void _node_index_prop_append(xmlNode * n, xmlAttr * a)
+{
+        NftPrefsNodeIndex *x = _props(n);
+
+        xmlAttr *last = x ? x->props_last : n->properties;
+        if(!x)
+        {
+                while(last && last->next)
+                        last = last->next;
+        }
+
+        a->parent = n;
+        a->doc = n->doc;
+        a->prev = last;
+        a->next = NULL;
+        if(last)
+                last->next = a;
+        else
+                n->properties = a;
+
+        if(!x)
+                return;
+
+        if(!x->props_first)
+                x->props_first = a;
+        x->props_last = a;
+        if(!_prop_insert(x, a))
+                _drop_props(x);
+}
+
+
+/** unlink property from its node (without freeing it) */
+void _node_index_prop_remove(xmlNode * n, xmlAttr * a)
+{
+        NftPrefsNodeIndex *x;
+        if((x = _props(n)))
+        {
+                if(x->props_shared)
+                {
+                        /* another property of this name might take its place */
+                        _drop_props(x);
+                }
+                else
+                {
+                        uint64_t hash = _diff_hash_bytes(a->name,
+                                                         (size_t) xmlStrlen(a->name));
+                        IndexProp *s = _prop_slot(x, a->name, hash);
+                        if(s->attr == a)
+                                _prop_erase(x, s);
+
+                        if(x->props_first == a)
+                                x->props_first = a->next;
+                        if(x->props_last == a)
+                                x->props_last = a->prev;
+                }
+        }
+
+        if(a->prev)
+                a->prev->next = a->next;
+        else
+                n->properties = a->next;
+        if(a->next)
+                a->next->prev = a->prev;
+
+        a->prev = a->next = NULL;
+        a->parent = NULL;
+}
+
+
+/** drop values of property (all values for qualified names) */
+static void _value_drop(NftPrefsNodeIndex * x, const xmlChar * name)
+{
+        if(xmlStrchr(name, ':'))
+        {
+                _drop_values(x);
+                return;
+        }
+
+        for(size_t i = 0; i < x->values_count;)
+        {
+                IndexValue *v = &x->values[i];
+                if(!xmlStrEqual(v->name, name))
+                {
+                        i++;
+                        continue;
+                }
+
+                if(v->pending)
+                        x->values_pending--;
+                if(v->owned)
+                        free((xmlChar *) v->name);
+                *v = x->values[--x->values_count];
+        }
+}
+
+
+/** get cached value of property. Returns false if node doesn't cache 
+    values or the value isn't cached */
+bool _node_index_value_get(xmlNode * n, const xmlChar * name,
+                           NftPrefsPropType type, void *value)
+{
+        NftPrefsNodeIndexes *t;
+        NftPrefsNodeIndex *x;
+        if(!(x = _values_lock(n, &t)))
+                return false;
+
+        IndexValue *v;
+        bool r = false;
+        if(x->values_count && (v = _value_find(x, name, type)))
+        {
+                memcpy(value, &v->v, _value_size(type));
+                r = true;
+        }
+
+        _values_unlock(t);
+        return r;
+}
+
+
+/** remember value of property if node caches values */
+void _node_index_value_put(xmlNode * n, const xmlChar * name,
+                           NftPrefsPropType type, const void *value)
+{
+        NftPrefsNodeIndexes *t;
+        NftPrefsNodeIndex *x;
+        if(!(x = _values_lock(n, &t)))
+                return;
+
+        IndexValue *v;
+        if(x->values_enabled && _value_size(type) &&
+           ((v = _value_find(x, name, type)) || (v = _value_add(x, name, type))))
+                memcpy(&v->v, value, _value_size(type));
+
+        _values_unlock(t);
+}
+
+
+/** drop cached values of property before it's set or unset (all values 
+    for qualified names) */
+void _node_index_value_drop(xmlNode * n, const xmlChar * name)
+{
+        NftPrefsNodeIndexes *t;
+        NftPrefsNodeIndex *x;
+        if(!(x = _values_lock(n, &t)))
+                return;
+
+        if(x->values_count)
+                _value_drop(x, name);
+
+        _values_unlock(t);
+}
+
+
+/** store value of property as pending value if node defers its values. 
+    Returns false if the property has to be set as text */
+bool _node_index_value_defer(xmlNode * n, const xmlChar * name,
+                             NftPrefsPropType type, const void *value)
+{
+        NftPrefsNodeIndexes *t;
+        NftPrefsNodeIndex *x;
+        if(!(x = _values_lock(n, &t)))
+                return false;
+
+        bool r = false;
+        if(!x->values_deferred || !_value_size(type) || xmlStrchr(name, ':'))
+                goto _vd_exit;
+
+        /* value replaces all values of this property */
+        _value_drop(x, name);
+
+        IndexValue *v;
+        if(!(v = _value_add(x, name, type)))
+                goto _vd_exit;
+
+        memcpy(&v->v, value, _value_size(type));
+        v->pending = true;
+        x->values_pending++;
+        r = true;
+
+_vd_exit:
+        _values_unlock(t);
+        return r;
+}
+
+
+/** take pending value of property (any property if name is NULL). The value
+    stays cached, *pname is valid as long as the value is. Returns false if 
+    there's no pending value */
+bool _node_index_value_take(xmlNode * n, const xmlChar * name,
+                            const xmlChar ** pname, NftPrefsPropType * type,
+                            NftPrefsNodeValue * value)
+{
+        NftPrefsNodeIndexes *t;
+        NftPrefsNodeIndex *x;
+        if(!(x = _values_lock(n, &t)))
+                return false;
+
+        bool r = false;
+        for(size_t i = 0; x->values_pending && i < x->values_count; i++)
+        {
+                IndexValue *v = &x->values[i];
+                if(!v->pending || (name && !xmlStrEqual(v->name, name)))
+                        continue;
+
+                v->pending = false;
+                x->values_pending--;
+                *pname = v->name;
+                *type = v->type;
+                *value = v->v;
+                r = true;
+                break;
+        }
+
+        _values_unlock(t);
+        return r;
+}
+
+
+/** get pending value of property (type & value may be NULL). Returns false
+    if there's no pending value */
+bool _node_index_value_pending(xmlNode * n, const xmlChar * name,
+                               NftPrefsPropType * type,
+                               NftPrefsNodeValue * value)
+{
+        NftPrefsNodeIndexes *t;
+        NftPrefsNodeIndex *x;
+        if(!(x = _values_lock(n, &t)))
+                return false;
+
+        bool r = false;
+        for(size_t i = 0; x->values_pending && i < x->values_count; i++)
+        {
+                IndexValue *v = &x->values[i];
+                if(!v->pending || !xmlStrEqual(v->name, name))
+                        continue;
+
+                if(type)
+                        *type = v->type;
+                if(value)
+                        *value = v->v;
+                r = true;
+                break;
+        }
+
+        _values_unlock(t);
+        return r;
+}
+
+
+/** iterate pending values of node (start with *i = 0). Bytes of *value 
+    beyond the size of its type are zero. Returns false after the last 
+    pending value */
+bool _node_index_value_next(xmlNode * n, size_t * i, const xmlChar ** name,
+                            NftPrefsPropType * type, NftPrefsNodeValue * value)
+{
+        NftPrefsNodeIndexes *t;
+        NftPrefsNodeIndex *x;
+        if(!(x = _values_lock(n, &t)))
+                return false;
+
+        bool r = false;
+        for(; x->values_pending && *i < x->values_count; (*i)++)
+        {
+                IndexValue *v = &x->values[*i];
+                if(!v->pending)
+                        continue;
+
+                (*i)++;
+                *name = v->name;
+                *type = v->type;
+                memset(value, 0, sizeof(NftPrefsNodeValue));
+                memcpy(value, &v->v, _value_size(v->type));
+                r = true;
+                break;
+        }
+
+        _values_unlock(t);
+        return r;
+}
+
+
+/** check whether node has the same typed value (pending or cached) for a
+    property, so both would be formatted to the same text */
+bool _node_index_value_equal(xmlNode * n, const xmlChar * name,
+                             NftPrefsPropType type,
+                             const NftPrefsNodeValue * value)
+{
+        NftPrefsNodeIndexes *t;
+        NftPrefsNodeIndex *x;
+        if(!(x = _values_lock(n, &t)))
+                return false;
+
+        IndexValue *v;
+        bool r = x->values_count && (v = _value_find(x, name, type)) &&
+                memcmp(&v->v, value, _value_size(type)) == 0;
+
+        _values_unlock(t);
+        return r;
+}
+
+
+/** write pending values of node and all its descendants to their properties
+    before the tree is looked at as text */
+void _node_index_flush(xmlNode * n)
+{
+        NftPrefsNodeIndexes *t;
+        if(!n || !(t = _lock(n->doc, false)))
+                return;
+
+        _subtree_each(t, n, _flush_one, NULL);
+        _unlock(t);
+}
+
+
+/** drop indexes of node and all its descendants before the node is freed or
+    moved to another document */
+void _node_index_drop(xmlNode * n)
+{
+        NftPrefsNodeIndexes *t;
+        if(!(t = _lock(n->doc, false)))
+                return;
+
+        _subtree_each(t, n, _drop_one, NULL);
+        _unlock(t);
+}
+
+
+/** move indexes of node and all its descendants to the list of another 
+    document before the node is moved there. Names of values that aren't 
+    part of the dictionary of that document become copies, indexes of 
+    children & properties (whose names move to that dictionary) are 
+    rebuilt on next access */
+NftResult _node_index_move(xmlNode * n, xmlDoc * to)
+{
+        NftPrefsNodeIndexes *src, *dst = NULL;
+        if(!(src = _lock(n->doc, false)))
+                return NFT_SUCCESS;
+
+        NftResult r = NFT_SUCCESS;
+        if(!src->list)
+                goto _m_exit;
+
+        if(!to || !(dst = _lock(to, true)))
+        {
+                _node_index_drop(n);
+                r = to ? NFT_FAILURE : NFT_SUCCESS;
+                goto _m_exit;
+        }
+
+        IndexMove m = { dst, to->dict };
+        if(!_subtree_each(src, n, _move_one, &m))
+                r = NFT_FAILURE;
+
+        _unlock(dst);
+_m_exit:
+        _unlock(src);
+        return r;
+}
+
+
+/** index of node moves to a copy of the node (s. _arena_doc_compact()).
+    Indexes of children & properties are rebuilt on next access */
+void _node_index_rekey(xmlNode * from, xmlNode * to)
+{
+        NftPrefsNodeIndexes *t;
+        if(!(t = _lock(from->doc, false)))
+                return;
+
+        NftPrefsNodeIndex *x;
+        if(!(x = _get(from)))
+        {
+                _unlock(t);
+                return;
+        }
+
+        /* the table has room since the index is in it already */
+        _erase(t, x);
+        x->parent = to;
+        *_find(t, to) = x;
+        t->count++;
+        _unlock(t);
+
+        if(x->children)
+        {
+                if(x->props)
+                        _drop_props(x);
+                _drop_children(x);
+        }
+        else if(x->props)
+        {
+                _drop_props(x);
+        }
+}
+
+
+/** free all indexes of a document (when the document is freed) */
+void _node_index_free_all(NftPrefsNodeIndexes * t)
+{
+        if(!t)
+                return;
+
+        for(NftPrefsNodeIndex * x = t->list; x;)
+        {
+                NftPrefsNodeIndex *next = x->next;
+                _free(x);
+                x = next;
+        }
+
+        pthread_mutex_destroy(&t->values_mutex);
+        pthread_mutex_destroy(&t->mutex);
+        free(t->table);
+        free(t);
+}
+
+
+
+/******************************************************************************/
+/**************************** API FUNCTIONS ***********************************/
+/******************************************************************************/
+
+/**
+ * get amount of element children of a node
+ *
+ * @param n parent node
+ * @result amount of children
+ */
+size_t nft_prefs_node_get_child_count(NftPrefsNode * n)
+{
+        if(!n)
+                NFT_LOG_NULL(0);
+
+        NftPrefsNodeIndex *x;
+        if((x = _index(n)))
+                return x->count;
+
+        size_t count = 0;
+        for(NftPrefsNode * c = nft_prefs_node_get_first_child(n); c;
+            c = nft_prefs_node_get_next(c))
+                count++;
+
+        return count;
+}
+
+
+/**
+ * get child of a node by position. Nodes with many children are indexed on
+ * first access, so this takes constant time afterwards.
+ *
+ * @param n parent node
+ * @param i position of child (starting at 0)
+ * @result child node or NULL
+ * @note indexes are kept by the document, not in the nodes (the _private 
+ * field of nodes belongs to the application). Building one is locked, so 
+ * several threads may read the same tree at once as long as none of them 
+ * modifies it.
+ */
+NftPrefsNode *nft_prefs_node_get_nth_child(NftPrefsNode * n, size_t i)
+{
+        if(!n)
+                NFT_LOG_NULL(NULL);
+
+        NftPrefsNodeIndex *x;
+        if((x = _index(n)))
+                return i < x->count ? x->children[i] : NULL;
+
+        NftPrefsNode *c;
+        for(c = nft_prefs_node_get_first_child(n); c && i > 0; i--)
+                c = nft_prefs_node_get_next(c);
+
+        return c;
+}
+
+
+/**
+ * get first child of a node with a certain name. Nodes with many children
+ * are indexed on first access, so this takes constant time afterwards.
+ *
+ * @param n parent node
+ * @param name name of child
+ * @result child node or NULL
+ */
+NftPrefsNode *nft_prefs_node_get_child_by_name(NftPrefsNode * n, const char *name)
+{
+        if(!n || !name)
+                NFT_LOG_NULL(NULL);
+
+        NftPrefsNodeIndex *x;
+        if((x = _index(n)))
+        {
+                IndexName *s = _slot(x, BAD_CAST name);
+                return s->name ? x->children[x->byname[s->offset]] : NULL;
+        }
+
+        NftPrefsNode *c;
+        if(!(c = nft_prefs_node_get_first_child(n)) ||
+           strcmp(nft_prefs_node_get_name(c), name) == 0)
+                return c;
+
+        return nft_prefs_node_get_next_with_name(c, name);
+}
+
+
+/**
+ * get all children of a node with a certain name
+ *
+ * @param n parent node
+ * @param name name of children
+ * @param count will be set to the amount of children found
+ * @result array of children in order (free it with nft_prefs_free()) or 
+ * NULL if there are none (or upon error)
+ */
+NftPrefsNode **nft_prefs_node_get_children_by_name(NftPrefsNode * n,
+                                                   const char *name,
+                                                   size_t * count)
+{
+        if(!n || !name || !count)
+                NFT_LOG_NULL(NULL);
+
+        *count = 0;
+
+        NftPrefsNodeIndex *x;
+        NftPrefsNode **result;
+        if((x = _index(n)))
+        {
+                IndexName *s = _slot(x, BAD_CAST name);
+                if(!s->name)
+                        return NULL;
+
+                if(!(result = xmlMalloc(s->count * sizeof(NftPrefsNode *))))
+                {
+                        NFT_LOG_PERROR("xmlMalloc");
+                        return NULL;
+                }
+
+                for(size_t i = 0; i < s->count; i++)
+                        result[i] = x->children[x->byname[s->offset + i]];
+                *count = s->count;
+
+                return result;
+        }
+
+        /* few children: count first */
+        size_t found = 0;
+        NftPrefsNode *c;
+        for(c = nft_prefs_node_get_child_by_name(n, name); c;
+            c = nft_prefs_node_get_next_with_name(c, name))
+                found++;
+
+        if(!found)
+                return NULL;
+
+        if(!(result = xmlMalloc(found * sizeof(NftPrefsNode *))))
+        {
+                NFT_LOG_PERROR("xmlMalloc");
+                return NULL;
+        }
+
+        found = 0;
+        for(c = nft_prefs_node_get_child_by_name(n, name); c;
+            c = nft_prefs_node_get_next_with_name(c, name))
+                result[found++] = c;
+        *count = found;
+
+        return result;
+}
+
+
+/**
+ * let a node keep the values its properties were parsed to by 
+ * nft_prefs_node_prop_int_get(), nft_prefs_node_prop_long_int_get(), 
+ * nft_prefs_node_prop_double_get() & nft_prefs_node_prop_boolean_get(). 
+ * Reading the same property again returns the cached value without 
+ * looking at the property. Use this for nodes whose properties are read
+ * frequently (e.g. every frame).
+ *
+ * @param n node
+ * @param enable true to cache values, false to drop all cached values 
+ * and stop caching
+ * @result NFT_SUCCESS or NFT_FAILURE (e.g. node doesn't belong to a 
+ * document, s. nft_prefs_node_alloc())
+ * @note values are dropped when their property is set or unset through 
+ * the API. Properties modified with libxml2 functions directly aren't 
+ * noticed. Disabling the cache also stops deferring values (s. 
+ * nft_prefs_node_set_deferred_values()). The cache is locked while it's 
+ * read or filled, so several threads may use the typed getters of the 
+ * same node at once (as long as no thread modifies the tree).
+ */
+NftResult nft_prefs_node_set_value_cache(NftPrefsNode * n, bool enable)
+{
+        if(!n)
+                NFT_LOG_NULL(NFT_FAILURE);
+
+        if(n->type != XML_ELEMENT_NODE)
+        {
+                NFT_LOG(L_ERROR, "only element nodes can cache values");
+                return NFT_FAILURE;
+        }
+
+        NftPrefsNodeIndex *x;
+        if(!enable)
+        {
+                if((x = _get(n)) && x->values_enabled)
+                {
+                        _node_prop_flush(n, NULL);
+                        _drop_values(x);
+                        free(x->values);
+                        x->values = NULL;
+                        x->values_size = 0;
+                        x->values_enabled = false;
+                        x->values_deferred = false;
+                        if(!x->children && !x->props)
+                                _remove(x);
+                }
+                return NFT_SUCCESS;
+        }
+
+        if(!(x = _record(n)))
+        {
+                NFT_LOG(L_ERROR, "Failed to enable value cache of <%s>", n->name);
+                return NFT_FAILURE;
+        }
+        x->values_enabled = true;
+
+        return NFT_SUCCESS;
+}
+
+
+/**
+ * check whether a node caches the values of its properties
+ *
+ * @param n node
+ * @result true if values are cached, false otherwise
+ */
+bool nft_prefs_node_get_value_cache(NftPrefsNode * n)
+{
+        if(!n)
+                NFT_LOG_NULL(false);
+
+        NftPrefsNodeIndex *x;
+        return (x = _get(n)) && x->values_enabled;
+}
+
+
+/**
+ * let nft_prefs_node_prop_int_set(), nft_prefs_node_prop_long_int_set(), 
+ * nft_prefs_node_prop_double_set() & nft_prefs_node_prop_boolean_set() 
+ * store their values in binary form. Values are only formatted when the
+ * node is serialized, diffed, queried or the property is read as string.
+ * Typed getters return the stored values directly. This enables the value
+ * cache of the node (s. nft_prefs_node_set_value_cache()).
+ *
+ * @param n node
+ * @param enable true to defer values, false to write all pending values 
+ * to their properties and stop deferring
+ * @result NFT_SUCCESS or NFT_FAILURE (e.g. node doesn't belong to a 
+ * document, s. nft_prefs_node_alloc())
+ * @note properties with qualified names are always set as text. Getters 
+ * that look at a node with pending values as text write those values to 
+ * its properties, i.e. they modify the tree and aren't thread-safe. Only 
+ * the typed getters leave the tree alone.
+ */
+NftResult nft_prefs_node_set_deferred_values(NftPrefsNode * n, bool enable)
+{
+        if(!n)
+                NFT_LOG_NULL(NFT_FAILURE);
+
+        NftPrefsNodeIndex *x;
+        if(!enable)
+        {
+                if((x = _get(n)) && x->values_deferred)
+                {
+                        _node_prop_flush(n, NULL);
+                        x->values_deferred = false;
+                }
+                return NFT_SUCCESS;
+        }
+
+        if(!nft_prefs_node_set_value_cache(n, true))
+                return NFT_FAILURE;
+
+        _get(n)->values_deferred = true;
+
+        return NFT_SUCCESS;
+}
+
+
+/**
+ * check whether a node defers the values of its properties
+ *
+ * @param n node
+ * @result true if typed setters store pending values, false otherwise
+ */
+bool nft_prefs_node_get_deferred_values(NftPrefsNode * n)
+{
+        if(!n)
+                NFT_LOG_NULL(false);
+
+        NftPrefsNodeIndex *x;
+        return (x = _get(n)) && x->values_deferred;
+}
+
+
+/**
+ * @}
+ */
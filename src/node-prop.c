@@ -53,9 +53,15 @@
  */
 
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
 #include <niftylog.h>
 #include "prefs.h"
-
+#include "arena.h"
+#include "node.h"
+#include "number.h"
+#include "base64.h"
 
 
 
@@ -63,10 +69,619 @@
 /**************************** STATIC FUNCTIONS ********************************/
 /******************************************************************************/
 
+/** get value of property without copying it. If the value consists of 
+    more than one node (entity references), a copy is made and returned in
+    *copy as well (free it with xmlFree()) */
+static const xmlChar *_attr_value(xmlAttr * a, size_t * length,
+                                  xmlChar ** copy)
+{
+        *copy = NULL;
+
+        const xmlChar *value;
+        if(a->type == XML_ATTRIBUTE_DECL)
+        {
+                /* default value from DTD */
+                value = ((xmlAttribute *) a)->defaultValue;
+        }
+        else if(!a->children)
+        {
+                value = BAD_CAST "";
+        }
+        else if(!a->children->next && a->children->type == XML_TEXT_NODE)
+        {
+                value = a->children->content;
+        }
+        else
+        {
+                value = *copy = xmlNodeListGetString(a->doc, a->children, 1);
+        }
+
+        if(value && length)
+                *length = (size_t) xmlStrlen(value);
+
+        return value;
+}
+
+
+/** get value of property by name (s. _attr_value()) */
+static const xmlChar *_value(xmlNode * n, const char *name, size_t * length,
+                             xmlChar ** copy)
+{
+        *copy = NULL;
+
+        if(n->type != XML_ELEMENT_NODE)
+                return NULL;
+
+        /* pending value is looked at as text */
+        _node_prop_flush(n, BAD_CAST name);
+
+        /* defaults from DTD aren't in the list of properties */
+        xmlAttr *a;
+        if(!(a = _node_index_prop_find(n, BAD_CAST name)) &&
+           (!n->doc || (!n->doc->intSubset && !n->doc->extSubset) ||
+            !(a = xmlHasProp(n, BAD_CAST name))))
+                return NULL;
+
+        return _attr_value(a, length, copy);
+}
+
+
+/** parse boolean value ("true", "yes", "on", "enable" or "1") */
+static bool _parse_boolean(const xmlChar * value)
+{
+        return xmlStrcasecmp(value, BAD_CAST "true") == 0 ||
+                xmlStrcasecmp(value, BAD_CAST "yes") == 0 ||
+                xmlStrcasecmp(value, BAD_CAST "on") == 0 ||
+                xmlStrcasecmp(value, BAD_CAST "enable") == 0 ||
+                xmlStrcasecmp(value, BAD_CAST "1") == 0;
+}
+
+
+/** true if elements of arrays are stored in native byte order */
+static inline bool _little_endian(void)
+{
+        const uint16_t one = 1;
+        return *(const unsigned char *) &one == 1;
+}
+
+
+/** reverse byte order of elements */
+static void _swap_elements(void *data, size_t count, size_t size)
+{
+        unsigned char *p = data;
+        for(size_t i = 0; i < count; i++, p += size)
+        {
+                for(size_t j = 0; j < size / 2; j++)
+                {
+                        unsigned char t = p[j];
+                        p[j] = p[size - 1 - j];
+                        p[size - 1 - j] = t;
+                }
+        }
+}
+
+
+/** set array property to base64 representation of little endian elements */
+static NftResult _array_set(xmlNode * n, const char *name, const void *values,
+                            size_t count, size_t size)
+{
+        if(!n || !name || (!values && count))
+                NFT_LOG_NULL(NFT_FAILURE);
+
+        if(count > (SIZE_MAX / 4 - 1) / size)
+        {
+                NFT_LOG(L_ERROR, "array of %zu elements too large", count);
+                return NFT_FAILURE;
+        }
+
+        NftResult result = NFT_FAILURE;
+        unsigned char *swapped = NULL;
+        char *value = NULL;
+
+        const unsigned char *data = values;
+        if(!_little_endian() && size > 1)
+        {
+                if(!(swapped = malloc(count * size)))
+                {
+                        NFT_LOG_PERROR("malloc");
+                        goto _as_exit;
+                }
+                memcpy(swapped, values, count * size);
+                _swap_elements(swapped, count, size);
+                data = swapped;
+        }
+
+        if(!(value = malloc(_base64_encoded_length(count * size) + 1)))
+        {
+                NFT_LOG_PERROR("malloc");
+                goto _as_exit;
+        }
+        _base64_encode(data, count * size, value);
+
+        result = nft_prefs_node_prop_string_set(n, name, value);
+
+_as_exit:
+        free(swapped);
+        free(value);
+        return result;
+}
+
+
+/** decode base64 array property into buffer of *count elements. *count is
+    set to the amount of elements of the property */
+static NftResult _array_get(xmlNode * n, const char *name, void *values,
+                            size_t * count, size_t size)
+{
+        if(!n || !name || !count)
+                NFT_LOG_NULL(NFT_FAILURE);
+
+        size_t length;
+        xmlChar *copy;
+        const xmlChar *value;
+        if(!(value = _value(n, name, &length, &copy)))
+        {
+                NFT_LOG(L_DEBUG, "array property \"%s\" not found in <%s>", name,
+                        n->name);
+                return NFT_FAILURE;
+        }
+
+        NftResult result = NFT_FAILURE;
+        size_t bytes;
+        if(!_base64_decoded_length((const char *) value, length, &bytes) ||
+           bytes % size)
+        {
+                NFT_LOG(L_ERROR, "array property \"%s\" is invalid", name);
+                goto _ag_exit;
+        }
+
+        size_t capacity = *count;
+        *count = bytes / size;
+        if(!values)
+        {
+                result = NFT_SUCCESS;
+                goto _ag_exit;
+        }
+
+        if(capacity < *count)
+        {
+                NFT_LOG(L_ERROR, "array property \"%s\" has %zu elements, "
+                        "buffer holds %zu", name, *count, capacity);
+                goto _ag_exit;
+        }
+
+        if(!_base64_decode((const char *) value, length, values))
+        {
+                NFT_LOG(L_ERROR, "array property \"%s\" is invalid", name);
+                goto _ag_exit;
+        }
+
+        if(!_little_endian() && size > 1)
+                _swap_elements(values, *count, size);
+
+        result = NFT_SUCCESS;
+
+_ag_exit:
+        xmlFree(copy);
+        return result;
+}
+
+
+/** find properties of descriptors in one pass over the properties of a node.
+    Properties usually appear in the order of their descriptors, so the 
+    search starts after the last match. */
+static void _props_find(xmlNode * n, const NftPrefsPropDesc desc[],
+                        size_t count, bool any_ns, xmlAttr * found[])
+{
+        memset(found, 0, sizeof(xmlAttr *) * count);
+
+        size_t next = 0;
+        for(xmlAttr * a = n->properties; a && count; a = a->next)
+        {
+                if(!any_ns && a->ns)
+                        continue;
+
+                for(size_t j = 0; j < count; j++)
+                {
+                        size_t i = (next + j) % count;
+                        if(found[i] || strcmp((const char *) a->name, desc[i].name) != 0)
+                                continue;
+
+                        found[i] = a;
+                        next = i + 1;
+                        break;
+                }
+        }
+}
+
+
+/** decode value into struct member of descriptor, false if it's invalid */
+static bool _prop_decode(const NftPrefsPropDesc * d, const xmlChar * value,
+                         size_t length, char *dst)
+{
+        void *member = dst + d->offset;
+        int64_t i;
+
+        switch (d->type)
+        {
+                case NFT_PREFS_PROP_STRING:
+                {
+                        if(length >= d->size)
+                                return false;
+                        memcpy(member, value, length + 1);
+                        return true;
+                }
+
+                case NFT_PREFS_PROP_STRING_ALLOC:
+                {
+                        char *s;
+                        if(!(s = (char *) xmlStrndup(value, (int) length)))
+                                return false;
+                        *(char **) member = s;
+                        return true;
+                }
+
+                case NFT_PREFS_PROP_INT:
+                {
+                        if(!_number_parse_int((const char *) value, &i) ||
+                           i < INT_MIN || i > INT_MAX)
+                                return false;
+                        *(int *) member = (int) i;
+                        return true;
+                }
+
+                case NFT_PREFS_PROP_LONG_INT:
+                {
+                        if(!_number_parse_int((const char *) value, &i) ||
+                           i < LONG_MIN || i > LONG_MAX)
+                                return false;
+                        *(long int *) member = (long int) i;
+                        return true;
+                }
+
+                case NFT_PREFS_PROP_DOUBLE:
+                {
+                        return _number_parse_double((const char *) value,
+                                                    (double *) member);
+                }
+
+                case NFT_PREFS_PROP_BOOLEAN:
+                {
+                        *(bool *) member = _parse_boolean(value);
+                        return true;
+                }
+        }
+
+        return false;
+}
+
+
+/** free copies in NFT_PREFS_PROP_STRING_ALLOC members of the first rows
+    of an array */
+static void _column_free(const NftPrefsPropDesc * d, void *dst, size_t stride,
+                         size_t rows)
+{
+        if(d->type != NFT_PREFS_PROP_STRING_ALLOC)
+                return;
+
+        for(size_t r = 0; r < rows; r++)
+        {
+                char **s = (char **) ((char *) dst + r * stride + d->offset);
+                xmlFree(*s);
+                *s = NULL;
+        }
+}
+
+
+/** format struct member of descriptor (tmp must hold NUMBER_MAXLEN chars),
+    NULL if it can't be formatted */
+static const char *_prop_encode(const NftPrefsPropDesc * d, const char *src,
+                                char *tmp)
+{
+        const void *member = src + d->offset;
+
+        switch (d->type)
+        {
+                case NFT_PREFS_PROP_STRING:
+                {
+                        /* must be terminated */
+                        if(!memchr(member, '\0', d->size))
+                                return NULL;
+                        return member;
+                }
+
+                case NFT_PREFS_PROP_STRING_ALLOC:
+                {
+                        return *(char *const *) member;
+                }
+
+                case NFT_PREFS_PROP_INT:
+                {
+                        _number_format_int(*(const int *) member, tmp);
+                        return tmp;
+                }
+
+                case NFT_PREFS_PROP_LONG_INT:
+                {
+                        _number_format_int(*(const long int *) member, tmp);
+                        return tmp;
+                }
+
+                case NFT_PREFS_PROP_DOUBLE:
+                {
+                        _number_format_double(*(const double *) member, tmp);
+                        return tmp;
+                }
+
+                case NFT_PREFS_PROP_BOOLEAN:
+                {
+                        return *(const bool *) member ? "true" : "false";
+                }
+        }
+
+        return NULL;
+}
+
+
+/** replace text of a property in place */
+static bool _prop_text(xmlNode * t, const xmlChar * value)
+{
+        xmlChar *copy;
+        if(!(copy = xmlStrdup(value)))
+                return false;
+
+        _arena_node_set_content(t, copy);
+        return true;
+}
+
+
+/** set property using xmlSetProp(). The old value of a property that is 
+    replaced is freed here since libxml2 doesn't know about arenas */
+static xmlAttr *_prop_set_xml(xmlNode * n, const xmlChar * name,
+                              const xmlChar * value)
+{
+        /* property xmlSetProp() would pick */
+        xmlNs *ns = NULL;
+        const xmlChar *colon;
+        if((colon = xmlStrchr(name, ':')))
+        {
+                xmlChar *prefix = xmlStrndup(name, (int) (colon - name));
+                if(prefix && (ns = xmlSearchNs(n->doc, n, prefix)))
+                        name = colon + 1;
+                xmlFree(prefix);
+        }
+
+        xmlAttr *a = xmlHasNsProp(n, name, ns ? ns->href : NULL);
+        if(a && a->type == XML_ATTRIBUTE_NODE)
+        {
+                if(a->atype == XML_ATTRIBUTE_ID && n->doc && n->doc->ids)
+                        xmlRemoveID(n->doc, a);
+
+                xmlNode *t = a->children;
+                a->children = a->last = NULL;
+                while(t)
+                {
+                        xmlNode *next = t->next;
+                        t->parent = NULL;
+                        t->next = t->prev = NULL;
+                        _arena_node_free(t);
+                        t = next;
+                }
+        }
+
+        _arena_doc_modified(n->doc);
+
+        return ns ? xmlSetNsProp(n, ns, name, value) : xmlSetNsProp(n, NULL, name, value);
+}
+
+
+/** set property like xmlSetProp() does. Existing plain values are replaced 
+    in place, new properties are appended and registered with the property 
+    index of the node (cached values are kept) */
+static xmlAttr *_prop_write(xmlNode * n, const xmlChar * name,
+                            const xmlChar * value)
+{
+        /* qualified names are resolved by libxml */
+        if(n->type != XML_ELEMENT_NODE || xmlStrchr(name, ':'))
+                return _prop_set_xml(n, name, value);
+
+        xmlAttr *a;
+        if((a = _node_index_prop_find(n, name)) && !a->ns)
+        {
+                xmlNode *t = a->children;
+                if(!t || t->next || t->type != XML_TEXT_NODE ||
+                   a->atype == XML_ATTRIBUTE_ID)
+                        return _prop_set_xml(n, name, value);
+
+                return _prop_text(t, value) ? a : NULL;
+        }
+
+        if(a)
+                return _prop_set_xml(n, name, value);
+
+        _arena_doc_modified(n->doc);
+
+        /* new property */
+        xmlNode *t = xmlNewDocText(n->doc, value);
+        if(!(a = xmlNewDocProp(n->doc, name, NULL)) || !t)
+        {
+                xmlFreeNode(t);
+                xmlFreeProp(a);
+                return NULL;
+        }
+        a->children = a->last = t;
+        t->parent = (xmlNode *) a;
+
+        _node_index_prop_append(n, a);
+
+        /* register ID declared by DTD */
+        if(n->doc && (n->doc->intSubset || n->doc->extSubset) &&
+           xmlIsID(n->doc, n, a) == 1)
+                xmlAddID(NULL, n->doc, value, a);
+
+        return a;
+}
+
+
+/** remove property (cached values are kept) */
+static int _prop_remove(xmlNode * n, const xmlChar * name)
+{
+        xmlAttr *a;
+        if(n->type != XML_ELEMENT_NODE ||
+           !(a = _node_index_prop_find(n, name)))
+                return -1;
+
+        /* like xmlUnsetProp(): only a property without namespace */
+        if(a->ns)
+        {
+                if(!(a = xmlHasNsProp(n, name, NULL)) ||
+                   a->type != XML_ATTRIBUTE_NODE)
+                        return -1;
+
+                xmlUnlinkNode((xmlNode *) a);
+                _node_index_invalidate_props(n);
+                _arena_node_free((xmlNode *) a);
+                return 0;
+        }
+
+        _node_index_prop_remove(n, a);
+        _arena_node_free((xmlNode *) a);
+
+        return 0;
+}
+
+
+/** store typed value of property as pending value if node defers its 
+    values (s. _node_index_value_defer()) */
+static bool _prop_defer(xmlNode * n, const char *name, NftPrefsPropType type,
+                        const void *value)
+{
+        if(!_node_index_value_defer(n, BAD_CAST name, type, value))
+                return false;
+
+        /* text of property is outdated now */
+        if(_node_index_prop_find(n, BAD_CAST name))
+                _prop_remove(n, BAD_CAST name);
+
+        return true;
+}
+
+
+
+
 /******************************************************************************/
 /**************************** PRIVATE FUNCTIONS *******************************/
 /******************************************************************************/
 
+/** store short property values (e.g. "true", "false", small numbers) in the
+    dictionary of the document so repeated values share one copy */
+void _node_prop_intern(xmlAttr * a, size_t len)
+{
+        if(len > DICT_VALUE_MAXLEN || !a->doc || !a->doc->dict)
+                return;
+
+        xmlNode *t = a->children;
+        if(!t || t->next || t->type != XML_TEXT_NODE || !t->content)
+                return;
+
+        xmlDict *dict = a->doc->dict;
+        if(xmlDictOwns(dict, t->content) == 1)
+                return;
+
+        const xmlChar *value;
+        if(!(value = xmlDictLookup(dict, t->content, -1)))
+                return;
+
+        _arena_node_set_content(t, (xmlChar *) value);
+}
+
+
+
+
+/** decode value formatted like a property value into member of struct 
+    (s. NftPrefsPropDesc) */
+bool _node_prop_decode(const NftPrefsPropDesc * d, const char *value,
+                       void *dst)
+{
+        return _prop_decode(d, BAD_CAST value, strlen(value), dst);
+}
+
+
+/** format typed value of property (buf has to hold NUMBER_MAXLEN bytes) */
+size_t _node_prop_format(NftPrefsPropType type, const NftPrefsNodeValue * value,
+                         char *buf)
+{
+        switch (type)
+        {
+                case NFT_PREFS_PROP_INT:
+                        return _number_format_int(value->i, buf);
+                case NFT_PREFS_PROP_LONG_INT:
+                        return _number_format_int(value->l, buf);
+                case NFT_PREFS_PROP_DOUBLE:
+                        return _number_format_double(value->d, buf);
+                case NFT_PREFS_PROP_BOOLEAN:
+                        strcpy(buf, value->b ? "true" : "false");
+                        return strlen(buf);
+                default:
+                        buf[0] = '\0';
+                        return 0;
+        }
+}
+
+
+/** set property like xmlSetProp() does (s. _prop_write()), dropping cached
+    values of the property */
+xmlAttr *_node_prop_set(xmlNode * n, const xmlChar * name,
+                        const xmlChar * value)
+{
+        /* qualified names drop all values, pending ones are written first */
+        if(xmlStrchr(name, ':'))
+                _node_prop_flush(n, NULL);
+
+        _node_index_value_drop(n, name);
+
+        return _prop_write(n, name, value);
+}
+
+
+/** remove property like xmlUnsetProp() does, keeping the property index 
+    of the node in sync */
+int _node_prop_unset(xmlNode * n, const xmlChar * name)
+{
+        /* property might only exist as pending value */
+        _node_prop_flush(n, xmlStrchr(name, ':') ? NULL : name);
+        _node_index_value_drop(n, name);
+
+        return _prop_remove(n, name);
+}
+
+
+/** write pending values of node (only the one of property name if name 
+    isn't NULL) to their properties */
+void _node_prop_flush(xmlNode * n, const xmlChar * name)
+{
+        const xmlChar *pname;
+        NftPrefsPropType type;
+        NftPrefsNodeValue v;
+        if(!_node_index_value_take(n, name, &pname, &type, &v))
+                return;
+
+        do
+        {
+                char tmp[NUMBER_MAXLEN];
+                size_t length = _node_prop_format(type, &v, tmp);
+
+                xmlAttr *a;
+                if((a = _prop_write(n, pname, BAD_CAST tmp)))
+                        _node_prop_intern(a, length);
+                else
+                        NFT_LOG(L_ERROR, "Failed to set property \"%s\" = \"%s\"",
+                                pname, tmp);
+        }
+        while(_node_index_value_take(n, name, &pname, &type, &v));
+}
+
+
+
 /******************************************************************************/
 /**************************** API FUNCTIONS ***********************************/
 /******************************************************************************/
@@ -83,7 +698,7 @@ NftResult nft_prefs_node_prop_unset(NftPrefsNode * n, const char *name)
     if(!n || !name)
             NFT_LOG_NULL(NFT_FAILURE);
 
-    if(xmlUnsetProp(n, BAD_CAST name) != 0)
+    if(_node_prop_unset(n, BAD_CAST name) != 0)
     {
             NFT_LOG(L_ERROR, "Failed to unset property \"%s\" from node \"%s\"",
                     name, nft_prefs_node_get_name(n));
@@ -108,7 +723,11 @@ NftResult nft_prefs_node_prop_string_set(NftPrefsNode * n, const char *name,
         if(!n || !name || !value)
                 NFT_LOG_NULL(NFT_FAILURE);
 
-        if(!xmlSetProp(n, (xmlChar *) name, (xmlChar *) value))
+        xmlAttr *a;
+        if((a = _node_prop_set(n, BAD_CAST name, BAD_CAST value)))
+                _node_prop_intern(a, strlen(value));
+
+        if(!a)
         {
                 NFT_LOG(L_DEBUG, "Failed to set property \"%s\" = \"%s\"",
                         name, value);
@@ -132,7 +751,43 @@ char *nft_prefs_node_prop_string_get(NftPrefsNode * n, const char *name)
         if(!n || !name)
                 NFT_LOG_NULL(NULL);
 
-        return (char *) xmlGetProp(n, BAD_CAST name);
+        xmlChar *copy;
+        const xmlChar *value;
+        if(!(value = _value(n, name, NULL, &copy)))
+                return NULL;
+
+        return (char *) (copy ? copy : xmlStrdup(value));
+}
+
+
+/**
+ * get string property without copying it
+ *
+ * @param n NftPrefsNode to get string property from
+ * @param name name of property
+ * @param length if not NULL, set to the length of the value
+ * @result value of property or NULL if it doesn't exist or can't be 
+ * borrowed (its value contains entity references, use 
+ * nft_prefs_node_prop_string_get() in that case)
+ * @note the result points into the node and stays valid until the property
+ * is changed or the node is freed. Don't free it.
+ */
+const char *nft_prefs_node_prop_string_borrow(NftPrefsNode * n,
+                                              const char *name,
+                                              size_t * length)
+{
+        if(!n || !name)
+                NFT_LOG_NULL(NULL);
+
+        xmlChar *copy;
+        const xmlChar *value = _value(n, name, length, &copy);
+        if(copy)
+        {
+                xmlFree(copy);
+                return NULL;
+        }
+
+        return (const char *) value;
 }
 
 
@@ -150,12 +805,12 @@ NftResult nft_prefs_node_prop_int_set(NftPrefsNode * n, const char *name,
         if(!n || !name)
                 NFT_LOG_NULL(NFT_FAILURE);
 
-        char tmp[32];
-        if(snprintf(tmp, sizeof(tmp), "%d", val) < 0)
-        {
-                NFT_LOG_PERROR("snprintf()");
-                return NFT_FAILURE;
-        }
+        /* formatted when it's looked at as text */
+        if(_prop_defer(n, name, NFT_PREFS_PROP_INT, &val))
+                return NFT_SUCCESS;
+
+        char tmp[NUMBER_MAXLEN];
+        _number_format_int(val, tmp);
 
         return nft_prefs_node_prop_string_set(n, name, tmp);
 }
@@ -175,8 +830,13 @@ NftResult nft_prefs_node_prop_int_get(NftPrefsNode * n, const char *name,
         if(!n || !name || !val)
                 NFT_LOG_NULL(NFT_FAILURE);
 
-        char *tmp;
-        if(!(tmp = nft_prefs_node_prop_string_get(n, name)))
+        /* value parsed before */
+        if(_node_index_value_get(n, BAD_CAST name, NFT_PREFS_PROP_INT, val))
+                return NFT_SUCCESS;
+
+        xmlChar *copy;
+        const xmlChar *tmp;
+        if(!(tmp = _value(n, name, NULL, &copy)))
         {
                 NFT_LOG(L_DEBUG, "int-type property \"%s\" not found in <%s>", name,
                         n->name);
@@ -184,18 +844,25 @@ NftResult nft_prefs_node_prop_int_get(NftPrefsNode * n, const char *name,
         }
 
         NftResult result = NFT_SUCCESS;
-        int parsed_val;
-        parsed_val = strtol(tmp, NULL, 10);
-        if(parsed_val < INT_MIN ||
-           parsed_val > INT_MAX)
+        int64_t parsed_val;
+        if(!_number_parse_int((const char *) tmp, &parsed_val))
+        {
+                NFT_LOG(L_ERROR, "failed to parse int-type property \"%s\".", name);
+                result = NFT_FAILURE;
+        }
+        else if(parsed_val < INT_MIN ||
+                parsed_val > INT_MAX)
         {
                 NFT_LOG(L_ERROR, "int-type property \"%s\" out of range.", name);
                 result = NFT_FAILURE;
         }
+        else
+        {
+                *val = (int) parsed_val;
+                _node_index_value_put(n, BAD_CAST name, NFT_PREFS_PROP_INT, val);
+        }
 
-        *val = parsed_val;
-
-        nft_prefs_free(tmp);
+        xmlFree(copy);
 
         return result;
 }
@@ -214,12 +881,12 @@ NftResult nft_prefs_node_prop_long_int_set(NftPrefsNode * n, const char *name,
         if(!n || !name)
                 NFT_LOG_NULL(NFT_FAILURE);
 
-        char tmp[32];
-        if(snprintf(tmp, sizeof(tmp), "%ld", val) < 0)
-        {
-                NFT_LOG_PERROR("snprintf()");
-                return NFT_FAILURE;
-        }
+        /* formatted when it's looked at as text */
+        if(_prop_defer(n, name, NFT_PREFS_PROP_LONG_INT, &val))
+                return NFT_SUCCESS;
+
+        char tmp[NUMBER_MAXLEN];
+        _number_format_int(val, tmp);
 
         return nft_prefs_node_prop_string_set(n, name, tmp);
 }
@@ -238,8 +905,13 @@ NftResult nft_prefs_node_prop_long_int_get(NftPrefsNode * n, const char *name,
         if(!n || !name || !val)
                 NFT_LOG_NULL(NFT_FAILURE);
 
-        char *tmp;
-        if(!(tmp = nft_prefs_node_prop_string_get(n, name)))
+        /* value parsed before */
+        if(_node_index_value_get(n, BAD_CAST name, NFT_PREFS_PROP_LONG_INT, val))
+                return NFT_SUCCESS;
+
+        xmlChar *copy;
+        const xmlChar *tmp;
+        if(!(tmp = _value(n, name, NULL, &copy)))
         {
                 NFT_LOG(L_DEBUG, "int-type property \"%s\" not found in <%s>", name,
                         n->name);
@@ -247,12 +919,25 @@ NftResult nft_prefs_node_prop_long_int_get(NftPrefsNode * n, const char *name,
         }
 
         NftResult result = NFT_SUCCESS;
-        long int parsed_val;
-        parsed_val = strtol(tmp, NULL, 10);
-
-        *val = parsed_val;
+        int64_t parsed_val;
+        if(!_number_parse_int((const char *) tmp, &parsed_val))
+        {
+                NFT_LOG(L_ERROR, "failed to parse int-type property \"%s\".", name);
+                result = NFT_FAILURE;
+        }
+        else if(parsed_val < LONG_MIN ||
+                parsed_val > LONG_MAX)
+        {
+                NFT_LOG(L_ERROR, "int-type property \"%s\" out of range.", name);
+                result = NFT_FAILURE;
+        }
+        else
+        {
+                *val = (long int) parsed_val;
+                _node_index_value_put(n, BAD_CAST name, NFT_PREFS_PROP_LONG_INT, val);
+        }
 
-        nft_prefs_free(tmp);
+        xmlFree(copy);
 
         return result;
 }
@@ -271,12 +956,12 @@ NftResult nft_prefs_node_prop_double_set(NftPrefsNode * n, const char *name,
         if(!n || !name)
                 NFT_LOG_NULL(NFT_FAILURE);
 
-        char tmp[32];
-        if(snprintf(tmp, sizeof(tmp), "%lf", val) < 0)
-        {
-                NFT_LOG_PERROR("snprintf()");
-                return NFT_FAILURE;
-        }
+        /* formatted when it's looked at as text */
+        if(_prop_defer(n, name, NFT_PREFS_PROP_DOUBLE, &val))
+                return NFT_SUCCESS;
+
+        char tmp[NUMBER_MAXLEN];
+        _number_format_double(val, tmp);
 
         return nft_prefs_node_prop_string_set(n, name, tmp);
 }
@@ -296,8 +981,13 @@ NftResult nft_prefs_node_prop_double_get(NftPrefsNode * n, const char *name,
         if(!n || !name || !val)
                 NFT_LOG_NULL(NFT_FAILURE);
 
-        char *tmp;
-        if(!(tmp = nft_prefs_node_prop_string_get(n, name)))
+        /* value parsed before */
+        if(_node_index_value_get(n, BAD_CAST name, NFT_PREFS_PROP_DOUBLE, val))
+                return NFT_SUCCESS;
+
+        xmlChar *copy;
+        const xmlChar *tmp;
+        if(!(tmp = _value(n, name, NULL, &copy)))
         {
                 NFT_LOG(L_DEBUG, "double-type property \"%s\" not found in <%s>", name,
                         n->name);
@@ -305,15 +995,17 @@ NftResult nft_prefs_node_prop_double_get(NftPrefsNode * n, const char *name,
         }
 
         NftResult result = NFT_SUCCESS;
-        char *endptr = NULL;
-        *val = strtod(tmp, &endptr);
-        if(endptr == tmp)
+        if(!_number_parse_double((const char *) tmp, val))
         {
                 NFT_LOG(L_ERROR, "failed to parse double-type property \"%s\".", name);
                 result = NFT_FAILURE;
         }
+        else
+        {
+                _node_index_value_put(n, BAD_CAST name, NFT_PREFS_PROP_DOUBLE, val);
+        }
 
-        nft_prefs_free(tmp);
+        xmlFree(copy);
 
         return result;
 }
@@ -332,6 +1024,10 @@ NftResult nft_prefs_node_prop_boolean_set(NftPrefsNode * n, const char *name,
         if(!n || !name)
                 NFT_LOG_NULL(NFT_FAILURE);
 
+        /* formatted when it's looked at as text */
+        if(_prop_defer(n, name, NFT_PREFS_PROP_BOOLEAN, &val))
+                return NFT_SUCCESS;
+
         char tmp[16];
         if(snprintf(tmp, sizeof(tmp), "%s", val ? "true" : "false") < 0)
         {
@@ -357,33 +1053,408 @@ NftResult nft_prefs_node_prop_boolean_get(NftPrefsNode * n, const char *name,
         if(!n || !name || !val)
                 NFT_LOG_NULL(NFT_FAILURE);
 
-        xmlChar *tmp;
-        if(!(tmp = (xmlChar *) nft_prefs_node_prop_string_get(n, name)))
+        /* value parsed before */
+        if(_node_index_value_get(n, BAD_CAST name, NFT_PREFS_PROP_BOOLEAN, val))
+                return NFT_SUCCESS;
+
+        xmlChar *copy;
+        const xmlChar *tmp;
+        if(!(tmp = _value(n, name, NULL, &copy)))
         {
                 NFT_LOG(L_DEBUG, "property \"%s\" not found in <%s>", name,
                         n->name);
                 return NFT_FAILURE;
         }
 
-        if(xmlStrcasecmp(tmp, BAD_CAST "true") == 0 ||
-           xmlStrcasecmp(tmp, BAD_CAST "yes") == 0 ||
-           xmlStrcasecmp(tmp, BAD_CAST "on") == 0 ||
-           xmlStrcasecmp(tmp, BAD_CAST "enable") == 0 ||
-           xmlStrcasecmp(tmp, BAD_CAST "1") == 0)
+        *val = _parse_boolean(tmp);
+        _node_index_value_put(n, BAD_CAST name, NFT_PREFS_PROP_BOOLEAN, val);
+
+        xmlFree(copy);
+
+        return NFT_SUCCESS;
+}
+
+
+/**
+ * set int array property. The elements are stored as base64 representation
+ * of 32 bit little endian integers.
+ *
+ * @param n node where property should be set
+ * @param name name of property
+ * @param values elements
+ * @param count amount of elements
+ * @result NFT_SUCCESS or NFT_FAILURE
+ */
+NftResult nft_prefs_node_prop_int_array_set(NftPrefsNode * n, const char *name,
+                                            const int *values, size_t count)
+{
+        if(sizeof(int) == sizeof(int32_t))
+                return _array_set(n, name, values, count, sizeof(int32_t));
+
+        int32_t *tmp = NULL;
+        if(count && !(tmp = malloc(count * sizeof(int32_t))))
         {
-                *val = true;
+                NFT_LOG_PERROR("malloc");
+                return NFT_FAILURE;
         }
-        else
+
+        for(size_t i = 0; i < count; i++)
+                tmp[i] = (int32_t) values[i];
+
+        NftResult r = _array_set(n, name, tmp, count, sizeof(int32_t));
+        free(tmp);
+        return r;
+}
+
+
+/**
+ * get int array property
+ *
+ * @param n node to read property from
+ * @param name name of property
+ * @param values buffer for elements or NULL to only get the amount of 
+ * elements
+ * @param count size of buffer (in elements), set to the amount of elements 
+ * of the property
+ * @result NFT_SUCCESS or NFT_FAILURE (property doesn't exist, is invalid or
+ * has more elements than the buffer can hold)
+ */
+NftResult nft_prefs_node_prop_int_array_get(NftPrefsNode * n, const char *name,
+                                            int *values, size_t * count)
+{
+        if(sizeof(int) == sizeof(int32_t) || !values)
+                return _array_get(n, name, values, count, sizeof(int32_t));
+
+        if(!count)
+                NFT_LOG_NULL(NFT_FAILURE);
+
+        int32_t *tmp = NULL;
+        size_t capacity = *count;
+        if(capacity && !(tmp = malloc(capacity * sizeof(int32_t))))
         {
-                *val = false;
+                NFT_LOG_PERROR("malloc");
+                return NFT_FAILURE;
         }
 
-        nft_prefs_free(tmp);
+        NftResult r = _array_get(n, name, tmp, count, sizeof(int32_t));
+        for(size_t i = 0; r && i < *count; i++)
+                values[i] = tmp[i];
 
-        return NFT_SUCCESS;
+        free(tmp);
+        return r;
 }
 
 
+/**
+ * set double array property. The elements are stored as base64 
+ * representation of little endian IEEE 754 doubles.
+ *
+ * @param n node where property should be set
+ * @param name name of property
+ * @param values elements
+ * @param count amount of elements
+ * @result NFT_SUCCESS or NFT_FAILURE
+ */
+NftResult nft_prefs_node_prop_double_array_set(NftPrefsNode * n,
+                                               const char *name,
+                                               const double *values,
+                                               size_t count)
+{
+        return _array_set(n, name, values, count, sizeof(double));
+}
+
+
+/**
+ * get double array property
+ *
+ * @param n node to read property from
+ * @param name name of property
+ * @param values buffer for elements or NULL to only get the amount of 
+ * elements
+ * @param count size of buffer (in elements), set to the amount of elements 
+ * of the property
+ * @result NFT_SUCCESS or NFT_FAILURE (property doesn't exist, is invalid or
+ * has more elements than the buffer can hold)
+ */
+NftResult nft_prefs_node_prop_double_array_get(NftPrefsNode * n,
+                                               const char *name,
+                                               double *values, size_t * count)
+{
+        return _array_get(n, name, values, count, sizeof(double));
+}
+
+
+/**
+ * set byte array property. The elements are stored as base64.
+ *
+ * @param n node where property should be set
+ * @param name name of property
+ * @param values elements
+ * @param count amount of elements
+ * @result NFT_SUCCESS or NFT_FAILURE
+ */
+NftResult nft_prefs_node_prop_u8_array_set(NftPrefsNode * n, const char *name,
+                                           const uint8_t * values, size_t count)
+{
+        return _array_set(n, name, values, count, sizeof(uint8_t));
+}
+
+
+/**
+ * get byte array property
+ *
+ * @param n node to read property from
+ * @param name name of property
+ * @param values buffer for elements or NULL to only get the amount of 
+ * elements
+ * @param count size of buffer (in elements), set to the amount of elements 
+ * of the property
+ * @result NFT_SUCCESS or NFT_FAILURE (property doesn't exist, is invalid or
+ * has more elements than the buffer can hold)
+ */
+NftResult nft_prefs_node_prop_u8_array_get(NftPrefsNode * n, const char *name,
+                                           uint8_t * values, size_t * count)
+{
+        return _array_get(n, name, values, count, sizeof(uint8_t));
+}
+
+
+/**
+ * read one property of all children with a certain name into an array 
+ * (e.g. all "x" properties of <led> nodes), in the order of the children
+ *
+ * @param n parent node
+ * @param child name of children
+ * @param desc descriptor of property and of the element (s. 
+ * NFT_PREFS_PROP_DESC()). The offset of the descriptor is relative to the 
+ * start of each element
+ * @param dst array of elements or NULL to only get the amount of children
+ * @param stride distance of elements in bytes (e.g. desc->size for a plain
+ * array or the size of a struct for an array of structs)
+ * @param count size of array (in elements), set to the amount of children
+ * @result NFT_SUCCESS or NFT_FAILURE (array too small or property of a 
+ * child missing or invalid while desc has no default)
+ * @note NFT_PREFS_PROP_STRING_ALLOC members receive a copy that must be 
+ * freed with nft_prefs_free(). Nothing has to be freed upon failure.
+ */
+NftResult nft_prefs_node_column_get(NftPrefsNode * n, const char *child,
+                                    const NftPrefsPropDesc * desc, void *dst,
+                                    size_t stride, size_t * count)
+{
+        if(!n || !child || !desc || !count)
+                NFT_LOG_NULL(NFT_FAILURE);
+
+        if(dst && stride < desc->offset + desc->size)
+        {
+                NFT_LOG(L_ERROR, "stride of %zu bytes too small for \"%s\"",
+                        stride, desc->name);
+                return NFT_FAILURE;
+        }
+
+        NftResult result = NFT_SUCCESS;
+        size_t capacity = *count, rows = 0;
+        for(xmlNode * c = nft_prefs_node_get_first_child(n); c;
+            c = nft_prefs_node_get_next(c))
+        {
+                if(!xmlStrEqual(c->name, BAD_CAST child))
+                        continue;
+
+                if(dst && result && rows < capacity)
+                {
+                        char *row = (char *) dst + rows * stride;
+                        size_t length = 0;
+                        xmlChar *copy;
+                        const xmlChar *value = _value(c, desc->name, &length, &copy);
+                        bool ok = value && _prop_decode(desc, value, length, row);
+                        xmlFree(copy);
+
+                        if(!ok && !(desc->def &&
+                                    _prop_decode(desc, BAD_CAST desc->def,
+                                                 strlen(desc->def), row)))
+                        {
+                                NFT_LOG(L_ERROR, "property \"%s\" of <%s> #%zu "
+                                        "missing or invalid", desc->name,
+                                        child, rows);
+                                result = NFT_FAILURE;
+                                _column_free(desc, dst, stride, rows);
+                        }
+                }
+
+                rows++;
+        }
+
+        *count = rows;
+
+        if(result && dst && rows > capacity)
+        {
+                NFT_LOG(L_ERROR, "%zu <%s> children, array holds %zu", rows,
+                        child, capacity);
+                _column_free(desc, dst, stride, capacity);
+                result = NFT_FAILURE;
+        }
+
+        return result;
+}
+
+
+/**
+ * read multiple properties into the members of a struct in one pass over 
+ * the properties of a node
+ *
+ * @param n node to read properties from
+ * @param desc descriptors of properties and struct members (s. 
+ * NFT_PREFS_PROP_DESC())
+ * @param count amount of descriptors (max. NFT_PREFS_PROPS_MAX)
+ * @param dst struct to fill
+ * @result bitmask with bit i set if property desc[i] was missing or invalid
+ * (the member is set to the default of the descriptor in that case, if it 
+ * has one, and left untouched otherwise). 0 if all properties were read, 
+ * all bits set on error.
+ * @note NFT_PREFS_PROP_STRING_ALLOC members receive a copy that must be 
+ * freed with nft_prefs_free()
+ */
+uint64_t nft_prefs_node_props_get(NftPrefsNode * n,
+                                  const NftPrefsPropDesc desc[], size_t count,
+                                  void *dst)
+{
+        if(!n || !desc || !dst)
+                NFT_LOG_NULL(UINT64_MAX);
+
+        if(count > NFT_PREFS_PROPS_MAX)
+        {
+                NFT_LOG(L_ERROR, "%zu property descriptors (max. %d)", count,
+                        NFT_PREFS_PROPS_MAX);
+                return UINT64_MAX;
+        }
+
+        /* typed values that are pending or were parsed before */
+        uint64_t cached = 0;
+        for(size_t i = 0; i < count; i++)
+        {
+                if(_node_index_value_get(n, BAD_CAST desc[i].name, desc[i].type,
+                                         (char *) dst + desc[i].offset))
+                        cached |= UINT64_C(1) << i;
+        }
+
+        /* other pending values are looked at as text */
+        _node_prop_flush(n, NULL);
+
+        xmlAttr *found[NFT_PREFS_PROPS_MAX];
+        _props_find(n, desc, count, true, found);
+
+        /* defaults from DTD aren't in the list of properties */
+        bool dtd = n->doc && (n->doc->intSubset || n->doc->extSubset);
+
+        uint64_t failed = 0;
+        for(size_t i = 0; i < count; i++)
+        {
+                if(cached & (UINT64_C(1) << i))
+                        continue;
+
+                const xmlChar *value = NULL;
+                size_t length = 0;
+                xmlChar *copy = NULL;
+                if(found[i])
+                        value = _attr_value(found[i], &length, &copy);
+                else if(dtd)
+                        value = _value(n, desc[i].name, &length, &copy);
+
+                bool ok = value && _prop_decode(&desc[i], value, length, dst);
+                xmlFree(copy);
+                if(ok)
+                        continue;
+
+                if(value)
+                        NFT_LOG(L_DEBUG, "property \"%s\" of <%s> is invalid",
+                                desc[i].name, n->name);
+
+                failed |= UINT64_C(1) << i;
+                if(desc[i].def)
+                        _prop_decode(&desc[i], BAD_CAST desc[i].def,
+                                     strlen(desc[i].def), dst);
+        }
+
+        return failed;
+}
+
+
+/**
+ * set multiple properties from the members of a struct in one pass over the
+ * properties of a node
+ *
+ * @param n node where properties should be set
+ * @param desc descriptors of properties and struct members (s. 
+ * NFT_PREFS_PROP_DESC())
+ * @param count amount of descriptors (max. NFT_PREFS_PROPS_MAX)
+ * @param src struct to read members from
+ * @result bitmask with bit i set if property desc[i] couldn't be set 
+ * (unterminated string, NULL pointer or out of memory). 0 if all 
+ * properties were set, all bits set on error.
+ */
+uint64_t nft_prefs_node_props_set(NftPrefsNode * n,
+                                  const NftPrefsPropDesc desc[], size_t count,
+                                  const void *src)
+{
+        if(!n || !desc || !src)
+                NFT_LOG_NULL(UINT64_MAX);
+
+        if(count > NFT_PREFS_PROPS_MAX)
+        {
+                NFT_LOG(L_ERROR, "%zu property descriptors (max. %d)", count,
+                        NFT_PREFS_PROPS_MAX);
+                return UINT64_MAX;
+        }
+
+        xmlAttr *found[NFT_PREFS_PROPS_MAX];
+        _props_find(n, desc, count, false, found);
+
+        uint64_t failed = 0;
+        for(size_t i = 0; i < count; i++)
+        {
+                /* kept in binary form by nodes that defer their values */
+                if(_prop_defer(n, desc[i].name, desc[i].type,
+                               (const char *) src + desc[i].offset))
+                        continue;
+
+                char tmp[NUMBER_MAXLEN];
+                const char *value;
+                if(!(value = _prop_encode(&desc[i], src, tmp)))
+                {
+                        failed |= UINT64_C(1) << i;
+                        continue;
+                }
+
+                xmlAttr *a = found[i];
+                xmlNode *t = a ? a->children : NULL;
+                if(t && !t->next && t->type == XML_TEXT_NODE &&
+                   a->atype != XML_ATTRIBUTE_ID)
+                {
+                        /* replace value of existing property */
+                        _node_index_value_drop(n, BAD_CAST desc[i].name);
+                        if(!_prop_text(t, BAD_CAST value))
+                                a = NULL;
+                }
+                else
+                {
+                        a = _node_prop_set(n, BAD_CAST desc[i].name, BAD_CAST value);
+                }
+
+                if(!a)
+                {
+                        NFT_LOG(L_DEBUG, "Failed to set property \"%s\" = \"%s\"",
+                                desc[i].name, value);
+                        failed |= UINT64_C(1) << i;
+                        continue;
+                }
+
+                _node_prop_intern(a, strlen(value));
+        }
+
+        return failed;
+}
+
+
+
 /**
  * @}
  */
@@ -57,10 +57,18 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <libxml/xmlIO.h>
 #include <niftylog.h>
 #include "prefs.h"
 #include "class.h"
 #include "updater.h"
+#include "node.h"
+#include "arena.h"
+#include "reclaim.h"
+#include "cache.h"
+#include "compress.h"
+#include "xinclude.h"
+#include "table.h"
 
 
 
@@ -68,10 +76,295 @@
 /**************************** STATIC FUNCTIONS ********************************/
 /******************************************************************************/
 
+/** move string from one dictionary to another. Returns the string that 
+    has to be used from now on */
+static xmlChar *_dict_move(xmlChar * str, xmlDoc * doc, xmlDict * to)
+{
+        xmlDict *from = doc ? doc->dict : NULL;
+        if(!str || from == to)
+                return str;
+
+        bool owned = from && (xmlDictOwns(from, str) == 1);
+
+        /* intern into new dictionary */
+        if(to)
+        {
+                const xmlChar *interned;
+                if(!(interned = xmlDictLookup(to, str, -1)))
+                {
+                        NFT_LOG(L_ERROR, "Failed to add \"%s\" to dictionary",
+                                str);
+                        return owned ? xmlStrdup(str) : str;
+                }
+
+                if(!owned)
+                        _arena_string_free(doc, str);
+
+                return (xmlChar *) interned;
+        }
+
+        /* new document has no dictionary */
+        return owned ? xmlStrdup(str) : str;
+}
+
+
+/** move content of a node (text, comment, ...) to another dictionary */
+static void _dict_move_content(xmlNode * n, xmlDoc * from, xmlDict * to)
+{
+        /* content stored inside the node itself (XML_PARSE_COMPACT) */
+        if(n->content == (xmlChar *) & (n->properties))
+                return;
+
+        n->content = _dict_move(n->content, from, to);
+}
+
+
+/** move a subtree to another document. Names (and values) owned by the 
+    dictionary of the old document are moved to the dictionary of the new 
+    document, so all names of a document that has a dictionary are always 
+    stored inside that dictionary */
+static void _node_set_doc(xmlNode * tree, xmlDoc * doc)
+{
+        xmlNode *n = tree;
+
+        if(!n || n->doc == doc)
+                return;
+
+        xmlDoc *from = n->doc;
+        xmlDict *to = doc ? doc->dict : NULL;
+
+        switch (n->type)
+        {
+                case XML_ELEMENT_NODE:
+                {
+                        n->name = _dict_move((xmlChar *) n->name, from, to);
+
+                        for(xmlAttr * a = n->properties; a; a = a->next)
+                        {
+                                a->name = _dict_move((xmlChar *) a->name, from, to);
+                                for(xmlNode * t = a->children; t; t = t->next)
+                                {
+                                        _dict_move_content(t, from, to);
+                                        t->doc = doc;
+                                }
+                                a->doc = doc;
+                        }
+                        break;
+                }
+
+                case XML_PI_NODE:
+                {
+                        n->name = _dict_move((xmlChar *) n->name, from, to);
+                        _dict_move_content(n, from, to);
+                        break;
+                }
+
+                case XML_TEXT_NODE:
+                case XML_CDATA_SECTION_NODE:
+                case XML_COMMENT_NODE:
+                {
+                        _dict_move_content(n, from, to);
+                        break;
+                }
+
+                default:
+                {
+                        break;
+                }
+        }
+
+        /* process children */
+        if(n->type != XML_ENTITY_REF_NODE)
+        {
+                for(xmlNode * c = n->children; c; c = c->next)
+                        _node_set_doc(c, doc);
+        }
+
+        n->doc = doc;
+}
+
+
+/** write runs of similar nodes of a copy as tables if enabled 
+    (s. nft_prefs_set_columnar()) */
+static NftResult _node_columnar(NftPrefs * p, xmlNode * copy)
+{
+        if(!_prefs_get_columnar(p))
+                return NFT_SUCCESS;
+
+        int tables;
+        if((tables = _table_encode(copy)) < 0)
+        {
+                NFT_LOG(L_ERROR, "Failed to create tables of node \"%s\"",
+                        nft_prefs_node_get_name(copy));
+                return NFT_FAILURE;
+        }
+        NFT_LOG(L_DEBUG, "%d tables created", tables);
+
+        return NFT_SUCCESS;
+}
+
+
+/** put a tree that has no document into a new document */
+static NftResult _node_add_doc(xmlNode * n)
+{
+        /* find root of tree */
+        while(n->parent)
+                n = n->parent;
+
+        xmlDoc *doc;
+        if(!(doc = xmlNewDoc(BAD_CAST "1.0")))
+        {
+                NFT_LOG(L_ERROR, "Failed to create new XML doc");
+                return NFT_FAILURE;
+        }
+
+        xmlDocSetRootElement(doc, n);
+
+        return NFT_SUCCESS;
+}
+
+
+/** create node from document (if xincludes is not NULL, the amount of
+    XInclude substitutions is written there) */
+static NftPrefsNode *_node_from_doc_ex(NftPrefs *p, xmlDoc *doc, int *xincludes)
+{
+        if(!doc)
+                NFT_LOG_NULL(NULL);
+
+        /* parse XInclude stuff (cached files first, libxml2 does the rest) */
+        int xinc_res = 0, xinc_rest = 0;
+        if(_prefs_get_lazy_xinclude(p))
+        {
+                if((xinc_res = _xinclude_defer(p, doc)) == -1)
+                {
+                        NFT_LOG(L_ERROR, "XInclude parsing failed.");
+                        goto _nfd_error;
+                }
+                NFT_LOG(L_DEBUG, "%d XInclude substitutions deferred", xinc_res);
+        }
+        else
+        {
+                if((_prefs_get_include_cache(p) && (xinc_res = _xinclude_process(p, doc)) == -1) ||
+                   (xinc_rest = xmlXIncludeProcessFlags(doc, _prefs_get_parse_options(p))) == -1)
+                {
+                        NFT_LOG(L_ERROR, "XInclude parsing failed.");
+                        goto _nfd_error;
+                }
+                xinc_res += xinc_rest;
+                NFT_LOG(L_DEBUG, "%d XInclude substitutions done", xinc_res);
+        }
+        if(xincludes)
+                *xincludes = xinc_res;
+
+        /* expand columnar tables */
+        int tables;
+        if((tables = _table_decode((xmlNode *) doc)) < 0)
+                goto _nfd_error;
+        NFT_LOG(L_DEBUG, "%d tables expanded", tables);
+
+        /* get node */
+        xmlNode *node;
+        if(!(node = xmlDocGetRootElement(doc)))
+        {
+                NFT_LOG(L_ERROR, "No root element found in XML");
+                goto _nfd_error;
+        }
+
+        /* update node */
+        if(!_updater_node_process(p, node))
+        {
+                NFT_LOG(L_ERROR, "Preference update failed for node \"%s\". This is a fatal bug. Aborting.",
+                        nft_prefs_node_get_name(node));
+                goto _nfd_error;
+        }
+
+        return node;
+
+_nfd_error:
+        _arena_doc_free(doc);
+        return NULL;
+}
+
+
+
 /******************************************************************************/
 /**************************** PRIVATE FUNCTIONS *******************************/
 /******************************************************************************/
 
+/** a new tree is complete. In arena mode it's copied into an arena of its
+    own. Returns the root node that has to be used from now on */
+NftPrefsNode *_node_tree_finish(NftPrefs * p, NftPrefsNode * n)
+{
+        if(!n || !n->doc || !_prefs_get_arena(p))
+                return n;
+
+        /* node itself is freed once it's copied */
+        xmlDoc *doc = n->doc;
+        if(!_arena_doc_compact(doc))
+                NFT_LOG(L_WARNING, "Failed to copy tree to arena, using heap");
+
+        return xmlDocGetRootElement(doc);
+}
+
+
+/** allocate a new node. A node of a NftPrefs context (p is not NULL) 
+    becomes root of a document of its own that holds a reference to the 
+    dictionary of the context, so it stays valid after nft_prefs_deinit() */
+NftPrefsNode *_node_alloc(NftPrefs * p, const char *name)
+{
+        if(!name)
+                NFT_LOG_NULL(NULL);
+
+        if(!p)
+                return xmlNewNode(NULL, BAD_CAST name);
+
+        xmlDoc *doc;
+        if(!(doc = xmlNewDoc(BAD_CAST "1.0")))
+        {
+                NFT_LOG(L_ERROR, "Failed to create new XML doc");
+                return NULL;
+        }
+        doc->dict = _prefs_doc_dict(p);
+        xmlDictReference(doc->dict);
+
+        NftPrefsNode *n;
+        if(!(n = xmlNewDocNode(doc, NULL, BAD_CAST name, NULL)))
+        {
+                xmlFreeDoc(doc);
+                return NULL;
+        }
+        xmlDocSetRootElement(doc, n);
+
+        return n;
+}
+
+
+/** process a freshly parsed document (XInclude, updaters) and return its root
+    node. The document is freed upon failure */
+NftPrefsNode *_node_from_doc(NftPrefs *p, xmlDoc *doc)
+{
+        return _node_from_doc_ex(p, doc, NULL);
+}
+
+
+/** create node from document that was already processed (XInclude & updates) */
+NftPrefsNode *_node_from_doc_processed(xmlDoc *doc)
+{
+        if(!doc)
+                NFT_LOG_NULL(NULL);
+
+        xmlNode *node;
+        if(!(node = xmlDocGetRootElement(doc)))
+        {
+                NFT_LOG(L_ERROR, "No root element found in XML");
+                _arena_doc_free(doc);
+                return NULL;
+        }
+
+        return node;
+}
+
+
 /******************************************************************************/
 /**************************** API FUNCTIONS ***********************************/
 /******************************************************************************/
@@ -87,10 +380,57 @@
  */
 NftResult nft_prefs_node_add_child(NftPrefsNode * parent, NftPrefsNode * cur)
 {
-		if(!parent)
+		if(!parent || !cur)
 				NFT_LOG_NULL(NFT_FAILURE);
 
-        return xmlAddChild(parent, cur) ? NFT_SUCCESS : NFT_FAILURE;
+        /* detach node from its old position */
+        xmlDoc *olddoc = cur->doc;
+        bool wasroot = olddoc && (cur->parent == (xmlNode *) olddoc);
+        _node_index_invalidate(cur->parent);
+        _node_index_invalidate(parent);
+        xmlUnlinkNode(cur);
+
+        if(olddoc != parent->doc)
+        {
+                /* nodes allocated from arenas need a document that keeps
+                   those arenas alive */
+                if(!parent->doc && _arena_doc_needs_tracking(olddoc) &&
+                   !_node_add_doc(parent))
+                        return NFT_FAILURE;
+
+                /* indexes & values move along with the node */
+                if(!_arena_doc_adopt(parent->doc, olddoc) ||
+                   !_node_index_move(cur, parent->doc))
+                        return NFT_FAILURE;
+        }
+
+        /* move node to document of parent */
+        if(cur->doc != parent->doc)
+                _node_set_doc(cur, parent->doc);
+
+        /* text nodes are linked as they are, libxml2 would merge them with a
+           preceding text node (freeing memory that might be part of an arena) */
+        if(cur->type == XML_TEXT_NODE)
+        {
+                cur->parent = parent;
+                cur->prev = parent->last;
+                cur->next = NULL;
+                if(parent->last)
+                        parent->last->next = cur;
+                else
+                        parent->children = cur;
+                parent->last = cur;
+        }
+        else if(!xmlAddChild(parent, cur))
+        {
+                return NFT_FAILURE;
+        }
+
+        /* node was the root of its own document that is empty now */
+        if(wasroot && olddoc != parent->doc && !xmlDocGetRootElement(olddoc))
+                _arena_doc_free(olddoc);
+
+        return NFT_SUCCESS;
 }
 
 
@@ -105,7 +445,7 @@ NftPrefsNode *nft_prefs_node_get_first_child(NftPrefsNode * n)
 		if(!n)
 				NFT_LOG_NULL(NULL);
 
-        return xmlFirstElementChild(n);
+        return _xinclude_expand(xmlFirstElementChild(n));
 }
 
 
@@ -117,7 +457,7 @@ NftPrefsNode *nft_prefs_node_get_first_child(NftPrefsNode * n)
  */
 NftPrefsNode *nft_prefs_node_get_next(NftPrefsNode * n)
 {
-        return xmlNextElementSibling(n);
+        return _xinclude_expand(xmlNextElementSibling(n));
 }
 
 
@@ -133,11 +473,20 @@ NftPrefsNode *nft_prefs_node_get_next_with_name(NftPrefsNode * n, const char *na
 		if(!n || !name)
 				NFT_LOG_NULL(NULL);
 
+		/* all names of a document with a dictionary are stored in that
+		   dictionary, so they can be compared by pointer. A name that's 
+		   not in there yet can only appear in lazily included files */
+		xmlDict *dict = n->doc ? n->doc->dict : NULL;
+		const xmlChar *dictname = NULL;
+		if(dict)
+				dictname = xmlDictExists(dict, BAD_CAST name, -1);
+
 		for(NftPrefsNode *sibling = nft_prefs_node_get_next(n);
 		    sibling;
 		    sibling = nft_prefs_node_get_next(sibling))
 		{
-				if(strcmp(nft_prefs_node_get_name(sibling), name) == 0)
+				if(dictname ? (sibling->name == dictname) :
+				   (strcmp(nft_prefs_node_get_name(sibling), name) == 0))
 				{
 						return sibling;
 				}
@@ -189,6 +538,9 @@ char *nft_prefs_node_to_buffer_minimal(NftPrefs *p, NftPrefsNode * n)
                 return NULL;
         }
 
+        /* pending values are written as text */
+        _node_index_flush(n);
+
         /* create buffer */
         xmlBufferPtr buf;
         if(!(buf = xmlBufferCreate()))
@@ -197,8 +549,13 @@ char *nft_prefs_node_to_buffer_minimal(NftPrefs *p, NftPrefsNode * n)
                 return NULL;
         }
 
-        /* dump node */
-        if(xmlNodeDump(buf, n->doc, n, 0, true) < 0)
+        /* dump node (or a copy holding tables) */
+        xmlNode *copy = NULL;
+        if(_prefs_get_columnar(p) &&
+           (!(copy = xmlCopyNode(n, 1)) || !_node_columnar(p, copy)))
+                goto _pntb_exit;
+
+        if(xmlNodeDump(buf, n->doc, copy ? copy : n, 0, true) < 0)
         {
                 NFT_LOG(L_ERROR, "xmlNodeDump() failed");
                 goto _pntb_exit;
@@ -217,6 +574,7 @@ char *nft_prefs_node_to_buffer_minimal(NftPrefs *p, NftPrefsNode * n)
         dump[length] = '\0';
 
 _pntb_exit:
+        xmlFreeNode(copy);
         xmlBufferFree(buf);
 
         return dump;
@@ -245,6 +603,9 @@ char *nft_prefs_node_to_buffer(NftPrefs *p, NftPrefsNode * n)
                 return NULL;
         }
 
+        /* pending values are written as text */
+        _node_index_flush(n);
+
         /* create copy of node */
         NftPrefsNode *copy;
         if(!(copy = xmlCopyNode(n, 1)))
@@ -267,6 +628,10 @@ char *nft_prefs_node_to_buffer(NftPrefs *p, NftPrefsNode * n)
         xmlChar *dump = NULL;
         int length = 0;
 
+        /* write runs of similar nodes as tables */
+        if(!_node_columnar(p, copy))
+                goto _pntbwh_exit;
+
         /* dump document to buffer */
         xmlDocDumpFormatMemoryEnc(d, &dump, &length, "UTF-8", 1);
         if(!dump || length <= 0)
@@ -337,6 +702,9 @@ NftResult nft_prefs_node_to_file(NftPrefs *p, NftPrefsNode * n, const char *file
                 return NFT_FAILURE;
         }
 
+        /* pending values are written as text */
+        _node_index_flush(n);
+
         /* create copy of node */
         NftPrefsNode *copy;
         if(!(copy = xmlCopyNode(n, 1)))
@@ -357,6 +725,10 @@ NftResult nft_prefs_node_to_file(NftPrefs *p, NftPrefsNode * n, const char *file
         /* set node as root element of temporary doc */
         xmlDocSetRootElement(d, copy);
 
+        /* write runs of similar nodes as tables */
+        if(!_node_columnar(p, copy))
+                goto _pntfwh_exit;
+
         /* file already existing? */
         struct stat sts;
         if(stat(filename, &sts) == -1)
@@ -416,6 +788,216 @@ _pntfwh_exit:
 }
 
 
+/**
+ * create compressed preferences file from NftPrefsNode and child nodes
+ *
+ * This will create the same output as nft_prefs_node_to_file() would, but 
+ * compressed while it's written. nft_prefs_node_from_file() detects
+ * compressed files and decompresses them while parsing.
+ *
+ * @param p NftPrefs context
+ * @param n NftPrefsNode
+ * @param filename full path of file to be written ("-" for stdout)
+ * @param overwrite if a file called "filename" already exists, it 
+ * will be overwritten if this is "true", otherwise NFT_FAILURE will be returned 
+ * @param compression compression to use 
+ * (s. nft_prefs_compression_supported())
+ * @param level compression level (higher levels produce smaller files but 
+ * need more CPU time) or -1 to use the default level of the compression
+ * @result NFT_SUCCESS or NFT_FAILURE
+ */
+NftResult nft_prefs_node_to_file_compressed(NftPrefs *p, NftPrefsNode * n,
+                                            const char *filename, bool overwrite,
+                                            NftPrefsCompression compression,
+                                            int level)
+{
+        if(!n || !filename)
+                NFT_LOG_NULL(NFT_FAILURE);
+
+        if(compression == NFT_PREFS_COMPRESSION_NONE)
+                return nft_prefs_node_to_file(p, n, filename, overwrite);
+
+        if(!nft_prefs_compression_supported(compression))
+        {
+                NFT_LOG(L_ERROR, "Compression %d not supported by this build",
+                        compression);
+                return NFT_FAILURE;
+        }
+
+        /* file already existing? */
+        struct stat sts;
+        if(stat(filename, &sts) == -1)
+        {
+                /* continue if stat error was caused because file doesn't exist 
+                 */
+                if(errno != ENOENT)
+                {
+                        NFT_LOG(L_ERROR, "Failed to access \"%s\" - %s",
+                                filename, strerror(errno));
+                        return NFT_FAILURE;
+                }
+        }
+        /* stat succeeded, file exists */
+        else if(strcmp("-", filename) != 0)
+        {
+                /* remove old file? */
+                if(!overwrite)
+                        return NFT_FAILURE;
+
+                /* delete existing file */
+                if(unlink(filename) == -1)
+                {
+                        NFT_LOG(L_ERROR,
+                                "Failed to remove old version of \"%s\" - %s",
+                                filename, strerror(errno));
+                        return NFT_FAILURE;
+                }
+        }
+
+        /* stdout? */
+        int fd;
+        if(strcmp("-", filename) == 0)
+        {
+                fd = STDOUT_FILENO;
+        }
+        /* open file */
+        else
+        {
+#ifdef WIN32
+                if((fd = open(filename,
+                              O_CREAT | O_WRONLY | O_BINARY, S_IRUSR | S_IWUSR)) == -1)
+#else
+                if((fd = open(filename,
+                              O_CREAT | O_WRONLY,
+                              S_IRUSR | S_IWUSR | S_IWGRP | S_IRGRP)) == -1)
+#endif
+                {
+                        NFT_LOG_PERROR("open");
+                        return NFT_FAILURE;
+                }
+        }
+
+        /* create compressor */
+        NftPrefsCompressStream *s;
+        if(!(s = _compress_writer_new(fd, compression, level)))
+        {
+                if(fd != STDOUT_FILENO)
+                        close(fd);
+                return NFT_FAILURE;
+        }
+
+        /* serialize into compressor (the sink closes the file) */
+        NftResult r = nft_prefs_node_to_sink(p, n, _compress_write,
+                                             _compress_writer_close, s);
+
+        if(!_compress_writer_free(s) && r)
+        {
+                NFT_LOG(L_ERROR, "Failed to write compressed file \"%s\"",
+                        filename);
+                r = NFT_FAILURE;
+        }
+
+        return r;
+}
+
+
+/**
+ * stream preferences with headers from NftPrefsNode and child nodes to
+ * an arbitrary sink
+ *
+ * This will create the same output as nft_prefs_node_to_file() would, but 
+ * instead of writing to a file, the serialized data is passed in chunks 
+ * of limited size to the write_cb function. This way preferences can be 
+ * written to sockets, pipes, compressors etc. without holding the complete 
+ * dump in memory.
+ *
+ * @param p NftPrefs context
+ * @param n NftPrefsNode
+ * @param write_cb function that will be called for every chunk of output
+ * @param close_cb function that will be called after the last chunk has 
+ * been written (or NULL)
+ * @param ctx arbitrary pointer that will be passed to write_cb and close_cb
+ * @result NFT_SUCCESS or NFT_FAILURE
+ * @note close_cb is called in any case once the output buffer was created
+ */
+NftResult nft_prefs_node_to_sink(NftPrefs *p, NftPrefsNode * n,
+                                 NftPrefsSinkWriteFunc * write_cb,
+                                 NftPrefsSinkCloseFunc * close_cb, void *ctx)
+{
+        if(!n || !write_cb)
+                NFT_LOG_NULL(NFT_FAILURE);
+
+        /* add prefs version to node */
+        if(!(_updater_node_add_version(p, n)))
+        {
+                NFT_LOG(L_ERROR, "failed to add version to node \"%s\"",
+                        nft_prefs_node_get_name(n));
+                return NFT_FAILURE;
+        }
+
+        /* pending values are written as text */
+        _node_index_flush(n);
+
+        /* create copy of node */
+        NftPrefsNode *copy;
+        if(!(copy = xmlCopyNode(n, 1)))
+                return NFT_FAILURE;
+
+        /* create temp xmlDoc */
+        xmlDoc *d = NULL;
+        if(!(d = xmlNewDoc(BAD_CAST "1.0")))
+        {
+                NFT_LOG(L_ERROR, "Failed to create new XML doc");
+                xmlFreeNode(copy);
+                return NFT_FAILURE;
+        }
+
+        /* overall result */
+        NftResult r = NFT_FAILURE;
+
+        /* set node as root element of temporary doc */
+        xmlDocSetRootElement(d, copy);
+
+        /* write runs of similar nodes as tables */
+        if(!_node_columnar(p, copy))
+                goto _pnts_exit;
+
+        /* create output buffer that writes to our sink */
+        xmlOutputBufferPtr out;
+        if(!(out = xmlOutputBufferCreateIO(write_cb, close_cb, ctx, NULL)))
+        {
+                NFT_LOG(L_ERROR, "Failed to xmlOutputBufferCreateIO()");
+                goto _pnts_exit;
+        }
+
+        /* write document to sink (this also closes the output buffer) */
+        if(xmlSaveFormatFileTo(out, d, "UTF-8", 1) < 0)
+        {
+                NFT_LOG(L_ERROR, "Failed to write XML to sink");
+                goto _pnts_exit;
+        }
+
+        /* successfully written */
+        r = NFT_SUCCESS;
+
+_pnts_exit:
+        if(copy)
+        {
+                /* unlink node from document again */
+                xmlUnlinkNode(copy);
+                xmlFreeNode(copy);
+        }
+
+        /* free temporary xmlDoc */
+        if(d)
+        {
+                xmlFreeDoc(d);
+        }
+
+        return r;
+}
+
+
 /**
  * create preferences file from NftPrefsNode and child nodes
  *
@@ -479,6 +1061,9 @@ NftResult nft_prefs_node_to_file_minimal(NftPrefs *p, NftPrefsNode * n, const ch
                 return r;
         }
 
+        /* pending values are written as text */
+        _node_index_flush(n);
+
         /* create buffer */
         xmlBufferPtr buf;
         if(!(buf = xmlBufferCreate()))
@@ -487,8 +1072,13 @@ NftResult nft_prefs_node_to_file_minimal(NftPrefs *p, NftPrefsNode * n, const ch
                 return r;
         }
 
-        /* dump node */
-        if(xmlNodeDump(buf, n->doc, n, 0, true) < 0)
+        /* dump node (or a copy holding tables) */
+        xmlNode *copy = NULL;
+        if(_prefs_get_columnar(p) &&
+           (!(copy = xmlCopyNode(n, 1)) || !_node_columnar(p, copy)))
+                goto _pntf_exit;
+
+        if(xmlNodeDump(buf, n->doc, copy ? copy : n, 0, true) < 0)
         {
                 NFT_LOG(L_ERROR, "xmlNodeDump() failed");
                 goto _pntf_exit;
@@ -531,6 +1121,7 @@ NftResult nft_prefs_node_to_file_minimal(NftPrefs *p, NftPrefsNode * n, const ch
         r = NFT_SUCCESS;
 
 _pntf_exit:
+        xmlFreeNode(copy);
         xmlBufferFree(buf);
 
         return r;
@@ -543,54 +1134,49 @@ _pntf_exit:
  * @param p NftPrefs context
  * @param filename full path of file
  * @result newly created NftPrefsNode or NULL
+ * @note files written by nft_prefs_node_to_file_compressed() are 
+ * decompressed while they are parsed.
+ * @note if caching is enabled (s. nft_prefs_set_cache()), the parsed tree
+ * is loaded from a valid parse cache of the file.
  */
 NftPrefsNode *nft_prefs_node_from_file(NftPrefs *p, const char *filename)
 {
-        if(!filename)
+        if(!p || !filename)
                 NFT_LOG_NULL(NULL);
 
+        NftPrefsNode *node = NULL;
 
-        /* parse XML */
-        xmlDocPtr doc;
-        if(!(doc = xmlReadFile(filename, NULL, 0)))
-        {
-                NFT_LOG(L_ERROR, "Failed to xmlReadFile(\"%s\")", filename);
-                return NULL;
-        }
-
-        /* parse XInclude stuff */
-        int xinc_res;
-        if((xinc_res = xmlXIncludeProcess(doc)) == -1)
-        {
-                NFT_LOG(L_ERROR, "XInclude parsing failed.");
-                goto _npnff_error;
-        }
-        NFT_LOG(L_DEBUG, "%d XInclude substitutions done", xinc_res);
+        /* try cache first */
+        struct stat sts;
+        bool cache = _prefs_get_cache(p) && stat(filename, &sts) == 0;
+        if(cache && (node = _cache_load(p, filename, &sts)))
+                goto _pnff_exit;
 
+        /* get parser context */
+        xmlParserCtxtPtr ctxt;
+        if(!(ctxt = _prefs_parser_get(p)))
+                goto _pnff_exit;
 
-        /* get node */
-        xmlNode *node;
-        if(!(node = xmlDocGetRootElement(doc)))
+        /* parse XML */
+        xmlDocPtr doc = _compress_read_file(ctxt, filename,
+                                            _prefs_get_parse_options(p));
+        _prefs_parser_put(p, ctxt);
+        if(!doc)
         {
-                NFT_LOG(L_ERROR, "No root element found in XML");
-                goto _npnff_error;
+                NFT_LOG(L_ERROR, "Failed to xmlCtxtReadFile(\"%s\")", filename);
+                goto _pnff_exit;
         }
 
-		/* update node */
-		if(!_updater_node_process(p, node))
-		{
-				NFT_LOG(L_ERROR, "Preference update failed for node \"%s\". This is a fatal bug. Aborting.",
-				        nft_prefs_node_get_name(node));
-				goto _npnff_error;
-		}
-
-		/* return node */
-        return node;
+        /* process document */
+        int xincludes = 0;
+        node = _node_from_doc_ex(p, doc, &xincludes);
 
+        /* update cache (changes of included files couldn't be detected) */
+        if(node && cache && xincludes == 0)
+                _cache_store(p, filename, &sts, node);
 
-_npnff_error:
-		xmlFreeDoc(doc);
-        return NULL;
+_pnff_exit:
+        return _node_tree_finish(p, node);
 }
 
 
@@ -604,48 +1190,31 @@ _npnff_error:
  */
 NftPrefsNode *nft_prefs_node_from_buffer(NftPrefs *p, char *buffer, size_t bufsize)
 {
-        if(!buffer)
+        if(!p || !buffer)
                 NFT_LOG_NULL(NULL);
 
+        NftPrefsNode *node = NULL;
 
-        /* parse XML */
-        xmlDocPtr doc;
-        if(!(doc = xmlReadMemory(buffer, bufsize, NULL, NULL, 0)))
-        {
-                NFT_LOG(L_ERROR, "Failed to xmlReadMemory()");
-                return NULL;
-        }
-
-        /* parse XInclude stuff */
-        int xinc_res;
-        if((xinc_res = xmlXIncludeProcess(doc)) == -1)
-        {
-                NFT_LOG(L_ERROR, "XInclude parsing failed.");
-                goto _npnfb_error;
-        }
-        NFT_LOG(L_DEBUG, "%d XInclude substitutions done", xinc_res);
+        /* get parser context */
+        xmlParserCtxtPtr ctxt;
+        if(!(ctxt = _prefs_parser_get(p)))
+                goto _pnfb_exit;
 
-        /* get node */
-        xmlNode *node;
-        if(!(node = xmlDocGetRootElement(doc)))
-        {
-                NFT_LOG(L_ERROR, "No root element found in XML");
-                goto _npnfb_error;
-        }
-
-        /* update node */
-        if(!_updater_node_process(p, node))
+        /* parse XML */
+        xmlDocPtr doc = xmlCtxtReadMemory(ctxt, buffer, bufsize, NULL, NULL,
+                                          _prefs_get_parse_options(p));
+        _prefs_parser_put(p, ctxt);
+        if(!doc)
         {
-                NFT_LOG(L_ERROR, "Preference update failed for node \"%s\". This is a fatal bug. Aborting.",
-                        nft_prefs_node_get_name(node));
-                goto _npnfb_error;
+                NFT_LOG(L_ERROR, "Failed to xmlCtxtReadMemory()");
+                goto _pnfb_exit;
         }
 
-        return node;
+        /* process document */
+        node = _node_from_doc(p, doc);
 
-_npnfb_error:
-        xmlFreeDoc(doc);
-        return NULL;
+_pnfb_exit:
+        return _node_tree_finish(p, node);
 }
 
 
@@ -655,13 +1224,16 @@ _npnfb_error:
  * @param name the name of the node
  * @result freshly created NftPrefsNode
  * @note use nft_prefs_node_free() if node is not used anymore
-		 */
+ * @note when added to a tree created by nft_prefs_obj_to_node() of a 
+ * context that uses arenas, the node is copied into the arena of that tree 
+ * once the tree is complete (s. nft_prefs_set_arena())
+ */
 NftPrefsNode *nft_prefs_node_alloc(const char *name)
 {
         if(!name)
                 NFT_LOG_NULL(NULL);
 
-        return xmlNewNode(NULL, BAD_CAST name);
+        return _node_alloc(NULL, name);
 }
 
 
@@ -669,26 +1241,72 @@ NftPrefsNode *nft_prefs_node_alloc(const char *name)
  * free resources of a NftPrefsNode
  *
  * @param n NftPrefsNode to free
+ * @note freeing the root node of a tree that was allocated from an arena
+ * releases the whole arena at once (s. nft_prefs_set_arena())
  */
 void nft_prefs_node_free(NftPrefsNode * n)
 {
         if(!n)
                 NFT_LOG_NULL();
 
-        /* save document for later */
-        xmlDoc *doc = n->doc;
+        /* root element is freed together with its document */
+        if(n->doc && (n->parent == (xmlNode *) n->doc))
+        {
+                _arena_doc_free(n->doc);
+                return;
+        }
 
         /* unlink node from doc */
+        _node_index_invalidate(n->parent);
+        _node_index_drop(n);
         xmlUnlinkNode(n);
 
         /* free node */
-        xmlFreeNode(n);
+        _arena_node_free(n);
+}
+
 
-        /* check if node was the last in doc */
-        if(doc && !doc->children)
+/**
+ * free resources of a NftPrefsNode in the background. The node is unlinked 
+ * from its tree immediately and handed to a reclaimer thread of the context.
+ * Trees kept in an arena (s. nft_prefs_set_arena()) are handed over in 
+ * constant time, other trees are walked once to drop their strings of the
+ * dictionary of the context (which must only be used by one thread at a 
+ * time) before the reclaimer frees them.
+ *
+ * @param p NftPrefs context
+ * @param n NftPrefsNode to free (must not be used anymore after this call)
+ * @note all pending nodes are freed before nft_prefs_deinit() returns. If
+ * the reclaimer can't be used, the node is freed synchronously.
+ */
+void nft_prefs_node_free_async(NftPrefs * p, NftPrefsNode * n)
+{
+        if(!p || !n)
+                NFT_LOG_NULL();
+
+        NftPrefsReclaimer *r;
+        if(!(r = _prefs_reclaimer(p)))
         {
-                xmlFreeDoc(doc);
+                NFT_LOG(L_WARNING, "reclaimer unavailable, freeing synchronously");
+                nft_prefs_node_free(n);
+                return;
         }
+
+        /* root element is freed together with its document */
+        if(n->doc && (n->parent == (xmlNode *) n->doc))
+        {
+                if(!_reclaim_push(r, NULL, n->doc))
+                        nft_prefs_node_free(n);
+                return;
+        }
+
+        /* unlink node from doc */
+        _node_index_invalidate(n->parent);
+        _node_index_drop(n);
+        xmlUnlinkNode(n);
+
+        if(!_reclaim_push(r, n, NULL))
+                _arena_node_free(n);
 }
 
 
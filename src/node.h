@@ -0,0 +1,100 @@
+/*
+ * libniftyprefs - lightweight modelless preferences management library
+ * Copyright (C) 2006-2014 Daniel Hiepler <daniel@niftylight.de>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _NODE_H
+#define _NODE_H
+
+
+#include "niftyprefs.h"
+#include "arena.h"
+
+
+/** typed value of a property */
+typedef union
+{
+        int i;
+        long int l;
+        double d;
+        bool b;
+} NftPrefsNodeValue;
+
+
+/** values up to this length are stored in the dictionary of the context */
+#define DICT_VALUE_MAXLEN 8
+
+
+NftPrefsNode *                  _node_alloc(NftPrefs * p, const char *name);
+NftPrefsNode *                  _node_from_doc(NftPrefs * p, xmlDoc * doc);
+NftPrefsNode *                  _node_from_doc_processed(xmlDoc * doc);
+NftPrefsNode *                  _node_tree_finish(NftPrefs * p, NftPrefsNode * n);
+void                            _node_prop_intern(xmlAttr * a, size_t len);
+xmlAttr *                       _node_prop_set(xmlNode * n, const xmlChar * name, const xmlChar * value);
+int                             _node_prop_unset(xmlNode * n, const xmlChar * name);
+void                            _node_prop_flush(xmlNode * n, const xmlChar * name);
+bool                            _node_prop_decode(const NftPrefsPropDesc * d, const char *value, void *dst);
+size_t                          _node_prop_format(NftPrefsPropType type, const NftPrefsNodeValue * value, char *buf);
+NftResult                       _node_binary_encode(NftPrefsNode * n, unsigned char **data, size_t * length);
+NftPrefsNode *                  _node_binary_decode(NftPrefs * p, const unsigned char *data, size_t length, const char *uri, bool process);
+unsigned char *                 _node_binary_read_fd(int fd, size_t * length);
+NftResult                       _node_binary_write_fd(int fd, const unsigned char *data, size_t length);
+void                            _node_index_invalidate(xmlNode * n);
+void                            _node_index_invalidate_props(xmlNode * n);
+xmlAttr *                       _node_index_prop_find(xmlNode * n, const xmlChar * name);
+void                            _node_index_prop_append(xmlNode * n, xmlAttr * a);
+void                            _node_index_prop_remove(xmlNode * n, xmlAttr * a);
+bool                            _node_index_value_get(xmlNode * n, const xmlChar * name, NftPrefsPropType type, void *value);
+void                            _node_index_value_put(xmlNode * n, const xmlChar * name, NftPrefsPropType type, const void *value);
+void                            _node_index_value_drop(xmlNode * n, const xmlChar * name);
+bool                            _node_index_value_defer(xmlNode * n, const xmlChar * name, NftPrefsPropType type, const void *value);
+bool                            _node_index_value_take(xmlNode * n, const xmlChar * name, const xmlChar ** pname, NftPrefsPropType * type, NftPrefsNodeValue * value);
+bool                            _node_index_value_pending(xmlNode * n, const xmlChar * name, NftPrefsPropType * type, NftPrefsNodeValue * value);
+bool                            _node_index_value_next(xmlNode * n, size_t * i, const xmlChar ** name, NftPrefsPropType * type, NftPrefsNodeValue * value);
+bool                            _node_index_value_equal(xmlNode * n, const xmlChar * name, NftPrefsPropType type, const NftPrefsNodeValue * value);
+void                            _node_index_flush(xmlNode * n);
+void                            _node_index_drop(xmlNode * n);
+NftResult                       _node_index_move(xmlNode * n, xmlDoc * to);
+void                            _node_index_rekey(xmlNode * from, xmlNode * to);
+void                            _node_index_free_all(NftPrefsNodeIndexes * t);
+
+
+#endif /** _NODE_H */
@@ -56,9 +56,12 @@
 #include <niftylog.h>
 #include "prefs.h"
 #include "class.h"
+#include "node.h"
 
 
 
+/** nesting depth of nft_prefs_obj_to_node() calls of this thread */
+static __thread unsigned int _depth;
 
 
 
@@ -95,7 +98,7 @@ NftPrefsNode *nft_prefs_obj_to_node(NftPrefs * p, const char *className,
 
         /* find class */
         NftPrefsClass *c;
-        if(!(c = _class_find_by_name(_prefs_classes(p), className)))
+        if(!(c = _class_find_by_name(p, className)))
         {
                 NFT_LOG(L_ERROR, "Unknown prefs class \"%s\"", className);
                 return NULL;
@@ -106,20 +109,40 @@ NftPrefsNode *nft_prefs_obj_to_node(NftPrefs * p, const char *className,
         /* NftPrefsObjSlot os; if((os = _obj_find_by_ptr(c, obj)) < 0) return
          * NULL; NftPrefsObj *o = _obj_get(c, os); */
 
+        /* nested calls create subtrees of the tree of the outermost one */
+        _depth++;
+
         /* new node */
         NftPrefsNode *node;
-        if(!(node = nft_prefs_node_alloc(className)))
-                return NULL;
+        if(!(node = _node_alloc(p, className)))
+                goto _pon_exit;
 
+        /* typed values are formatted when the node is looked at as text */
+        if(_prefs_get_deferred_values(p) &&
+           !nft_prefs_node_set_deferred_values(node, true))
+        {
+                nft_prefs_node_free(node);
+                node = NULL;
+                goto _pon_exit;
+        }
 
-        /* call prefsFromObj() registered for this class */
-        if(!_class_fromObj(c) (p, node, obj, userptr))
+        /* convert struct bound to class or call prefsFromObj() registered 
+           for this class */
+        NftPrefsStruct *s = _class_struct(c);
+        if(s ? !_struct_to_node(p, s, node, obj) :
+           !_class_fromObj(c) (p, node, obj, userptr))
         {
                 NFT_LOG(L_ERROR, "prefsFromObj() of class \"%s\" failed.",
                         className);
-                return NULL;
+                nft_prefs_node_free(node);
+                node = NULL;
         }
 
+_pon_exit:
+        /* tree is complete */
+        if(--_depth == 0)
+                node = _node_tree_finish(p, node);
+
         return node;
 }
 
@@ -138,18 +161,27 @@ void *nft_prefs_obj_from_node(NftPrefs * p, NftPrefsNode * n, void *userptr)
         if(!p || !n)
                 NFT_LOG_NULL(NULL);
 
+        /* resolve lazy XInclude placeholder */
+        if(!(n = _xinclude_expand(n)))
+        {
+                NFT_LOG(L_ERROR, "Included file contains no element");
+                return NULL;
+        }
+
         /* find object class */
         NftPrefsClass *c;
-        if(!
-           (c =
-            _class_find_by_name(_prefs_classes(p),
-                                     (const char *) n->name)))
+        if(!(c = _class_find_by_name(p, (const char *) n->name)))
         {
                 NFT_LOG(L_ERROR, "Unknown prefs class \"%s\"", n->name);
                 return NULL;
         }
 
 
+        /* struct bound to class */
+        NftPrefsStruct *s;
+        if((s = _class_struct(c)))
+                return _struct_from_node(p, s, n);
+
         /* create object from prefs */
         void *result = NULL;
         if(!(_class_toObj(c) (p, &result, n, userptr)))
@@ -0,0 +1,295 @@
+/*
+ * libniftyprefs - lightweight modelless preferences management library
+ * Copyright (C) 2006-2014 Daniel Hiepler <daniel@niftylight.de>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/**
+ * @file parser.c
+ */
+
+/**
+ * @addtogroup prefs_parser
+ * @{
+ *
+ */
+
+#include <unistd.h>
+#include <libxml/parser.h>
+#include <niftylog.h>
+#include "prefs.h"
+#include "node.h"
+
+
+
+/** size of chunks read by nft_prefs_parser_feed_fd() */
+#define FD_CHUNKSIZE 16384
+
+
+
+/** incremental parser descriptor */
+struct _NftPrefsParser
+{
+        /** NftPrefs context this parser belongs to */
+        NftPrefs *prefs;
+        /** libxml2 push-parser context */
+        xmlParserCtxtPtr ctxt;
+        /** true if parsing failed - all further calls will fail */
+        bool failed;
+};
+
+
+
+
+/******************************************************************************/
+/**************************** STATIC FUNCTIONS ********************************/
+/******************************************************************************/
+
+/** pass one chunk to the push parser */
+static NftResult _parse_chunk(NftPrefsParser * parser, const char *chunk,
+                              size_t size, bool terminate)
+{
+        if(parser->failed)
+        {
+                NFT_LOG(L_ERROR, "feeding parser that already failed");
+                return NFT_FAILURE;
+        }
+
+        /* libxml2 takes int sized chunks */
+        do
+        {
+                int len = size > INT_MAX ? INT_MAX : (int) size;
+                bool last = terminate && ((size_t) len == size);
+
+                if(xmlParseChunk(parser->ctxt, chunk, len, last) != 0 ||
+                   !parser->ctxt->wellFormed)
+                {
+                        NFT_LOG(L_ERROR, "Failed to parse chunk");
+                        parser->failed = true;
+                        break;
+                }
+
+                chunk += len;
+                size -= len;
+        }
+        while(size > 0);
+
+        return parser->failed ? NFT_FAILURE : NFT_SUCCESS;
+}
+
+
+
+/******************************************************************************/
+/**************************** API FUNCTIONS ***********************************/
+/******************************************************************************/
+
+/**
+ * create new incremental parser. Chunks of a preferences representation
+ * can be passed to nft_prefs_parser_feed() as soon as they arrive. They are 
+ * parsed immediately, so the complete document never has to be buffered.
+ *
+ * @param p NftPrefs context
+ * @param uri URI the document originates from, used to resolve relative
+ * XIncludes (or NULL)
+ * @result newly created NftPrefsParser or NULL
+ * @note use nft_prefs_parser_finish() to get the resulting node or 
+ * nft_prefs_parser_free() to abort parsing
+ */
+NftPrefsParser *nft_prefs_parser_new(NftPrefs * p, const char *uri)
+{
+        if(!p)
+                NFT_LOG_NULL(NULL);
+
+        NftPrefsParser *parser;
+        if(!(parser = calloc(1, sizeof(NftPrefsParser))))
+        {
+                NFT_LOG_PERROR("calloc");
+                return NULL;
+        }
+
+        /* create push parser, encoding is detected from first chunk */
+        if((parser->ctxt = xmlCreatePushParserCtxt(NULL, NULL, NULL, 0, uri)))
+        {
+                /* share names with all other documents of this context */
+                _prefs_parser_use_dict(p, parser->ctxt);
+
+                /* use same options as nft_prefs_node_from_buffer() */
+                xmlCtxtUseOptions(parser->ctxt, _prefs_get_parse_options(p));
+        }
+
+        if(!parser->ctxt)
+        {
+                NFT_LOG(L_ERROR, "Failed to xmlCreatePushParserCtxt()");
+                free(parser);
+                return NULL;
+        }
+
+        parser->prefs = p;
+
+        return parser;
+}
+
+
+/**
+ * abort parsing and free all resources of a NftPrefsParser
+ *
+ * @param parser NftPrefsParser descriptor
+ */
+void nft_prefs_parser_free(NftPrefsParser * parser)
+{
+        if(!parser)
+                NFT_LOG_NULL();
+
+        if(parser->ctxt->myDoc)
+                xmlFreeDoc(parser->ctxt->myDoc);
+
+        xmlFreeParserCtxt(parser->ctxt);
+        free(parser);
+}
+
+
+/**
+ * feed a chunk of data to an incremental parser
+ *
+ * @param parser NftPrefsParser descriptor
+ * @param chunk buffer holding the next bytes of the document
+ * @param size amount of bytes in chunk
+ * @result NFT_SUCCESS or NFT_FAILURE if the data is not well-formed
+ */
+NftResult nft_prefs_parser_feed(NftPrefsParser * parser, const char *chunk,
+                                size_t size)
+{
+        if(!parser || (!chunk && size))
+                NFT_LOG_NULL(NFT_FAILURE);
+
+        if(size == 0)
+                return NFT_SUCCESS;
+
+        return _parse_chunk(parser, chunk, size, false);
+}
+
+
+/**
+ * feed all data that can currently be read from a file descriptor to an
+ * incremental parser. If the descriptor is non-blocking, this returns
+ * as soon as no more data is available, so it can be called whenever
+ * the descriptor becomes readable in an event loop.
+ *
+ * @param parser NftPrefsParser descriptor
+ * @param fd file descriptor to read from
+ * @param eof will be set to true if end of file was reached (or NULL)
+ * @result NFT_SUCCESS or NFT_FAILURE upon read- or parse-error
+ */
+NftResult nft_prefs_parser_feed_fd(NftPrefsParser * parser, int fd, bool * eof)
+{
+        if(!parser)
+                NFT_LOG_NULL(NFT_FAILURE);
+
+        if(eof)
+                *eof = false;
+
+        char chunk[FD_CHUNKSIZE];
+        for(;;)
+        {
+                ssize_t r;
+                if((r = read(fd, chunk, sizeof(chunk))) < 0)
+                {
+                        /* interrupted - just try again */
+                        if(errno == EINTR)
+                                continue;
+
+                        /* no more data available for now */
+                        if(errno == EAGAIN || errno == EWOULDBLOCK)
+                                return NFT_SUCCESS;
+
+                        NFT_LOG_PERROR("read");
+                        return NFT_FAILURE;
+                }
+
+                /* end of file */
+                if(r == 0)
+                {
+                        if(eof)
+                                *eof = true;
+                        return NFT_SUCCESS;
+                }
+
+                if(!_parse_chunk(parser, chunk, (size_t) r, false))
+                        return NFT_FAILURE;
+        }
+}
+
+
+/**
+ * finish parsing and create NftPrefsNode from all data fed so far. 
+ * The parser is freed in any case.
+ *
+ * @param parser NftPrefsParser descriptor
+ * @result newly created NftPrefsNode or NULL
+ */
+NftPrefsNode *nft_prefs_parser_finish(NftPrefsParser * parser)
+{
+        if(!parser)
+                NFT_LOG_NULL(NULL);
+
+        NftPrefsNode *node = NULL;
+
+        /* terminate parsing */
+        if(!_parse_chunk(parser, NULL, 0, true))
+                goto _ppf_exit;
+
+        /* take over document from parser context */
+        xmlDoc *doc = parser->ctxt->myDoc;
+        parser->ctxt->myDoc = NULL;
+
+        /* process document */
+        node = _node_tree_finish(parser->prefs,
+                                 _node_from_doc(parser->prefs, doc));
+
+_ppf_exit:
+        nft_prefs_parser_free(parser);
+        return node;
+}
+
+
+/**
+ * @}
+ */
@@ -53,13 +53,21 @@
  */
 
 
+#include <pthread.h>
 #include <niftylog.h>
 #include "niftyprefs.h"
 #include "class.h"
+#include "reclaim.h"
+#include "xinclude.h"
+#include "query.h"
 #include "config.h"
 
 
 
+/** maximum amount of idle parser contexts kept for reuse */
+#define PARSER_POOL_SIZE 4
+
+
 
 /** context descriptor */
 struct _NftPrefs
@@ -71,9 +79,65 @@ struct _NftPrefs
             - older versions should always be < than newer versions.
             - versions should increase in steps of 1 */
         unsigned int version;
+        /** NftPrefsParseOption flags used when parsing preferences */
+        int parse_options;
+        /** idle parser contexts that can be reused */
+        xmlParserCtxtPtr parsers[PARSER_POOL_SIZE];
+        /** amount of contexts in parsers */
+        size_t parsers_count;
+        /** dictionary shared by all nodes of this context (names & short 
+            values). Every document using it holds a reference */
+        xmlDictPtr dict;
+        /** true if nodes are allocated from arenas */
+        bool arena;
+        /** background thread for nft_prefs_node_free_async() (or NULL) */
+        NftPrefsReclaimer *reclaimer;
+        /** true if nft_prefs_node_from_file() uses parse caches */
+        bool cache;
+        /** read-locked while files are loaded by nft_prefs_load_many() or 
+            reloads of watched files, write-locked while classes or 
+            updaters are registered */
+        pthread_rwlock_t registry;
+        /** true if files included by preferences files are cached */
+        bool include_cache;
+        /** files included by preferences files (s. 
+            nft_prefs_set_include_cache()) */
+        NftPrefsIncludes *includes;
+        /** true if XInclude elements are resolved when they're accessed */
+        bool lazy_xinclude;
+        /** compiled path queries (s. nft_prefs_node_query()) */
+        NftPrefsQueries *queries;
+        /** true if runs of similar nodes are written as columnar tables */
+        bool columnar;
+        /** true if nodes created from objects defer their values */
+        bool deferred_values;
+        /** unique id of this context (s. _prefs_find()) */
+        unsigned long id;
+        /** next initialized context */
+        NftPrefs *next;
 };
 
 
+/** all initialized contexts */
+static NftPrefs *_contexts;
+/** id of the context that was initialized last */
+static unsigned long _contexts_id;
+/** protects _contexts & _contexts_id */
+static pthread_mutex_t _contexts_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+/** dictionary for documents parsed by a nft_prefs_load_many() worker 
+    thread (NULL if current thread is no worker) */
+static __thread xmlDictPtr _worker_dict;
+/** idle parser context of a nft_prefs_load_many() worker thread */
+static __thread xmlParserCtxtPtr _worker_parser;
+/** current thread loads files while the class registry is read-locked (it
+    would wait for itself if it modified the registry) */
+static __thread unsigned int _registry_reads;
+/** current thread is a worker of nft_prefs_load_many() */
+static __thread bool _worker_shared;
+
+
 
 
 
@@ -130,6 +194,19 @@ static void _xml_error_handler(void *ctx, const char *msg, ...)
 }
 
 
+/** setup libxml2 for the current thread (its settings are thread-local) */
+static void _xml_thread_setup(void)
+{
+        xmlSetBufferAllocationScheme(XML_BUFFER_ALLOC_DOUBLEIT);
+
+        /* register error-logging function */
+        xmlSetGenericErrorFunc(NULL, _xml_error_handler);
+
+        /* needed for indented output */
+        xmlKeepBlanksDefault(0);
+}
+
+
 /** helper for nft_array_foreach_element() */
 static bool _class_free_helper(void *element, void *userptr)
 {
@@ -159,6 +236,289 @@ unsigned int _prefs_get_version(NftPrefs * p)
 }
 
 
+/** getter */
+unsigned long _prefs_get_id(NftPrefs * p)
+{
+        return p->id;
+}
+
+
+/** find context by its id. Returns NULL if it has been deinitialized */
+NftPrefs *_prefs_find(unsigned long id)
+{
+        pthread_mutex_lock(&_contexts_mutex);
+
+        NftPrefs *p;
+        for(p = _contexts; p && p->id != id; p = p->next);
+
+        pthread_mutex_unlock(&_contexts_mutex);
+
+        return p;
+}
+
+
+/** getter */
+int _prefs_get_parse_options(NftPrefs * p)
+{
+        return p->parse_options;
+}
+
+
+/** getter */
+bool _prefs_get_arena(NftPrefs * p)
+{
+        return p->arena;
+}
+
+
+/** getter */
+bool _prefs_get_cache(NftPrefs * p)
+{
+        return p->cache;
+}
+
+
+/** getter */
+bool _prefs_get_include_cache(NftPrefs * p)
+{
+        return p->include_cache;
+}
+
+
+/** getter */
+bool _prefs_get_lazy_xinclude(NftPrefs * p)
+{
+        return p->lazy_xinclude;
+}
+
+
+/** getter */
+bool _prefs_get_columnar(NftPrefs * p)
+{
+        return p && p->columnar;
+}
+
+
+/** getter */
+bool _prefs_get_deferred_values(NftPrefs * p)
+{
+        return p && p->deferred_values;
+}
+
+
+/** getter */
+xmlDictPtr _prefs_dict(NftPrefs * p)
+{
+        return p->dict;
+}
+
+
+/** get dictionary for documents created by the current thread */
+xmlDictPtr _prefs_doc_dict(NftPrefs * p)
+{
+        return _worker_dict ? _worker_dict : p->dict;
+}
+
+
+/** get reclaimer of this context (started on first use) */
+NftPrefsReclaimer *_prefs_reclaimer(NftPrefs * p)
+{
+        if(!p->reclaimer)
+                p->reclaimer = _reclaim_new();
+
+        return p->reclaimer;
+}
+
+
+/** getter */
+NftPrefsIncludes *_prefs_includes(NftPrefs * p)
+{
+        return p->includes;
+}
+
+
+/** getter */
+NftPrefsQueries *_prefs_queries(NftPrefs * p)
+{
+        return p->queries;
+}
+
+
+/** make a parser context use the dictionary of this context */
+void _prefs_parser_use_dict(NftPrefs * p, xmlParserCtxtPtr ctxt)
+{
+        xmlDictPtr dict = _prefs_doc_dict(p);
+        if(ctxt->dict == dict)
+                return;
+
+        xmlDictFree(ctxt->dict);
+        ctxt->dict = dict;
+        xmlDictReference(dict);
+
+        /* the parser compares these by pointer */
+        ctxt->str_xml = xmlDictLookup(dict, BAD_CAST "xml", 3);
+        ctxt->str_xmlns = xmlDictLookup(dict, BAD_CAST "xmlns", 5);
+        ctxt->str_xml_ns = xmlDictLookup(dict, XML_XML_NAMESPACE, 36);
+}
+
+
+/** get a parser context from the pool (or create a new one) */
+xmlParserCtxtPtr _prefs_parser_get(NftPrefs * p)
+{
+        /* workers keep one idle context of their own */
+        if(_worker_dict && _worker_parser)
+        {
+                xmlParserCtxtPtr ctxt = _worker_parser;
+                _worker_parser = NULL;
+                return ctxt;
+        }
+
+        /* reuse idle context */
+        if(p->parsers_count > 0 && !_worker_dict)
+                return p->parsers[--p->parsers_count];
+
+        xmlParserCtxtPtr ctxt;
+        if(!(ctxt = xmlNewParserCtxt()))
+        {
+                NFT_LOG(L_ERROR, "Failed to xmlNewParserCtxt()");
+                return NULL;
+        }
+
+        /* share names with all other documents of this context */
+        _prefs_parser_use_dict(p, ctxt);
+
+        return ctxt;
+}
+
+
+/** return a parser context to the pool (or free it if the pool is full) */
+void _prefs_parser_put(NftPrefs * p, xmlParserCtxtPtr ctxt)
+{
+        if(!ctxt)
+                return;
+
+        if(_worker_dict && !_worker_parser)
+        {
+                xmlCtxtReset(ctxt);
+                _worker_parser = ctxt;
+                return;
+        }
+
+        if(p->parsers_count >= PARSER_POOL_SIZE || _worker_dict)
+        {
+                xmlFreeParserCtxt(ctxt);
+                return;
+        }
+
+        /* clean context for next use */
+        xmlCtxtReset(ctxt);
+        p->parsers[p->parsers_count++] = ctxt;
+}
+
+
+
+/** make current thread a worker that parses files while other threads use 
+    the context. Documents parsed by this thread use a dictionary of their
+    own. If shared is true, that one looks up names in the dictionary of the
+    context first (which therefore must not be modified until the worker 
+    ends, like during nft_prefs_load_many()) */
+NftResult _prefs_worker_begin(NftPrefs * p, bool shared)
+{
+        _xml_thread_setup();
+
+        if(!(_worker_dict = shared ? xmlDictCreateSub(p->dict) : xmlDictCreate()))
+        {
+                NFT_LOG(L_ERROR, "Failed to create dictionary");
+                return NFT_FAILURE;
+        }
+
+        /* shared workers run while the registry is read-locked */
+        if((_worker_shared = shared))
+                _registry_reads++;
+
+        return NFT_SUCCESS;
+}
+
+
+/** check whether current thread is a worker (s. _prefs_worker_begin()) */
+bool _prefs_is_worker(void)
+{
+        return _worker_dict != NULL;
+}
+
+
+/** prepare libxml2 for use by a new thread */
+void _prefs_thread_setup(void)
+{
+        _xml_thread_setup();
+}
+
+
+/** current thread stops being a worker */
+void _prefs_worker_end(NftPrefs * p)
+{
+        if(_worker_parser)
+        {
+                xmlFreeParserCtxt(_worker_parser);
+                _worker_parser = NULL;
+        }
+
+        /* documents keep a reference to the dictionary */
+        xmlDictFree(_worker_dict);
+        _worker_dict = NULL;
+
+        if(_worker_shared)
+                _registry_reads--;
+        _worker_shared = false;
+}
+
+
+/** class registry is read-only until _prefs_batch_end() */
+void _prefs_batch_begin(NftPrefs * p)
+{
+        pthread_rwlock_rdlock(&p->registry);
+        _registry_reads++;
+}
+
+
+/** class registry is writable again */
+void _prefs_batch_end(NftPrefs * p)
+{
+        _registry_reads--;
+        pthread_rwlock_unlock(&p->registry);
+}
+
+
+/** lock class registry to modify it. Waits until other threads finished 
+    loading files (nft_prefs_load_many() or reloads of watched files), 
+    fails if the current thread is loading files itself (e.g. when called 
+    by an updater) */
+NftResult _prefs_registry_lock(NftPrefs * p)
+{
+        if(_registry_reads)
+        {
+                NFT_LOG(L_ERROR, "Classes & updaters can't be modified "
+                        "while files are loaded by the same thread");
+                return NFT_FAILURE;
+        }
+
+        if(pthread_rwlock_wrlock(&p->registry) != 0)
+        {
+                NFT_LOG(L_ERROR, "Failed to lock class registry");
+                return NFT_FAILURE;
+        }
+
+        return NFT_SUCCESS;
+}
+
+
+/** unlock class registry after modifying it */
+void _prefs_registry_unlock(NftPrefs * p)
+{
+        pthread_rwlock_unlock(&p->registry);
+}
+
+
 
 /******************************************************************************/
 /**************************** API FUNCTIONS ***********************************/
@@ -181,13 +541,7 @@ NftPrefs *nft_prefs_init(unsigned int version)
         if(!NFT_PREFS_CHECK_VERSION)
                 return NULL;
 
-        xmlSetBufferAllocationScheme(XML_BUFFER_ALLOC_DOUBLEIT);
-
-        /* register error-logging function */
-        xmlSetGenericErrorFunc(NULL, _xml_error_handler);
-
-        /* needed for indented output */
-        xmlKeepBlanksDefault(0);
+        _xml_thread_setup();
 
         /* allocate new NftPrefs context */
         NftPrefs *p;
@@ -200,21 +554,69 @@ NftPrefs *nft_prefs_init(unsigned int version)
         /* save version */
         p->version = version;
 
+        if(pthread_rwlock_init(&p->registry, NULL) != 0)
+        {
+                NFT_LOG(L_ERROR, "Failed to initialize lock");
+                free(p);
+                return NULL;
+        }
+
+        /* create dictionary for nodes of this context */
+        if(!(p->dict = xmlDictCreate()))
+        {
+                NFT_LOG(L_ERROR, "Failed to create dictionary");
+                pthread_rwlock_destroy(&p->registry);
+                free(p);
+                return NULL;
+        }
+
+        /* create cache for included files */
+        if(!(p->includes = _xinclude_cache_new()))
+        {
+                xmlDictFree(p->dict);
+                pthread_rwlock_destroy(&p->registry);
+                free(p);
+                return NULL;
+        }
+
+        /* create cache for compiled queries */
+        if(!(p->queries = _query_cache_new()))
+        {
+                _xinclude_cache_free(p->includes);
+                xmlDictFree(p->dict);
+                pthread_rwlock_destroy(&p->registry);
+                free(p);
+                return NULL;
+        }
+
         /* allocate array to store classes that will be registered */
         if(!_class_init_array(&p->classes))
         {
                 NFT_LOG(L_ERROR, "Failed to init class array");
+                _query_cache_free(p->queries);
+                _xinclude_cache_free(p->includes);
+                xmlDictFree(p->dict);
+                pthread_rwlock_destroy(&p->registry);
                 free(p);
                 return NULL;
         }
 
+        /* ids are never reused */
+        pthread_mutex_lock(&_contexts_mutex);
+        p->id = ++_contexts_id;
+        p->next = _contexts;
+        _contexts = p;
+        pthread_mutex_unlock(&_contexts_mutex);
+
         return p;
 }
 
 
 /**
  * deinitialize libniftyprefs - call this after doing the last API call to
- * finally clean up
+ * finally clean up. Nodes created by this context stay valid and still have
+ * to be freed with nft_prefs_node_free(). Nodes passed to 
+ * nft_prefs_node_free_async() are freed before this returns.
  *
  * @param p NftPrefs context
  */
@@ -224,12 +626,39 @@ void nft_prefs_deinit(NftPrefs * p)
                 NFT_LOG_NULL();
 
 
+        /* context can't be found by its id anymore */
+        pthread_mutex_lock(&_contexts_mutex);
+        NftPrefs **c;
+        for(c = &_contexts; *c && *c != p; c = &(*c)->next);
+        if(*c)
+                *c = p->next;
+        pthread_mutex_unlock(&_contexts_mutex);
+
         /* free all classes */
         nft_array_foreach_element(&p->classes, _class_free_helper, p);
 
         /* free classes array */
         nft_array_deinit(&p->classes);
 
+        /* wait for nodes that are freed in the background */
+        _reclaim_free(p->reclaimer);
+
+        /* free idle parser contexts */
+        while(p->parsers_count > 0)
+                xmlFreeParserCtxt(p->parsers[--p->parsers_count]);
+
+        /* free cached included files */
+        _xinclude_cache_free(p->includes);
+
+        /* free compiled queries */
+        _query_cache_free(p->queries);
+
+        /* drop reference to dictionary (documents of nodes that still 
+           exist hold references of their own) */
+        xmlDictFree(p->dict);
+
+        pthread_rwlock_destroy(&p->registry);
+
         /* free descriptor */
         free(p);
 
@@ -238,6 +667,269 @@ void nft_prefs_deinit(NftPrefs * p)
 }
 
 
+/**
+ * set options used for parsing preferences in this context. 
+ * Per default no options are set.
+ *
+ * @param p NftPrefs context
+ * @param options NftPrefsParseOption flags ORed together
+ */
+void nft_prefs_set_parse_options(NftPrefs * p, int options)
+{
+        if(!p)
+                NFT_LOG_NULL();
+
+        p->parse_options = options;
+}
+
+
+/**
+ * get options used for parsing preferences in this context
+ *
+ * @param p NftPrefs context
+ * @result NftPrefsParseOption flags ORed together
+ */
+int nft_prefs_get_parse_options(NftPrefs * p)
+{
+        if(!p)
+                NFT_LOG_NULL(0);
+
+        return p->parse_options;
+}
+
+
+/**
+ * keep trees of this context in arenas. Every tree that is parsed or 
+ * created by nft_prefs_obj_to_node() is copied into one block of memory of
+ * its own once it's complete. Freeing the tree with nft_prefs_node_free() 
+ * releases that block at once instead of freeing every node individually.
+ *
+ * @param p NftPrefs context
+ * @param enable true to use arenas, false to use the heap
+ * @result NFT_SUCCESS or NFT_FAILURE
+ * @note nodes & values added to a tree later are allocated from the heap.
+ * Memory of arena nodes that are removed is reclaimed when the whole tree 
+ * is freed, so the arena of a tree never grows. Nodes that are moved to 
+ * another tree keep their arena alive until that tree is freed.
+ * @note trees kept in arenas must only be modified using functions of this
+ * library. libxml2 functions that free or replace parts of a node 
+ * (e.g. xmlSetProp(), xmlFreeNode()) must not be used on them.
+ */
+NftResult nft_prefs_set_arena(NftPrefs * p, bool enable)
+{
+        if(!p)
+                NFT_LOG_NULL(NFT_FAILURE);
+
+        p->arena = enable;
+
+        return NFT_SUCCESS;
+}
+
+
+/**
+ * check whether nodes of this context are allocated from arenas
+ *
+ * @param p NftPrefs context
+ * @result true if arenas are used, false otherwise
+ */
+bool nft_prefs_get_arena(NftPrefs * p)
+{
+        if(!p)
+                NFT_LOG_NULL(false);
+
+        return p->arena;
+}
+
+
+/**
+ * let nft_prefs_node_from_file() keep a parse cache alongside every
+ * preferences file it loads. The cache holds the parsed, XInclude processed
+ * and updated tree in the binary format of nft_prefs_node_to_file_binary()
+ * and is stored as hidden file ".<filename>.cache" in the directory of the
+ * XML file. It is reused as long as path, modification time, size and inode
+ * of the XML file, the version of the context and the parse options match.
+ * Stale or corrupt caches are replaced after a full parse.
+ *
+ * @param p NftPrefs context
+ * @param enable true to use parse caches, false to always parse XML
+ * @note documents that include other files are never cached on disk since 
+ * changes of the included files couldn't be detected. Included files are 
+ * cached in memory instead (s. nft_prefs_set_include_cache()).
+ */
+void nft_prefs_set_cache(NftPrefs * p, bool enable)
+{
+        if(!p)
+                NFT_LOG_NULL();
+
+        p->cache = enable;
+}
+
+
+/**
+ * check whether nft_prefs_node_from_file() uses parse caches
+ *
+ * @param p NftPrefs context
+ * @result true if parse caches are used, false otherwise
+ */
+bool nft_prefs_get_cache(NftPrefs * p)
+{
+        if(!p)
+                NFT_LOG_NULL(false);
+
+        return p->cache;
+}
+
+
+/**
+ * keep files included by preferences files (XInclude) parsed in memory. 
+ * Every included file is parsed once and reused by all documents of this
+ * context as long as its modification time, size and inode don't change. 
+ * Included files that aren't cached yet are parsed concurrently. This is 
+ * independent of the parse caches of nft_prefs_set_cache().
+ *
+ * @param p NftPrefs context
+ * @param enable true to cache included files, false to let libxml2 parse 
+ * them for every inclusion
+ */
+void nft_prefs_set_include_cache(NftPrefs * p, bool enable)
+{
+        if(!p)
+                NFT_LOG_NULL();
+
+        p->include_cache = enable;
+}
+
+
+/**
+ * check whether files included by preferences files are cached
+ *
+ * @param p NftPrefs context
+ * @result true if included files are cached, false otherwise
+ */
+bool nft_prefs_get_include_cache(NftPrefs * p)
+{
+        if(!p)
+                NFT_LOG_NULL(false);
+
+        return p->include_cache;
+}
+
+
+/**
+ * let nft_prefs_node_from_file() & nft_prefs_node_from_buffer() keep 
+ * XInclude elements as placeholders instead of substituting them while 
+ * parsing. A placeholder is resolved the first time it's reached by 
+ * nft_prefs_node_get_first_child(), nft_prefs_node_get_next() or 
+ * nft_prefs_obj_from_node(), so only files that are actually used get 
+ * loaded.
+ *
+ * @param p NftPrefs context
+ * @param enable true to resolve XIncludes on first access, false to 
+ * resolve them while parsing
+ * @note the content of files included lazily is updated from the version
+ * of the document (s. nft_prefs_updater_register()) when it's included. 
+ * Placeholders that were never reached are written as XInclude elements by
+ * nft_prefs_node_to_file() & co. Since traversal may modify the tree, it
+ * must not be traversed by multiple threads at the same time. Placeholders
+ * reached after the context has been deinitialized stay XInclude elements.
+ */
+void nft_prefs_set_lazy_xinclude(NftPrefs * p, bool enable)
+{
+        if(!p)
+                NFT_LOG_NULL();
+
+        p->lazy_xinclude = enable;
+}
+
+
+/**
+ * check whether XInclude elements are resolved on first access
+ *
+ * @param p NftPrefs context
+ * @result true if XIncludes are resolved lazily, false otherwise
+ */
+bool nft_prefs_get_lazy_xinclude(NftPrefs * p)
+{
+        if(!p)
+                NFT_LOG_NULL(false);
+
+        return p->lazy_xinclude;
+}
+
+
+/**
+ * let nft_prefs_node_to_file(), nft_prefs_node_to_buffer() & co. write 
+ * runs of sibling nodes that have the same name and the same set of 
+ * properties (but no children) as one table element holding one packed 
+ * column per property. Tables are expanded to regular nodes again by 
+ * nft_prefs_node_from_file() & nft_prefs_node_from_buffer() regardless of 
+ * this setting.
+ *
+ * @param p NftPrefs context
+ * @param enable true to write columnar tables, false to write every node 
+ * as is
+ * @note files containing tables can't be read by versions of niftyprefs 
+ * that don't know about them
+ */
+void nft_prefs_set_columnar(NftPrefs * p, bool enable)
+{
+        if(!p)
+                NFT_LOG_NULL();
+
+        p->columnar = enable;
+}
+
+
+/**
+ * check whether runs of similar nodes are written as columnar tables
+ *
+ * @param p NftPrefs context
+ * @result true if tables are written, false otherwise
+ */
+bool nft_prefs_get_columnar(NftPrefs * p)
+{
+        if(!p)
+                NFT_LOG_NULL(false);
+
+        return p->columnar;
+}
+
+
+/**
+ * let nodes created by nft_prefs_obj_to_node() keep the values set by 
+ * nft_prefs_node_prop_int_set() & co. in binary form until they're 
+ * serialized, diffed, queried or read as string 
+ * (s. nft_prefs_node_set_deferred_values()). Objects that are converted 
+ * to nodes over and over again (e.g. to take snapshots) don't pay for 
+ * formatting values nobody looks at as text.
+ *
+ * @param p NftPrefs context
+ * @param enable true to defer values, false to format them when they're set
+ */
+void nft_prefs_set_deferred_values(NftPrefs * p, bool enable)
+{
+        if(!p)
+                NFT_LOG_NULL();
+
+        p->deferred_values = enable;
+}
+
+
+/**
+ * check whether nodes created from objects defer their values
+ *
+ * @param p NftPrefs context
+ * @result true if values are deferred, false otherwise
+ */
+bool nft_prefs_get_deferred_values(NftPrefs * p)
+{
+        if(!p)
+                NFT_LOG_NULL(false);
+
+        return p->deferred_values;
+}
+
+
 /**
  * wrapper for xmlFree()
  *
@@ -46,10 +46,38 @@
 
 
 #include "niftyprefs.h"
+#include "reclaim.h"
+#include "xinclude.h"
+#include "query.h"
 
 
 NftPrefsClasses *               _prefs_classes(NftPrefs * p);
 unsigned int                    _prefs_get_version(NftPrefs * p);
+unsigned long                   _prefs_get_id(NftPrefs * p);
+NftPrefs *                      _prefs_find(unsigned long id);
+int                             _prefs_get_parse_options(NftPrefs * p);
+bool                            _prefs_get_arena(NftPrefs * p);
+bool                            _prefs_get_cache(NftPrefs * p);
+bool                            _prefs_get_include_cache(NftPrefs * p);
+bool                            _prefs_get_lazy_xinclude(NftPrefs * p);
+bool                            _prefs_get_columnar(NftPrefs * p);
+bool                            _prefs_get_deferred_values(NftPrefs * p);
+xmlDictPtr                      _prefs_dict(NftPrefs * p);
+xmlDictPtr                      _prefs_doc_dict(NftPrefs * p);
+void                            _prefs_parser_use_dict(NftPrefs * p, xmlParserCtxtPtr ctxt);
+xmlParserCtxtPtr                _prefs_parser_get(NftPrefs * p);
+NftPrefsReclaimer *             _prefs_reclaimer(NftPrefs * p);
+NftPrefsIncludes *              _prefs_includes(NftPrefs * p);
+NftPrefsQueries *               _prefs_queries(NftPrefs * p);
+void                            _prefs_parser_put(NftPrefs * p, xmlParserCtxtPtr ctxt);
+NftResult                       _prefs_worker_begin(NftPrefs * p, bool shared);
+void                            _prefs_worker_end(NftPrefs * p);
+bool                            _prefs_is_worker(void);
+void                            _prefs_thread_setup(void);
+void                            _prefs_batch_begin(NftPrefs * p);
+void                            _prefs_batch_end(NftPrefs * p);
+NftResult                       _prefs_registry_lock(NftPrefs * p);
+void                            _prefs_registry_unlock(NftPrefs * p);
 
 
 #endif /** _PREFS_H */
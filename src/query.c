@@ -0,0 +1,615 @@
+/*
+ * libniftyprefs - lightweight modelless preferences management library
+ * Copyright (C) 2006-2014 Daniel Hiepler <daniel@niftylight.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/**
+ * @file query.c
+ *
+ * path queries. Expressions are compiled once into a list of steps and kept
+ * in a cache of the context, so repeated queries only walk the tree: every
+ * step is a loop over the element children of the previous match.
+ */
+
+/**
+ * @addtogroup prefs_query
+ * @{
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <libxml/hash.h>
+#include <niftylog.h>
+#include "prefs.h"
+#include "node.h"
+#include "query.h"
+
+
+
+/** maximum amount of predicates of one step */
+#define QUERY_MAX_PREDICATES    8
+/** maximum amount of compiled queries cached by a context */
+#define QUERY_CACHE_SIZE        256
+
+
+/** kind of predicate */
+typedef enum
+{
+        /** [@prop] */
+        PREDICATE_HAS_PROP,
+        /** [@prop='value'] */
+        PREDICATE_PROP_EQUALS,
+        /** [n] */
+        PREDICATE_POSITION,
+} QueryPredicateType;
+
+
+/** one predicate of a step */
+typedef struct
+{
+        QueryPredicateType type;
+        /** name of property */
+        xmlChar *name;
+        /** value of property (PREDICATE_PROP_EQUALS) */
+        xmlChar *value;
+        /** position (PREDICATE_POSITION) */
+        size_t position;
+} QueryPredicate;
+
+
+/** one step of a path */
+typedef struct
+{
+        /** name of node (NULL matches any node) */
+        xmlChar *name;
+        /** predicates in order */
+        QueryPredicate predicates[QUERY_MAX_PREDICATES];
+        /** amount of predicates */
+        size_t count;
+} QueryStep;
+
+
+/** compiled path */
+typedef struct
+{
+        /** steps (the first one matches the root of the query) */
+        QueryStep *steps;
+        /** amount of steps */
+        size_t length;
+        /** property selected by the path (or NULL) */
+        xmlChar *prop;
+        /** reference count (one reference is held by the cache) */
+        int refs;
+} Query;
+
+
+/** cache of compiled queries */
+struct _NftPrefsQueries
+{
+        pthread_mutex_t mutex;
+        /** Query entries by expression */
+        xmlHashTablePtr queries;
+};
+
+
+
+
+/******************************************************************************/
+/**************************** STATIC FUNCTIONS ********************************/
+/******************************************************************************/
+
+/** free compiled query */
+static void _free(Query * q)
+{
+        for(size_t i = 0; i < q->length; i++)
+        {
+                QueryStep *step = &q->steps[i];
+                xmlFree(step->name);
+                for(size_t k = 0; k < step->count; k++)
+                {
+                        xmlFree(step->predicates[k].name);
+                        xmlFree(step->predicates[k].value);
+                }
+        }
+
+        xmlFree(q->prop);
+        free(q->steps);
+        free(q);
+}
+
+
+/** drop reference to compiled query */
+static void _release(Query * q)
+{
+        if(__atomic_sub_fetch(&q->refs, 1, __ATOMIC_ACQ_REL) == 0)
+                _free(q);
+}
+
+
+/** xmlHashDeallocator */
+static void _dealloc(void *payload, const xmlChar * name)
+{
+        _release(payload);
+}
+
+
+/** skip whitespace */
+static void _spaces(const char **s)
+{
+        while(**s == ' ' || **s == '\t')
+                (*s)++;
+}
+
+
+/** parse name */
+static xmlChar *_name(const char **s)
+{
+        const char *start = *s;
+        while(**s && !strchr("/[]@=*'\" \t", **s))
+                (*s)++;
+
+        if(*s == start)
+                return NULL;
+
+        return xmlStrndup(BAD_CAST start, (int) (*s - start));
+}
+
+
+/** parse quoted string */
+static xmlChar *_literal(const char **s)
+{
+        char quote = **s;
+        if(quote != '\'' && quote != '"')
+                return NULL;
+
+        const char *start = ++(*s);
+        const char *end;
+        if(!(end = strchr(start, quote)))
+                return NULL;
+
+        *s = end + 1;
+        return xmlStrndup(BAD_CAST start, (int) (end - start));
+}
+
+
+/** parse predicate (after the opening bracket) */
+static NftResult _predicate(const char **s, QueryPredicate * pr)
+{
+        _spaces(s);
+
+        if(**s == '@')
+        {
+                (*s)++;
+                if(!(pr->name = _name(s)))
+                        return NFT_FAILURE;
+
+                _spaces(s);
+                pr->type = PREDICATE_HAS_PROP;
+                if(**s == '=')
+                {
+                        (*s)++;
+                        _spaces(s);
+                        if(!(pr->value = _literal(s)))
+                                return NFT_FAILURE;
+                        pr->type = PREDICATE_PROP_EQUALS;
+                }
+        }
+        else
+        {
+                /* digits only (strtoul() would also take a sign or more 
+                   whitespace and wrap negative numbers) */
+                if(**s < '0' || **s > '9')
+                        return NFT_FAILURE;
+
+                char *end;
+                errno = 0;
+                unsigned long position = strtoul(*s, &end, 10);
+                if(errno == ERANGE || position == 0)
+                        return NFT_FAILURE;
+
+                *s = end;
+                pr->type = PREDICATE_POSITION;
+                pr->position = (size_t) position;
+        }
+
+        _spaces(s);
+        if(**s != ']')
+                return NFT_FAILURE;
+
+        (*s)++;
+        return NFT_SUCCESS;
+}
+
+
+/** compile path */
+static Query *_compile(const char *path)
+{
+        Query *q;
+        if(!(q = calloc(1, sizeof(Query))))
+        {
+                NFT_LOG_PERROR("calloc");
+                return NULL;
+        }
+        q->refs = 1;
+
+        /* path has at most one step more than slashes */
+        size_t size = 1;
+        for(const char *c = path; *c; c++)
+        {
+                if(*c == '/')
+                        size++;
+        }
+        if(!(q->steps = calloc(size, sizeof(QueryStep))))
+        {
+                NFT_LOG_PERROR("calloc");
+                free(q);
+                return NULL;
+        }
+
+        const char *s = path;
+        if(*s == '/')
+                s++;
+
+        while(*s)
+        {
+                /* selected property */
+                if(*s == '@')
+                {
+                        s++;
+                        if(!(q->prop = _name(&s)) || *s)
+                                goto _c_error;
+                        break;
+                }
+
+                QueryStep *step = &q->steps[q->length++];
+                if(*s == '*')
+                        s++;
+                else if(!(step->name = _name(&s)))
+                        goto _c_error;
+
+                while(*s == '[')
+                {
+                        s++;
+                        if(step->count == QUERY_MAX_PREDICATES ||
+                           !_predicate(&s, &step->predicates[step->count++]))
+                                goto _c_error;
+                }
+
+                /* steps are separated by slashes */
+                if(*s == '\0')
+                        break;
+                if(*s != '/' || *(++s) == '\0')
+                        goto _c_error;
+        }
+
+        return q;
+
+_c_error:
+        NFT_LOG(L_ERROR, "Invalid path \"%s\" (at position %td)", path, s - path);
+        _free(q);
+        return NULL;
+}
+
+
+/** get compiled query from cache (or compile & cache it) */
+static Query *_get(NftPrefs * p, const char *path)
+{
+        NftPrefsQueries *c = _prefs_queries(p);
+
+        pthread_mutex_lock(&c->mutex);
+        Query *q;
+        if((q = xmlHashLookup(c->queries, BAD_CAST path)))
+        {
+                __atomic_add_fetch(&q->refs, 1, __ATOMIC_RELAXED);
+                pthread_mutex_unlock(&c->mutex);
+                return q;
+        }
+        pthread_mutex_unlock(&c->mutex);
+
+        if(!(q = _compile(path)))
+                return NULL;
+
+        pthread_mutex_lock(&c->mutex);
+
+        /* start over once the cache is full (queries in use are freed when 
+           they're released) */
+        if(xmlHashSize(c->queries) >= QUERY_CACHE_SIZE)
+        {
+                xmlHashFree(c->queries, _dealloc);
+                if(!(c->queries = xmlHashCreate(QUERY_CACHE_SIZE)))
+                {
+                        NFT_LOG(L_ERROR, "Failed to create hashtable");
+                        pthread_mutex_unlock(&c->mutex);
+                        return q;
+                }
+        }
+
+        /* keep a reference for the cache (unless another thread was faster) */
+        if(xmlHashAddEntry(c->queries, BAD_CAST path, q) == 0)
+                __atomic_add_fetch(&q->refs, 1, __ATOMIC_RELAXED);
+
+        pthread_mutex_unlock(&c->mutex);
+
+        return q;
+}
+
+
+/** check whether property has a certain value */
+static bool _prop_equals(xmlAttr * a, const xmlChar * value)
+{
+        xmlNode *t = a->children;
+        if(!t)
+                return *value == '\0';
+        if(!t->next && t->type == XML_TEXT_NODE)
+                return xmlStrEqual(t->content, value);
+
+        xmlChar *v = xmlNodeListGetString(a->doc, t, 1);
+        bool result = xmlStrEqual(v, value);
+        xmlFree(v);
+        return result;
+}
+
+
+/** check whether node matches step. counters hold the amount of nodes 
+    that passed every positional predicate so far */
+static bool _matches(QueryStep * step, xmlNode * n, size_t * counters)
+{
+        if(step->name && !xmlStrEqual(n->name, step->name))
+                return false;
+
+        for(size_t k = 0; k < step->count; k++)
+        {
+                QueryPredicate *pr = &step->predicates[k];
+                xmlAttr *a;
+                switch (pr->type)
+                {
+                        case PREDICATE_HAS_PROP:
+                                if(!xmlHasProp(n, pr->name))
+                                        return false;
+                                break;
+
+                        case PREDICATE_PROP_EQUALS:
+                                if(!(a = xmlHasProp(n, pr->name)) ||
+                                   !_prop_equals(a, pr->value))
+                                        return false;
+                                break;
+
+                        case PREDICATE_POSITION:
+                                if(++counters[k] != pr->position)
+                                        return false;
+                                break;
+                }
+        }
+
+        return true;
+}
+
+
+/** check whether a positional predicate can't match anymore */
+static bool _exhausted(QueryStep * step, size_t * counters)
+{
+        for(size_t k = 0; k < step->count; k++)
+        {
+                if(step->predicates[k].type == PREDICATE_POSITION &&
+                   counters[k] >= step->predicates[k].position)
+                        return true;
+        }
+
+        return false;
+}
+
+
+/** check whether node is a result of the query */
+static bool _result(Query * q, xmlNode * n)
+{
+        return !q->prop || xmlHasProp(n, q->prop);
+}
+
+
+/** find first child of n matching step i (and all steps after it) */
+static xmlNode *_walk(Query * q, size_t i, xmlNode * n)
+{
+        QueryStep *step = &q->steps[i];
+        size_t counters[QUERY_MAX_PREDICATES] = { 0 };
+
+        for(xmlNode * c = nft_prefs_node_get_first_child(n); c;
+            c = nft_prefs_node_get_next(c))
+        {
+                if(_matches(step, c, counters))
+                {
+                        xmlNode *r;
+                        if(i + 1 == q->length)
+                                r = _result(q, c) ? c : NULL;
+                        else
+                                r = _walk(q, i + 1, c);
+
+                        if(r)
+                                return r;
+                }
+
+                if(_exhausted(step, counters))
+                        break;
+        }
+
+        return NULL;
+}
+
+
+/** find first node matching query */
+static xmlNode *_evaluate(Query * q, xmlNode * root)
+{
+        if(q->length == 0)
+                return _result(q, root) ? root : NULL;
+
+        size_t counters[QUERY_MAX_PREDICATES] = { 0 };
+        if(!_matches(&q->steps[0], root, counters))
+                return NULL;
+
+        if(q->length == 1)
+                return _result(q, root) ? root : NULL;
+
+        return _walk(q, 1, root);
+}
+
+
+
+/******************************************************************************/
+/**************************** PRIVATE FUNCTIONS *******************************/
+/******************************************************************************/
+
+/** create empty query cache */
+NftPrefsQueries *_query_cache_new(void)
+{
+        NftPrefsQueries *c;
+        if(!(c = calloc(1, sizeof(NftPrefsQueries))))
+        {
+                NFT_LOG_PERROR("calloc");
+                return NULL;
+        }
+
+        if(pthread_mutex_init(&c->mutex, NULL) != 0)
+        {
+                NFT_LOG(L_ERROR, "Failed to initialize mutex");
+                free(c);
+                return NULL;
+        }
+
+        if(!(c->queries = xmlHashCreate(16)))
+        {
+                NFT_LOG(L_ERROR, "Failed to create hashtable");
+                pthread_mutex_destroy(&c->mutex);
+                free(c);
+                return NULL;
+        }
+
+        return c;
+}
+
+
+/** free query cache and all compiled queries */
+void _query_cache_free(NftPrefsQueries * c)
+{
+        if(!c)
+                return;
+
+        if(c->queries)
+                xmlHashFree(c->queries, _dealloc);
+        pthread_mutex_destroy(&c->mutex);
+        free(c);
+}
+
+
+
+/******************************************************************************/
+/**************************** API FUNCTIONS ***********************************/
+/******************************************************************************/
+
+/**
+ * find first node matching a path (s. @ref prefs_query). If the path
+ * selects a property, the node carrying that property is returned.
+ *
+ * @param p NftPrefs context (caches the compiled path)
+ * @param root node the first step of the path has to match
+ * @param path path expression, e.g. "people/person[@name='Bob']"
+ * @result first matching node or NULL
+ */
+NftPrefsNode *nft_prefs_node_query_node(NftPrefs * p, NftPrefsNode * root,
+                                        const char *path)
+{
+        if(!p || !root || !path)
+                NFT_LOG_NULL(NULL);
+
+        Query *q;
+        if(!(q = _get(p, path)))
+                return NULL;
+
+        /* predicates compare pending values as text */
+        _node_index_flush(root);
+
+        xmlNode *n = _evaluate(q, root);
+        _release(q);
+
+        return n;
+}
+
+
+/**
+ * get value of first match of a path (s. @ref prefs_query)
+ *
+ * @param p NftPrefs context (caches the compiled path)
+ * @param root node the first step of the path has to match
+ * @param path path expression, e.g. "people/person[@name='Bob']/@age"
+ * @result value of selected property (or text content of selected node) 
+ * or NULL if nothing matched. Use nft_prefs_free() to free it.
+ */
+char *nft_prefs_node_query(NftPrefs * p, NftPrefsNode * root, const char *path)
+{
+        if(!p || !root || !path)
+                NFT_LOG_NULL(NULL);
+
+        Query *q;
+        if(!(q = _get(p, path)))
+                return NULL;
+
+        /* predicates compare pending values as text */
+        _node_index_flush(root);
+
+        char *result = NULL;
+        xmlNode *n;
+        if((n = _evaluate(q, root)))
+        {
+                if(q->prop)
+                        result = (char *) xmlGetProp(n, q->prop);
+                else
+                        result = (char *) xmlNodeGetContent(n);
+        }
+        _release(q);
+
+        return result;
+}
+
+
+/**
+ * @}
+ */
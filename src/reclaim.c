@@ -0,0 +1,246 @@
+/*
+ * libniftyprefs - lightweight modelless preferences management library
+ * Copyright (C) 2006-2014 Daniel Hiepler <daniel@niftylight.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/**
+ * @file reclaim.c
+ */
+
+/**
+ * @addtogroup prefs_node
+ * @{
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <niftylog.h>
+#include "reclaim.h"
+#include "arena.h"
+
+
+
+/** one node or document waiting to be freed */
+typedef struct _ReclaimItem
+{
+        /** next item in queue */
+        struct _ReclaimItem *next;
+        /** unlinked node to free (or NULL) */
+        xmlNode *node;
+        /** document to free (or NULL) */
+        xmlDoc *doc;
+} ReclaimItem;
+
+
+/** reclaimer descriptor */
+struct _NftPrefsReclaimer
+{
+        /** background thread */
+        pthread_t thread;
+        /** protects everything below */
+        pthread_mutex_t mutex;
+        /** signalled when items are queued or thread should stop */
+        pthread_cond_t cond;
+        /** items waiting to be freed (oldest first) */
+        ReclaimItem *head;
+        /** last item in queue */
+        ReclaimItem *tail;
+        /** true if thread should terminate after freeing all items */
+        bool stop;
+};
+
+
+
+
+/******************************************************************************/
+/**************************** STATIC FUNCTIONS ********************************/
+/******************************************************************************/
+
+/** background thread */
+static void *_reclaim_thread(void *arg)
+{
+        NftPrefsReclaimer *r = arg;
+
+        pthread_mutex_lock(&r->mutex);
+        for(;;)
+        {
+                while(!r->head && !r->stop)
+                        pthread_cond_wait(&r->cond, &r->mutex);
+
+                if(!r->head)
+                        break;
+
+                /* take whole queue */
+                ReclaimItem *i = r->head;
+                r->head = r->tail = NULL;
+                pthread_mutex_unlock(&r->mutex);
+
+                /* items were detached by _reclaim_push(), so freeing them 
+                   doesn't use the dictionary or ID table of their documents,
+                   which other threads may still modify */
+                while(i)
+                {
+                        ReclaimItem *next = i->next;
+
+                        if(i->node)
+                        {
+                                /* document was held by _reclaim_push() */
+                                xmlDoc *doc = i->node->doc;
+                                _arena_node_free_detached(i->node);
+                                if(doc)
+                                        _arena_doc_release(doc);
+                        }
+                        if(i->doc)
+                                _arena_doc_free(i->doc);
+
+                        free(i);
+                        i = next;
+                }
+
+                pthread_mutex_lock(&r->mutex);
+        }
+        pthread_mutex_unlock(&r->mutex);
+
+        return NULL;
+}
+
+
+
+/******************************************************************************/
+/**************************** PRIVATE FUNCTIONS *******************************/
+/******************************************************************************/
+
+/** create reclaimer & start its thread */
+NftPrefsReclaimer *_reclaim_new(void)
+{
+        NftPrefsReclaimer *r;
+        if(!(r = calloc(1, sizeof(NftPrefsReclaimer))))
+        {
+                NFT_LOG_PERROR("calloc");
+                return NULL;
+        }
+
+        pthread_mutex_init(&r->mutex, NULL);
+        pthread_cond_init(&r->cond, NULL);
+
+        int err;
+        if((err = pthread_create(&r->thread, NULL, _reclaim_thread, r)) != 0)
+        {
+                NFT_LOG(L_ERROR, "Failed to create reclaimer thread: %s",
+                        strerror(err));
+                pthread_cond_destroy(&r->cond);
+                pthread_mutex_destroy(&r->mutex);
+                free(r);
+                return NULL;
+        }
+
+        return r;
+}
+
+
+/** free everything that is still queued, stop thread & free reclaimer */
+void _reclaim_free(NftPrefsReclaimer * r)
+{
+        if(!r)
+                return;
+
+        pthread_mutex_lock(&r->mutex);
+        r->stop = true;
+        pthread_cond_signal(&r->cond);
+        pthread_mutex_unlock(&r->mutex);
+
+        pthread_join(r->thread, NULL);
+
+        pthread_cond_destroy(&r->cond);
+        pthread_mutex_destroy(&r->mutex);
+        free(r);
+}
+
+
+/** queue an unlinked node and/or a document to be freed in the background */
+NftResult _reclaim_push(NftPrefsReclaimer * r, xmlNode * n, xmlDoc * doc)
+{
+        /* nodes that are kept in an arena are released with it */
+        if(n && !_arena_node_detach(n))
+                n = NULL;
+        if(doc)
+                _arena_doc_detach(doc);
+
+        if(!n && !doc)
+                return NFT_SUCCESS;
+
+        ReclaimItem *i;
+        if(!(i = malloc(sizeof(ReclaimItem))))
+        {
+                NFT_LOG_PERROR("malloc");
+                return NFT_FAILURE;
+        }
+
+        /* document of node must exist until node is freed */
+        if(n && n->doc && !_arena_doc_hold(n->doc))
+        {
+                free(i);
+                return NFT_FAILURE;
+        }
+
+        i->next = NULL;
+        i->node = n;
+        i->doc = doc;
+
+        pthread_mutex_lock(&r->mutex);
+        if(r->tail)
+                r->tail->next = i;
+        else
+                r->head = i;
+        r->tail = i;
+        pthread_cond_signal(&r->cond);
+        pthread_mutex_unlock(&r->mutex);
+
+        return NFT_SUCCESS;
+}
+
+
+/**
+ * @}
+ */
@@ -0,0 +1,626 @@
+/*
+ * libniftyprefs - lightweight modelless preferences management library
+ * Copyright (C) 2006-2014 Daniel Hiepler <daniel@niftylight.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/**
+ * @file struct.c
+ *
+ * classes bound to structs (s. nft_prefs_class_register_struct()). The 
+ * descriptors of a struct are compiled when its class is registered: 
+ * members stored as properties become one table that is processed by 
+ * nft_prefs_node_props_get() & nft_prefs_node_props_set(), their defaults 
+ * become a struct every new object starts as (one copy instead of decoding
+ * defaults member by member). Nested structs & arrays of structs are stored
+ * as child nodes of their own class. The bindings of those classes are 
+ * looked up when classes are registered or unregistered (in any order), 
+ * not per converted object.
+ */
+
+/**
+ * @addtogroup prefs_class
+ * @{
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <niftylog.h>
+#include "prefs.h"
+#include "class.h"
+#include "node.h"
+#include "xinclude.h"
+
+
+/** no nested member for child */
+#define NO_MEMBER ((size_t) -1)
+
+
+/** binding of a struct to the nodes of a class */
+struct _NftPrefsStruct
+{
+        /** size of struct */
+        size_t size;
+        /** struct holding the defaults of all members */
+        void *defaults;
+        /** members stored as properties (defaults that are part of 
+            NftPrefsStruct.defaults are removed) */
+        NftPrefsPropDesc *props;
+        /** amount of properties */
+        size_t props_count;
+        /** nested structs & arrays */
+        NftPrefsFieldDesc *nested;
+        /** amount of nested members */
+        size_t nested_count;
+        /** bindings of the classes of nested members (NULL while a class 
+            isn't registered or isn't bound to a struct) */
+        NftPrefsStruct **classes;
+};
+
+
+
+
+/******************************************************************************/
+/**************************** STATIC FUNCTIONS ********************************/
+/******************************************************************************/
+
+/** size of member of type (0 for char arrays of any size) */
+static size_t _member_size(NftPrefsPropType type)
+{
+        switch (type)
+        {
+                case NFT_PREFS_PROP_STRING:
+                        return 0;
+                case NFT_PREFS_PROP_STRING_ALLOC:
+                        return sizeof(char *);
+                case NFT_PREFS_PROP_INT:
+                        return sizeof(int);
+                case NFT_PREFS_PROP_LONG_INT:
+                        return sizeof(long int);
+                case NFT_PREFS_PROP_DOUBLE:
+                        return sizeof(double);
+                case NFT_PREFS_PROP_BOOLEAN:
+                        return sizeof(bool);
+        }
+
+        return NO_MEMBER;
+}
+
+
+/** check descriptor of one member */
+static bool _check(const char *className, size_t size,
+                   const NftPrefsFieldDesc * f)
+{
+        const NftPrefsPropDesc *d = &f->prop;
+        if(d->offset > size || d->size > size - d->offset)
+        {
+                NFT_LOG(L_ERROR, "member of class \"%s\" exceeds struct "
+                        "(offset %zu, size %zu)", className, d->offset, d->size);
+                return false;
+        }
+
+        if(f->kind == NFT_PREFS_FIELD_PROP)
+        {
+                size_t expected = _member_size(d->type);
+                if(!d->name || !*d->name || expected == NO_MEMBER ||
+                   (expected ? d->size != expected : d->size == 0))
+                {
+                        NFT_LOG(L_ERROR, "invalid descriptor of member \"%s\" "
+                                "of class \"%s\"", d->name ? d->name : "",
+                                className);
+                        return false;
+                }
+
+                return true;
+        }
+
+        if(f->kind != NFT_PREFS_FIELD_CHILD && f->kind != NFT_PREFS_FIELD_ARRAY)
+        {
+                NFT_LOG(L_ERROR, "unknown kind of member in class \"%s\"",
+                        className);
+                return false;
+        }
+
+        if(!f->child || !*f->child)
+        {
+                NFT_LOG(L_ERROR, "nested member of class \"%s\" has no class",
+                        className);
+                return false;
+        }
+
+        if(f->kind == NFT_PREFS_FIELD_ARRAY &&
+           (d->size != sizeof(void *) || f->count > size ||
+            sizeof(size_t) > size - f->count))
+        {
+                NFT_LOG(L_ERROR, "invalid array of <%s> in class \"%s\"",
+                        f->child, className);
+                return false;
+        }
+
+        return true;
+}
+
+
+/** copy string of descriptor (if any) */
+static bool _copy(const char **dst, const char *src)
+{
+        if(src && !(*dst = strdup(src)))
+        {
+                NFT_LOG_PERROR("strdup");
+                return false;
+        }
+
+        return true;
+}
+
+
+/** binding of class of nested member i */
+static NftPrefsStruct *_child(NftPrefsStruct * s, size_t i)
+{
+        if(!s->classes[i])
+                NFT_LOG(L_ERROR, "class \"%s\" of nested member isn't bound "
+                        "to a struct", s->nested[i].child);
+
+        return s->classes[i];
+}
+
+
+/** create child node from nested struct */
+static NftResult _child_to_node(NftPrefs * p, NftPrefsNode * n,
+                                const char *className, const void *obj)
+{
+        NftPrefsNode *c;
+        if(!(c = nft_prefs_obj_to_node(p, className, (void *) obj, NULL)))
+                return NFT_FAILURE;
+
+        if(!nft_prefs_node_add_child(n, c))
+        {
+                nft_prefs_node_free(c);
+                return NFT_FAILURE;
+        }
+
+        return NFT_SUCCESS;
+}
+
+
+/** nested member a child belongs to. Nested members of the same class take
+    one child each (in order), arrays take all remaining ones. taken holds 
+    the amount of children every member took so far */
+static size_t _member(NftPrefsStruct * s, const size_t taken[],
+                      const xmlChar * name)
+{
+        for(size_t i = 0; i < s->nested_count; i++)
+        {
+                const NftPrefsFieldDesc *f = &s->nested[i];
+                if(strcmp((const char *) name, f->child) != 0)
+                        continue;
+
+                if(f->kind == NFT_PREFS_FIELD_ARRAY || !taken[i])
+                        return i;
+        }
+
+        return NO_MEMBER;
+}
+
+
+/** fill struct from node. Upon failure, everything allocated for the 
+    struct is freed again */
+static NftResult _decode(NftPrefs * p, NftPrefsStruct * s, xmlNode * n,
+                         char *obj)
+{
+        /* defaults of all members in one copy */
+        memcpy(obj, s->defaults, s->size);
+
+        /* members stored as properties (missing or invalid ones keep their
+           defaults) */
+        for(size_t i = 0; i < s->props_count; i += NFT_PREFS_PROPS_MAX)
+        {
+                size_t count = s->props_count - i;
+                if(count > NFT_PREFS_PROPS_MAX)
+                        count = NFT_PREFS_PROPS_MAX;
+                nft_prefs_node_props_get(n, &s->props[i], count, obj);
+        }
+
+        if(!s->nested_count)
+                return NFT_SUCCESS;
+
+        /* classes of nested members, nested structs start as defaults of 
+           their class, arrays as empty arrays */
+        NftPrefsStruct *classes[NFT_PREFS_PROPS_MAX];
+        size_t taken[NFT_PREFS_PROPS_MAX];
+        for(size_t i = 0; i < s->nested_count; i++)
+        {
+                const NftPrefsFieldDesc *f = &s->nested[i];
+                char *member = obj + f->prop.offset;
+                taken[i] = 0;
+                if(f->kind == NFT_PREFS_FIELD_ARRAY)
+                {
+                        *(char **) member = NULL;
+                        *(size_t *) (obj + f->count) = 0;
+                }
+
+                if(!(classes[i] = _child(s, i)))
+                        goto _d_error;
+
+                if(f->kind != NFT_PREFS_FIELD_CHILD)
+                        continue;
+
+                if(classes[i]->size != f->prop.size)
+                {
+                        NFT_LOG(L_ERROR, "size of nested <%s> doesn't match its "
+                                "class", f->child);
+                        goto _d_error;
+                }
+                memcpy(member, classes[i]->defaults, f->prop.size);
+        }
+
+        /* amount of children of every member */
+        for(xmlNode * c = n->children; c; c = c->next)
+        {
+                if(c->type != XML_ELEMENT_NODE)
+                        continue;
+
+                /* resolve lazy XInclude placeholder */
+                if(!(c = _xinclude_expand(c)))
+                {
+                        NFT_LOG(L_ERROR, "Included file contains no element");
+                        goto _d_error;
+                }
+
+                size_t m;
+                if((m = _member(s, taken, c->name)) != NO_MEMBER)
+                        taken[m]++;
+        }
+
+        /* arrays for all children */
+        for(size_t i = 0; i < s->nested_count; i++)
+        {
+                const NftPrefsFieldDesc *f = &s->nested[i];
+                if(f->kind != NFT_PREFS_FIELD_ARRAY || !taken[i])
+                        continue;
+
+                char **elements = (char **) (obj + f->prop.offset);
+                if(!(*elements = calloc(taken[i], classes[i]->size)))
+                {
+                        NFT_LOG_PERROR("calloc");
+                        goto _d_error;
+                }
+        }
+
+        /* convert children */
+        memset(taken, 0, sizeof(size_t) * s->nested_count);
+        for(xmlNode * c = n->children; c; c = c->next)
+        {
+                size_t m;
+                if(c->type != XML_ELEMENT_NODE ||
+                   (m = _member(s, taken, c->name)) == NO_MEMBER)
+                        continue;
+
+                const NftPrefsFieldDesc *f = &s->nested[m];
+                char *member = obj + f->prop.offset;
+                taken[m]++;
+                if(f->kind == NFT_PREFS_FIELD_CHILD)
+                {
+                        if(!_decode(p, classes[m], c, member))
+                                goto _d_error;
+                        continue;
+                }
+
+                size_t *count = (size_t *) (obj + f->count);
+                if(!_decode(p, classes[m], c,
+                            *(char **) member + *count * classes[m]->size))
+                        goto _d_error;
+                (*count)++;
+        }
+
+        return NFT_SUCCESS;
+
+_d_error:
+        _struct_clear(p, s, obj);
+        return NFT_FAILURE;
+}
+
+
+
+/******************************************************************************/
+/**************************** PRIVATE FUNCTIONS *******************************/
+/******************************************************************************/
+
+/** compile descriptors of struct members (s. 
+    nft_prefs_class_register_struct()) */
+NftPrefsStruct *_struct_new(const char *className, size_t size,
+                            const NftPrefsFieldDesc fields[], size_t count)
+{
+        if(size == 0)
+        {
+                NFT_LOG(L_ERROR, "struct of class \"%s\" has no size", className);
+                return NULL;
+        }
+
+        NftPrefsStruct *s;
+        if(!(s = calloc(1, sizeof(NftPrefsStruct))))
+        {
+                NFT_LOG_PERROR("calloc");
+                return NULL;
+        }
+        s->size = size;
+
+        if(!(s->defaults = calloc(1, size)) ||
+           (count && (!(s->props = calloc(count, sizeof(NftPrefsPropDesc))) ||
+                      !(s->nested = calloc(count, sizeof(NftPrefsFieldDesc))) ||
+                      !(s->classes = calloc(count, sizeof(NftPrefsStruct *))))))
+        {
+                NFT_LOG_PERROR("calloc");
+                goto _sn_error;
+        }
+
+        for(size_t i = 0; i < count; i++)
+        {
+                const NftPrefsFieldDesc *f = &fields[i];
+                if(!_check(className, size, f))
+                        goto _sn_error;
+
+                /* nested struct or array */
+                if(f->kind != NFT_PREFS_FIELD_PROP)
+                {
+                        if(s->nested_count == NFT_PREFS_PROPS_MAX)
+                        {
+                                NFT_LOG(L_ERROR, "class \"%s\" has more than %d "
+                                        "nested members", className,
+                                        NFT_PREFS_PROPS_MAX);
+                                goto _sn_error;
+                        }
+
+                        NftPrefsFieldDesc *n = &s->nested[s->nested_count++];
+                        *n = *f;
+                        n->prop.name = n->prop.def = n->child = NULL;
+                        if(!_copy(&n->child, f->child))
+                                goto _sn_error;
+                        continue;
+                }
+
+                for(size_t j = 0; j < s->props_count; j++)
+                {
+                        if(strcmp(s->props[j].name, f->prop.name) == 0)
+                        {
+                                NFT_LOG(L_ERROR, "property \"%s\" bound twice "
+                                        "in class \"%s\"", f->prop.name,
+                                        className);
+                                goto _sn_error;
+                        }
+                }
+
+                NftPrefsPropDesc *d = &s->props[s->props_count++];
+                *d = f->prop;
+                d->name = d->def = NULL;
+                if(!_copy(&d->name, f->prop.name))
+                        goto _sn_error;
+
+                if(!f->prop.def)
+                        continue;
+
+                /* copies of strings can't be shared by objects */
+                if(d->type == NFT_PREFS_PROP_STRING_ALLOC)
+                {
+                        if(!_copy(&d->def, f->prop.def))
+                                goto _sn_error;
+                        continue;
+                }
+
+                if(!_node_prop_decode(d, f->prop.def, s->defaults))
+                {
+                        NFT_LOG(L_ERROR, "invalid default \"%s\" of property "
+                                "\"%s\" in class \"%s\"", f->prop.def,
+                                f->prop.name, className);
+                        goto _sn_error;
+                }
+        }
+
+        return s;
+
+_sn_error:
+        _struct_free(s);
+        return NULL;
+}
+
+
+/** free binding of struct */
+void _struct_free(NftPrefsStruct * s)
+{
+        if(!s)
+                return;
+
+        for(size_t i = 0; i < s->props_count; i++)
+        {
+                free((char *) s->props[i].name);
+                free((char *) s->props[i].def);
+        }
+        for(size_t i = 0; i < s->nested_count; i++)
+                free((char *) s->nested[i].child);
+
+        free(s->props);
+        free(s->nested);
+        free(s->classes);
+        free(s->defaults);
+        free(s);
+}
+
+
+/** bind nested members of class className to binding c of that class 
+    (unbind them if c is NULL). Called when classes are registered & 
+    unregistered, so a class may be registered before the classes of its
+    nested members */
+void _struct_bind(NftPrefsStruct * s, const char *className,
+                  NftPrefsStruct * c)
+{
+        for(size_t i = 0; i < s->nested_count; i++)
+        {
+                if(strcmp(s->nested[i].child, className) == 0)
+                        s->classes[i] = c;
+        }
+}
+
+
+/** fill node from struct */
+NftResult _struct_to_node(NftPrefs * p, NftPrefsStruct * s, NftPrefsNode * n,
+                          const void *obj)
+{
+        /* members stored as properties */
+        for(size_t i = 0; i < s->props_count; i += NFT_PREFS_PROPS_MAX)
+        {
+                size_t count = s->props_count - i;
+                if(count > NFT_PREFS_PROPS_MAX)
+                        count = NFT_PREFS_PROPS_MAX;
+
+                if(nft_prefs_node_props_set(n, &s->props[i], count, obj))
+                {
+                        NFT_LOG(L_ERROR, "Failed to set properties of <%s>",
+                                n->name);
+                        return NFT_FAILURE;
+                }
+        }
+
+        /* nested structs & arrays */
+        for(size_t i = 0; i < s->nested_count; i++)
+        {
+                const NftPrefsFieldDesc *f = &s->nested[i];
+                const char *member = (const char *) obj + f->prop.offset;
+
+                NftPrefsStruct *c;
+                if(!(c = _child(s, i)))
+                        return NFT_FAILURE;
+
+                if(f->kind == NFT_PREFS_FIELD_CHILD)
+                {
+                        if(c->size != f->prop.size)
+                        {
+                                NFT_LOG(L_ERROR, "size of nested <%s> doesn't "
+                                        "match its class", f->child);
+                                return NFT_FAILURE;
+                        }
+
+                        if(!_child_to_node(p, n, f->child, member))
+                                return NFT_FAILURE;
+                        continue;
+                }
+
+                size_t count = *(const size_t *) ((const char *) obj + f->count);
+                const char *elements = *(const char *const *) member;
+                if(count && !elements)
+                {
+                        NFT_LOG(L_ERROR, "array of %zu <%s> is NULL", count,
+                                f->child);
+                        return NFT_FAILURE;
+                }
+
+                for(size_t j = 0; j < count; j++)
+                {
+                        if(!_child_to_node(p, n, f->child, elements + j * c->size))
+                                return NFT_FAILURE;
+                }
+        }
+
+        return NFT_SUCCESS;
+}
+
+
+/** create struct from node */
+void *_struct_from_node(NftPrefs * p, NftPrefsStruct * s, NftPrefsNode * n)
+{
+        void *obj;
+        if(!(obj = malloc(s->size)))
+        {
+                NFT_LOG_PERROR("malloc");
+                return NULL;
+        }
+
+        if(!_decode(p, s, n, obj))
+        {
+                free(obj);
+                return NULL;
+        }
+
+        return obj;
+}
+
+
+/** free strings, nested arrays & their elements of struct (but not the 
+    struct itself). Freed pointers are reset, so clearing twice is fine */
+void _struct_clear(NftPrefs * p, NftPrefsStruct * s, void *obj)
+{
+        char *o = obj;
+        for(size_t i = 0; i < s->props_count; i++)
+        {
+                if(s->props[i].type != NFT_PREFS_PROP_STRING_ALLOC)
+                        continue;
+
+                char **str = (char **) (o + s->props[i].offset);
+                nft_prefs_free(*str);
+                *str = NULL;
+        }
+
+        for(size_t i = 0; i < s->nested_count; i++)
+        {
+                const NftPrefsFieldDesc *f = &s->nested[i];
+                char *member = o + f->prop.offset;
+                NftPrefsStruct *c = _child(s, i);
+                if(f->kind == NFT_PREFS_FIELD_CHILD)
+                {
+                        if(c)
+                                _struct_clear(p, c, member);
+                        continue;
+                }
+
+                char **elements = (char **) member;
+                size_t *count = (size_t *) (o + f->count);
+                for(size_t j = 0; c && *elements && j < *count; j++)
+                        _struct_clear(p, c, *elements + j * c->size);
+
+                free(*elements);
+                *elements = NULL;
+                *count = 0;
+        }
+}
+
+
+/**
+ * @}
+ */
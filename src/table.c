@@ -0,0 +1,654 @@
+/*
+ * libniftyprefs - lightweight modelless preferences management library
+ * Copyright (C) 2006-2014 Daniel Hiepler <daniel@niftylight.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/**
+ * @file table.c
+ *
+ * columnar tables of similar nodes. A run of sibling elements that have the 
+ * same name and the same properties in the same order (but neither children 
+ * nor namespaces) can be written as one table:
+ *
+ * @verbatim
+   <nft:table xmlns:nft="http://wiki.niftylight.de/libniftyprefs/table" name="led" rows="50000">
+     <nft:column name="x" type="int">AgICAgIC...</nft:column>
+     <nft:column name="label" type="string">bGVkIDEAbGVk...</nft:column>
+   </nft:table>
+   @endverbatim
+ *
+ * Every column holds the base64 representation of the values of one 
+ * property in the order of the rows. "int" columns (only used if all values
+ * are integers in canonical form) hold the difference to the value of the 
+ * previous row as zigzag varint, "string" columns hold the values each 
+ * terminated by a 0 byte. Tables are expanded to regular nodes again when 
+ * a tree is loaded.
+ */
+
+/**
+ * @addtogroup prefs_node
+ * @{
+ *
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <niftylog.h>
+#include "node.h"
+#include "number.h"
+#include "base64.h"
+#include "table.h"
+
+
+
+/** minimum amount of nodes written as table */
+#define TABLE_MIN_ROWS          16
+/** maximum amount of rows accepted when decoding */
+#define TABLE_MAX_ROWS          (1 << 24)
+
+
+/** growing buffer for packed column */
+typedef struct
+{
+        unsigned char *data;
+        size_t length;
+        size_t size;
+} TableBuffer;
+
+
+/** column of table while it's decoded */
+typedef struct
+{
+        /** name of property */
+        xmlChar *name;
+        /** name of property in dictionary of document (or NULL) */
+        const xmlChar *key;
+        /** "int" column */
+        bool ints;
+        /** decoded column */
+        unsigned char *data;
+        const unsigned char *pos;
+        const unsigned char *end;
+        /** value of previous row ("int" columns) */
+        uint64_t prev;
+} TableColumn;
+
+
+
+
+/******************************************************************************/
+/**************************** STATIC FUNCTIONS ********************************/
+/******************************************************************************/
+
+/** append bytes to buffer */
+static bool _buffer_put(TableBuffer * b, const void *data, size_t n)
+{
+        if(b->size - b->length < n)
+        {
+                size_t size = b->size ? b->size : 4096;
+                while(size - b->length < n)
+                        size *= 2;
+
+                unsigned char *tmp;
+                if(!(tmp = realloc(b->data, size)))
+                {
+                        NFT_LOG_PERROR("realloc");
+                        return false;
+                }
+                b->data = tmp;
+                b->size = size;
+        }
+
+        memcpy(&b->data[b->length], data, n);
+        b->length += n;
+
+        return true;
+}
+
+
+/** append varint to buffer */
+static bool _buffer_varint(TableBuffer * b, uint64_t v)
+{
+        unsigned char tmp[10];
+        size_t n = 0;
+        while(v >= 0x80)
+        {
+                tmp[n++] = (unsigned char) (v | 0x80);
+                v >>= 7;
+        }
+        tmp[n++] = (unsigned char) v;
+
+        return _buffer_put(b, tmp, n);
+}
+
+
+/** value of property that consists of one text node (NULL otherwise) */
+static const xmlChar *_plain_value(xmlAttr * a)
+{
+        if(a->ns)
+                return NULL;
+
+        xmlNode *t;
+        if(!(t = a->children))
+                return BAD_CAST "";
+
+        if(t->next || t->type != XML_TEXT_NODE || !t->content)
+                return NULL;
+
+        return t->content;
+}
+
+
+/** true if node can be a row of a table */
+static bool _is_row(xmlNode * n)
+{
+        if(n->type != XML_ELEMENT_NODE || n->ns || n->nsDef || n->children)
+                return false;
+
+        for(xmlAttr * a = n->properties; a; a = a->next)
+        {
+                if(!_plain_value(a))
+                        return false;
+        }
+
+        return true;
+}
+
+
+/** true if two rows have the same name and the same properties in the 
+    same order */
+static bool _same_shape(xmlNode * a, xmlNode * b)
+{
+        if(!xmlStrEqual(a->name, b->name))
+                return false;
+
+        xmlAttr *x, *y;
+        for(x = a->properties, y = b->properties; x && y;
+            x = x->next, y = y->next)
+        {
+                if(!xmlStrEqual(x->name, y->name))
+                        return false;
+        }
+
+        return !x && !y;
+}
+
+
+/** true if node is a table */
+static bool _is_table(xmlNode * n)
+{
+        return n->type == XML_ELEMENT_NODE && n->ns &&
+                xmlStrEqual(n->ns->href, BAD_CAST TABLE_NS) &&
+                xmlStrEqual(n->name, BAD_CAST "table");
+}
+
+
+/** create column element from the current property of all rows. The 
+    properties in attrs are advanced to the next property of their row */
+static xmlNode *_encode_column(xmlNode * table, xmlAttr ** attrs, size_t rows,
+                               TableBuffer * b)
+{
+        const xmlChar *name = attrs[0]->name;
+
+        /* integers in canonical form are stored as difference to the 
+           previous row */
+        bool ints = true;
+        uint64_t prev = 0;
+        b->length = 0;
+        for(size_t r = 0; r < rows && ints; r++)
+        {
+                const char *v = (const char *) _plain_value(attrs[r]);
+                char tmp[NUMBER_MAXLEN];
+                int64_t i;
+                if(!(ints = _number_parse_int(v, &i) &&
+                     _number_format_int(i, tmp) > 0 && strcmp(tmp, v) == 0))
+                        break;
+
+                uint64_t d = (uint64_t) i - prev;
+                prev = (uint64_t) i;
+                if(!_buffer_varint(b, (d << 1) ^ ((d >> 63) ? UINT64_MAX : 0)))
+                        return NULL;
+        }
+
+        /* anything else as string */
+        if(!ints)
+        {
+                b->length = 0;
+                for(size_t r = 0; r < rows; r++)
+                {
+                        const xmlChar *v = _plain_value(attrs[r]);
+                        if(!_buffer_put(b, v, xmlStrlen(v) + 1))
+                                return NULL;
+                }
+        }
+
+        for(size_t r = 0; r < rows; r++)
+                attrs[r] = attrs[r]->next;
+
+        char *encoded;
+        if(!(encoded = malloc(_base64_encoded_length(b->length) + 1)))
+        {
+                NFT_LOG_PERROR("malloc");
+                return NULL;
+        }
+        _base64_encode(b->data, b->length, encoded);
+
+        xmlNode *c = xmlNewChild(table, table->ns, BAD_CAST "column", NULL);
+        xmlNode *t = xmlNewDocText(table->doc, BAD_CAST encoded);
+        free(encoded);
+        if(!c || !t ||
+           !xmlNewProp(c, BAD_CAST "name", name) ||
+           !xmlNewProp(c, BAD_CAST "type", BAD_CAST(ints ? "int" : "string")))
+        {
+                NFT_LOG(L_ERROR, "Failed to create column \"%s\"", name);
+                xmlFreeNode(t);
+                return NULL;
+        }
+        xmlAddChild(c, t);
+
+        return c;
+}
+
+
+/** replace a run of rows from first to last (separated by blank text 
+    nodes only) by a table */
+static xmlNode *_encode_run(xmlNode * first, xmlNode * last, size_t rows)
+{
+        xmlNode *table = NULL;
+        xmlAttr **attrs;
+        TableBuffer b = { NULL, 0, 0 };
+
+        if(!(attrs = malloc(rows * sizeof(xmlAttr *))))
+        {
+                NFT_LOG_PERROR("malloc");
+                return NULL;
+        }
+
+        size_t r = 0;
+        for(xmlNode * n = first; r < rows; n = n->next)
+        {
+                if(n->type != XML_ELEMENT_NODE)
+                        continue;
+                attrs[r++] = n->properties;
+        }
+
+        /* table element */
+        char count[NUMBER_MAXLEN];
+        _number_format_int((int64_t) rows, count);
+        xmlNs *ns;
+        if(!(table = xmlNewDocNode(first->doc, NULL, BAD_CAST "table", NULL)) ||
+           !(ns = xmlNewNs(table, BAD_CAST TABLE_NS, BAD_CAST "nft")) ||
+           !xmlNewProp(table, BAD_CAST "name", first->name) ||
+           !xmlNewProp(table, BAD_CAST "rows", BAD_CAST count))
+        {
+                NFT_LOG(L_ERROR, "Failed to create table of <%s>",
+                        first->name);
+                goto _er_error;
+        }
+        xmlSetNs(table, ns);
+
+        /* one column per property */
+        while(attrs[0])
+        {
+                if(!_encode_column(table, attrs, rows, &b))
+                        goto _er_error;
+        }
+
+        /* table takes the place of the rows */
+        xmlAddPrevSibling(first, table);
+        _node_index_invalidate(first->parent);
+
+        xmlNode *end = last->next;
+        for(xmlNode * n = first, *next; n != end; n = next)
+        {
+                next = n->next;
+                xmlUnlinkNode(n);
+                xmlFreeNode(n);
+        }
+
+        free(attrs);
+        free(b.data);
+        return table;
+
+_er_error:
+        xmlFreeNode(table);
+        free(attrs);
+        free(b.data);
+        return NULL;
+}
+
+
+/** read varint of "int" column */
+static bool _column_varint(TableColumn * c, uint64_t * v)
+{
+        uint64_t r = 0;
+        for(int shift = 0; shift < 64; shift += 7)
+        {
+                if(c->pos >= c->end)
+                        return false;
+
+                unsigned char b = *c->pos++;
+                r |= (uint64_t) (b & 0x7f) << shift;
+                if(!(b & 0x80))
+                {
+                        *v = r;
+                        return true;
+                }
+        }
+
+        return false;
+}
+
+
+/** get value of next row from column */
+static const xmlChar *_column_next(TableColumn * c, char *tmp)
+{
+        if(c->ints)
+        {
+                uint64_t z;
+                if(!_column_varint(c, &z))
+                        return NULL;
+
+                c->prev += (z >> 1) ^ (0 - (z & 1));
+                _number_format_int((int64_t) c->prev, tmp);
+                return BAD_CAST tmp;
+        }
+
+        const unsigned char *end;
+        if(!(end = memchr(c->pos, 0, c->end - c->pos)))
+                return NULL;
+
+        const xmlChar *v = c->pos;
+        c->pos = end + 1;
+
+        return xmlCheckUTF8(v) ? v : NULL;
+}
+
+
+/** read column element */
+static bool _column_read(xmlNode * n, TableColumn * c)
+{
+        bool result = false;
+        xmlChar *type = NULL, *content = NULL;
+
+        if(n->type != XML_ELEMENT_NODE || !n->ns ||
+           !xmlStrEqual(n->ns->href, BAD_CAST TABLE_NS) ||
+           !xmlStrEqual(n->name, BAD_CAST "column") ||
+           !(c->name = xmlGetNoNsProp(n, BAD_CAST "name")) ||
+           xmlValidateNCName(c->name, 0) != 0 ||
+           !(type = xmlGetNoNsProp(n, BAD_CAST "type")))
+                goto _cr_exit;
+
+        if(xmlStrEqual(type, BAD_CAST "int"))
+                c->ints = true;
+        else if(!xmlStrEqual(type, BAD_CAST "string"))
+                goto _cr_exit;
+
+        size_t length, decoded;
+        if(!(content = xmlNodeGetContent(n)) ||
+           !_base64_decoded_length((const char *) content,
+                                   (length = xmlStrlen(content)), &decoded))
+                goto _cr_exit;
+
+        if(!(c->data = malloc(decoded ? decoded : 1)))
+        {
+                NFT_LOG_PERROR("malloc");
+                goto _cr_exit;
+        }
+
+        if(!_base64_decode((const char *) content, length, c->data))
+                goto _cr_exit;
+
+        c->pos = c->data;
+        c->end = c->data + decoded;
+        result = true;
+
+_cr_exit:
+        xmlFree(type);
+        xmlFree(content);
+        return result;
+}
+
+
+/** replace table by its rows */
+static bool _decode_table(xmlNode * table)
+{
+        bool result = false;
+        TableColumn *columns = NULL;
+        size_t count = 0;
+        int64_t rows;
+
+        xmlChar *name = xmlGetNoNsProp(table, BAD_CAST "name");
+        xmlChar *srows = xmlGetNoNsProp(table, BAD_CAST "rows");
+        if(!name || xmlValidateNCName(name, 0) != 0 || !srows ||
+           !_number_parse_int((const char *) srows, &rows) ||
+           rows < 0 || rows > TABLE_MAX_ROWS)
+                goto _dt_exit;
+
+        /* columns */
+        size_t size = 0;
+        for(xmlNode * n = table->children; n; n = n->next)
+                size++;
+
+        if(size && !(columns = calloc(size, sizeof(TableColumn))))
+        {
+                NFT_LOG_PERROR("calloc");
+                goto _dt_exit;
+        }
+
+        for(xmlNode * n = table->children; n; n = n->next)
+        {
+                if(xmlIsBlankNode(n))
+                        continue;
+
+                TableColumn *c = &columns[count++];
+                if(!_column_read(n, c))
+                        goto _dt_exit;
+
+                /* properties must be unique */
+                for(TableColumn * o = columns; o != c; o++)
+                {
+                        if(xmlStrEqual(o->name, c->name))
+                                goto _dt_exit;
+                }
+        }
+
+        /* names of dictionary are used by all rows without looking them 
+           up again */
+        xmlDict *dict = table->doc ? table->doc->dict : NULL;
+        const xmlChar *key = NULL;
+        if(dict && !(key = xmlDictLookup(dict, name, -1)))
+                goto _dt_exit;
+        for(size_t i = 0; dict && i < count; i++)
+        {
+                if(!(columns[i].key = xmlDictLookup(dict, columns[i].name, -1)))
+                        goto _dt_exit;
+        }
+
+        /* rows take the place of the table */
+        for(int64_t r = 0; r < rows; r++)
+        {
+                xmlNode *n;
+                if(!(n = key ?
+                     xmlNewDocNodeEatName(table->doc, NULL, (xmlChar *) key, NULL) :
+                     xmlNewDocNode(table->doc, NULL, name, NULL)))
+                        goto _dt_exit;
+                xmlAddPrevSibling(table, n);
+
+                for(size_t i = 0; i < count; i++)
+                {
+                        TableColumn *c = &columns[i];
+                        char tmp[NUMBER_MAXLEN];
+                        const xmlChar *value;
+                        if(!(value = _column_next(c, tmp)) ||
+                           !(c->key ?
+                             xmlNewNsPropEatName(n, NULL, (xmlChar *) c->key, value) :
+                             xmlNewNsProp(n, NULL, c->name, value)))
+                                goto _dt_exit;
+                }
+        }
+
+        /* every value was used */
+        for(size_t i = 0; i < count; i++)
+        {
+                if(columns[i].pos != columns[i].end)
+                        goto _dt_exit;
+        }
+
+        _node_index_invalidate(table->parent);
+        xmlUnlinkNode(table);
+        xmlFreeNode(table);
+        result = true;
+
+_dt_exit:
+        if(!result)
+                NFT_LOG(L_ERROR, "Invalid table of <%s> in line %ld",
+                        name ? (char *) name : "?", xmlGetLineNo(table));
+
+        for(size_t i = 0; i < count; i++)
+        {
+                xmlFree(columns[i].name);
+                free(columns[i].data);
+        }
+        free(columns);
+        xmlFree(name);
+        xmlFree(srows);
+        return result;
+}
+
+
+
+
+/******************************************************************************/
+/**************************** PRIVATE FUNCTIONS *******************************/
+/******************************************************************************/
+
+/** replace runs of at least TABLE_MIN_ROWS similar children of a node and 
+    all its descendants by tables. Returns amount of tables or -1 upon 
+    error */
+int _table_encode(xmlNode * n)
+{
+        int result = 0;
+
+        xmlNode *c = n->children;
+        while(c)
+        {
+                if(!_is_row(c))
+                {
+                        if(c->type == XML_ELEMENT_NODE)
+                        {
+                                int r;
+                                if((r = _table_encode(c)) < 0)
+                                        return -1;
+                                result += r;
+                        }
+                        c = c->next;
+                        continue;
+                }
+
+                /* find end of run */
+                size_t rows = 1;
+                xmlNode *last = c;
+                for(xmlNode * s = c->next; s; s = s->next)
+                {
+                        if(xmlIsBlankNode(s))
+                                continue;
+
+                        if(!_is_row(s) || !_same_shape(c, s))
+                                break;
+
+                        last = s;
+                        rows++;
+                }
+
+                if(rows < TABLE_MIN_ROWS)
+                {
+                        c = last->next;
+                        continue;
+                }
+
+                xmlNode *table;
+                if(!(table = _encode_run(c, last, rows)))
+                        return -1;
+
+                result++;
+                c = table->next;
+        }
+
+        return result;
+}
+
+
+/** expand all tables in the descendants of a node. Returns amount of 
+    tables or -1 upon error */
+int _table_decode(xmlNode * n)
+{
+        int result = 0;
+
+        for(xmlNode * c = n->children, *next; c; c = next)
+        {
+                next = c->next;
+
+                if(c->type != XML_ELEMENT_NODE)
+                        continue;
+
+                if(_is_table(c))
+                {
+                        if(!_decode_table(c))
+                                return -1;
+                        result++;
+                        continue;
+                }
+
+                int r;
+                if((r = _table_decode(c)) < 0)
+                        return -1;
+                result += r;
+        }
+
+        return result;
+}
+
+
+/**
+ * @}
+ */
@@ -56,6 +56,7 @@
 #include <niftylog.h>
 #include "prefs.h"
 #include "class.h"
+#include "xinclude.h"
 
 
 
@@ -129,64 +130,70 @@ static NftResult _get_version(NftPrefsNode *node, unsigned int *version)
 }
 
 
-/** run updater for node, all siblings and all child nodes */
+/** true while a tree is updated by this thread */
+static __thread bool _running;
+
+
 static NftResult _update_node(NftPrefs *p, NftPrefsNode *node,
-                              unsigned int fromVersion, unsigned int toVersion)
+                              unsigned int fromVersion, unsigned int toVersion);
+
+
+/** run updater for node and all child nodes. XInclude placeholders are 
+    not resolved, their content is updated once it's included 
+    (s. _updater_nodes_process()) */
+static NftResult _update_one(NftPrefs *p, NftPrefsNode *n,
+                             unsigned int fromVersion, unsigned int toVersion)
 {
-		/* update this node and all siblings */
-		NftPrefsNode *n;
-		for(n = node; n; n = nft_prefs_node_get_next(n))
+		if(_xinclude_is_placeholder(n))
+				return NFT_SUCCESS;
+
+		/* find class */
+		NftPrefsClass *c;
+		if(!(c = _class_find_by_name(p, nft_prefs_node_get_name(n))))
 		{
+				NFT_LOG(L_DEBUG, "Unknown prefs class \"%s\". Skipping...",
+						nft_prefs_node_get_name(n));
 
-				/* find class */
-				NftPrefsClass *c;
-				if(!(c = _class_find_by_name(_prefs_classes(p),
-											 nft_prefs_node_get_name(n))))
-				{
-						NFT_LOG(L_DEBUG, "Unknown prefs class \"%s\". Skipping...",
-								nft_prefs_node_get_name(n));
+				return NFT_SUCCESS;
+		}
 
+		NFT_LOG(L_NOTICE, "Preferences older than context. Trying to update...");
+
+		/* update version succesively */
+		for(unsigned int v = fromVersion; v < toVersion; v++)
+		{
+				/* find updater */
+				NftPrefsUpdater *u;
+				if(!(u = _find_updater(_class_updaters(c), v)))
+				{
 						continue;
 				}
 
-				NFT_LOG(L_NOTICE, "Preferences older than context. Trying to update...");
+				NFT_LOG(L_DEBUG, "Found updater function for "
+							"class \"%s\" version \"%d\"",
+							u->className, u->version);
 
-				/* update version succesively */
-				for(unsigned int v = fromVersion; v < toVersion; v++)
+				/* run updater */
+				if(!(u->updater(n, v, u->userptr)))
 				{
-						/* find updater */
-						NftPrefsUpdater *u;
-						if(!(u = _find_updater(_class_updaters(c), v)))
-						{
-								continue;
-						}
-
-						NFT_LOG(L_DEBUG, "Found updater function for "
-									"class \"%s\" version \"%d\"",
-									u->className, u->version);
-
-						/* run updater */
-						if(!(u->updater(n, v, u->userptr)))
-						{
-								NFT_LOG(L_ERROR, "Update for class \"%s\" "
-											"(from version %d) failed!",
-											u->className, v);
-								return NFT_FAILURE;
-						}
-
-						NFT_LOG(L_NOTICE, "Node \"%s\" successfully "
-									"updated to version %d",
+						NFT_LOG(L_ERROR, "Update for class \"%s\" "
+									"(from version %d) failed!",
 									u->className, v);
+						return NFT_FAILURE;
 				}
 
-				/* update all child nodes */
-				NftPrefsNode *nc;
-				if((nc = nft_prefs_node_get_first_child(n)))
+				NFT_LOG(L_NOTICE, "Node \"%s\" successfully "
+							"updated to version %d",
+							u->className, v);
+		}
+
+		/* update all child nodes */
+		NftPrefsNode *nc;
+		if((nc = xmlFirstElementChild(n)))
+		{
+				if(!(_update_node(p, nc, fromVersion, toVersion)))
 				{
-							if(!(_update_node(p, nc, fromVersion, toVersion)))
-							{
-									return NFT_FAILURE;
-							}
+						return NFT_FAILURE;
 				}
 		}
 
@@ -194,6 +201,22 @@ static NftResult _update_node(NftPrefs *p, NftPrefsNode *node,
 }
 
 
+/** run updater for node, all siblings and all child nodes */
+static NftResult _update_node(NftPrefs *p, NftPrefsNode *node,
+                              unsigned int fromVersion, unsigned int toVersion)
+{
+		/* update this node and all siblings */
+		NftPrefsNode *n;
+		for(n = node; n; n = xmlNextElementSibling(n))
+		{
+				if(!_update_one(p, n, fromVersion, toVersion))
+						return NFT_FAILURE;
+		}
+
+		return NFT_SUCCESS;
+}
+
+
 
 /******************************************************************************/
 /**************************** PRIVATE FUNCTIONS *******************************/
@@ -240,12 +263,41 @@ NftResult _updater_node_process(NftPrefs *p, NftPrefsNode *node)
 
 
 		/* update node and all child nodes */
-		if(!_update_node(p, node, nodeVersion, contextVersion))
+		bool running = _running;
+		_running = true;
+		NftResult r = _update_node(p, node, nodeVersion, contextVersion);
+		_running = running;
+
+		return r;
+}
+
+
+/** update nodes that were added to a tree after it has been processed
+    (like the content of lazily included files) from the version of the 
+    root node of the tree. Nodes added by an updater while the tree itself
+    is updated are left to that update */
+NftResult _updater_nodes_process(NftPrefs *p, NftPrefsNode *root,
+                                 NftPrefsNode *first, NftPrefsNode *last)
+{
+		if(_running)
+				return NFT_SUCCESS;
+
+		unsigned int contextVersion = _prefs_get_version(p);
+		unsigned int nodeVersion = 0;
+		if(!root || !_get_version(root, &nodeVersion) ||
+		   nodeVersion >= contextVersion)
+				return NFT_SUCCESS;
+
+		_running = true;
+		NftResult r = NFT_SUCCESS;
+		for(NftPrefsNode *n = first; r && n; n = (n == last) ? NULL : n->next)
 		{
-				return NFT_FAILURE;
+				if(n->type == XML_ELEMENT_NODE)
+						r = _update_one(p, n, nodeVersion, contextVersion);
 		}
+		_running = false;
 
-		return NFT_SUCCESS;
+		return r;
 }
 
 
@@ -303,13 +355,18 @@ NftResult nft_prefs_updater_register(NftPrefs *p,
 	if(!p || !updater || !className)
 			NFT_LOG_NULL(NFT_FAILURE);
 
+	/* waits while other threads load files */
+	if(!_prefs_registry_lock(p))
+			return NFT_FAILURE;
+
+	NftResult r = NFT_FAILURE;
 
 	/* get class */
 	NftPrefsClass *c;
-	if(!(c = _class_find_by_name(_prefs_classes(p), className)))
+	if(!(c = _class_find_by_name(p, className)))
 	{
 			NFT_LOG(L_ERROR, "Class \"%s\" not registered", className);
-			return NFT_FAILURE;
+			goto _pur_exit;
 	}
 
 	/* allocate new slot in updater array */
@@ -317,7 +374,7 @@ NftResult nft_prefs_updater_register(NftPrefs *p,
     if(!(nft_array_slot_alloc(_class_updaters(c), &s)))
     {
             NFT_LOG(L_ERROR, "Failed to allocate new array slot");
-            return NFT_FAILURE;
+            goto _pur_exit;
     }
 
     /* get newly allocated empty array element */
@@ -326,7 +383,7 @@ NftResult nft_prefs_updater_register(NftPrefs *p,
     {
             NFT_LOG(L_ERROR, "Failed to get element from array slot");
 			nft_array_slot_free(_class_updaters(c), s);
-            return NFT_FAILURE;
+            goto _pur_exit;
     }
 
 	/* register updater */
@@ -335,7 +392,11 @@ NftResult nft_prefs_updater_register(NftPrefs *p,
 	n->userptr = userptr;
 	strncpy(n->className, className, NFT_PREFS_MAX_CLASSNAME);
 
-	return NFT_SUCCESS;
+	r = NFT_SUCCESS;
+
+_pur_exit:
+	_prefs_registry_unlock(p);
+	return r;
 }
 
 
@@ -51,6 +51,7 @@
 
 NftResult  _updater_init_array(NftPrefsUpdaters * a);
 NftResult  _updater_node_process(NftPrefs *p, NftPrefsNode *node);
+NftResult  _updater_nodes_process(NftPrefs *p, NftPrefsNode *root, NftPrefsNode *first, NftPrefsNode *last);
 NftResult  _updater_node_add_version(NftPrefs *p, NftPrefsNode *node);
 void       _updater_node_remove_version(NftPrefsNode *node);
 
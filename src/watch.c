@@ -0,0 +1,441 @@
+/*
+ * libniftyprefs - lightweight modelless preferences management library
+ * Copyright (C) 2006-2014 Daniel Hiepler <daniel@niftylight.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/**
+ * @file watch.c
+ *
+ * reload preferences files when they change. A thread waits for changes
+ * of the file (inotify events of its directory, so files replaced by 
+ * rename() are noticed as well, or polling if inotify is unavailable). 
+ * After the file didn't change for WATCH_DEBOUNCE_MS, its content is
+ * hashed and only if that changed, the file is parsed and compared to the 
+ * previous tree.
+ */
+
+/**
+ * @addtogroup prefs_watch
+ * @{
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <libgen.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <niftylog.h>
+#include "config.h"
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
+#include "prefs.h"
+#include "node.h"
+#include "diff.h"
+
+
+
+/** time a file must stay unchanged before it's reloaded */
+#define WATCH_DEBOUNCE_MS       100
+/** interval of checking the file if inotify is unavailable */
+#define WATCH_POLL_MS           500
+
+
+/** watcher descriptor */
+struct _NftPrefsWatch
+{
+        NftPrefs *p;
+        /** watched file */
+        char *path;
+        /** name of file in its directory */
+        char *name;
+        /** function called after file changed */
+        NftPrefsWatchFunc *cb;
+        void *userptr;
+        /** tree of last successful load */
+        NftPrefsNode *current;
+        /** hash of content last loaded */
+        uint64_t hash;
+        /** status of file when it was checked last (polling) */
+        struct stat sts;
+        /** inotify instance (or -1 when polling) */
+        int fd;
+        /** written to stop the thread */
+        int stop[2];
+        /** thread waiting for changes */
+        pthread_t thread;
+};
+
+
+
+
+/******************************************************************************/
+/**************************** STATIC FUNCTIONS ********************************/
+/******************************************************************************/
+
+/** read file and hash its content. Returns false if it can't be read */
+static bool _watch_hash(const char *path, uint64_t * hash)
+{
+        int fd;
+        if((fd = open(path, O_RDONLY)) == -1)
+                return false;
+
+        size_t length;
+        unsigned char *data = _node_binary_read_fd(fd, &length);
+        close(fd);
+        if(!data)
+                return false;
+
+        *hash = _diff_hash_bytes(data, length);
+        free(data);
+
+        return true;
+}
+
+
+/** reload file if its content changed and tell the callback what changed */
+static void _watch_reload(NftPrefsWatch * w)
+{
+        uint64_t hash;
+        if(!_watch_hash(w->path, &hash))
+        {
+                NFT_LOG(L_DEBUG, "\"%s\" can't be read (yet)", w->path);
+                return;
+        }
+
+        /* file was touched or rewritten with the same content */
+        if(hash == w->hash)
+                return;
+
+        /* classes & updaters can't change while parsing */
+        _prefs_batch_begin(w->p);
+        NftPrefsNode *n = nft_prefs_node_from_file(w->p, w->path);
+        _prefs_batch_end(w->p);
+        if(!n)
+        {
+                NFT_LOG(L_WARNING, "Failed to reload \"%s\", keeping previous version", w->path);
+                return;
+        }
+
+        /* content that failed to load is retried on the next change */
+        w->hash = hash;
+
+        /* no callback if nothing but formatting or comments changed */
+        NftPrefsDiff *d = _diff_new(w->current, n);
+        if(!d || nft_prefs_diff_length(d) > 0)
+                w->cb(w->p, w->current, n, d, w->userptr);
+
+        _diff_free(d);
+        nft_prefs_node_free(w->current);
+        w->current = n;
+}
+
+
+/** check whether events concern the watched file */
+static bool _watch_events(NftPrefsWatch * w)
+{
+        bool result = false;
+
+#ifdef HAVE_SYS_INOTIFY_H
+        char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+        ssize_t length;
+        while((length = read(w->fd, buf, sizeof(buf))) > 0)
+        {
+                for(char *b = buf; b < buf + length;)
+                {
+                        struct inotify_event *e = (struct inotify_event *) b;
+                        if((e->mask & IN_Q_OVERFLOW) ||
+                           (e->len > 0 && strcmp(e->name, w->name) == 0))
+                                result = true;
+
+                        b += sizeof(struct inotify_event) + e->len;
+                }
+        }
+#endif
+
+        return result;
+}
+
+
+/** current time of the monotonic clock in ms */
+static int64_t _watch_now(void)
+{
+        struct timespec t;
+        clock_gettime(CLOCK_MONOTONIC, &t);
+
+        return (int64_t) t.tv_sec * 1000 + t.tv_nsec / 1000000;
+}
+
+
+/** check whether file status changed since last check (polling) */
+static bool _watch_stat(NftPrefsWatch * w)
+{
+        struct stat sts;
+        if(stat(w->path, &sts) != 0)
+                memset(&sts, 0, sizeof(sts));
+
+        bool changed = sts.st_ino != w->sts.st_ino ||
+                sts.st_size != w->sts.st_size ||
+                sts.st_mtim.tv_sec != w->sts.st_mtim.tv_sec ||
+                sts.st_mtim.tv_nsec != w->sts.st_mtim.tv_nsec;
+
+        w->sts = sts;
+        return changed;
+}
+
+
+/** thread waiting for changes */
+static void *_watch_thread(void *arg)
+{
+        NftPrefsWatch *w = arg;
+
+        /* parse with a dictionary of our own */
+        if(!_prefs_worker_begin(w->p, false))
+                return NULL;
+
+        struct pollfd fds[2] = {
+                {.fd = w->stop[0],.events = POLLIN},
+                {.fd = w->fd,.events = POLLIN},
+        };
+        nfds_t nfds = w->fd != -1 ? 2 : 1;
+
+        /* file changed and is reloaded at deadline unless it changes
+           again before */
+        bool pending = false;
+        int64_t deadline = 0;
+        for(;;)
+        {
+                int timeout = w->fd != -1 ? -1 : WATCH_POLL_MS;
+                if(pending)
+                {
+                        int64_t left = deadline - _watch_now();
+                        timeout = left > 0 ? (int) left : 0;
+                }
+
+                int r;
+                if((r = poll(fds, nfds, timeout)) == -1)
+                {
+                        if(errno == EINTR)
+                                continue;
+
+                        NFT_LOG_PERROR("poll");
+                        break;
+                }
+
+                /* stop requested */
+                if(fds[0].revents)
+                        break;
+
+                /* only changes of the file itself postpone the reload */
+                bool changed = (w->fd != -1) ?
+                        (r > 0 && _watch_events(w)) : _watch_stat(w);
+                if(changed)
+                {
+                        pending = true;
+                        deadline = _watch_now() + WATCH_DEBOUNCE_MS;
+                        continue;
+                }
+
+                if(pending && _watch_now() >= deadline)
+                {
+                        pending = false;
+                        _watch_reload(w);
+                }
+        }
+
+        _prefs_worker_end(w->p);
+
+        return NULL;
+}
+
+
+/** free watcher descriptor */
+static void _watch_free(NftPrefsWatch * w)
+{
+        if(w->fd != -1)
+                close(w->fd);
+        if(w->stop[0] != -1)
+        {
+                close(w->stop[0]);
+                close(w->stop[1]);
+        }
+
+        nft_prefs_node_free(w->current);
+        free(w->path);
+        free(w->name);
+        free(w);
+}
+
+
+
+/******************************************************************************/
+/**************************** API FUNCTIONS ***********************************/
+/******************************************************************************/
+
+/**
+ * watch a preferences file and reload it whenever it changes. The file is 
+ * loaded by nft_prefs_node_from_file() after it stayed unchanged for a 
+ * short time (so rapid writes only cause one reload) and only if its content
+ * actually changed. The callback receives the previous and the current tree
+ * together with the changes between them. It's not called if the trees are
+ * equal.
+ *
+ * @param p NftPrefs context
+ * @param path full path of file to watch (it must exist & be loadable)
+ * @param cb function to call after the file changed
+ * @param userptr arbitrary pointer passed to cb
+ * @result new watcher or NULL upon error
+ * @note cb is called from a thread of its own. Registering classes & 
+ * updaters waits while the file is reloaded. Use nft_prefs_watch_stop() 
+ * before calling nft_prefs_deinit().
+ */
+NftPrefsWatch *nft_prefs_watch(NftPrefs * p, const char *path,
+                               NftPrefsWatchFunc * cb, void *userptr)
+{
+        if(!p || !path || !cb)
+                NFT_LOG_NULL(NULL);
+
+        NftPrefsWatch *w;
+        if(!(w = calloc(1, sizeof(NftPrefsWatch))))
+        {
+                NFT_LOG_PERROR("calloc");
+                return NULL;
+        }
+        w->p = p;
+        w->cb = cb;
+        w->userptr = userptr;
+        w->fd = w->stop[0] = w->stop[1] = -1;
+
+        char *copy = NULL;
+        if(!(w->path = strdup(path)) ||
+           !(copy = strdup(path)) ||
+           !(w->name = strdup(basename(copy))))
+        {
+                NFT_LOG_PERROR("strdup");
+                goto _npw_error;
+        }
+
+        /* initial tree (parsed like the thread will do it, so it doesn't 
+           share the dictionary of the context) */
+        if(!_watch_hash(path, &w->hash))
+        {
+                NFT_LOG(L_ERROR, "Failed to read \"%s\"", path);
+                goto _npw_error;
+        }
+        _watch_stat(w);
+
+        if(!_prefs_worker_begin(p, false))
+                goto _npw_error;
+        w->current = nft_prefs_node_from_file(p, path);
+        _prefs_worker_end(p);
+        if(!w->current)
+                goto _npw_error;
+
+        if(pipe(w->stop) == -1)
+        {
+                w->stop[0] = -1;
+                NFT_LOG_PERROR("pipe");
+                goto _npw_error;
+        }
+
+#ifdef HAVE_SYS_INOTIFY_H
+        /* watch directory (files are often replaced by renaming them) */
+        strcpy(copy, path);
+        if((w->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) == -1 ||
+           inotify_add_watch(w->fd, dirname(copy),
+                             IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_TO |
+                             IN_CREATE | IN_DELETE) == -1)
+        {
+                NFT_LOG(L_WARNING, "inotify unavailable (%s), polling \"%s\"",
+                        strerror(errno), path);
+                if(w->fd != -1)
+                        close(w->fd);
+                w->fd = -1;
+        }
+#endif
+
+        if(pthread_create(&w->thread, NULL, _watch_thread, w) != 0)
+        {
+                NFT_LOG(L_ERROR, "Failed to start watcher thread");
+                goto _npw_error;
+        }
+
+        free(copy);
+        return w;
+
+_npw_error:
+        free(copy);
+        _watch_free(w);
+        return NULL;
+}
+
+
+/**
+ * stop watching a file and free watcher
+ *
+ * @param w watcher created by nft_prefs_watch()
+ * @note the callback won't be called anymore once this returns
+ */
+void nft_prefs_watch_stop(NftPrefsWatch * w)
+{
+        if(!w)
+                NFT_LOG_NULL();
+
+        if(write(w->stop[1], "", 1) != 1)
+                NFT_LOG_PERROR("write");
+
+        pthread_join(w->thread, NULL);
+
+        _watch_free(w);
+}
+
+
+/**
+ * @}
+ */
@@ -0,0 +1,870 @@
+/*
+ * libniftyprefs - lightweight modelless preferences management library
+ * Copyright (C) 2006-2014 Daniel Hiepler <daniel@niftylight.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/**
+ * @file xinclude.c
+ *
+ * XInclude processing with a cache of included files (s. 
+ * nft_prefs_set_include_cache()). Every file that's included by a 
+ * preferences file is parsed (and XInclude processed) once and kept by the
+ * context as long as its modification time, size and inode don't change. Every inclusion gets a copy of the cached tree. Files 
+ * that aren't cached yet are parsed concurrently before any substitution
+ * takes place.
+ *
+ * Only plain inclusions of local XML files are handled here. Everything
+ * else (xpointer, parse="text", fallbacks, remote files, ...) is left to 
+ * xmlXIncludeProcessFlags() which runs afterwards.
+ *
+ * If lazy XInclude processing is enabled (s. nft_prefs_set_lazy_xinclude())
+ * <xi:include> elements are kept as placeholders instead. The document 
+ * remembers the id of the context, so placeholders can be resolved when 
+ * they're reached for the first time (as long as the context exists). 
+ * Included nodes are updated from the version of the document.
+ */
+
+/**
+ * @addtogroup prefs_node
+ * @{
+ *
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <libxml/hash.h>
+#include <libxml/uri.h>
+#include <libxml/xinclude.h>
+#include <niftylog.h>
+#include "prefs.h"
+#include "arena.h"
+#include "node.h"
+#include "compress.h"
+#include "updater.h"
+#include "xinclude.h"
+
+
+
+/** maximum amount of threads used to parse included files */
+#define XINCLUDE_MAX_THREADS    64
+
+
+
+/** one parsed included file */
+typedef struct
+{
+        /** parsed & XInclude processed file */
+        xmlDoc *doc;
+        /** identity of the file when it was parsed */
+        dev_t dev;
+        ino_t ino;
+        off_t size;
+        struct timespec mtime;
+        /** parse options used */
+        int options;
+        /** false if the file includes other files (changes of those
+            couldn't be detected) */
+        bool cacheable;
+        /** references held by the cache & by documents being processed */
+        unsigned int refs;
+} IncludeEntry;
+
+
+/** include cache descriptor */
+struct _NftPrefsIncludes
+{
+        /** protects everything below & the refs of all entries */
+        pthread_mutex_t mutex;
+        /** IncludeEntry for each resolved URI */
+        xmlHashTablePtr entries;
+};
+
+
+/** one distinct file included by a document */
+typedef struct
+{
+        /** resolved URI */
+        xmlChar *uri;
+        /** local path of file (or NULL) */
+        char *path;
+        /** status of file */
+        struct stat sts;
+        /** parsed file (or NULL if it's left to libxml2) */
+        IncludeEntry *entry;
+} IncludeTarget;
+
+
+/** one <xi:include> element of a document */
+typedef struct
+{
+        /** the element */
+        xmlNode *node;
+        /** index of included file in list of targets */
+        size_t target;
+} IncludeRef;
+
+
+/** state of concurrent parsing of included files */
+typedef struct
+{
+        /** files to parse */
+        IncludeTarget **jobs;
+        size_t n;
+        /** index of next file to parse */
+        size_t next;
+        /** parse options */
+        int options;
+} IncludeFetch;
+
+
+
+
+/******************************************************************************/
+/**************************** STATIC FUNCTIONS ********************************/
+/******************************************************************************/
+
+/** drop reference of entry (cache mutex must be held) */
+static void _entry_unref(IncludeEntry * e)
+{
+        if(--e->refs > 0)
+                return;
+
+        xmlFreeDoc(e->doc);
+        free(e);
+}
+
+
+/** xmlHashDeallocator for cache entries */
+static void _entry_dealloc(void *payload, const xmlChar * name)
+{
+        _entry_unref(payload);
+}
+
+
+/** check whether cached entry still represents file */
+static bool _entry_valid(IncludeEntry * e, const struct stat *sts, int options)
+{
+        return e->dev == sts->st_dev &&
+                e->ino == sts->st_ino &&
+                e->size == sts->st_size &&
+                e->mtime.tv_sec == sts->st_mtim.tv_sec &&
+                e->mtime.tv_nsec == sts->st_mtim.tv_nsec &&
+                e->options == options;
+}
+
+
+/** parse included file like libxml2 would do it */
+static IncludeEntry *_entry_parse(IncludeTarget * t, int options)
+{
+        xmlParserCtxtPtr ctxt;
+        if(!(ctxt = xmlNewParserCtxt()))
+                return NULL;
+
+        xmlDoc *doc = _compress_read_file(ctxt, t->path,
+                                          options | XML_PARSE_DTDLOAD);
+        xmlFreeParserCtxt(ctxt);
+        if(!doc)
+        {
+                /* libxml2 will report this when it tries again */
+                NFT_LOG(L_DEBUG, "Failed to parse included file \"%s\"",
+                        t->uri);
+                return NULL;
+        }
+
+        /* relative URIs of nested inclusions are resolved against this */
+        xmlFree((xmlChar *) doc->URL);
+        doc->URL = xmlStrdup(t->uri);
+
+        int nested;
+        if((nested = xmlXIncludeProcessFlags(doc, options)) == -1)
+        {
+                xmlFreeDoc(doc);
+                return NULL;
+        }
+
+        IncludeEntry *e;
+        if(!(e = calloc(1, sizeof(IncludeEntry))))
+        {
+                NFT_LOG_PERROR("calloc");
+                xmlFreeDoc(doc);
+                return NULL;
+        }
+
+        e->doc = doc;
+        e->dev = t->sts.st_dev;
+        e->ino = t->sts.st_ino;
+        e->size = t->sts.st_size;
+        e->mtime = t->sts.st_mtim;
+        e->options = options;
+        e->cacheable = (nested == 0);
+        e->refs = 1;
+
+        return e;
+}
+
+
+/** parse files until there are no more left */
+static void *_fetch_worker(void *arg)
+{
+        IncludeFetch *f = arg;
+
+        size_t i;
+        while((i = __atomic_fetch_add(&f->next, 1, __ATOMIC_RELAXED)) < f->n)
+                f->jobs[i]->entry = _entry_parse(f->jobs[i], f->options);
+
+        return NULL;
+}
+
+
+/** additional thread parsing files */
+static void *_fetch_thread(void *arg)
+{
+        _prefs_thread_setup();
+
+        return _fetch_worker(arg);
+}
+
+
+/** parse files, one thread per core */
+static void _fetch(IncludeTarget ** jobs, size_t n, int options)
+{
+        IncludeFetch f = {
+                .jobs = jobs,
+                .n = n,
+                .options = options,
+        };
+
+        /* workers of nft_prefs_load_many() already keep all cores busy */
+        size_t threads = 1;
+        if(!_prefs_is_worker())
+        {
+                long cores = sysconf(_SC_NPROCESSORS_ONLN);
+                threads = cores > 0 ? (size_t) cores : 1;
+                if(threads > n)
+                        threads = n;
+                if(threads > XINCLUDE_MAX_THREADS)
+                        threads = XINCLUDE_MAX_THREADS;
+        }
+
+        pthread_t tids[XINCLUDE_MAX_THREADS];
+        size_t started = 0;
+        for(; started + 1 < threads; started++)
+        {
+                if(pthread_create(&tids[started], NULL, _fetch_thread, &f) != 0)
+                {
+                        NFT_LOG(L_WARNING, "Failed to start worker thread");
+                        break;
+                }
+        }
+
+        _fetch_worker(&f);
+
+        for(size_t t = 0; t < started; t++)
+                pthread_join(tids[t], NULL);
+}
+
+
+/** check whether node is an <xi:include> element */
+static bool _is_include(xmlNode * n)
+{
+        return n->type == XML_ELEMENT_NODE && n->ns &&
+                (xmlStrEqual(n->ns->href, XINCLUDE_NS) ||
+                 xmlStrEqual(n->ns->href, XINCLUDE_OLD_NS)) &&
+                xmlStrEqual(n->name, XINCLUDE_NODE);
+}
+
+
+/** resolve URI of file included by an <xi:include> element. Returns NULL
+    if the element can't be handled here */
+static xmlChar *_include_uri(xmlDoc * doc, xmlNode * n)
+{
+        /* multiple root elements, fallbacks & errors are left to libxml2 */
+        if(n->parent == (xmlNode *) doc || xmlFirstElementChild(n))
+                return NULL;
+
+        /* only plain inclusion of whole XML files */
+        xmlChar *parse = xmlGetProp(n, BAD_CAST "parse");
+        bool xml = !parse || xmlStrEqual(parse, BAD_CAST "xml");
+        xmlFree(parse);
+        if(!xml || xmlHasProp(n, BAD_CAST "xpointer"))
+                return NULL;
+
+        xmlChar *href;
+        if(!(href = xmlGetProp(n, BAD_CAST "href")))
+                return NULL;
+
+        xmlChar *uri = NULL;
+        if(*href && !xmlStrchr(href, '#'))
+        {
+                xmlChar *base = xmlNodeGetBase(doc, n);
+                uri = xmlBuildURI(href, base);
+                xmlFree(base);
+        }
+        xmlFree(href);
+
+        /* recursion is reported by libxml2 */
+        if(uri && doc->URL && xmlStrEqual(uri, doc->URL))
+        {
+                xmlFree(uri);
+                return NULL;
+        }
+
+        return uri;
+}
+
+
+/** local path of resolved URI (or NULL) */
+static char *_include_path(const xmlChar * uri)
+{
+        xmlURIPtr u;
+        if(!(u = xmlParseURI((const char *) uri)))
+                return NULL;
+
+        char *path = NULL;
+        if((!u->scheme || strcmp(u->scheme, "file") == 0) &&
+           (!u->server || !*u->server) && u->path && !u->fragment)
+        {
+                path = strdup(u->path);
+        }
+
+        xmlFreeURI(u);
+        return path;
+}
+
+
+/** collect all <xi:include> elements of a subtree and the distinct files 
+    they include */
+static NftResult _collect(xmlDoc * doc, xmlNode * tree, IncludeRef ** refs,
+                          size_t * nrefs, IncludeTarget ** targets,
+                          size_t * ntargets)
+{
+        NftResult r = NFT_FAILURE;
+        size_t refs_size = 0, targets_size = 0;
+
+        /* index + 1 of target for each URI */
+        xmlHashTablePtr index;
+        if(!(index = xmlHashCreate(16)))
+                return NFT_FAILURE;
+
+        xmlNode *n = tree;
+        while(n)
+        {
+                xmlChar *uri = NULL;
+                if(!_is_include(n) || !(uri = _include_uri(doc, n)))
+                {
+                        /* don't descend into <xi:include> elements */
+                        if(n->children && !_is_include(n) &&
+                           n->type == XML_ELEMENT_NODE)
+                        {
+                                n = n->children;
+                                continue;
+                        }
+                        goto _c_next;
+                }
+
+                /* new target? */
+                size_t t = (uintptr_t) xmlHashLookup(index, uri);
+                if(t == 0)
+                {
+                        if(*ntargets == targets_size)
+                        {
+                                targets_size = targets_size ? targets_size * 2 : 8;
+                                IncludeTarget *tmp;
+                                if(!(tmp = realloc(*targets, targets_size * sizeof(IncludeTarget))))
+                                {
+                                        NFT_LOG_PERROR("realloc");
+                                        xmlFree(uri);
+                                        goto _c_exit;
+                                }
+                                *targets = tmp;
+                        }
+
+                        IncludeTarget *target = &(*targets)[*ntargets];
+                        memset(target, 0, sizeof(IncludeTarget));
+                        target->uri = uri;
+                        t = ++(*ntargets);
+                        xmlHashAddEntry(index, uri, (void *) (uintptr_t) t);
+                }
+                else
+                {
+                        xmlFree(uri);
+                }
+
+                if(*nrefs == refs_size)
+                {
+                        refs_size = refs_size ? refs_size * 2 : 8;
+                        IncludeRef *tmp;
+                        if(!(tmp = realloc(*refs, refs_size * sizeof(IncludeRef))))
+                        {
+                                NFT_LOG_PERROR("realloc");
+                                goto _c_exit;
+                        }
+                        *refs = tmp;
+                }
+
+                (*refs)[*nrefs].node = n;
+                (*refs)[(*nrefs)++].target = t - 1;
+
+_c_next:
+                /* next node of subtree in document order */
+                while(n != tree && !n->next)
+                        n = n->parent;
+                n = (n == tree) ? NULL : n->next;
+        }
+
+        r = NFT_SUCCESS;
+
+_c_exit:
+        xmlHashFree(index, NULL);
+        return r;
+}
+
+
+/** replace <xi:include> element by copies of all top level nodes of the 
+    included document (like libxml2 does it) */
+static NftResult _substitute(xmlDoc * doc, xmlNode * inc,
+                             const xmlChar * uri, xmlDoc * included,
+                             int options)
+{
+        /* base URI of included file relative to the <xi:include> element.
+           Files of the same directory don't need an xml:base */
+        xmlChar *rel = NULL;
+        if(!(options & XML_PARSE_NOBASEFIX))
+        {
+                xmlChar *base = xmlNodeGetBase(doc, inc);
+                rel = xmlBuildRelativeURI(uri, base);
+                xmlFree(base);
+                if(rel && !xmlStrchr(rel, '/'))
+                {
+                        xmlFree(rel);
+                        rel = NULL;
+                }
+        }
+
+        /* nodes are inserted before this one */
+        xmlNode *anchor = inc;
+        if(!(options & XML_PARSE_NOXINCNODE))
+        {
+                if(!(anchor = xmlNewDocNode(doc, inc->ns, inc->name, NULL)))
+                {
+                        xmlFree(rel);
+                        return NFT_FAILURE;
+                }
+                anchor->type = XML_XINCLUDE_END;
+                xmlAddNextSibling(inc, anchor);
+        }
+
+        for(xmlNode *n = included->children; n; n = n->next)
+        {
+                if(n->type == XML_DTD_NODE)
+                        continue;
+
+                xmlNode *copy;
+                if(!(copy = xmlDocCopyNode(n, doc, 1)))
+                {
+                        NFT_LOG(L_ERROR, "Failed to copy included node");
+                        xmlFree(rel);
+                        return NFT_FAILURE;
+                }
+
+                if(rel && copy->type == XML_ELEMENT_NODE)
+                {
+                        xmlChar *base = xmlGetNsProp(copy, BAD_CAST "base",
+                                                     XML_XML_NAMESPACE);
+                        if(base)
+                        {
+                                xmlChar *fixed = xmlBuildURI(base, rel);
+                                xmlNodeSetBase(copy, fixed);
+                                xmlFree(fixed);
+                                xmlFree(base);
+                        }
+                        else
+                        {
+                                xmlNodeSetBase(copy, rel);
+                        }
+                }
+
+                xmlAddPrevSibling(anchor, copy);
+        }
+        xmlFree(rel);
+
+        /* <xi:include> element becomes the start marker or is removed */
+        if(options & XML_PARSE_NOXINCNODE)
+        {
+                xmlUnlinkNode(inc);
+                _arena_node_free(inc);
+        }
+        else
+        {
+                inc->type = XML_XINCLUDE_START;
+        }
+
+        return NFT_SUCCESS;
+}
+
+
+/** substitute all <xi:include> elements of a subtree that include local 
+    XML files using the include cache of the context. Returns amount of 
+    substitutions or -1 upon error */
+static int _process(NftPrefs * p, xmlDoc * doc, xmlNode * tree)
+{
+        int result = -1;
+        NftPrefsIncludes *c = _prefs_includes(p);
+
+        IncludeRef *refs = NULL;
+        IncludeTarget *targets = NULL, **jobs = NULL;
+        size_t nrefs = 0, ntargets = 0, njobs = 0;
+        if(!_collect(doc, tree, &refs, &nrefs, &targets, &ntargets))
+                goto _xp_exit;
+
+        if(ntargets == 0)
+        {
+                result = 0;
+                goto _xp_exit;
+        }
+
+        if(!(jobs = calloc(ntargets, sizeof(IncludeTarget *))))
+        {
+                NFT_LOG_PERROR("calloc");
+                goto _xp_exit;
+        }
+
+        /* cached entries may be used as long as the file is unchanged.
+           The documents of those are only read, so they can be shared */
+        int options = nft_prefs_get_parse_options(p);
+        for(size_t i = 0; i < ntargets; i++)
+        {
+                IncludeTarget *t = &targets[i];
+                if(!(t->path = _include_path(t->uri)) ||
+                   stat(t->path, &t->sts) != 0)
+                        continue;
+
+                pthread_mutex_lock(&c->mutex);
+                IncludeEntry *e = xmlHashLookup(c->entries, t->uri);
+                if(e && _entry_valid(e, &t->sts, options))
+                {
+                        e->refs++;
+                        t->entry = e;
+                }
+                pthread_mutex_unlock(&c->mutex);
+
+                if(!t->entry)
+                        jobs[njobs++] = t;
+        }
+
+        /* parse all files that aren't cached yet */
+        if(njobs > 0)
+                _fetch(jobs, njobs, options);
+
+        for(size_t i = 0; i < njobs; i++)
+        {
+                IncludeEntry *e;
+                if(!(e = jobs[i]->entry) || !e->cacheable)
+                        continue;
+
+                /* replaced entries are dropped once they're unused */
+                pthread_mutex_lock(&c->mutex);
+                e->refs++;
+                if(xmlHashUpdateEntry(c->entries, jobs[i]->uri, e, _entry_dealloc) != 0)
+                        e->refs--;
+                pthread_mutex_unlock(&c->mutex);
+        }
+
+        /* substitute in document order */
+        result = 0;
+        for(size_t i = 0; i < nrefs; i++)
+        {
+                IncludeTarget *t = &targets[refs[i].target];
+                if(!t->entry)
+                        continue;
+
+                if(!_substitute(doc, refs[i].node, t->uri, t->entry->doc, options))
+                {
+                        result = -1;
+                        break;
+                }
+                result++;
+        }
+
+_xp_exit:
+        pthread_mutex_lock(&c->mutex);
+        for(size_t i = 0; i < ntargets; i++)
+        {
+                if(targets[i].entry)
+                        _entry_unref(targets[i].entry);
+                xmlFree(targets[i].uri);
+                free(targets[i].path);
+        }
+        pthread_mutex_unlock(&c->mutex);
+
+        free(jobs);
+        free(targets);
+        free(refs);
+
+        return result;
+}
+
+
+/** resolve placeholder left by _xinclude_defer(). Returns the first element
+    that took its place, the next element if nothing was included or the
+    placeholder itself if it couldn't be resolved */
+static xmlNode *_resolve(xmlNode * inc)
+{
+        /* context might have been deinitialized since parsing */
+        NftPrefs *p;
+        if(!(p = _prefs_find(_arena_doc_get_xinclude(inc->doc))))
+        {
+                NFT_LOG(L_ERROR, "Context of XInclude placeholder was "
+                        "deinitialized, keeping <xi:include> element");
+                return inc;
+        }
+
+        int options = nft_prefs_get_parse_options(p);
+        xmlDoc *doc = inc->doc;
+        xmlNode *parent = inc->parent;
+
+        /* libxml2 frees the <xi:include> element & merges text nodes while 
+           including. The tree may live in an arena, so a copy of the element 
+           is processed inside a temporary element with the same base URI */
+        xmlNode *holder, *copy = NULL;
+        if(!(holder = xmlNewDocNode(doc, NULL, BAD_CAST "include", NULL)) ||
+           !(copy = xmlDocCopyNode(inc, doc, 1)))
+        {
+                NFT_LOG(L_ERROR, "Failed to copy <xi:include> element");
+                xmlFreeNode(copy);
+                xmlFreeNode(holder);
+                return inc;
+        }
+        xmlAddChild(holder, copy);
+        _arena_doc_modified(doc);
+
+        xmlChar *base;
+        if((base = xmlNodeGetBase(doc, parent)))
+        {
+                xmlNodeSetBase(holder, base);
+                xmlFree(base);
+        }
+
+        int r = 0;
+        if(_prefs_get_include_cache(p))
+                r = _process(p, doc, copy);
+        if(r == 0)
+                r = xmlXIncludeProcessTreeFlags(copy, options);
+
+        if(r <= 0)
+        {
+                NFT_LOG(L_ERROR, "XInclude parsing failed.");
+                xmlFreeNode(holder);
+                return inc;
+        }
+
+        /* result takes the place of the <xi:include> element */
+        _node_index_invalidate(parent);
+        xmlNode *after = inc->next;
+        xmlNode *first = holder->children, *last = holder->last;
+        for(xmlNode * n = first; n; n = n->next)
+                n->parent = parent;
+        holder->children = holder->last = NULL;
+        xmlFreeNode(holder);
+
+        if(first)
+        {
+                first->prev = inc->prev;
+                last->next = inc->next;
+                if(inc->prev)
+                        inc->prev->next = first;
+                else
+                        parent->children = first;
+                if(inc->next)
+                        inc->next->prev = last;
+                else
+                        parent->last = last;
+                inc->prev = inc->next = NULL;
+                inc->parent = NULL;
+        }
+        else
+        {
+                xmlUnlinkNode(inc);
+        }
+        _arena_node_free(inc);
+
+        /* update included nodes like the rest of the document */
+        if(first && !_updater_nodes_process(p, xmlDocGetRootElement(doc),
+                                            first, last))
+                NFT_LOG(L_ERROR, "Preference update of included nodes failed");
+
+        /* nothing included */
+        if(!first)
+                return (after && after->type == XML_ELEMENT_NODE) ?
+                        after : xmlNextElementSibling(after);
+
+        /* copy of <xi:include> element became the start marker */
+        if(!(options & XML_PARSE_NOXINCNODE))
+                return xmlNextElementSibling(first);
+
+        return (first->type == XML_ELEMENT_NODE) ?
+                first : xmlNextElementSibling(first);
+}
+
+
+/******************************************************************************/
+/**************************** PRIVATE FUNCTIONS *******************************/
+/******************************************************************************/
+
+/** substitute all <xi:include> elements of a document that include local 
+    XML files using the include cache of the context. Returns amount of 
+    substitutions or -1 upon error */
+int _xinclude_process(NftPrefs * p, xmlDoc * doc)
+{
+        xmlNode *root;
+        if(!(root = xmlDocGetRootElement(doc)))
+                return 0;
+
+        return _process(p, doc, root);
+}
+
+
+/** keep all <xi:include> elements of a document as placeholders that are 
+    resolved by _xinclude_expand(). Returns amount of placeholders */
+int _xinclude_defer(NftPrefs * p, xmlDoc * doc)
+{
+        int result = 0;
+
+        xmlNode *root, *n;
+        if(!(root = n = xmlDocGetRootElement(doc)))
+                return 0;
+
+        if(!_arena_doc_set_xinclude(doc, _prefs_get_id(p)))
+                return -1;
+
+        while(n)
+        {
+                if(_is_include(n))
+                {
+                        result++;
+                }
+                else if(n->type == XML_ELEMENT_NODE && n->children)
+                {
+                        n = n->children;
+                        continue;
+                }
+
+                while(n != root && !n->next)
+                        n = n->parent;
+                n = (n == root) ? NULL : n->next;
+        }
+
+        return result;
+}
+
+
+/** true if node is an <xi:include> element that's resolved when it's 
+    reached (s. _xinclude_defer()) */
+bool _xinclude_is_placeholder(xmlNode * n)
+{
+        return _is_include(n) && _arena_doc_get_xinclude(n->doc);
+}
+
+
+/** resolve placeholders until node is a regular element (or NULL) */
+xmlNode *_xinclude_expand(xmlNode * n)
+{
+        while(n && _xinclude_is_placeholder(n))
+        {
+                xmlNode *next;
+                if((next = _resolve(n)) == n)
+                        break;
+                n = next;
+        }
+
+        return n;
+}
+
+
+/** create empty include cache */
+NftPrefsIncludes *_xinclude_cache_new(void)
+{
+        NftPrefsIncludes *c;
+        if(!(c = calloc(1, sizeof(NftPrefsIncludes))))
+        {
+                NFT_LOG_PERROR("calloc");
+                return NULL;
+        }
+
+        if(pthread_mutex_init(&c->mutex, NULL) != 0)
+        {
+                NFT_LOG(L_ERROR, "Failed to initialize mutex");
+                free(c);
+                return NULL;
+        }
+
+        if(!(c->entries = xmlHashCreate(16)))
+        {
+                NFT_LOG(L_ERROR, "Failed to create hashtable");
+                pthread_mutex_destroy(&c->mutex);
+                free(c);
+                return NULL;
+        }
+
+        return c;
+}
+
+
+/** free include cache and all cached files */
+void _xinclude_cache_free(NftPrefsIncludes * c)
+{
+        if(!c)
+                return;
+
+        xmlHashFree(c->entries, _entry_dealloc);
+        pthread_mutex_destroy(&c->mutex);
+        free(c);
+}
+
+
+/**
+ * @}
+ */
@@ -0,0 +1,214 @@
+/*
+ * libniftyprefs - lightweight modelless preferences management library
+ * Copyright (C) 2006-2014 Daniel Hiepler <daniel@niftylight.de>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <stdlib.h>
+#include <niftylog.h>
+#include <niftyprefs.h>
+
+
+/* file to read from (created by obj-to-prefs test) */
+#define FILE_NAME   "test-prefs.xml"
+
+/* name of test class */
+#define TREE_NAME   "tree"
+
+/* depth of generated tree */
+#define TREE_DEPTH  6
+
+/* amount of parse/free cycles */
+#define CYCLES      64
+
+
+
+/** create a tree of nodes (called recursively through nft_prefs_obj_to_node) */
+static NftResult _tree_to_prefs(NftPrefs * p, NftPrefsNode * newNode,
+                                void *obj, void *userptr)
+{
+        int depth = *(int *) obj;
+
+        if(!nft_prefs_node_prop_int_set(newNode, "depth", depth) ||
+           !nft_prefs_node_prop_string_set(newNode, "name",
+                                           "a somewhat longer property value") ||
+           !nft_prefs_node_prop_boolean_set(newNode, "leaf", depth == 0))
+                return NFT_FAILURE;
+
+        if(depth == 0)
+                return NFT_SUCCESS;
+
+        int child = depth - 1;
+        for(int i = 0; i < 3; i++)
+        {
+                NftPrefsNode *n;
+                if(!(n = nft_prefs_obj_to_node(p, TREE_NAME, &child, NULL)))
+                        return NFT_FAILURE;
+
+                if(!nft_prefs_node_add_child(newNode, n))
+                        return NFT_FAILURE;
+        }
+
+        /* plain node */
+        NftPrefsNode *n;
+        if(!(n = nft_prefs_node_alloc("plain")) ||
+           !nft_prefs_node_add_child(newNode, n))
+                return NFT_FAILURE;
+
+        return NFT_SUCCESS;
+}
+
+
+/** parse file & create tree with current settings, return dumps */
+static NftResult _dump(NftPrefs * p, char **parsed, char **created)
+{
+        NftPrefsNode *n;
+        int depth = TREE_DEPTH;
+
+        if(!(n = nft_prefs_node_from_file(p, FILE_NAME)))
+                return NFT_FAILURE;
+        *parsed = nft_prefs_node_to_buffer(p, n);
+        nft_prefs_node_free(n);
+
+        if(!(n = nft_prefs_obj_to_node(p, TREE_NAME, &depth, NULL)))
+                return NFT_FAILURE;
+        *created = nft_prefs_node_to_buffer(p, n);
+        nft_prefs_node_free(n);
+
+        return (*parsed && *created) ? NFT_SUCCESS : NFT_FAILURE;
+}
+
+
+/** trees allocated from arenas must behave exactly like heap trees */
+int main(int argc, char *argv[])
+{
+        /* do preliminary version checks */
+        if(!NFT_PREFS_CHECK_VERSION)
+                return EXIT_FAILURE;
+
+        /* fail per default */
+        int result = EXIT_FAILURE;
+
+        char *heap_parsed = NULL, *heap_created = NULL;
+        char *arena_parsed = NULL, *arena_created = NULL;
+        char *before = NULL, *after = NULL;
+        NftPrefsNode *heap = NULL, *arena = NULL;
+
+
+        /* initialize libniftyprefs */
+        NftPrefs *prefs;
+        if(!(prefs = nft_prefs_init(0)))
+                return EXIT_FAILURE;
+
+        if(!nft_prefs_class_register(prefs, TREE_NAME, NULL, _tree_to_prefs))
+                goto _deinit;
+
+
+        /* create reference output using the heap */
+        if(!_dump(prefs, &heap_parsed, &heap_created))
+                goto _deinit;
+
+        /* same using arenas */
+        if(!nft_prefs_set_arena(prefs, true) || !nft_prefs_get_arena(prefs))
+                goto _deinit;
+
+        for(int i = 0; i < CYCLES; i++)
+        {
+                free(arena_parsed);
+                free(arena_created);
+                arena_parsed = arena_created = NULL;
+                if(!_dump(prefs, &arena_parsed, &arena_created))
+                        goto _deinit;
+        }
+
+        if(strcmp(heap_parsed, arena_parsed) != 0 ||
+           strcmp(heap_created, arena_created) != 0)
+        {
+                NFT_LOG(L_ERROR, "arena trees differ from heap trees");
+                goto _deinit;
+        }
+
+
+        /* move nodes between arena- and heap trees */
+        int depth = 2;
+        if(!(arena = nft_prefs_obj_to_node(prefs, TREE_NAME, &depth, NULL)))
+                goto _deinit;
+
+        nft_prefs_set_arena(prefs, false);
+        if(!(heap = nft_prefs_obj_to_node(prefs, TREE_NAME, &depth, NULL)))
+                goto _deinit;
+
+        /* arena node into heap tree, heap node into arena tree */
+        NftPrefsNode *a = nft_prefs_node_get_first_child(arena);
+        NftPrefsNode *h = nft_prefs_node_get_first_child(heap);
+        if(!nft_prefs_node_add_child(heap, a) ||
+           !nft_prefs_node_add_child(arena, h) ||
+           !nft_prefs_node_prop_string_set(a, "moved", "to heap") ||
+           !nft_prefs_node_prop_string_set(h, "moved", "to arena"))
+                goto _deinit;
+
+        /* arena of moved node must survive its tree */
+        before = nft_prefs_node_to_buffer(prefs, heap);
+        nft_prefs_node_free(arena);
+        arena = NULL;
+        after = nft_prefs_node_to_buffer(prefs, heap);
+        if(!before || !after || strcmp(before, after) != 0)
+        {
+                NFT_LOG(L_ERROR, "moved node changed after freeing its arena");
+                goto _deinit;
+        }
+
+
+        result = EXIT_SUCCESS;
+
+_deinit:
+        nft_prefs_node_free(arena);
+        nft_prefs_node_free(heap);
+        free(heap_parsed);
+        free(heap_created);
+        free(arena_parsed);
+        free(arena_created);
+        free(before);
+        free(after);
+        nft_prefs_deinit(prefs);
+
+        return result;
+}
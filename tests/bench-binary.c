@@ -0,0 +1,163 @@
+/*
+ * libniftyprefs - lightweight modelless preferences management library
+ * Copyright (C) 2006-2014 Daniel Hiepler <daniel@niftylight.de>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <niftylog.h>
+#include <niftyprefs.h>
+#include "bench.h"
+
+
+/* files written by this benchmark */
+#define XML_NAME        "bench-binary.xml"
+#define BINARY_NAME     "bench-binary.bin"
+
+/* amount of items in generated tree */
+#define ITEMS           20000
+/* amount of write/read cycles per format */
+#define CYCLES          8
+
+
+
+/** generate tree with ITEMS children */
+static NftPrefsNode *_generate()
+{
+        NftPrefsNode *root;
+        if(!(root = nft_prefs_node_alloc("bench")))
+                return NULL;
+
+        for(int i = 0; i < ITEMS; i++)
+        {
+                NftPrefsNode *n;
+                if(!(n = nft_prefs_node_alloc("item")))
+                        goto _g_error;
+
+                char name[64];
+                snprintf(name, sizeof(name), "item-%d <&\"%d\">", i, i % 7);
+                if(!nft_prefs_node_prop_string_set(n, "name", name) ||
+                   !nft_prefs_node_prop_int_set(n, "id", i - ITEMS / 2) ||
+                   !nft_prefs_node_prop_double_set(n, "weight", i * 0.37 - 1000) ||
+                   !nft_prefs_node_prop_boolean_set(n, "enabled", i & 1) ||
+                   !nft_prefs_node_prop_string_set(n, "padded", "007") ||
+                   !nft_prefs_node_add_child(root, n))
+                {
+                        nft_prefs_node_free(n);
+                        goto _g_error;
+                }
+        }
+
+        return root;
+
+_g_error:
+        nft_prefs_node_free(root);
+        return NULL;
+}
+
+
+/** write & read a generated tree as XML and in binary format */
+int main(int argc, char *argv[])
+{
+        /* do preliminary version checks */
+        if(!NFT_PREFS_CHECK_VERSION)
+                return EXIT_FAILURE;
+
+        /* fail per default */
+        int result = EXIT_FAILURE;
+
+        NftPrefsNode *n = NULL;
+
+
+        /* initialize libniftyprefs */
+        NftPrefs *prefs;
+        if(!(prefs = nft_prefs_init(0)))
+                return EXIT_FAILURE;
+
+        if(!(n = _generate()))
+                goto _deinit;
+
+        double t_xml_write = 0, t_xml_read = 0, t_bin_write = 0, t_bin_read = 0;
+        for(int i = 0; i < CYCLES; i++)
+        {
+                NftPrefsNode *r;
+
+                double t = bench_now();
+                if(!nft_prefs_node_to_file(prefs, n, XML_NAME, true))
+                        goto _deinit;
+                t_xml_write += bench_now() - t;
+
+                t = bench_now();
+                if(!(r = nft_prefs_node_from_file(prefs, XML_NAME)))
+                        goto _deinit;
+                t_xml_read += bench_now() - t;
+                nft_prefs_node_free(r);
+
+                t = bench_now();
+                if(!nft_prefs_node_to_file_binary(prefs, n, BINARY_NAME, true))
+                        goto _deinit;
+                t_bin_write += bench_now() - t;
+
+                t = bench_now();
+                if(!(r = nft_prefs_node_from_file_binary(prefs, BINARY_NAME)))
+                        goto _deinit;
+                t_bin_read += bench_now() - t;
+                nft_prefs_node_free(r);
+        }
+
+        printf("%d items, XML:    write %.2f ms, read %.2f ms\n", ITEMS,
+               t_xml_write / CYCLES, t_xml_read / CYCLES);
+        printf("%d items, binary: write %.2f ms, read %.2f ms\n", ITEMS,
+               t_bin_write / CYCLES, t_bin_read / CYCLES);
+
+        result = EXIT_SUCCESS;
+
+_deinit:
+        nft_prefs_node_free(n);
+        unlink(XML_NAME);
+        unlink(BINARY_NAME);
+        nft_prefs_deinit(prefs);
+
+        return result;
+}
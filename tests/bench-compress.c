@@ -0,0 +1,177 @@
+/*
+ * libniftyprefs - lightweight modelless preferences management library
+ * Copyright (C) 2006-2014 Daniel Hiepler <daniel@niftylight.de>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <niftylog.h>
+#include <niftyprefs.h>
+#include "bench.h"
+
+
+/* file written & read by this benchmark */
+#define FILE_NAME       "bench-compress.xml"
+
+/* amount of items in generated tree */
+#define ITEMS           20000
+
+
+/** compression settings to compare */
+static const struct
+{
+        NftPrefsCompression compression;
+        int level;
+        const char *name;
+} _settings[] =
+{
+        { NFT_PREFS_COMPRESSION_NONE, -1, "none" },
+        { NFT_PREFS_COMPRESSION_GZIP, 1, "gzip -1" },
+        { NFT_PREFS_COMPRESSION_GZIP, 6, "gzip -6" },
+        { NFT_PREFS_COMPRESSION_GZIP, 9, "gzip -9" },
+        { NFT_PREFS_COMPRESSION_ZSTD, 1, "zstd -1" },
+        { NFT_PREFS_COMPRESSION_ZSTD, 3, "zstd -3" },
+        { NFT_PREFS_COMPRESSION_ZSTD, 19, "zstd -19" },
+};
+
+
+
+/** generate tree with ITEMS children */
+static NftPrefsNode *_generate()
+{
+        NftPrefsNode *root;
+        if(!(root = nft_prefs_node_alloc("bench")))
+                return NULL;
+
+        for(int i = 0; i < ITEMS; i++)
+        {
+                NftPrefsNode *n;
+                if(!(n = nft_prefs_node_alloc("item")))
+                        goto _g_error;
+
+                char name[64];
+                snprintf(name, sizeof(name), "item-%d", i);
+                if(!nft_prefs_node_prop_string_set(n, "name", name) ||
+                   !nft_prefs_node_prop_int_set(n, "id", i) ||
+                   !nft_prefs_node_prop_double_set(n, "weight", i * 0.37) ||
+                   !nft_prefs_node_prop_boolean_set(n, "enabled", i & 1) ||
+                   !nft_prefs_node_add_child(root, n))
+                {
+                        nft_prefs_node_free(n);
+                        goto _g_error;
+                }
+        }
+
+        return root;
+
+_g_error:
+        nft_prefs_node_free(root);
+        return NULL;
+}
+
+
+/** compare size & time of compressed files */
+int main(int argc, char *argv[])
+{
+        /* do preliminary version checks */
+        if(!NFT_PREFS_CHECK_VERSION)
+                return EXIT_FAILURE;
+
+        /* fail per default */
+        int result = EXIT_FAILURE;
+
+        NftPrefsNode *n = NULL;
+
+
+        /* initialize libniftyprefs */
+        NftPrefs *prefs;
+        if(!(prefs = nft_prefs_init(0)))
+                return EXIT_FAILURE;
+
+        if(!(n = _generate()))
+                goto _deinit;
+
+        printf("%-10s %10s %10s %10s\n", "compression", "bytes", "write ms", "read ms");
+
+        for(size_t s = 0; s < sizeof(_settings) / sizeof(_settings[0]); s++)
+        {
+                if(!nft_prefs_compression_supported(_settings[s].compression))
+                {
+                        printf("%-10s (not supported)\n", _settings[s].name);
+                        continue;
+                }
+
+                double t = bench_now();
+                if(!nft_prefs_node_to_file_compressed(prefs, n, FILE_NAME, true,
+                                                      _settings[s].compression,
+                                                      _settings[s].level))
+                        goto _deinit;
+                double t_write = bench_now() - t;
+
+                struct stat sts;
+                if(stat(FILE_NAME, &sts) != 0)
+                        goto _deinit;
+
+                t = bench_now();
+                NftPrefsNode *r;
+                if(!(r = nft_prefs_node_from_file(prefs, FILE_NAME)))
+                        goto _deinit;
+                double t_read = bench_now() - t;
+                nft_prefs_node_free(r);
+
+                printf("%-10s %10ld %10.2f %10.2f\n", _settings[s].name,
+                       (long) sts.st_size, t_write, t_read);
+        }
+
+        result = EXIT_SUCCESS;
+
+_deinit:
+        nft_prefs_node_free(n);
+        unlink(FILE_NAME);
+        nft_prefs_deinit(prefs);
+
+        return result;
+}
@@ -0,0 +1,164 @@
+/*
+ * libniftyprefs - lightweight modelless preferences management library
+ * Copyright (C) 2006-2014 Daniel Hiepler <daniel@niftylight.de>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <niftylog.h>
+#include <niftyprefs.h>
+#include "bench.h"
+
+
+/* amount of values */
+#define BENCHMARK       1000000
+
+
+/** state of random number generator */
+static uint64_t _state = 0x9e3779b97f4a7c15;
+
+
+
+/** deterministic 64 bit random numbers (xorshift64*) */
+static uint64_t _random()
+{
+        _state ^= _state >> 12;
+        _state ^= _state << 25;
+        _state ^= _state >> 27;
+        return _state * UINT64_C(2685821657736338717);
+}
+
+
+/** compare with snprintf() & strtod() */
+static bool _benchmark(NftPrefsNode * n)
+{
+        double *values = malloc(sizeof(double) * BENCHMARK);
+        if(!values)
+                return false;
+
+        for(int i = 0; i < BENCHMARK; i++)
+                values[i] = (double) (_random() >> 11) / (1 << 20) - 1e9;
+
+        double sum = 0, d;
+
+        double t = bench_now();
+        for(int i = 0; i < BENCHMARK; i++)
+        {
+                nft_prefs_node_prop_double_set(n, "v", values[i]);
+                nft_prefs_node_prop_double_get(n, "v", &d);
+                sum += d;
+        }
+        double tdouble = bench_now() - t;
+
+        t = bench_now();
+        for(int i = 0; i < BENCHMARK; i++)
+        {
+                char tmp[32];
+                snprintf(tmp, sizeof(tmp), "%.17g", values[i]);
+                nft_prefs_node_prop_string_set(n, "v", tmp);
+                sum += strtod(nft_prefs_node_prop_string_borrow(n, "v", NULL), NULL);
+        }
+        double tprintf = bench_now() - t;
+
+        t = bench_now();
+        for(int i = 0; i < BENCHMARK; i++)
+        {
+                nft_prefs_node_prop_long_int_set(n, "v", (long int) values[i]);
+                long int l;
+                nft_prefs_node_prop_long_int_get(n, "v", &l);
+                sum += l;
+        }
+        double tlong = bench_now() - t;
+
+        t = bench_now();
+        for(int i = 0; i < BENCHMARK; i++)
+        {
+                char tmp[32];
+                snprintf(tmp, sizeof(tmp), "%ld", (long int) values[i]);
+                nft_prefs_node_prop_string_set(n, "v", tmp);
+                sum += strtol(nft_prefs_node_prop_string_borrow(n, "v", NULL), NULL, 10);
+        }
+        double tstrtol = bench_now() - t;
+
+        printf("%d double set & get: %.2f ms, snprintf(\"%%.17g\") & strtod() %.2f ms\n",
+               BENCHMARK, tdouble, tprintf);
+        printf("%d long set & get: %.2f ms, snprintf(\"%%ld\") & strtol() %.2f ms (%g)\n",
+               BENCHMARK, tlong, tstrtol, sum);
+
+        free(values);
+        return true;
+}
+
+
+/** time formatting & parsing of numeric properties */
+int main(int argc, char *argv[])
+{
+        /* do preliminary version checks */
+        if(!NFT_PREFS_CHECK_VERSION)
+                return EXIT_FAILURE;
+
+        /* fail per default */
+        int result = EXIT_FAILURE;
+
+        /* initialize libniftyprefs */
+        NftPrefs *prefs;
+        if(!(prefs = nft_prefs_init(0)))
+                return EXIT_FAILURE;
+
+        NftPrefsNode *n;
+        if(!(n = nft_prefs_node_alloc("number")))
+                goto _deinit;
+
+        bool ok = _benchmark(n);
+        nft_prefs_node_free(n);
+        if(!ok)
+                goto _deinit;
+
+        result = EXIT_SUCCESS;
+
+_deinit:
+        nft_prefs_deinit(prefs);
+
+        return result;
+}
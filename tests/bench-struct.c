@@ -0,0 +1,274 @@
+/*
+ * libniftyprefs - lightweight modelless preferences management library
+ * Copyright (C) 2006-2014 Daniel Hiepler <daniel@niftylight.de>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <niftylog.h>
+#include <niftyprefs.h>
+#include "bench.h"
+
+
+/* amount of points per shape */
+#define POINTS          4
+/* amount of conversions per class */
+#define ROUNDS          50000
+
+
+/** nested struct */
+struct Point
+{
+        int x;
+        int y;
+        double weight;
+};
+
+/** struct with array of nested structs */
+struct Shape
+{
+        char name[16];
+        struct Point *points;
+        size_t points_count;
+};
+
+
+/** descriptors of Point */
+static const NftPrefsFieldDesc POINT[] =
+{
+        NFT_PREFS_FIELD("x", NFT_PREFS_PROP_INT, struct Point, x, NULL),
+        NFT_PREFS_FIELD("y", NFT_PREFS_PROP_INT, struct Point, y, NULL),
+        NFT_PREFS_FIELD("weight", NFT_PREFS_PROP_DOUBLE, struct Point, weight, "1.5"),
+};
+
+/** descriptors of Shape */
+static const NftPrefsFieldDesc SHAPE[] =
+{
+        NFT_PREFS_FIELD("name", NFT_PREFS_PROP_STRING, struct Shape, name, NULL),
+        NFT_PREFS_FIELD_ARRAY(struct Shape, points, points_count, "point"),
+};
+
+/** amount of descriptors */
+#define COUNT(a)        (sizeof(a) / sizeof(a[0]))
+
+
+
+/** hand-written prefsFromObj() of Point */
+static NftResult _point_from_obj(NftPrefs * p, NftPrefsNode * n, void *obj,
+                                 void *userptr)
+{
+        struct Point *pt = obj;
+        return nft_prefs_node_prop_int_set(n, "x", pt->x) &&
+                nft_prefs_node_prop_int_set(n, "y", pt->y) &&
+                nft_prefs_node_prop_double_set(n, "weight", pt->weight);
+}
+
+
+/** hand-written prefsToObj() of Point */
+static NftResult _point_to_obj(NftPrefs * p, void **newObj, NftPrefsNode * n,
+                               void *userptr)
+{
+        struct Point *pt;
+        if(!(pt = malloc(sizeof(struct Point))))
+                return NFT_FAILURE;
+
+        pt->x = pt->y = 0;
+        pt->weight = 1.5;
+        nft_prefs_node_prop_int_get(n, "x", &pt->x);
+        nft_prefs_node_prop_int_get(n, "y", &pt->y);
+        nft_prefs_node_prop_double_get(n, "weight", &pt->weight);
+
+        *newObj = pt;
+        return NFT_SUCCESS;
+}
+
+
+/** hand-written prefsFromObj() of Shape */
+static NftResult _shape_from_obj(NftPrefs * p, NftPrefsNode * n, void *obj,
+                                 void *userptr)
+{
+        struct Shape *s = obj;
+        if(!nft_prefs_node_prop_string_set(n, "name", s->name))
+                return NFT_FAILURE;
+
+        for(size_t i = 0; i < s->points_count; i++)
+        {
+                NftPrefsNode *c;
+                if(!(c = nft_prefs_obj_to_node(p, "point-cb", &s->points[i], NULL)))
+                        return NFT_FAILURE;
+
+                if(!nft_prefs_node_add_child(n, c))
+                {
+                        nft_prefs_node_free(c);
+                        return NFT_FAILURE;
+                }
+        }
+
+        return NFT_SUCCESS;
+}
+
+
+/** hand-written prefsToObj() of Shape */
+static NftResult _shape_to_obj(NftPrefs * p, void **newObj, NftPrefsNode * n,
+                               void *userptr)
+{
+        struct Shape *s;
+        if(!(s = calloc(1, sizeof(struct Shape))))
+                return NFT_FAILURE;
+
+        const char *name = nft_prefs_node_prop_string_borrow(n, "name", NULL);
+        if(name)
+                strncpy(s->name, name, sizeof(s->name) - 1);
+
+        s->points_count = nft_prefs_node_get_child_count(n);
+        if(s->points_count &&
+           !(s->points = malloc(s->points_count * sizeof(struct Point))))
+        {
+                free(s);
+                return NFT_FAILURE;
+        }
+
+        size_t i = 0;
+        for(NftPrefsNode * c = nft_prefs_node_get_first_child(n); c;
+            c = nft_prefs_node_get_next(c))
+        {
+                struct Point *pt;
+                if(!(pt = nft_prefs_obj_from_node(p, c, NULL)))
+                        continue;
+                s->points[i++] = *pt;
+                free(pt);
+        }
+        s->points_count = i;
+
+        *newObj = s;
+        return NFT_SUCCESS;
+}
+
+
+/** time conversion of one shape class in both directions */
+static bool _benchmark(NftPrefs * prefs, const char *className,
+                       struct Shape *shape, bool bound)
+{
+        double to = 0, from = 0;
+        for(int r = 0; r < ROUNDS; r++)
+        {
+                double t = bench_now();
+                NftPrefsNode *n;
+                if(!(n = nft_prefs_obj_to_node(prefs, className, shape, NULL)))
+                        return false;
+                to += bench_now() - t;
+
+                t = bench_now();
+                struct Shape *s = nft_prefs_obj_from_node(prefs, n, NULL);
+                from += bench_now() - t;
+                nft_prefs_node_free(n);
+
+                if(!s || s->points_count != POINTS)
+                        return false;
+
+                if(bound)
+                {
+                        nft_prefs_class_free_struct(prefs, className, s);
+                }
+                else
+                {
+                        free(s->points);
+                        free(s);
+                }
+        }
+
+        printf("%d <%s> with %d nested points: to node %.2f ms, from node %.2f ms\n",
+               ROUNDS, className, POINTS, to, from);
+        return true;
+}
+
+
+/** compare struct binding with hand-written callbacks */
+int main(int argc, char *argv[])
+{
+        /* do preliminary version checks */
+        if(!NFT_PREFS_CHECK_VERSION)
+                return EXIT_FAILURE;
+
+        /* fail per default */
+        int result = EXIT_FAILURE;
+
+        /* initialize libniftyprefs */
+        NftPrefs *prefs;
+        if(!(prefs = nft_prefs_init(0)))
+                return EXIT_FAILURE;
+
+        struct Point *points;
+        if(!(points = malloc(POINTS * sizeof(struct Point))))
+                goto _deinit;
+
+        for(int i = 0; i < POINTS; i++)
+        {
+                points[i].x = i;
+                points[i].y = -i;
+                points[i].weight = i / 4.0;
+        }
+        struct Shape shape = { "polygon", points, POINTS };
+
+        /* nested class is registered after its parent */
+        if(!nft_prefs_class_register_struct(prefs, "shape", sizeof(struct Shape), SHAPE, COUNT(SHAPE)) ||
+           !nft_prefs_class_register_struct(prefs, "point", sizeof(struct Point), POINT, COUNT(POINT)) ||
+           !nft_prefs_class_register(prefs, "shape-cb", _shape_to_obj, _shape_from_obj) ||
+           !nft_prefs_class_register(prefs, "point-cb", _point_to_obj, _point_from_obj))
+                goto _free;
+
+        if(!_benchmark(prefs, "shape", &shape, true) ||
+           !_benchmark(prefs, "shape-cb", &shape, false))
+                goto _free;
+
+        result = EXIT_SUCCESS;
+
+_free:
+        free(points);
+_deinit:
+        nft_prefs_deinit(prefs);
+
+        return result;
+}
@@ -0,0 +1,198 @@
+/*
+ * libniftyprefs - lightweight modelless preferences management library
+ * Copyright (C) 2006-2014 Daniel Hiepler <daniel@niftylight.de>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <niftylog.h>
+#include <niftyprefs.h>
+
+
+/* file to read from (created by obj-to-prefs test) */
+#define FILE_NAME       "test-prefs.xml"
+/* file written & loaded by this test */
+#define CACHED_NAME     "test-cache.xml"
+/* cache of CACHED_NAME */
+#define CACHE_NAME      ".test-cache.xml.cache"
+
+
+
+/** load file and compare with expected dump. Also check whether the cache 
+    was used (inode of cache file is unchanged) */
+static bool _load(NftPrefs * prefs, const char *expected, bool from_cache)
+{
+        struct stat before, after;
+        bool existed = (stat(CACHE_NAME, &before) == 0);
+
+        NftPrefsNode *n;
+        if(!(n = nft_prefs_node_from_file(prefs, CACHED_NAME)))
+                return false;
+
+        char *dump = nft_prefs_node_to_buffer(prefs, n);
+        nft_prefs_node_free(n);
+        if(!dump)
+                return false;
+
+        bool result = (strcmp(dump, expected) == 0);
+        free(dump);
+        if(!result)
+        {
+                NFT_LOG(L_ERROR, "loaded tree differs from expected tree");
+                return false;
+        }
+
+        if(stat(CACHE_NAME, &after) != 0)
+        {
+                NFT_LOG(L_ERROR, "cache \"%s\" wasn't created", CACHE_NAME);
+                return false;
+        }
+
+        if((existed && before.st_ino == after.st_ino) != from_cache)
+        {
+                NFT_LOG(L_ERROR, "cache was %sused", from_cache ? "not " : "");
+                return false;
+        }
+
+        return true;
+}
+
+
+/** write tree to CACHED_NAME and return its dump */
+static char *_write(NftPrefs * prefs, NftPrefsNode * n)
+{
+        if(!nft_prefs_node_to_file(prefs, n, CACHED_NAME, true))
+                return NULL;
+
+        return nft_prefs_node_to_buffer(prefs, n);
+}
+
+
+/** load files through the parse cache */
+int main(int argc, char *argv[])
+{
+        /* do preliminary version checks */
+        if(!NFT_PREFS_CHECK_VERSION)
+                return EXIT_FAILURE;
+
+        /* fail per default */
+        int result = EXIT_FAILURE;
+
+        NftPrefsNode *n = NULL;
+        char *expected = NULL;
+
+
+        /* initialize libniftyprefs */
+        NftPrefs *prefs;
+        if(!(prefs = nft_prefs_init(0)))
+                return EXIT_FAILURE;
+
+        nft_prefs_set_cache(prefs, true);
+
+
+        for(int arena = 0; arena <= 1; arena++)
+        {
+                if(!nft_prefs_set_arena(prefs, arena))
+                        goto _deinit;
+
+                unlink(CACHE_NAME);
+
+                /* create file to be cached */
+                if(!(n = nft_prefs_node_from_file(prefs, FILE_NAME)) ||
+                   !(expected = _write(prefs, n)))
+                        goto _deinit;
+
+                /* first load creates cache, second one uses it */
+                if(!_load(prefs, expected, false) ||
+                   !_load(prefs, expected, true))
+                        goto _deinit;
+
+                /* modified file invalidates cache */
+                free(expected);
+                if(!nft_prefs_node_prop_string_set(n, "modified", "yes") ||
+                   !(expected = _write(prefs, n)))
+                        goto _deinit;
+
+                if(!_load(prefs, expected, false) ||
+                   !_load(prefs, expected, true))
+                        goto _deinit;
+
+                /* corrupt cache is replaced */
+                FILE *f;
+                if(!(f = fopen(CACHE_NAME, "r+")))
+                        goto _deinit;
+                fseek(f, -3, SEEK_END);
+                fputc('#', f);
+                fclose(f);
+
+                if(!_load(prefs, expected, false) ||
+                   !_load(prefs, expected, true))
+                        goto _deinit;
+
+                /* cache of a context with other parse options isn't used */
+                int options = nft_prefs_get_parse_options(prefs);
+                nft_prefs_set_parse_options(prefs, options ^ NFT_PREFS_PARSE_NOCDATA);
+                bool ok = _load(prefs, expected, false);
+                nft_prefs_set_parse_options(prefs, options);
+                if(!ok)
+                        goto _deinit;
+
+                nft_prefs_node_free(n);
+                n = NULL;
+                free(expected);
+                expected = NULL;
+        }
+
+        result = EXIT_SUCCESS;
+
+_deinit:
+        nft_prefs_node_free(n);
+        free(expected);
+        nft_prefs_deinit(prefs);
+
+        return result;
+}
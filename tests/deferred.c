@@ -0,0 +1,378 @@
+/*
+ * libniftyprefs - lightweight modelless preferences management library
+ * Copyright (C) 2006-2014 Daniel Hiepler <daniel@niftylight.de>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <niftylog.h>
+#include <niftyprefs.h>
+
+
+/* amount of objects in test tree */
+#define LEDS            1000
+/* amount of snapshots diffed */
+#define SNAPSHOTS       5
+
+
+/** one "object" */
+struct Led
+{
+        char name[16];
+        int x;
+        long int id;
+        double gain;
+        bool on;
+};
+
+/** toplevel object */
+struct Strip
+{
+        struct Led *leds;
+        size_t count;
+};
+
+
+
+/** NftPrefsFromObjFunc for a strip */
+static NftResult _strip_to_prefs(NftPrefs * p, NftPrefsNode * newNode,
+                                 void *obj, void *userptr)
+{
+        struct Strip *s = obj;
+        for(size_t i = 0; i < s->count; i++)
+        {
+                NftPrefsNode *n;
+                if(!(n = nft_prefs_obj_to_node(p, "led", &s->leds[i], NULL)) ||
+                   !nft_prefs_node_add_child(newNode, n))
+                        return NFT_FAILURE;
+        }
+
+        return NFT_SUCCESS;
+}
+
+
+/** NftPrefsFromObjFunc for a led */
+static NftResult _led_to_prefs(NftPrefs * p, NftPrefsNode * newNode,
+                               void *obj, void *userptr)
+{
+        struct Led *l = obj;
+        return nft_prefs_node_prop_string_set(newNode, "name", l->name) &&
+                nft_prefs_node_prop_int_set(newNode, "x", l->x) &&
+                nft_prefs_node_prop_long_int_set(newNode, "id", l->id) &&
+                nft_prefs_node_prop_double_set(newNode, "gain", l->gain) &&
+                nft_prefs_node_prop_boolean_set(newNode, "on", l->on);
+}
+
+
+/** read all typed properties */
+static bool _read(NftPrefsNode * n, const struct Led *l)
+{
+        int i;
+        long int id;
+        double d;
+        bool b;
+        return nft_prefs_node_prop_int_get(n, "x", &i) && i == l->x &&
+                nft_prefs_node_prop_long_int_get(n, "id", &id) && id == l->id &&
+                nft_prefs_node_prop_double_get(n, "gain", &d) && d == l->gain &&
+                nft_prefs_node_prop_boolean_get(n, "on", &b) && b == l->on;
+}
+
+
+/** diff between two trees has length changes */
+static bool _diff(NftPrefsNode * a, NftPrefsNode * b, size_t length)
+{
+        NftPrefsDiff *d;
+        if(!(d = nft_prefs_node_diff(a, b)))
+                return false;
+
+        bool result = nft_prefs_diff_length(d) == length;
+        nft_prefs_diff_free(d);
+
+        return result;
+}
+
+
+/** deferred values behave like formatted ones */
+static bool _test_deferred(NftPrefs * p, struct Strip *s)
+{
+        bool result = false;
+        NftPrefsNode *text = NULL, *deferred = NULL, *changed = NULL, *other = NULL;
+        char *expected = NULL, *buffer = NULL;
+
+        /* reference */
+        nft_prefs_set_deferred_values(p, false);
+        if(!(text = nft_prefs_obj_to_node(p, "strip", s, NULL)))
+                goto _exit;
+
+        nft_prefs_set_deferred_values(p, true);
+        if(!nft_prefs_get_deferred_values(p) ||
+           !(deferred = nft_prefs_obj_to_node(p, "strip", s, NULL)))
+                goto _exit;
+
+        /* typed values are read without formatting them */
+        NftPrefsNode *led = nft_prefs_node_get_first_child(deferred);
+        if(!nft_prefs_node_get_deferred_values(led) || !_read(led, &s->leds[0]))
+        {
+                NFT_LOG(L_ERROR, "deferred values differ");
+                goto _exit;
+        }
+
+        /* trees are equal regardless of representation */
+        if(!_diff(text, deferred, 0) || !_diff(deferred, text, 0))
+        {
+                NFT_LOG(L_ERROR, "deferred tree differs from formatted tree");
+                goto _exit;
+        }
+
+        /* changes between deferred trees */
+        double gain = s->leds[5].gain;
+        s->leds[5].gain = 0.25;
+        s->leds[7].on = !s->leds[7].on;
+        if(!(changed = nft_prefs_obj_to_node(p, "strip", s, NULL)) ||
+           !_diff(deferred, changed, 2) || !_diff(text, changed, 2))
+        {
+                NFT_LOG(L_ERROR, "changes of deferred values not found");
+                goto _exit;
+        }
+
+        /* patch formatted tree with deferred values */
+        NftPrefsDiff *d;
+        if(!(d = nft_prefs_node_diff(text, changed)))
+                goto _exit;
+        bool patched = nft_prefs_node_patch(text, d);
+        nft_prefs_diff_free(d);
+        if(!patched || !_diff(text, changed, 0))
+        {
+                NFT_LOG(L_ERROR, "failed to patch tree with deferred values");
+                goto _exit;
+        }
+        s->leds[5].gain = gain;
+        s->leds[7].on = !s->leds[7].on;
+
+        /* values are formatted when they're read as string */
+        const char *x = nft_prefs_node_prop_string_borrow(led, "x", NULL);
+        if(!x || strcmp(x, "12") != 0)
+        {
+                NFT_LOG(L_ERROR, "deferred value formatted as \"%s\"", x);
+                goto _exit;
+        }
+
+        /* serialized trees are equal */
+        NftPrefsNode *ref;
+        nft_prefs_set_deferred_values(p, false);
+        if(!(ref = nft_prefs_obj_to_node(p, "strip", s, NULL)))
+                goto _exit;
+        expected = nft_prefs_node_to_buffer(p, ref);
+        nft_prefs_node_free(ref);
+        if(!expected || !(buffer = nft_prefs_node_to_buffer(p, deferred)) ||
+           strcmp(buffer, expected) != 0)
+        {
+                NFT_LOG(L_ERROR, "serialized deferred tree differs");
+                goto _exit;
+        }
+
+        /* properties that only exist as deferred values can be unset */
+        led = nft_prefs_node_get_first_child(changed);
+        int i;
+        if(!nft_prefs_node_prop_unset(led, "id") ||
+           nft_prefs_node_prop_unset(led, "id") ||
+           nft_prefs_node_prop_int_get(led, "id", &i))
+        {
+                NFT_LOG(L_ERROR, "failed to unset deferred value");
+                goto _exit;
+        }
+
+        /* deferred value replaces formatted one */
+        const char *xml = "<other x=\"1\"/>";
+        if(!(other = nft_prefs_node_from_buffer(p, (char *) xml, strlen(xml))) ||
+           !nft_prefs_node_set_deferred_values(other, true) ||
+           !nft_prefs_node_prop_int_set(other, "x", 5) ||
+           !nft_prefs_node_prop_int_get(other, "x", &i) || i != 5 ||
+           !(x = nft_prefs_node_query(p, other, "other/@x")) || strcmp(x, "5") != 0)
+        {
+                NFT_LOG(L_ERROR, "deferred value didn't replace formatted one");
+                nft_prefs_free((char *) x);
+                goto _exit;
+        }
+        nft_prefs_free((char *) x);
+
+        /* values are kept when a node is moved to another tree */
+        if(!nft_prefs_node_add_child(other, led) ||
+           !(x = nft_prefs_node_prop_string_borrow(led, "x", NULL)) ||
+           strcmp(x, "12") != 0)
+        {
+                NFT_LOG(L_ERROR, "deferred value lost when moving node");
+                goto _exit;
+        }
+
+        /* disabling writes all pending values */
+        led = nft_prefs_node_get_first_child(changed);
+        if(!nft_prefs_node_set_deferred_values(led, false) ||
+           nft_prefs_node_get_deferred_values(led) ||
+           !nft_prefs_node_prop_int_set(led, "x", 42) ||
+           !(x = nft_prefs_node_prop_string_borrow(led, "gain", NULL)) ||
+           strcmp(x, "1.5") != 0)
+        {
+                NFT_LOG(L_ERROR, "failed to stop deferring values");
+                goto _exit;
+        }
+
+        result = true;
+
+_exit:
+        nft_prefs_set_deferred_values(p, false);
+        free(expected);
+        free(buffer);
+        if(text)
+                nft_prefs_node_free(text);
+        if(deferred)
+                nft_prefs_node_free(deferred);
+        if(changed)
+                nft_prefs_node_free(changed);
+        if(other)
+                nft_prefs_node_free(other);
+
+        return result;
+}
+
+
+/** take snapshots of changing objects and diff them */
+static bool _test_snapshots(NftPrefs * p, struct Strip *s)
+{
+        for(int deferred = 0; deferred < 2; deferred++)
+        {
+                nft_prefs_set_deferred_values(p, deferred);
+
+                NftPrefsNode *prev;
+                if(!(prev = nft_prefs_obj_to_node(p, "strip", s, NULL)))
+                        return false;
+                for(int i = 0; i < SNAPSHOTS; i++)
+                {
+                        s->leds[i].x++;
+
+                        NftPrefsNode *n;
+                        if(!(n = nft_prefs_obj_to_node(p, "strip", s, NULL)))
+                        {
+                                nft_prefs_node_free(prev);
+                                return false;
+                        }
+
+                        bool ok = _diff(prev, n, 1);
+                        nft_prefs_node_free(prev);
+                        prev = n;
+                        if(!ok)
+                        {
+                                NFT_LOG(L_ERROR, "wrong diff of snapshots");
+                                nft_prefs_node_free(prev);
+                                return false;
+                        }
+                }
+                nft_prefs_node_free(prev);
+
+                for(int i = 0; i < SNAPSHOTS; i++)
+                        s->leds[i].x--;
+        }
+
+        nft_prefs_set_deferred_values(p, false);
+
+        return true;
+}
+
+
+/** deferred values of nodes allocated from the heap and from arenas */
+int main(int argc, char *argv[])
+{
+        /* do preliminary version checks */
+        if(!NFT_PREFS_CHECK_VERSION)
+                return EXIT_FAILURE;
+
+        /* fail per default */
+        int result = EXIT_FAILURE;
+
+        /* test objects */
+        struct Led leds[LEDS];
+        for(int i = 0; i < LEDS; i++)
+        {
+                snprintf(leds[i].name, sizeof(leds[i].name), "led%d", i);
+                leds[i].x = 12 + i;
+                leds[i].id = 1234567890123 + i;
+                leds[i].gain = 0.5 + (i % 3);
+                leds[i].on = i % 2;
+        }
+        struct Strip strip = {.leds = leds,.count = LEDS };
+
+        /* initialize libniftyprefs */
+        NftPrefs *prefs;
+        if(!(prefs = nft_prefs_init(0)))
+                return EXIT_FAILURE;
+
+        if(!nft_prefs_class_register(prefs, "strip", NULL, &_strip_to_prefs) ||
+           !nft_prefs_class_register(prefs, "led", NULL, &_led_to_prefs))
+                goto _deinit;
+
+        for(int arena = 0; arena < 2; arena++)
+        {
+                if(!nft_prefs_set_arena(prefs, arena) ||
+                   !_test_deferred(prefs, &strip) ||
+                   !_test_snapshots(prefs, &strip))
+                        goto _deinit;
+        }
+
+        /* nodes that don't belong to a document can't defer values */
+        NftPrefsNode *n;
+        if(!(n = nft_prefs_node_alloc("led")))
+                goto _deinit;
+        bool ok = !nft_prefs_node_set_deferred_values(n, true);
+        nft_prefs_node_free(n);
+        if(!ok)
+                goto _deinit;
+
+        result = EXIT_SUCCESS;
+
+_deinit:
+        nft_prefs_class_unregister(prefs, "strip");
+        nft_prefs_class_unregister(prefs, "led");
+        nft_prefs_deinit(prefs);
+
+        return result;
+}
@@ -0,0 +1,132 @@
+/*
+ * libniftyprefs - lightweight modelless preferences management library
+ * Copyright (C) 2006-2014 Daniel Hiepler <daniel@niftylight.de>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <niftylog.h>
+#include <niftyprefs.h>
+
+
+/** test tree */
+static const char *XML =
+        "<people><person name=\"Alice\" age=\"30\"/></people>";
+
+
+
+/** prefsFromObj() of a person (obj is the name) */
+static NftResult _person_from_obj(NftPrefs * p, NftPrefsNode * n, void *obj,
+                                  void *userptr)
+{
+        return nft_prefs_node_prop_string_set(n, "name", obj) &&
+                nft_prefs_node_prop_int_set(n, "age", 40);
+}
+
+
+/** check name of node & "name" property of its n-th child */
+static bool _check(NftPrefsNode * n, const char *name, size_t i,
+                   const char *child)
+{
+        char *value = NULL;
+        NftPrefsNode *c = nft_prefs_node_get_nth_child(n, i);
+        bool result = strcmp(nft_prefs_node_get_name(n), name) == 0 && c &&
+                (value = nft_prefs_node_prop_string_get(c, "name")) &&
+                strcmp(value, child) == 0;
+        nft_prefs_free(value);
+        return result;
+}
+
+
+/** nodes created by a context (from objects & parsed) outlive it */
+static bool _test(bool arena)
+{
+        NftPrefs *prefs;
+        if(!(prefs = nft_prefs_init(0)))
+                return false;
+
+        NftPrefsNode *parsed = NULL, *bob = NULL;
+        if(!nft_prefs_set_arena(prefs, arena) ||
+           !nft_prefs_class_register(prefs, "person", NULL, _person_from_obj) ||
+           !(parsed = nft_prefs_node_from_buffer(prefs, (char *) XML, strlen(XML))) ||
+           !(bob = nft_prefs_obj_to_node(prefs, "person", "Bob", NULL)))
+        {
+                nft_prefs_deinit(prefs);
+                if(parsed)
+                        nft_prefs_node_free(parsed);
+                return false;
+        }
+
+        nft_prefs_deinit(prefs);
+
+        /* nodes can still be read, modified & combined */
+        int age;
+        bool added = _check(parsed, "people", 0, "Alice") &&
+                nft_prefs_node_prop_int_get(bob, "age", &age) && age == 40 &&
+                nft_prefs_node_add_child(parsed, bob);
+        if(!added)
+                nft_prefs_node_free(bob);
+
+        bool result = added && _check(parsed, "people", 1, "Bob");
+        if(!result)
+                NFT_LOG(L_ERROR, "node changed after nft_prefs_deinit()");
+
+        nft_prefs_node_free(parsed);
+        return result;
+}
+
+
+/** nodes from the heap & from arenas stay valid after nft_prefs_deinit() */
+int main(int argc, char *argv[])
+{
+        /* do preliminary version checks */
+        if(!NFT_PREFS_CHECK_VERSION)
+                return EXIT_FAILURE;
+
+        if(!_test(false) || !_test(true))
+                return EXIT_FAILURE;
+
+        return EXIT_SUCCESS;
+}
@@ -0,0 +1,323 @@
+/*
+ * libniftyprefs - lightweight modelless preferences management library
+ * Copyright (C) 2006-2014 Daniel Hiepler <daniel@niftylight.de>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <niftylog.h>
+#include <niftyprefs.h>
+
+
+/* amount of children in large tree */
+#define PEOPLE          2000
+
+
+/** old tree */
+static const char *OLD =
+        "<people>"
+        "<person name=\"Alice\" age=\"30\"/>"
+        "<person name=\"Bob\" age=\"40\"/>"
+        "<person name=\"Carol\" age=\"50\"/>"
+        "<settings color=\"red\"><font size=\"10\"/></settings>"
+        "<note>hello</note>"
+        "</people>";
+
+/** new tree */
+static const char *NEW =
+        "<people>"
+        "<note>hello world</note>"
+        "<person name=\"Carol\" age=\"50\"/>"
+        "<person name=\"Alice\" age=\"31\" alive=\"true\"/>"
+        "<person name=\"Dave\" age=\"20\"/>"
+        "<settings><font size=\"10\"/><font size=\"12\"/></settings>"
+        "</people>";
+
+/** expected changes from OLD to NEW */
+static const char *CHANGES =
+        "move note;replace note;move person[Carol];"
+        "set person[Alice].age;set person[Alice].alive;add person[Dave];"
+        "unset settings.color;add font;remove person[Bob];";
+
+
+
+/** parse tree from string */
+static NftPrefsNode *_parse(NftPrefs * p, const char *xml)
+{
+        return nft_prefs_node_from_buffer(p, (char *) xml, strlen(xml));
+}
+
+
+/** append "name[key]" of node to string */
+static void _describe(char *s, size_t size, NftPrefsNode * n)
+{
+        char *key = nft_prefs_node_prop_string_get(n, "name");
+        size_t l = strlen(s);
+        if(key)
+                snprintf(s + l, size - l, "%s[%s]", nft_prefs_node_get_name(n), key);
+        else
+                snprintf(s + l, size - l, "%s", nft_prefs_node_get_name(n));
+        nft_prefs_free(key);
+}
+
+
+/** describe all changes of a diff */
+static void _changes(NftPrefsDiff * d, char *s, size_t size)
+{
+        s[0] = '\0';
+        for(size_t i = 0; i < nft_prefs_diff_length(d); i++)
+        {
+                const NftPrefsDiffEntry *e = nft_prefs_diff_get(d, i);
+                const char *op = "";
+                NftPrefsNode *n = e->to;
+                switch (e->op)
+                {
+                        case NFT_PREFS_DIFF_ADD:
+                                op = "add";
+                                break;
+                        case NFT_PREFS_DIFF_REMOVE:
+                                op = "remove";
+                                n = e->from;
+                                break;
+                        case NFT_PREFS_DIFF_MOVE:
+                                op = "move";
+                                break;
+                        case NFT_PREFS_DIFF_REPLACE:
+                                op = "replace";
+                                break;
+                        case NFT_PREFS_DIFF_PROP_SET:
+                                op = "set";
+                                break;
+                        case NFT_PREFS_DIFF_PROP_UNSET:
+                                op = "unset";
+                                break;
+                }
+
+                size_t l = strlen(s);
+                snprintf(s + l, size - l, "%s ", op);
+                _describe(s, size, n);
+                l = strlen(s);
+                if(e->prop)
+                        snprintf(s + l, size - l, ".%s;", e->prop);
+                else
+                        snprintf(s + l, size - l, ";");
+        }
+}
+
+
+/** check whether two trees serialize to the same buffer */
+static bool _equal(NftPrefs * p, NftPrefsNode * a, NftPrefsNode * b)
+{
+        char *sa = nft_prefs_node_to_buffer_minimal(p, a);
+        char *sb = nft_prefs_node_to_buffer_minimal(p, b);
+
+        bool result = sa && sb && strcmp(sa, sb) == 0;
+        if(!result)
+                NFT_LOG(L_ERROR, "trees differ:\n%s\n%s", sa, sb);
+
+        nft_prefs_free(sa);
+        nft_prefs_free(sb);
+        return result;
+}
+
+
+/** diff OLD & NEW and patch a copy of OLD as well as OLD itself */
+static bool _test_patch(NftPrefs * p)
+{
+        bool result = false;
+
+        NftPrefsNode *old = _parse(p, OLD);
+        NftPrefsNode *copy = _parse(p, OLD);
+        NftPrefsNode *new = _parse(p, NEW);
+        NftPrefsNode *other = _parse(p, "<people><person name=\"Alice\"/></people>");
+        NftPrefsNode *unchanged = _parse(p, "<people><person name=\"Alice\"/></people>");
+        NftPrefsDiff *d = NULL, *same = NULL;
+        if(!old || !copy || !new || !other || !unchanged)
+                goto _tp_exit;
+
+        /* equal trees */
+        if(!(same = nft_prefs_node_diff(old, copy)) ||
+           nft_prefs_diff_length(same) != 0)
+        {
+                NFT_LOG(L_ERROR, "equal trees have differences");
+                goto _tp_exit;
+        }
+
+        char changes[1024];
+        if(!(d = nft_prefs_node_diff(old, new)))
+                goto _tp_exit;
+        _changes(d, changes, sizeof(changes));
+        if(strcmp(changes, CHANGES) != 0)
+        {
+                NFT_LOG(L_ERROR, "expected \"%s\", got \"%s\"", CHANGES, changes);
+                goto _tp_exit;
+        }
+
+        /* tree that doesn't match stays unchanged */
+        if(nft_prefs_node_patch(other, d) ||
+           !_equal(p, other, unchanged))
+        {
+                NFT_LOG(L_ERROR, "unrelated tree was patched");
+                goto _tp_exit;
+        }
+
+        /* copy */
+        if(!nft_prefs_node_patch(copy, d) || !_equal(p, copy, new))
+                goto _tp_exit;
+
+        /* old tree itself */
+        if(!nft_prefs_node_patch(old, d) || !_equal(p, old, new))
+                goto _tp_exit;
+        nft_prefs_diff_free(d);
+
+        /* nothing left to change */
+        if(!(d = nft_prefs_node_diff(old, new)) || nft_prefs_diff_length(d) != 0)
+        {
+                NFT_LOG(L_ERROR, "patched tree still differs");
+                goto _tp_exit;
+        }
+
+        result = true;
+
+_tp_exit:
+        if(d)
+                nft_prefs_diff_free(d);
+        if(same)
+                nft_prefs_diff_free(same);
+        nft_prefs_node_free(old);
+        nft_prefs_node_free(copy);
+        nft_prefs_node_free(new);
+        nft_prefs_node_free(other);
+        nft_prefs_node_free(unchanged);
+        return result;
+}
+
+
+/** build large tree */
+static NftPrefsNode *_people(NftPrefs * p, int changed, bool swapped)
+{
+        size_t size = PEOPLE * 64 + 64;
+        char *xml;
+        if(!(xml = malloc(size)))
+                return NULL;
+
+        size_t l = (size_t) snprintf(xml, size, "<people>");
+        for(int i = 0; i < PEOPLE; i++)
+        {
+                int n = i;
+                if(swapped && (i == 10 || i == PEOPLE - 10))
+                        n = (i == 10) ? PEOPLE - 10 : 10;
+                l += (size_t) snprintf(xml + l, size - l,
+                                       "<person name=\"p%d\" age=\"%d\"/>",
+                                       n, n == changed ? 1 : 42);
+        }
+        snprintf(xml + l, size - l, "</people>");
+
+        NftPrefsNode *n = _parse(p, xml);
+        free(xml);
+        return n;
+}
+
+
+/** diff & patch a large tree */
+static bool _test_large(NftPrefs * p)
+{
+        bool result = false;
+
+        NftPrefsNode *old = _people(p, -1, false);
+        NftPrefsNode *new = _people(p, PEOPLE / 2, true);
+        NftPrefsDiff *d = NULL;
+        if(!old || !new)
+                goto _tl_exit;
+
+        if(!(d = nft_prefs_node_diff(old, new)) || !nft_prefs_node_patch(old, d))
+                goto _tl_exit;
+
+        /* one changed property and two moves */
+        if(nft_prefs_diff_length(d) != 3 || !_equal(p, old, new))
+        {
+                NFT_LOG(L_ERROR, "unexpected result of large diff");
+                goto _tl_exit;
+        }
+
+        result = true;
+
+_tl_exit:
+        if(d)
+                nft_prefs_diff_free(d);
+        nft_prefs_node_free(old);
+        nft_prefs_node_free(new);
+        return result;
+}
+
+
+/** diff & patch trees (allocated from the heap and from arenas) */
+int main(int argc, char *argv[])
+{
+        /* do preliminary version checks */
+        if(!NFT_PREFS_CHECK_VERSION)
+                return EXIT_FAILURE;
+
+        /* fail per default */
+        int result = EXIT_FAILURE;
+
+        /* initialize libniftyprefs */
+        NftPrefs *prefs;
+        if(!(prefs = nft_prefs_init(0)))
+                return EXIT_FAILURE;
+
+        if(!_test_patch(prefs) || !_test_large(prefs))
+                goto _deinit;
+
+        if(!nft_prefs_set_arena(prefs, true) ||
+           !_test_patch(prefs) || !_test_large(prefs))
+                goto _deinit;
+
+        result = EXIT_SUCCESS;
+
+_deinit:
+        nft_prefs_deinit(prefs);
+
+        return result;
+}
@@ -0,0 +1,127 @@
+/*
+ * libniftyprefs - lightweight modelless preferences management library
+ * Copyright (C) 2006-2014 Daniel Hiepler <daniel@niftylight.de>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <stdlib.h>
+#include <niftylog.h>
+#include <niftyprefs.h>
+
+
+/* file to read from (created by obj-to-prefs test) */
+#define FILE_NAME   "test-prefs.xml"
+
+/* amount of trees parsed & freed */
+#define CYCLES      256
+
+
+
+/** free trees and subtrees in the background while parsing new ones */
+int main(int argc, char *argv[])
+{
+        /* do preliminary version checks */
+        if(!NFT_PREFS_CHECK_VERSION)
+                return EXIT_FAILURE;
+
+        /* fail per default */
+        int result = EXIT_FAILURE;
+
+        char *expected = NULL;
+
+
+        /* initialize libniftyprefs */
+        NftPrefs *prefs;
+        if(!(prefs = nft_prefs_init(0)))
+                return EXIT_FAILURE;
+
+
+        /* reference output */
+        NftPrefsNode *n;
+        if(!(n = nft_prefs_node_from_file(prefs, FILE_NAME)))
+                goto _deinit;
+
+        NftPrefsNode *child = nft_prefs_node_get_first_child(n);
+        nft_prefs_node_free(child);
+        expected = nft_prefs_node_to_buffer(prefs, n);
+        nft_prefs_node_free(n);
+        if(!expected)
+                goto _deinit;
+
+
+        for(int i = 0; i < CYCLES; i++)
+        {
+                /* use heap and arenas alternately */
+                if(!nft_prefs_set_arena(prefs, i & 1))
+                        goto _deinit;
+
+                if(!(n = nft_prefs_node_from_file(prefs, FILE_NAME)))
+                        goto _deinit;
+
+                /* free subtree in the background, tree must be unchanged
+                   by anything but the removal */
+                child = nft_prefs_node_get_first_child(n);
+                nft_prefs_node_free_async(prefs, child);
+
+                char *dump = nft_prefs_node_to_buffer(prefs, n);
+                if(!dump || strcmp(dump, expected) != 0)
+                {
+                        NFT_LOG(L_ERROR, "tree changed after freeing child");
+                        free(dump);
+                        nft_prefs_node_free(n);
+                        goto _deinit;
+                }
+                free(dump);
+
+                /* free whole tree in the background */
+                nft_prefs_node_free_async(prefs, n);
+        }
+
+        result = EXIT_SUCCESS;
+
+_deinit:
+        free(expected);
+
+        /* frees everything still pending */
+        nft_prefs_deinit(prefs);
+
+        return result;
+}
@@ -0,0 +1,474 @@
+/*
+ * libniftyprefs - lightweight modelless preferences management library
+ * Copyright (C) 2006-2014 Daniel Hiepler <daniel@niftylight.de>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <niftylog.h>
+#include <niftyprefs.h>
+
+
+/* amount of <led> children */
+#define LEDS            10000
+/* every n-th child is a <group> */
+#define GROUP_EVERY     1000
+/* amount of properties of wide node */
+#define PROPS           5000
+/* threads looking up children of the same tree */
+#define READERS         4
+
+
+
+/** check whether node has a certain name & "id" property */
+static bool _is(NftPrefsNode * n, const char *name, int id)
+{
+        if(!n || strcmp(nft_prefs_node_get_name(n), name) != 0)
+                return false;
+
+        char *v = nft_prefs_node_prop_string_get(n, "id");
+        bool result = v && atoi(v) == id;
+        nft_prefs_free(v);
+        return result;
+}
+
+
+/** build tree with LEDS <led> children and a <group> after every 
+    GROUP_EVERY of them */
+static NftPrefsNode *_tree(NftPrefs * p)
+{
+        size_t size = LEDS * 32 + 64;
+        char *xml;
+        if(!(xml = malloc(size)))
+                return NULL;
+
+        size_t l = (size_t) snprintf(xml, size, "<setup>");
+        for(int i = 0; i < LEDS; i++)
+        {
+                l += (size_t) snprintf(xml + l, size - l, "<led id=\"%d\"/>", i);
+                if(i % GROUP_EVERY == GROUP_EVERY - 1)
+                        l += (size_t) snprintf(xml + l, size - l,
+                                               "<group id=\"%d\"/>", i / GROUP_EVERY);
+        }
+        snprintf(xml + l, size - l, "</setup>");
+
+        NftPrefsNode *n = nft_prefs_node_from_buffer(p, xml, strlen(xml));
+        free(xml);
+        return n;
+}
+
+
+/** look up every child of a tree (thread function) */
+static void *_read(void *arg)
+{
+        NftPrefsNode *root = arg;
+
+        size_t count = LEDS + LEDS / GROUP_EVERY;
+        for(size_t i = 0; i < count; i++)
+        {
+                if(!nft_prefs_node_get_nth_child(root, i))
+                        return NULL;
+        }
+
+        size_t n;
+        NftPrefsNode **groups;
+        if(!nft_prefs_node_get_child_by_name(root, "group") ||
+           !(groups = nft_prefs_node_get_children_by_name(root, "group", &n)))
+                return NULL;
+        nft_prefs_free(groups);
+
+        return n == LEDS / GROUP_EVERY ? root : NULL;
+}
+
+
+/** several threads index the same tree at once */
+static bool _test_readers(NftPrefs * p)
+{
+        NftPrefsNode *root;
+        if(!(root = _tree(p)))
+                return false;
+
+        /* the application's pointer isn't touched by indexing */
+        int marker;
+        root->_private = &marker;
+
+        pthread_t threads[READERS];
+        int started = 0;
+        for(; started < READERS; started++)
+        {
+                if(pthread_create(&threads[started], NULL, _read, root) != 0)
+                        break;
+        }
+
+        bool result = started == READERS;
+        for(int i = 0; i < started; i++)
+        {
+                void *r;
+                if(pthread_join(threads[i], &r) != 0 || r != root)
+                        result = false;
+        }
+
+        if(!result || root->_private != &marker)
+        {
+                NFT_LOG(L_ERROR, "concurrent lookups failed");
+                result = false;
+        }
+
+        root->_private = NULL;
+        nft_prefs_node_free(root);
+        return result;
+}
+
+
+/** lookups & invalidation */
+static bool _test(NftPrefs * p)
+{
+        bool result = false;
+
+        NftPrefsNode *root, *other = NULL, **groups = NULL;
+        if(!(root = _tree(p)))
+                return false;
+
+        size_t count = LEDS + LEDS / GROUP_EVERY;
+        if(nft_prefs_node_get_child_count(root) != count)
+        {
+                NFT_LOG(L_ERROR, "wrong amount of children");
+                goto _t_exit;
+        }
+
+        /* by position */
+        if(!_is(nft_prefs_node_get_nth_child(root, 0), "led", 0) ||
+           !_is(nft_prefs_node_get_nth_child(root, GROUP_EVERY), "group", 0) ||
+           !_is(nft_prefs_node_get_nth_child(root, GROUP_EVERY + 1), "led", GROUP_EVERY) ||
+           !_is(nft_prefs_node_get_nth_child(root, count - 1), "group", LEDS / GROUP_EVERY - 1) ||
+           nft_prefs_node_get_nth_child(root, count))
+        {
+                NFT_LOG(L_ERROR, "nft_prefs_node_get_nth_child() failed");
+                goto _t_exit;
+        }
+
+        /* by name */
+        size_t n;
+        if(!_is(nft_prefs_node_get_child_by_name(root, "group"), "group", 0) ||
+           nft_prefs_node_get_child_by_name(root, "unknown") ||
+           nft_prefs_node_get_children_by_name(root, "unknown", &n) || n != 0 ||
+           !(groups = nft_prefs_node_get_children_by_name(root, "group", &n)) ||
+           n != LEDS / GROUP_EVERY)
+        {
+                NFT_LOG(L_ERROR, "lookup by name failed");
+                goto _t_exit;
+        }
+        for(size_t i = 0; i < n; i++)
+        {
+                if(!_is(groups[i], "group", (int) i))
+                {
+                        NFT_LOG(L_ERROR, "group %zu in wrong order", i);
+                        goto _t_exit;
+                }
+        }
+
+        /* added child */
+        NftPrefsNode *added;
+        if(!(added = nft_prefs_node_alloc("extra")) ||
+           !nft_prefs_node_add_child(root, added) ||
+           nft_prefs_node_get_child_count(root) != count + 1 ||
+           nft_prefs_node_get_nth_child(root, count) != added ||
+           nft_prefs_node_get_child_by_name(root, "extra") != added)
+        {
+                NFT_LOG(L_ERROR, "index not updated after adding child");
+                goto _t_exit;
+        }
+
+        /* removed child */
+        nft_prefs_node_free(nft_prefs_node_get_nth_child(root, 0));
+        if(nft_prefs_node_get_child_count(root) != count ||
+           !_is(nft_prefs_node_get_nth_child(root, 0), "led", 1))
+        {
+                NFT_LOG(L_ERROR, "index not updated after removing child");
+                goto _t_exit;
+        }
+
+        /* modified through libxml */
+        xmlNode *direct;
+        if(!(direct = xmlNewDocNode(root->doc, NULL, BAD_CAST "direct", NULL)) ||
+           !xmlAddChild(root, direct) ||
+           nft_prefs_node_get_nth_child(root, count) != direct)
+        {
+                NFT_LOG(L_ERROR, "index not updated after modification by libxml");
+                goto _t_exit;
+        }
+
+        /* few children */
+        NftPrefsNode *small = groups[0];
+        for(int i = 0; i < 3; i++)
+        {
+                NftPrefsNode *c = nft_prefs_node_alloc(i == 1 ? "b" : "a");
+                if(!c || !nft_prefs_node_add_child(small, c))
+                        goto _t_exit;
+        }
+        size_t na = 0;
+        NftPrefsNode **a = nft_prefs_node_get_children_by_name(small, "a", &na);
+        bool ok = a && na == 2 && a[1] == nft_prefs_node_get_nth_child(small, 2) &&
+                nft_prefs_node_get_child_count(small) == 3 &&
+                nft_prefs_node_get_child_by_name(small, "b") == nft_prefs_node_get_nth_child(small, 1);
+        nft_prefs_free(a);
+        if(!ok)
+        {
+                NFT_LOG(L_ERROR, "lookup in node with few children failed");
+                goto _t_exit;
+        }
+
+        /* move indexed tree to another document and free the old one */
+        if(!(other = nft_prefs_node_from_buffer(p, "<other/>", 8)) ||
+           !nft_prefs_node_add_child(other, root))
+                goto _t_exit;
+        root = NULL;
+        NftPrefsNode *moved = nft_prefs_node_get_first_child(other);
+        if(!_is(nft_prefs_node_get_nth_child(moved, 0), "led", 1))
+        {
+                NFT_LOG(L_ERROR, "lookup in moved tree failed");
+                goto _t_exit;
+        }
+
+        /* every child by position */
+        size_t i = 0;
+        for(NftPrefsNode * c = nft_prefs_node_get_first_child(moved); c;
+            c = nft_prefs_node_get_next(c), i++)
+        {
+                if(nft_prefs_node_get_nth_child(moved, i) != c)
+                {
+                        NFT_LOG(L_ERROR, "child %zu has wrong position", i);
+                        goto _t_exit;
+                }
+        }
+        /* one child added & one removed through the API, one added by libxml */
+        if(i != count + 1)
+                goto _t_exit;
+
+        result = true;
+
+_t_exit:
+        nft_prefs_free(groups);
+        if(root)
+                nft_prefs_node_free(root);
+        if(other)
+                nft_prefs_node_free(other);
+        return result;
+}
+
+
+/** check all properties of wide node ("p<i>" = i unless i % removed == 0) */
+static bool _check_props(NftPrefsNode * n, int removed)
+{
+        for(int i = 0; i < PROPS; i++)
+        {
+                char name[16];
+                snprintf(name, sizeof(name), "p%d", i);
+
+                int v;
+                bool exists = nft_prefs_node_prop_int_get(n, name, &v);
+                if(removed && i % removed == 0 ? exists : !exists || v != i)
+                {
+                        NFT_LOG(L_ERROR, "property \"%s\" wrong", name);
+                        return false;
+                }
+        }
+
+        /* every property is in the list exactly once */
+        int count = 0;
+        for(xmlAttr * a = n->properties; a; a = a->next)
+                count++;
+        if(count != (removed ? PROPS - (PROPS + removed - 1) / removed : PROPS))
+        {
+                NFT_LOG(L_ERROR, "node has %d properties", count);
+                return false;
+        }
+
+        return true;
+}
+
+
+/** set, get & unset properties of a wide node */
+static bool _test_props(NftPrefs * p)
+{
+        bool result = false;
+
+        NftPrefsNode *n;
+        if(!(n = nft_prefs_node_from_buffer(p, "<wide/>", 7)))
+                return false;
+
+        /* fill node */
+        for(int i = 0; i < PROPS; i++)
+        {
+                char name[16];
+                snprintf(name, sizeof(name), "p%d", i);
+                if(!nft_prefs_node_prop_int_set(n, name, i))
+                        goto _tp_exit;
+        }
+
+        if(!_check_props(n, 0))
+                goto _tp_exit;
+
+        /* overwrite & remove (including first and last) */
+        for(int i = 0; i < PROPS; i++)
+        {
+                char name[16];
+                snprintf(name, sizeof(name), "p%d", i);
+                if(i % 3 == 0 || i == PROPS - 1 ?
+                   !nft_prefs_node_prop_unset(n, name) :
+                   !nft_prefs_node_prop_int_set(n, name, i))
+                        goto _tp_exit;
+        }
+        if(!nft_prefs_node_prop_int_set(n, "p4999", 4999) || !_check_props(n, 3))
+                goto _tp_exit;
+
+        /* add them again */
+        for(int i = 0; i < PROPS; i += 3)
+        {
+                char name[16];
+                snprintf(name, sizeof(name), "p%d", i);
+                if(!nft_prefs_node_prop_int_set(n, name, i))
+                        goto _tp_exit;
+        }
+        if(!_check_props(n, 0))
+                goto _tp_exit;
+
+        /* property added directly with libxml */
+        int v;
+        if(!xmlSetProp(n, BAD_CAST "direct", BAD_CAST "1") ||
+           !nft_prefs_node_prop_int_get(n, "direct", &v) || v != 1 ||
+           !nft_prefs_node_prop_unset(n, "direct") ||
+           nft_prefs_node_prop_int_get(n, "direct", &v))
+        {
+                NFT_LOG(L_ERROR, "property added by libxml not found");
+                goto _tp_exit;
+        }
+
+        result = true;
+
+_tp_exit:
+        nft_prefs_node_free(n);
+        return result;
+}
+
+
+/** free every second child with pending values one after the other, the 
+    values of the others survive & are written by serialization */
+static bool _test_subtrees(NftPrefs * p)
+{
+        bool result = false;
+
+        NftPrefsNode *root;
+        char *dump = NULL;
+        if(!(root = _tree(p)))
+                return false;
+
+        for(NftPrefsNode * c = nft_prefs_node_get_first_child(root); c;
+            c = nft_prefs_node_get_next(c))
+        {
+                if(!nft_prefs_node_set_deferred_values(c, true) ||
+                   !nft_prefs_node_prop_int_set(c, "x", 2 * LEDS))
+                        goto _ts_exit;
+        }
+
+        for(NftPrefsNode * c = nft_prefs_node_get_first_child(root); c;)
+        {
+                NftPrefsNode *next = nft_prefs_node_get_next(c);
+                nft_prefs_node_free(c);
+                c = next ? nft_prefs_node_get_next(next) : NULL;
+        }
+
+        size_t count = (LEDS + LEDS / GROUP_EVERY) / 2;
+        char x[32];
+        snprintf(x, sizeof(x), "x=\"%d\"", 2 * LEDS);
+        if(nft_prefs_node_get_child_count(root) != count ||
+           !(dump = nft_prefs_node_to_buffer(p, root)) || !strstr(dump, x) ||
+           !_is(nft_prefs_node_get_nth_child(root, count - 1), "group",
+                LEDS / GROUP_EVERY - 1))
+        {
+                NFT_LOG(L_ERROR, "pending values lost when freeing siblings");
+                goto _ts_exit;
+        }
+
+        result = true;
+
+_ts_exit:
+        nft_prefs_free(dump);
+        nft_prefs_node_free(root);
+        return result;
+}
+
+
+/** index children & properties of nodes allocated from the heap and from arenas */
+int main(int argc, char *argv[])
+{
+        /* do preliminary version checks */
+        if(!NFT_PREFS_CHECK_VERSION)
+                return EXIT_FAILURE;
+
+        /* fail per default */
+        int result = EXIT_FAILURE;
+
+        /* initialize libniftyprefs */
+        NftPrefs *prefs;
+        if(!(prefs = nft_prefs_init(0)))
+                return EXIT_FAILURE;
+
+        if(!_test(prefs) || !_test_props(prefs) || !_test_readers(prefs) ||
+           !_test_subtrees(prefs))
+                goto _deinit;
+
+        if(!nft_prefs_set_arena(prefs, true) || !_test(prefs) ||
+           !_test_props(prefs) || !_test_readers(prefs) ||
+           !_test_subtrees(prefs))
+                goto _deinit;
+
+        result = EXIT_SUCCESS;
+
+_deinit:
+        nft_prefs_deinit(prefs);
+
+        return result;
+}
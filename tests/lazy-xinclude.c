@@ -0,0 +1,397 @@
+/*
+ * libniftyprefs - lightweight modelless preferences management library
+ * Copyright (C) 2006-2014 Daniel Hiepler <daniel@niftylight.de>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <niftylog.h>
+#include <niftyprefs.h>
+
+
+/* amount of included fragments */
+#define FRAGMENTS       8
+/* amount of items per fragment */
+#define ITEMS           200
+/* directory of fragments */
+#define DIR_NAME        "test-lazy-xinclude.d"
+/* file including all fragments */
+#define FILE_NAME       "test-lazy-xinclude.xml"
+/* file of version 0 including two fragments */
+#define FILE_VERSIONED  "test-lazy-xinclude-v0.xml"
+
+
+
+/** name of fragment f */
+static void _fragment_name(char *name, size_t size, int f)
+{
+        snprintf(name, size, DIR_NAME "/fragment-%d.xml", f);
+}
+
+
+/** write fragment f with a revision attribute */
+static bool _write_fragment(int f, int revision)
+{
+        char name[64];
+        _fragment_name(name, sizeof(name), f);
+
+        FILE *fp;
+        if(!(fp = fopen(name, "w")))
+                return false;
+
+        fprintf(fp, "<fragment id=\"%d\" revision=\"%d\">\n", f, revision);
+        for(int i = 0; i < ITEMS; i++)
+                fprintf(fp, "  <item name=\"item-%d-%d\" id=\"%d\"/>\n", f, i, i);
+        fprintf(fp, "</fragment>\n");
+
+        return fclose(fp) == 0;
+}
+
+
+/** write all files */
+static bool _write_files(void)
+{
+        mkdir(DIR_NAME, 0755);
+
+        for(int f = 0; f < FRAGMENTS; f++)
+        {
+                if(!_write_fragment(f, 0))
+                        return false;
+        }
+
+        FILE *fp;
+        if(!(fp = fopen(FILE_NAME, "w")))
+                return false;
+
+        fprintf(fp, "<file xmlns:xi=\"http://www.w3.org/2001/XInclude\">\n");
+        for(int f = 0; f < FRAGMENTS; f++)
+                fprintf(fp, "  <xi:include href=\"" DIR_NAME "/fragment-%d.xml\"/>\n", f);
+
+        /* nested placeholder & placeholder that includes nothing */
+        fprintf(fp, "  <nested><xi:include href=\"" DIR_NAME "/fragment-0.xml\"/><last/></nested>\n"
+                "  <xi:include href=\"" DIR_NAME "/missing.xml\"><xi:fallback/></xi:include>\n"
+                "  <last/>\n"
+                "</file>\n");
+
+        if(fclose(fp) != 0 || !(fp = fopen(FILE_VERSIONED, "w")))
+                return false;
+
+        fprintf(fp, "<file version=\"0\" xmlns:xi=\"http://www.w3.org/2001/XInclude\">\n"
+                "  <xi:include href=\"" DIR_NAME "/fragment-0.xml\"/>\n"
+                "  <xi:include href=\"" DIR_NAME "/fragment-1.xml\"/>\n"
+                "</file>\n");
+
+        return fclose(fp) == 0;
+}
+
+
+/** remove all files */
+static void _remove_files(void)
+{
+        char name[64];
+        for(int f = 0; f < FRAGMENTS; f++)
+        {
+                _fragment_name(name, sizeof(name), f);
+                unlink(name);
+        }
+
+        unlink(FILE_NAME);
+        unlink(FILE_VERSIONED);
+        rmdir(DIR_NAME);
+}
+
+
+/** visit all nodes of a tree (resolves all placeholders) */
+static int _traverse(NftPrefsNode * n)
+{
+        int count = 1;
+        for(NftPrefsNode *c = nft_prefs_node_get_first_child(n);
+            c; c = nft_prefs_node_get_next(c))
+        {
+                count += _traverse(c);
+        }
+
+        return count;
+}
+
+
+/** NftPrefsToObjFunc for fragments */
+static NftResult _fragment_to_obj(NftPrefs * p, void **newObj,
+                                  NftPrefsNode * node, void *userptr)
+{
+        int *id;
+        if(!(id = malloc(sizeof(int))))
+                return NFT_FAILURE;
+
+        if(!nft_prefs_node_prop_int_get(node, "id", id))
+        {
+                free(id);
+                return NFT_FAILURE;
+        }
+
+        *newObj = id;
+        return NFT_SUCCESS;
+}
+
+
+/** load file lazily and compare with eagerly loaded file */
+static bool _test(NftPrefs * prefs)
+{
+        bool result = false;
+        NftPrefsNode *lazy = NULL, *eager = NULL;
+        char *expected = NULL, *dump = NULL;
+
+        /* placeholders are kept */
+        nft_prefs_set_lazy_xinclude(prefs, true);
+        if(!(lazy = nft_prefs_node_from_file(prefs, FILE_NAME)))
+                goto _t_exit;
+
+        if(!xmlStrEqual(xmlFirstElementChild(lazy)->name, BAD_CAST "include"))
+        {
+                NFT_LOG(L_ERROR, "XInclude was processed while parsing");
+                goto _t_exit;
+        }
+
+        /* placeholder reached by nft_prefs_obj_from_node() */
+        int *id;
+        if(!(id = nft_prefs_obj_from_node(prefs, xmlFirstElementChild(lazy), NULL)))
+                goto _t_exit;
+        bool ok = (*id == 0);
+        free(id);
+        if(!ok)
+        {
+                NFT_LOG(L_ERROR, "wrong object created from placeholder");
+                goto _t_exit;
+        }
+
+        /* file that changed after parsing is included in its new state */
+        if(!_write_fragment(FRAGMENTS - 1, 1))
+                goto _t_exit;
+
+        nft_prefs_set_lazy_xinclude(prefs, false);
+        if(!(eager = nft_prefs_node_from_file(prefs, FILE_NAME)))
+                goto _t_exit;
+
+        if(_traverse(lazy) != _traverse(eager))
+        {
+                NFT_LOG(L_ERROR, "lazy tree has wrong amount of nodes");
+                goto _t_exit;
+        }
+
+        if(!(expected = nft_prefs_node_to_buffer(prefs, eager)) ||
+           !(dump = nft_prefs_node_to_buffer(prefs, lazy)))
+                goto _t_exit;
+
+        if(strcmp(expected, dump) != 0)
+        {
+                NFT_LOG(L_ERROR, "lazy tree differs from eager tree");
+                goto _t_exit;
+        }
+
+        if(!strstr(dump, "revision=\"1\""))
+        {
+                NFT_LOG(L_ERROR, "included file was loaded too early");
+                goto _t_exit;
+        }
+
+        result = _write_fragment(FRAGMENTS - 1, 0);
+
+_t_exit:
+        nft_prefs_node_free(lazy);
+        nft_prefs_node_free(eager);
+        free(expected);
+        free(dump);
+        return result;
+}
+
+
+/** NftPrefsUpdaterFunc for fragments (counts calls) */
+static NftResult _fragment_update(NftPrefsNode * node, unsigned int version,
+                                  void *userptr)
+{
+        (*(int *) userptr)++;
+        return nft_prefs_node_prop_boolean_set(node, "updated", true);
+}
+
+
+/** included nodes are updated once, placeholders outlive their context */
+static bool _test_update(bool arena)
+{
+        bool result = false;
+        NftPrefsNode *n = NULL;
+        int updates = 0;
+
+        NftPrefs *prefs;
+        if(!(prefs = nft_prefs_init(1)))
+                return false;
+
+        nft_prefs_set_lazy_xinclude(prefs, true);
+        if(!nft_prefs_set_arena(prefs, arena) ||
+           !nft_prefs_class_register(prefs, "fragment", _fragment_to_obj, NULL) ||
+           !nft_prefs_updater_register(prefs, _fragment_update, "fragment", 0, &updates))
+                goto _tu_exit;
+
+        /* updating the tree doesn't resolve placeholders */
+        if(!(n = nft_prefs_node_from_file(prefs, FILE_VERSIONED)) || updates != 0)
+        {
+                NFT_LOG(L_ERROR, "placeholders resolved while updating");
+                goto _tu_exit;
+        }
+
+        bool updated = false;
+        NftPrefsNode *f = nft_prefs_node_get_first_child(n);
+        if(!f || !nft_prefs_node_prop_boolean_get(f, "updated", &updated) ||
+           !updated || updates != 1)
+        {
+                NFT_LOG(L_ERROR, "included nodes were not updated");
+                goto _tu_exit;
+        }
+
+        if(_traverse(n) != 2 * (ITEMS + 1) + 1 || updates != 2)
+        {
+                NFT_LOG(L_ERROR, "included nodes updated %d times", updates);
+                goto _tu_exit;
+        }
+        nft_prefs_node_free(n);
+
+        /* placeholder reached after deinitializing the context is kept */
+        if(!(n = nft_prefs_node_from_file(prefs, FILE_VERSIONED)))
+                goto _tu_exit;
+        nft_prefs_deinit(prefs);
+        prefs = NULL;
+
+        if(!(f = nft_prefs_node_get_first_child(n)) ||
+           strcmp(nft_prefs_node_get_name(f), "include") != 0)
+        {
+                NFT_LOG(L_ERROR, "placeholder resolved without context");
+                goto _tu_exit;
+        }
+
+        result = true;
+
+_tu_exit:
+        nft_prefs_node_free(n);
+        if(prefs)
+                nft_prefs_deinit(prefs);
+        return result;
+}
+
+
+/** load file and access its first object */
+static bool _first(NftPrefs * prefs, bool lazy)
+{
+        nft_prefs_set_lazy_xinclude(prefs, lazy);
+
+        NftPrefsNode *n;
+        if(!(n = nft_prefs_node_from_file(prefs, FILE_NAME)))
+                return false;
+
+        NftPrefsNode *first = nft_prefs_node_get_first_child(n);
+
+        bool result = first && strcmp(nft_prefs_node_get_name(first), "fragment") == 0;
+        nft_prefs_node_free(n);
+        return result;
+}
+
+
+/** resolve XIncludes on first access */
+int main(int argc, char *argv[])
+{
+        /* do preliminary version checks */
+        if(!NFT_PREFS_CHECK_VERSION)
+                return EXIT_FAILURE;
+
+        /* fail per default */
+        int result = EXIT_FAILURE;
+
+
+        /* initialize libniftyprefs */
+        NftPrefs *prefs;
+        if(!(prefs = nft_prefs_init(0)))
+                return EXIT_FAILURE;
+
+        if(!nft_prefs_class_register(prefs, "fragment", _fragment_to_obj, NULL) ||
+           !_write_files())
+                goto _deinit;
+
+        for(int arena = 0; arena <= 1; arena++)
+        {
+                if(!nft_prefs_set_arena(prefs, arena))
+                        goto _deinit;
+
+                for(int cache = 0; cache <= 1; cache++)
+                {
+                        nft_prefs_set_include_cache(prefs, cache);
+
+                        /* with & without XInclude start/end nodes */
+                        int options = nft_prefs_get_parse_options(prefs);
+                        bool ok = _test(prefs);
+                        nft_prefs_set_parse_options(prefs, options | NFT_PREFS_PARSE_NOXINCNODE);
+                        ok = ok && _test(prefs);
+                        nft_prefs_set_parse_options(prefs, options);
+                        if(!ok)
+                                goto _deinit;
+                }
+
+                nft_prefs_set_include_cache(prefs, false);
+
+                if(!_first(prefs, false) || !_first(prefs, true))
+                        goto _deinit;
+        }
+
+        /* uses contexts of its own */
+        if(!_test_update(false) || !_test_update(true))
+                goto _deinit;
+
+        result = EXIT_SUCCESS;
+
+_deinit:
+        _remove_files();
+        nft_prefs_deinit(prefs);
+
+        return result;
+}
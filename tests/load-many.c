@@ -0,0 +1,280 @@
+/*
+ * libniftyprefs - lightweight modelless preferences management library
+ * Copyright (C) 2006-2014 Daniel Hiepler <daniel@niftylight.de>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <niftylog.h>
+#include <niftyprefs.h>
+
+
+/* amount of files loaded */
+#define FILES           64
+/* amount of items per file */
+#define ITEMS           200
+/* name of root node (and class) */
+#define ROOT_NAME       "device"
+/* classes registered by another thread while files are loaded */
+#define REGISTRATIONS   100
+
+
+/** state shared by updater calls */
+typedef struct
+{
+        NftPrefs *prefs;
+        /** amount of updater calls */
+        int updated;
+        /** amount of successful class registrations during batch */
+        int registered;
+} UpdaterState;
+
+
+
+/** update from version 0 to 1. Classes can't be registered meanwhile */
+static NftResult _update(NftPrefsNode * n, unsigned int version, void *userptr)
+{
+        UpdaterState *s = userptr;
+
+        __atomic_fetch_add(&s->updated, 1, __ATOMIC_RELAXED);
+
+        if(nft_prefs_class_register(s->prefs, "late", NULL, NULL))
+        {
+                __atomic_fetch_add(&s->registered, 1, __ATOMIC_RELAXED);
+                nft_prefs_class_unregister(s->prefs, "late");
+        }
+
+        return nft_prefs_node_prop_string_set(n, "migrated", "yes");
+}
+
+
+/** register & unregister a class over and over again while other threads
+    load files (thread) */
+static void *_register(void *arg)
+{
+        NftPrefs *prefs = arg;
+        for(int i = 0; i < REGISTRATIONS; i++)
+        {
+                if(!nft_prefs_class_register(prefs, "other", NULL, NULL))
+                        return NULL;
+                nft_prefs_class_unregister(prefs, "other");
+        }
+
+        return prefs;
+}
+
+
+/** write FILES preferences files with version 0 */
+static bool _write_files(char *paths[])
+{
+        NftPrefs *old;
+        if(!(old = nft_prefs_init(0)))
+                return false;
+
+        bool result = false;
+        for(int f = 0; f < FILES; f++)
+        {
+                NftPrefsNode *root;
+                if(!(root = nft_prefs_node_alloc(ROOT_NAME)))
+                        goto _wf_exit;
+
+                for(int i = 0; i < ITEMS; i++)
+                {
+                        NftPrefsNode *n;
+                        char name[64];
+                        snprintf(name, sizeof(name), "item-%d-%d", f, i);
+                        if(!(n = nft_prefs_node_alloc("item")) ||
+                           !nft_prefs_node_prop_string_set(n, "name", name) ||
+                           !nft_prefs_node_prop_int_set(n, "id", i) ||
+                           !nft_prefs_node_add_child(root, n))
+                        {
+                                nft_prefs_node_free(n);
+                                nft_prefs_node_free(root);
+                                goto _wf_exit;
+                        }
+                }
+
+                snprintf(paths[f], 64, "test-load-many-%d.xml", f);
+                bool ok = nft_prefs_node_to_file(old, root, paths[f], true);
+                nft_prefs_node_free(root);
+                if(!ok)
+                        goto _wf_exit;
+        }
+
+        result = true;
+
+_wf_exit:
+        nft_prefs_deinit(old);
+        return result;
+}
+
+
+/** load many files sequentially & in parallel and compare results */
+int main(int argc, char *argv[])
+{
+        /* do preliminary version checks */
+        if(!NFT_PREFS_CHECK_VERSION)
+                return EXIT_FAILURE;
+
+        /* fail per default */
+        int result = EXIT_FAILURE;
+
+        char names[FILES][64];
+        char *paths[FILES];
+        char *expected[FILES] = { NULL };
+        NftPrefsNode *nodes[FILES] = { NULL };
+        for(int f = 0; f < FILES; f++)
+                paths[f] = names[f];
+
+        if(!_write_files(paths))
+                return EXIT_FAILURE;
+
+
+        /* initialize libniftyprefs */
+        NftPrefs *prefs;
+        if(!(prefs = nft_prefs_init(1)))
+                return EXIT_FAILURE;
+
+        UpdaterState state = { .prefs = prefs };
+        if(!nft_prefs_class_register(prefs, ROOT_NAME, NULL, NULL) ||
+           !nft_prefs_updater_register(prefs, _update, ROOT_NAME, 0, &state))
+                goto _deinit;
+
+
+        /* load sequentially */
+        for(int f = 0; f < FILES; f++)
+        {
+                NftPrefsNode *n;
+                if(!(n = nft_prefs_node_from_file(prefs, paths[f])))
+                        goto _deinit;
+
+                expected[f] = nft_prefs_node_to_buffer(prefs, n);
+                nft_prefs_node_free(n);
+                if(!expected[f])
+                        goto _deinit;
+        }
+
+        /* registering classes works outside of batches */
+        if(state.registered != FILES)
+        {
+                NFT_LOG(L_ERROR, "class registration failed outside of batch");
+                goto _deinit;
+        }
+        state.registered = 0;
+        state.updated = 0;
+
+
+        /* load in parallel (heap & arenas) */
+        for(int arena = 0; arena <= 1; arena++)
+        {
+                if(!nft_prefs_set_arena(prefs, arena))
+                        goto _deinit;
+
+                /* other threads wait for the batch instead of failing */
+                pthread_t other;
+                if(pthread_create(&other, NULL, _register, prefs) != 0)
+                        goto _deinit;
+
+                NftResult loaded = nft_prefs_load_many(prefs, (const char *const *) paths,
+                                                       FILES, nodes);
+                void *registered;
+                if(pthread_join(other, &registered) != 0 || registered != prefs)
+                {
+                        NFT_LOG(L_ERROR, "class registration failed during batch");
+                        goto _deinit;
+                }
+
+                if(!loaded)
+                        goto _deinit;
+
+                for(int f = 0; f < FILES; f++)
+                {
+                        char *dump = nft_prefs_node_to_buffer(prefs, nodes[f]);
+                        bool equal = dump && strcmp(dump, expected[f]) == 0;
+                        free(dump);
+                        if(nodes[f])
+                                nft_prefs_node_free(nodes[f]);
+                        nodes[f] = NULL;
+                        if(!equal)
+                        {
+                                NFT_LOG(L_ERROR, "\"%s\" differs when loaded in parallel",
+                                        paths[f]);
+                                goto _deinit;
+                        }
+                }
+        }
+
+        if(state.updated != 2 * FILES || state.registered != 0)
+        {
+                NFT_LOG(L_ERROR, "%d updates, %d registrations during batch",
+                        state.updated, state.registered);
+                goto _deinit;
+        }
+
+
+        /* missing files are reported */
+        const char *missing[] = { paths[0], "test-load-many-missing.xml" };
+        if(nft_prefs_load_many(prefs, missing, 2, nodes) || !nodes[0] || nodes[1])
+        {
+                NFT_LOG(L_ERROR, "missing file not reported");
+                goto _deinit;
+        }
+
+
+        result = EXIT_SUCCESS;
+
+_deinit:
+        for(int f = 0; f < FILES; f++)
+        {
+                free(expected[f]);
+                if(nodes[f])
+                        nft_prefs_node_free(nodes[f]);
+                remove(paths[f]);
+        }
+
+        nft_prefs_deinit(prefs);
+
+        return result;
+}
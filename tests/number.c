@@ -0,0 +1,404 @@
+/*
+ * libniftyprefs - lightweight modelless preferences management library
+ * Copyright (C) 2006-2014 Daniel Hiepler <daniel@niftylight.de>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <float.h>
+#include <math.h>
+#include <locale.h>
+#include <niftylog.h>
+#include <niftyprefs.h>
+
+
+/* amount of random values checked */
+#define VALUES          200000
+
+
+/** state of random number generator */
+static uint64_t _state = 0x9e3779b97f4a7c15;
+
+
+
+/** deterministic 64 bit random numbers (xorshift64*) */
+static uint64_t _random()
+{
+        _state ^= _state >> 12;
+        _state ^= _state << 25;
+        _state ^= _state >> 27;
+        return _state * UINT64_C(2685821657736338717);
+}
+
+
+/** double from raw bits */
+static double _double(uint64_t bits)
+{
+        double v;
+        memcpy(&v, &bits, sizeof(v));
+        return v;
+}
+
+
+/** true if both doubles have the same bits (or both are NaN) */
+static bool _same(double a, double b)
+{
+        if(isnan(a) || isnan(b))
+                return isnan(a) && isnan(b);
+
+        return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+
+/** amount of significant digits of a formatted double */
+static int _digits(const char *s)
+{
+        int digits = 0, zeros = 0;
+        bool leading = true;
+        for(; *s && *s != 'e'; s++)
+        {
+                if(*s < '0' || *s > '9' || (leading && *s == '0'))
+                        continue;
+
+                leading = false;
+                if(*s == '0')
+                {
+                        zeros++;
+                }
+                else
+                {
+                        digits += zeros + 1;
+                        zeros = 0;
+                }
+        }
+
+        return digits;
+}
+
+
+/** set & get int and long properties */
+static bool _test_int(NftPrefsNode * n)
+{
+        long int longs[] = { 0, 1, -1, 9, 10, 99, 100, -100, 12345,
+                INT_MIN, INT_MAX, LONG_MIN, LONG_MAX, LONG_MIN + 1 };
+
+        for(int i = 0; i < VALUES; i++)
+        {
+                long int v = (long int) (_random() >> (1 + _random() % 63));
+                if(i & 1)
+                        v = -v;
+                if(i < (int) (sizeof(longs) / sizeof(longs[0])))
+                        v = longs[i];
+
+                char expected[32];
+                snprintf(expected, sizeof(expected), "%ld", v);
+
+                long int l;
+                const char *s = NULL;
+                if(!nft_prefs_node_prop_long_int_set(n, "v", v) ||
+                   !(s = nft_prefs_node_prop_string_borrow(n, "v", NULL)) ||
+                   strcmp(s, expected) != 0 ||
+                   !nft_prefs_node_prop_long_int_get(n, "v", &l) || l != v)
+                {
+                        NFT_LOG(L_ERROR, "long %ld didn't round-trip", v);
+                        return false;
+                }
+
+                int x;
+                bool in_range = (v >= INT_MIN && v <= INT_MAX);
+                if(in_range && (!nft_prefs_node_prop_int_set(n, "v", (int) v) ||
+                                !nft_prefs_node_prop_int_get(n, "v", &x) ||
+                                x != v))
+                {
+                        NFT_LOG(L_ERROR, "int %ld didn't round-trip", v);
+                        return false;
+                }
+
+                if(!in_range && i < (int) (sizeof(longs) / sizeof(longs[0])) &&
+                   nft_prefs_node_prop_int_get(n, "v", &x))
+                {
+                        NFT_LOG(L_ERROR, "int %ld out of range not detected", v);
+                        return false;
+                }
+        }
+
+        /* strings that aren't integers */
+        const char *invalid[] = { "", " ", "-", "+", "12abc", "1.5", "0x10",
+                "--1", "1 2", "99999999999999999999",
+                "9223372036854775808", "-9223372036854775809" };
+        for(size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++)
+        {
+                long int l;
+                if(!nft_prefs_node_prop_string_set(n, "v", (char *) invalid[i]) ||
+                   nft_prefs_node_prop_long_int_get(n, "v", &l))
+                {
+                        NFT_LOG(L_ERROR, "\"%s\" parsed as integer", invalid[i]);
+                        return false;
+                }
+        }
+
+        /* surrounding whitespace and explicit sign are accepted */
+        long int l;
+        if(!nft_prefs_node_prop_string_set(n, "v", " +42\n") ||
+           !nft_prefs_node_prop_long_int_get(n, "v", &l) || l != 42)
+        {
+                NFT_LOG(L_ERROR, "\" +42\" not parsed");
+                return false;
+        }
+
+        return true;
+}
+
+
+/** set double property and make sure it's formatted as shortest string 
+    that parses to the same value again */
+static bool _check_double(NftPrefsNode * n, double v)
+{
+        const char *s = NULL;
+        double d;
+        if(!nft_prefs_node_prop_double_set(n, "v", v) ||
+           !(s = nft_prefs_node_prop_string_borrow(n, "v", NULL)) ||
+           !nft_prefs_node_prop_double_get(n, "v", &d) || !_same(d, v) ||
+           !_same(strtod(s, NULL), v))
+        {
+                NFT_LOG(L_ERROR, "%.17g didn't round-trip", v);
+                return false;
+        }
+
+        if(!isfinite(v))
+                return true;
+
+        /* one digit less mustn't be enough */
+        int digits = _digits(s);
+        char shorter[32];
+        snprintf(shorter, sizeof(shorter), "%.*e", digits - 2, v);
+        if(digits > 1 && _same(strtod(shorter, NULL), v))
+        {
+                NFT_LOG(L_ERROR, "\"%s\" isn't the shortest representation (\"%s\")",
+                        s, shorter);
+                return false;
+        }
+
+        return true;
+}
+
+
+/** set & get double properties */
+static bool _test_double(NftPrefsNode * n)
+{
+        double doubles[] = { 0.0, -0.0, 1.0, -1.0, 0.1, 0.2, 0.3, 1.0 / 3,
+                0.75, 100.0, 1e-7, 1e-8, 1e20, 1e21, 1e22, 123456789012345678.0,
+                5e-324, DBL_MIN, DBL_MAX, -DBL_MAX, 2.2250738585072009e-308,
+                9007199254740993.0, 1.7976931348623157e308, 4.9406564584124654e-324,
+                M_PI, M_E, INFINITY, -INFINITY, NAN };
+
+        for(size_t i = 0; i < sizeof(doubles) / sizeof(doubles[0]); i++)
+        {
+                if(!_check_double(n, doubles[i]))
+                        return false;
+        }
+
+        /* expected formatting */
+        struct
+        {
+                double v;
+                const char *s;
+        } formatted[] =
+        {
+                { 0.75, "0.75" }, { -0.0, "-0" }, { 100.0, "100" },
+                { 1e-7, "0.0000001" }, { 1e-8, "1e-8" }, { 1e20, "100000000000000000000" },
+                { 1e21, "1e21" }, { 1.5e300, "1.5e300" }, { 5e-324, "5e-324" },
+                { 0.1 + 0.2, "0.30000000000000004" }, { -INFINITY, "-inf" },
+        };
+        for(size_t i = 0; i < sizeof(formatted) / sizeof(formatted[0]); i++)
+        {
+                const char *s = NULL;
+                if(!nft_prefs_node_prop_double_set(n, "v", formatted[i].v) ||
+                   !(s = nft_prefs_node_prop_string_borrow(n, "v", NULL)) ||
+                   strcmp(s, formatted[i].s) != 0)
+                {
+                        NFT_LOG(L_ERROR, "%.17g formatted as \"%s\" instead of \"%s\"",
+                                formatted[i].v, s, formatted[i].s);
+                        return false;
+                }
+        }
+
+        /* random bit patterns */
+        for(int i = 0; i < VALUES; i++)
+        {
+                if(!_check_double(n, _double(_random())))
+                        return false;
+        }
+
+        /* random decimal strings are parsed like strtod() does */
+        for(int i = 0; i < VALUES; i++)
+        {
+                char s[64];
+                int digits = 1 + (int) (_random() % (i & 1 ? 17 : 25));
+                int l = 0;
+                if(_random() & 1)
+                        s[l++] = '-';
+                int point = (int) (_random() % (digits + 1));
+                for(int d = 0; d < digits; d++)
+                {
+                        if(d == point)
+                                s[l++] = '.';
+                        s[l++] = (char) ('0' + _random() % 10);
+                }
+                snprintf(&s[l], sizeof(s) - l, "e%d", (int) (_random() % 700) - 350);
+
+                double d;
+                if(!nft_prefs_node_prop_string_set(n, "v", s) ||
+                   !nft_prefs_node_prop_double_get(n, "v", &d) ||
+                   !_same(d, strtod(s, NULL)))
+                {
+                        NFT_LOG(L_ERROR, "\"%s\" parsed as %.17g instead of %.17g",
+                                s, d, strtod(s, NULL));
+                        return false;
+                }
+        }
+
+        /* strings that aren't doubles */
+        const char *invalid[] = { "", ".", "-", "e5", "1e", "1.5x", "1,5", "0x",
+                "infinite", "1 2" };
+        for(size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++)
+        {
+                double d;
+                if(!nft_prefs_node_prop_string_set(n, "v", (char *) invalid[i]) ||
+                   nft_prefs_node_prop_double_get(n, "v", &d))
+                {
+                        NFT_LOG(L_ERROR, "\"%s\" parsed as double", invalid[i]);
+                        return false;
+                }
+        }
+
+        /* formats accepted like strtod() does */
+        const char *valid[] = { " 1.5 ", "+.5", "5.", "1E3", "-Infinity",
+                "0x1.8p1", "1e-400", "1e400", "2.4703282292062328e-324",
+                "0.000000000000000000000000000000000000000000001" };
+        for(size_t i = 0; i < sizeof(valid) / sizeof(valid[0]); i++)
+        {
+                double d;
+                if(!nft_prefs_node_prop_string_set(n, "v", (char *) valid[i]) ||
+                   !nft_prefs_node_prop_double_get(n, "v", &d) ||
+                   !_same(d, strtod(valid[i], NULL)))
+                {
+                        NFT_LOG(L_ERROR, "\"%s\" not parsed", valid[i]);
+                        return false;
+                }
+        }
+
+        return true;
+}
+
+
+/** formatting & parsing doesn't depend on LC_NUMERIC */
+static bool _test_locale(NftPrefsNode * n)
+{
+        const char *locales[] = { "de_DE.UTF-8", "de_DE.utf8", "fr_FR.UTF-8",
+                "ru_RU.UTF-8" };
+
+        const char *locale = NULL;
+        for(size_t i = 0; !locale && i < sizeof(locales) / sizeof(locales[0]); i++)
+                locale = setlocale(LC_NUMERIC, locales[i]);
+
+        if(!locale)
+        {
+                printf("# no locale with decimal comma available\n");
+                return true;
+        }
+
+        const char *s = NULL;
+        double d;
+        bool ok = nft_prefs_node_prop_double_set(n, "v", 1.25) &&
+                (s = nft_prefs_node_prop_string_borrow(n, "v", NULL)) &&
+                strcmp(s, "1.25") == 0 &&
+                nft_prefs_node_prop_string_set(n, "v", "1.5e400") &&
+                nft_prefs_node_prop_double_get(n, "v", &d) && isinf(d) &&
+                nft_prefs_node_prop_string_set(n, "v",
+                                              "1.00000000000000000000000001") &&
+                nft_prefs_node_prop_double_get(n, "v", &d) && d == 1.0;
+
+        setlocale(LC_NUMERIC, "C");
+
+        if(!ok)
+                NFT_LOG(L_ERROR, "formatting depends on locale \"%s\"", locale);
+
+        return ok;
+}
+
+
+/** format & parse numeric properties */
+int main(int argc, char *argv[])
+{
+        /* do preliminary version checks */
+        if(!NFT_PREFS_CHECK_VERSION)
+                return EXIT_FAILURE;
+
+        /* fail per default */
+        int result = EXIT_FAILURE;
+
+        /* initialize libniftyprefs */
+        NftPrefs *prefs;
+        if(!(prefs = nft_prefs_init(0)))
+                return EXIT_FAILURE;
+
+        NftPrefsNode *n;
+        if(!(n = nft_prefs_node_alloc("number")))
+                goto _deinit;
+
+        bool ok = _test_int(n) && _test_double(n) && _test_locale(n);
+        nft_prefs_node_free(n);
+        if(!ok)
+                goto _deinit;
+
+        result = EXIT_SUCCESS;
+
+_deinit:
+        nft_prefs_deinit(prefs);
+
+        return result;
+}
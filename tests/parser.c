@@ -0,0 +1,235 @@
+/*
+ * libniftyprefs - lightweight modelless preferences management library
+ * Copyright (C) 2006-2014 Daniel Hiepler <daniel@niftylight.de>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <niftylog.h>
+#include <niftyprefs.h>
+
+
+/* file to read from (created by obj-to-prefs test) */
+#define FILE_NAME   "test-prefs.xml"
+
+/* amount of bytes written to the pipe at once */
+#define CHUNKSIZE   7
+
+
+/** feed a preferences file through a non-blocking pipe to an incremental 
+    parser in tiny chunks and compare the result with a regular parse */
+int main(int argc, char *argv[])
+{
+        /* do preliminary version checks */
+        if(!NFT_PREFS_CHECK_VERSION)
+                return EXIT_FAILURE;
+
+        /* fail per default */
+        int result = EXIT_FAILURE;
+
+        NftPrefsNode *node = NULL, *pushed = NULL;
+        char *file = NULL, *expected = NULL, *got = NULL;
+        int fds[2] = { -1, -1 };
+
+
+        /* initialize libniftyprefs */
+        NftPrefs *prefs;
+        if(!(prefs = nft_prefs_init(0)))
+                return EXIT_FAILURE;
+
+        /* parse file the regular way */
+        if(!(node = nft_prefs_node_from_file(prefs, FILE_NAME)))
+        {
+                NFT_LOG(L_ERROR, "failed to parse \"%s\"", FILE_NAME);
+                goto _deinit;
+        }
+
+        /* read raw file */
+        FILE *f;
+        if(!(f = fopen(FILE_NAME, "r")))
+        {
+                NFT_LOG_PERROR("fopen");
+                goto _deinit;
+        }
+        size_t length = 0;
+        char tmp[1024];
+        size_t r;
+        while((r = fread(tmp, 1, sizeof(tmp), f)) > 0)
+        {
+                char *nf;
+                if(!(nf = realloc(file, length + r)))
+                {
+                        fclose(f);
+                        goto _deinit;
+                }
+                file = nf;
+                memcpy(&file[length], tmp, r);
+                length += r;
+        }
+        fclose(f);
+
+
+        /* create non-blocking pipe */
+        if(pipe(fds) == -1)
+        {
+                NFT_LOG_PERROR("pipe");
+                goto _deinit;
+        }
+        fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+
+
+        /* create incremental parser */
+        NftPrefsParser *parser;
+        if(!(parser = nft_prefs_parser_new(prefs, FILE_NAME)))
+                goto _deinit;
+
+        /* write file in chunks, parse whatever arrived in between */
+        size_t written = 0;
+        bool eof = false;
+        while(!eof)
+        {
+                if(written < length)
+                {
+                        size_t n = length - written < CHUNKSIZE ?
+                                length - written : CHUNKSIZE;
+                        if(write(fds[1], &file[written], n) != (ssize_t) n)
+                        {
+                                NFT_LOG_PERROR("write");
+                                nft_prefs_parser_free(parser);
+                                goto _deinit;
+                        }
+                        written += n;
+
+                        /* close writing end after last chunk */
+                        if(written == length)
+                        {
+                                close(fds[1]);
+                                fds[1] = -1;
+                        }
+                }
+
+                if(!nft_prefs_parser_feed_fd(parser, fds[0], &eof))
+                {
+                        nft_prefs_parser_free(parser);
+                        goto _deinit;
+                }
+        }
+
+        if(!(pushed = nft_prefs_parser_finish(parser)))
+        {
+                NFT_LOG(L_ERROR, "incremental parsing failed");
+                goto _deinit;
+        }
+
+
+        /* both results must be identical */
+        if(!(expected = nft_prefs_node_to_buffer(prefs, node)) ||
+           !(got = nft_prefs_node_to_buffer(prefs, pushed)))
+                goto _deinit;
+
+        if(strcmp(expected, got) != 0)
+        {
+                NFT_LOG(L_ERROR, "incremental parser result differs:\n%s\n%s",
+                        expected, got);
+                goto _deinit;
+        }
+
+
+        /* parse buffer repeatedly with custom options (reuses pooled parser
+           contexts) - result must not change */
+        nft_prefs_set_parse_options(prefs, NFT_PREFS_PARSE_NOBLANKS |
+                                    NFT_PREFS_PARSE_COMPACT |
+                                    NFT_PREFS_PARSE_NONET);
+        for(int i = 0; i < 16; i++)
+        {
+                NftPrefsNode *n;
+                if(!(n = nft_prefs_node_from_buffer(prefs, file, length)))
+                {
+                        NFT_LOG(L_ERROR, "failed to parse buffer");
+                        goto _deinit;
+                }
+
+                char *dump = nft_prefs_node_to_buffer(prefs, n);
+                nft_prefs_node_free(n);
+                if(!dump || strcmp(dump, expected) != 0)
+                {
+                        NFT_LOG(L_ERROR, "parsing with options changed result");
+                        free(dump);
+                        goto _deinit;
+                }
+                free(dump);
+        }
+
+        /* feeding garbage must fail */
+        NFT_LOG(L_INFO, "==== IGNORE ERROR MESSAGES ====");
+        if(!(parser = nft_prefs_parser_new(prefs, NULL)))
+                goto _deinit;
+        nft_prefs_parser_feed(parser, "<foo><bar></foo>", 16);
+        NftPrefsNode *broken = nft_prefs_parser_finish(parser);
+        NFT_LOG(L_INFO, "==== END IGNORING ERROR MESSAGES ====");
+        if(broken)
+        {
+                NFT_LOG(L_ERROR, "parsing malformed document succeeded");
+                nft_prefs_node_free(broken);
+                goto _deinit;
+        }
+
+        /* all went fine */
+        result = EXIT_SUCCESS;
+
+_deinit:
+        if(fds[0] != -1)
+                close(fds[0]);
+        if(fds[1] != -1)
+                close(fds[1]);
+        free(file);
+        free(expected);
+        free(got);
+        if(node)
+                nft_prefs_node_free(node);
+        if(pushed)
+                nft_prefs_node_free(pushed);
+        nft_prefs_deinit(prefs);
+
+        return result;
+}
@@ -0,0 +1,255 @@
+/*
+ * libniftyprefs - lightweight modelless preferences management library
+ * Copyright (C) 2006-2014 Daniel Hiepler <daniel@niftylight.de>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <niftylog.h>
+#include <niftyprefs.h>
+
+
+/* amount of elements of large array */
+#define ELEMENTS        100000
+
+
+
+/** byte arrays of all lengths up to a few SIMD blocks */
+static bool _test_u8(NftPrefsNode * n)
+{
+        uint8_t in[256], out[256];
+        for(size_t length = 0; length <= sizeof(in); length++)
+        {
+                for(size_t i = 0; i < length; i++)
+                        in[i] = rand();
+
+                size_t count = sizeof(out);
+                memset(out, 0xaa, sizeof(out));
+                if(!nft_prefs_node_prop_u8_array_set(n, "bytes", in, length) ||
+                   !nft_prefs_node_prop_u8_array_get(n, "bytes", out, &count) ||
+                   count != length || memcmp(in, out, length) != 0)
+                {
+                        NFT_LOG(L_ERROR, "byte array of %zu elements differs",
+                                length);
+                        return false;
+                }
+
+                /* bytes after the elements are untouched */
+                for(size_t i = length; i < sizeof(out); i++)
+                {
+                        if(out[i] != 0xaa)
+                        {
+                                NFT_LOG(L_ERROR, "byte array of %zu elements "
+                                        "overwrote buffer", length);
+                                return false;
+                        }
+                }
+        }
+
+        /* representation is plain base64 */
+        const char *s;
+        if(!nft_prefs_node_prop_u8_array_set(n, "bytes", (const uint8_t *) "Ma", 2) ||
+           !(s = nft_prefs_node_prop_string_borrow(n, "bytes", NULL)) ||
+           strcmp(s, "TWE=") != 0)
+        {
+                NFT_LOG(L_ERROR, "unexpected representation of byte array");
+                return false;
+        }
+
+        return true;
+}
+
+
+/** int and double arrays */
+static bool _test_numbers(NftPrefsNode * n)
+{
+        int ints[] = { 0, 1, -1, INT_MIN, INT_MAX, 123456789, -42 };
+        double doubles[] = { 0.0, -0.0, 0.1, -1e300, 5e-324, INFINITY, -INFINITY };
+        int iout[7];
+        double dout[7];
+        size_t icount = 7, dcount = 7;
+
+        if(!nft_prefs_node_prop_int_array_set(n, "ints", ints, 7) ||
+           !nft_prefs_node_prop_double_array_set(n, "doubles", doubles, 7) ||
+           !nft_prefs_node_prop_int_array_get(n, "ints", iout, &icount) ||
+           !nft_prefs_node_prop_double_array_get(n, "doubles", dout, &dcount) ||
+           icount != 7 || dcount != 7 ||
+           memcmp(ints, iout, sizeof(ints)) != 0 ||
+           memcmp(doubles, dout, sizeof(doubles)) != 0)
+        {
+                NFT_LOG(L_ERROR, "number arrays differ");
+                return false;
+        }
+
+        /* amount of elements without buffer */
+        size_t count = 0;
+        if(!nft_prefs_node_prop_double_array_get(n, "doubles", NULL, &count) ||
+           count != 7)
+        {
+                NFT_LOG(L_ERROR, "wrong amount of elements");
+                return false;
+        }
+
+        /* buffer too small */
+        count = 6;
+        if(nft_prefs_node_prop_int_array_get(n, "ints", iout, &count) ||
+           count != 7)
+        {
+                NFT_LOG(L_ERROR, "too small buffer wasn't rejected");
+                return false;
+        }
+
+        /* 28 bytes aren't a multiple of 8 */
+        count = 7;
+        if(nft_prefs_node_prop_double_array_get(n, "ints", dout, &count))
+        {
+                NFT_LOG(L_ERROR, "int array was read as double array");
+                return false;
+        }
+
+        /* empty array */
+        count = 7;
+        if(!nft_prefs_node_prop_int_array_set(n, "ints", NULL, 0) ||
+           !nft_prefs_node_prop_int_array_get(n, "ints", iout, &count) ||
+           count != 0)
+        {
+                NFT_LOG(L_ERROR, "empty array failed");
+                return false;
+        }
+
+        return true;
+}
+
+
+/** malformed base64 is rejected */
+static bool _test_invalid(NftPrefsNode * n)
+{
+        const char *invalid[] =
+        {
+                "TWF", "TW=u", "TWF@", "TWF=", "TQ", "TR==", "T===", "====",
+                "TWFuTWFuTWFuTWFuTWFuTWFuTWFuTWFuTWFuTWFu TWFuTWFu",
+                "TWFuTWFuTWFuTWFuTWFuTWFuTWFuTWFuTWFuTWFuTWFuTWF\x80",
+        };
+
+        for(size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++)
+        {
+                uint8_t out[64];
+                size_t count = sizeof(out);
+                if(!nft_prefs_node_prop_string_set(n, "bytes", (char *) invalid[i]) ||
+                   nft_prefs_node_prop_u8_array_get(n, "bytes", out, &count))
+                {
+                        NFT_LOG(L_ERROR, "\"%s\" wasn't rejected", invalid[i]);
+                        return false;
+                }
+        }
+
+        return true;
+}
+
+
+/** large array survives the round trip */
+static bool _test_large(NftPrefsNode * n)
+{
+        double *values, *out = NULL;
+        if(!(values = malloc(ELEMENTS * sizeof(double))) ||
+           !(out = malloc(ELEMENTS * sizeof(double))))
+        {
+                free(values);
+                return false;
+        }
+
+        for(size_t i = 0; i < ELEMENTS; i++)
+                values[i] = rand() / 1024.0;
+
+        size_t count = ELEMENTS;
+        bool ok = nft_prefs_node_prop_double_array_set(n, "array", values, ELEMENTS) &&
+                nft_prefs_node_prop_double_array_get(n, "array", out, &count) &&
+                count == ELEMENTS && memcmp(values, out, count * sizeof(double)) == 0;
+        if(!ok)
+                NFT_LOG(L_ERROR, "large double array differs");
+
+        free(values);
+        free(out);
+        return ok;
+}
+
+
+/** array properties of nodes allocated from the heap and from arenas */
+int main(int argc, char *argv[])
+{
+        /* do preliminary version checks */
+        if(!NFT_PREFS_CHECK_VERSION)
+                return EXIT_FAILURE;
+
+        /* fail per default */
+        int result = EXIT_FAILURE;
+
+        /* initialize libniftyprefs */
+        NftPrefs *prefs;
+        if(!(prefs = nft_prefs_init(0)))
+                return EXIT_FAILURE;
+
+        for(int arena = 0; arena < 2; arena++)
+        {
+                NftPrefsNode *n;
+                if(!nft_prefs_set_arena(prefs, arena) ||
+                   !(n = nft_prefs_node_from_buffer(prefs, (char *) "<data/>", 7)))
+                        goto _deinit;
+
+                bool ok = _test_u8(n) && _test_numbers(n) &&
+                        _test_invalid(n) && _test_large(n);
+                nft_prefs_node_free(n);
+                if(!ok)
+                        goto _deinit;
+        }
+
+        result = EXIT_SUCCESS;
+
+_deinit:
+        nft_prefs_deinit(prefs);
+
+        return result;
+}
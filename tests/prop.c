@@ -0,0 +1,213 @@
+/*
+ * libniftyprefs - lightweight modelless preferences management library
+ * Copyright (C) 2006-2014 Daniel Hiepler <daniel@niftylight.de>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <niftylog.h>
+#include <niftyprefs.h>
+
+
+/* amount of reads that must not allocate */
+#define READS           1000
+
+
+/** test node */
+static const char *XML =
+        "<!DOCTYPE led [<!ENTITY unit \"mA\">"
+        "<!ATTLIST led mode CDATA \"pwm\">]>"
+        "<led name=\"front left\" current=\"20&unit;\" x=\"-12\" "
+        "gain=\"0.75\" enabled=\"Yes\" empty=\"\" big=\"4000000000\"/>";
+
+
+/* count allocations (unless a sanitizer replaces malloc()) */
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__) && !defined(__SANITIZE_THREAD__)
+#define COUNT_MALLOCS
+#endif
+
+
+#ifdef COUNT_MALLOCS
+/** amount of malloc() calls */
+static size_t _mallocs;
+extern void *__libc_malloc(size_t size);
+
+/** count calls to malloc() */
+void *malloc(size_t size)
+{
+        __atomic_add_fetch(&_mallocs, 1, __ATOMIC_RELAXED);
+        return __libc_malloc(size);
+}
+#endif
+
+
+
+/** check borrowed values */
+static bool _test_borrow(NftPrefsNode * n)
+{
+        size_t length;
+        const char *v;
+        if(!(v = nft_prefs_node_prop_string_borrow(n, "name", &length)) ||
+           strcmp(v, "front left") != 0 || length != 10)
+        {
+                NFT_LOG(L_ERROR, "failed to borrow \"name\"");
+                return false;
+        }
+
+        if(!(v = nft_prefs_node_prop_string_borrow(n, "empty", &length)) ||
+           *v != '\0' || length != 0)
+        {
+                NFT_LOG(L_ERROR, "failed to borrow empty property");
+                return false;
+        }
+
+        /* default from DTD */
+        if(!(v = nft_prefs_node_prop_string_borrow(n, "mode", NULL)) ||
+           strcmp(v, "pwm") != 0)
+        {
+                NFT_LOG(L_ERROR, "failed to borrow default value");
+                return false;
+        }
+
+        /* entity reference can't be borrowed but is copied */
+        char *copy = nft_prefs_node_prop_string_get(n, "current");
+        bool ok = copy && strcmp(copy, "20mA") == 0;
+        nft_prefs_free(copy);
+        if(nft_prefs_node_prop_string_borrow(n, "current", NULL) || !ok ||
+           nft_prefs_node_prop_string_borrow(n, "unknown", &length))
+        {
+                NFT_LOG(L_ERROR, "unexpected result of borrowing");
+                return false;
+        }
+
+        return true;
+}
+
+
+/** check typed getters */
+static bool _test_typed(NftPrefsNode * n)
+{
+        int i;
+        long int l;
+        double d;
+        bool b;
+
+        if(!nft_prefs_node_prop_int_get(n, "x", &i) || i != -12 ||
+           !nft_prefs_node_prop_long_int_get(n, "x", &l) || l != -12 ||
+           !nft_prefs_node_prop_double_get(n, "gain", &d) || d != 0.75 ||
+           !nft_prefs_node_prop_boolean_get(n, "enabled", &b) || !b)
+        {
+                NFT_LOG(L_ERROR, "typed getter returned wrong value");
+                return false;
+        }
+
+        if(nft_prefs_node_prop_int_get(n, "unknown", &i) ||
+           nft_prefs_node_prop_int_get(n, "big", &i) ||
+           nft_prefs_node_prop_int_get(n, "current", &i) ||
+           nft_prefs_node_prop_double_get(n, "name", &d))
+        {
+                NFT_LOG(L_ERROR, "typed getter didn't fail");
+                return false;
+        }
+
+        return true;
+}
+
+
+/** make sure typed getters don't allocate */
+static bool _test_allocations(NftPrefsNode * n)
+{
+#ifdef COUNT_MALLOCS
+        int i = 0;
+        size_t before = __atomic_load_n(&_mallocs, __ATOMIC_RELAXED);
+        for(int r = 0; r < READS; r++)
+                nft_prefs_node_prop_int_get(n, "x", &i);
+        size_t allocations = __atomic_load_n(&_mallocs, __ATOMIC_RELAXED) - before;
+
+        if(allocations != 0)
+        {
+                NFT_LOG(L_ERROR, "typed getter allocated memory %zu times", allocations);
+                return false;
+        }
+#endif
+
+        return true;
+}
+
+
+/** read properties of nodes allocated from the heap and from arenas */
+int main(int argc, char *argv[])
+{
+        /* do preliminary version checks */
+        if(!NFT_PREFS_CHECK_VERSION)
+                return EXIT_FAILURE;
+
+        /* fail per default */
+        int result = EXIT_FAILURE;
+
+        /* initialize libniftyprefs */
+        NftPrefs *prefs;
+        if(!(prefs = nft_prefs_init(0)))
+                return EXIT_FAILURE;
+
+        for(int arena = 0; arena < 2; arena++)
+        {
+                NftPrefsNode *n;
+                if(!nft_prefs_set_arena(prefs, arena) ||
+                   !(n = nft_prefs_node_from_buffer(prefs, (char *) XML, strlen(XML))))
+                        goto _deinit;
+
+                bool ok = _test_borrow(n) && _test_typed(n) && _test_allocations(n);
+                nft_prefs_node_free(n);
+                if(!ok)
+                        goto _deinit;
+        }
+
+        result = EXIT_SUCCESS;
+
+_deinit:
+        nft_prefs_deinit(prefs);
+
+        return result;
+}
@@ -0,0 +1,248 @@
+/*
+ * libniftyprefs - lightweight modelless preferences management library
+ * Copyright (C) 2006-2014 Daniel Hiepler <daniel@niftylight.de>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <niftylog.h>
+#include <niftyprefs.h>
+
+
+/** test node */
+static const char *XML =
+        "<!DOCTYPE person [<!ATTLIST person country CDATA \"de\">]>"
+        "<person name=\"Alice\" email=\"alice@example.com\" age=\"42\" "
+        "id=\"1234567890123\" weight=\"61.5\" alive=\"yes\" shoe=\"big\" "
+        "nick=\"much too long for the buffer\"/>";
+
+
+/** struct bound to properties */
+struct Person
+{
+        char name[64];
+        char *email;
+        int age;
+        long int id;
+        double weight;
+        bool alive;
+        char country[8];
+        int shoe;
+        int height;
+        char nick[8];
+};
+
+
+/** descriptors of all members */
+static const NftPrefsPropDesc PERSON[] =
+{
+        NFT_PREFS_PROP_DESC("name", NFT_PREFS_PROP_STRING, struct Person, name, NULL),
+        NFT_PREFS_PROP_DESC("email", NFT_PREFS_PROP_STRING_ALLOC, struct Person, email, NULL),
+        NFT_PREFS_PROP_DESC("age", NFT_PREFS_PROP_INT, struct Person, age, "0"),
+        NFT_PREFS_PROP_DESC("id", NFT_PREFS_PROP_LONG_INT, struct Person, id, NULL),
+        NFT_PREFS_PROP_DESC("weight", NFT_PREFS_PROP_DOUBLE, struct Person, weight, NULL),
+        NFT_PREFS_PROP_DESC("alive", NFT_PREFS_PROP_BOOLEAN, struct Person, alive, "false"),
+        NFT_PREFS_PROP_DESC("country", NFT_PREFS_PROP_STRING, struct Person, country, NULL),
+        NFT_PREFS_PROP_DESC("shoe", NFT_PREFS_PROP_INT, struct Person, shoe, "40"),
+        NFT_PREFS_PROP_DESC("height", NFT_PREFS_PROP_INT, struct Person, height, NULL),
+        NFT_PREFS_PROP_DESC("nick", NFT_PREFS_PROP_STRING, struct Person, nick, "-"),
+};
+
+/** amount of descriptors */
+#define PERSON_COUNT    (sizeof(PERSON) / sizeof(PERSON[0]))
+
+/** bits of descriptors */
+#define BIT(i)          (UINT64_C(1) << (i))
+
+
+
+/** read struct from node */
+static bool _test_get(NftPrefsNode * n)
+{
+        struct Person person;
+        memset(&person, 0, sizeof(person));
+        person.height = 180;
+
+        uint64_t failed = nft_prefs_node_props_get(n, PERSON, PERSON_COUNT, &person);
+        bool ok = strcmp(person.name, "Alice") == 0 &&
+                person.email && strcmp(person.email, "alice@example.com") == 0 &&
+                person.age == 42 && person.id == 1234567890123 &&
+                person.weight == 61.5 && person.alive &&
+                strcmp(person.country, "de") == 0 &&
+                person.shoe == 40 && person.height == 180 &&
+                strcmp(person.nick, "-") == 0;
+        nft_prefs_free(person.email);
+
+        if(!ok)
+        {
+                NFT_LOG(L_ERROR, "struct wasn't filled as expected");
+                return false;
+        }
+
+        /* invalid "shoe", missing "height", too long "nick" */
+        if(failed != (BIT(7) | BIT(8) | BIT(9)))
+        {
+                NFT_LOG(L_ERROR, "unexpected bitmask 0x%llx",
+                        (unsigned long long) failed);
+                return false;
+        }
+
+        if(nft_prefs_node_props_get(n, PERSON, NFT_PREFS_PROPS_MAX + 1,
+                                    &person) != UINT64_MAX)
+        {
+                NFT_LOG(L_ERROR, "too many descriptors weren't rejected");
+                return false;
+        }
+
+        return true;
+}
+
+
+/** write struct to existing and to new node and read it back */
+static bool _test_set(NftPrefsNode * n)
+{
+        struct Person person =
+        {
+                .name = "Bob",
+                .email = "bob@example.com",
+                .age = -7,
+                .id = -1234567890123,
+                .weight = 0.1,
+                .alive = false,
+                .country = "fr",
+                .shoe = 44,
+                .height = 190,
+                .nick = "b",
+        };
+
+        NftPrefsNode *fresh = nft_prefs_node_alloc("person");
+        NftPrefsNode *nodes[] = { n, fresh };
+        for(int i = 0; i < 2; i++)
+        {
+                if(!nodes[i] ||
+                   nft_prefs_node_props_set(nodes[i], PERSON, PERSON_COUNT, &person) != 0)
+                {
+                        NFT_LOG(L_ERROR, "failed to set properties");
+                        nft_prefs_node_free(fresh);
+                        return false;
+                }
+
+                /* every property exists once */
+                size_t count = 0;
+                for(xmlAttr * a = nodes[i]->properties; a; a = a->next)
+                        count++;
+
+                struct Person result;
+                memset(&result, 0, sizeof(result));
+                const char *weight = nft_prefs_node_prop_string_borrow(nodes[i], "weight", NULL);
+                bool ok = count == PERSON_COUNT &&
+                        weight && strcmp(weight, "0.1") == 0 &&
+                        nft_prefs_node_props_get(nodes[i], PERSON, PERSON_COUNT, &result) == 0 &&
+                        strcmp(result.name, "Bob") == 0 &&
+                        strcmp(result.email, person.email) == 0 &&
+                        result.age == -7 && result.id == -1234567890123 &&
+                        result.weight == 0.1 && !result.alive &&
+                        strcmp(result.country, "fr") == 0 && result.shoe == 44 &&
+                        result.height == 190 && strcmp(result.nick, "b") == 0;
+                nft_prefs_free(result.email);
+
+                if(!ok)
+                {
+                        NFT_LOG(L_ERROR, "properties weren't set as expected");
+                        nft_prefs_node_free(fresh);
+                        return false;
+                }
+        }
+
+        nft_prefs_node_free(fresh);
+
+        /* NULL string and unterminated buffer can't be set */
+        person.email = NULL;
+        memset(person.nick, 'x', sizeof(person.nick));
+        if(nft_prefs_node_props_set(n, PERSON, PERSON_COUNT, &person) !=
+           (BIT(1) | BIT(9)))
+        {
+                NFT_LOG(L_ERROR, "invalid members weren't reported");
+                return false;
+        }
+
+        return true;
+}
+
+
+/** bind properties of nodes allocated from the heap and from arenas */
+int main(int argc, char *argv[])
+{
+        /* do preliminary version checks */
+        if(!NFT_PREFS_CHECK_VERSION)
+                return EXIT_FAILURE;
+
+        /* fail per default */
+        int result = EXIT_FAILURE;
+
+        /* initialize libniftyprefs */
+        NftPrefs *prefs;
+        if(!(prefs = nft_prefs_init(0)))
+                return EXIT_FAILURE;
+
+        for(int arena = 0; arena < 2; arena++)
+        {
+                NftPrefsNode *n;
+                if(!nft_prefs_set_arena(prefs, arena) ||
+                   !(n = nft_prefs_node_from_buffer(prefs, (char *) XML, strlen(XML))))
+                        goto _deinit;
+
+                bool ok = _test_get(n) && _test_set(n);
+                nft_prefs_node_free(n);
+                if(!ok)
+                        goto _deinit;
+        }
+
+        result = EXIT_SUCCESS;
+
+_deinit:
+        nft_prefs_deinit(prefs);
+
+        return result;
+}
@@ -0,0 +1,232 @@
+/*
+ * libniftyprefs - lightweight modelless preferences management library
+ * Copyright (C) 2006-2014 Daniel Hiepler <daniel@niftylight.de>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <niftylog.h>
+#include <niftyprefs.h>
+
+
+/* amount of people in large tree */
+#define PEOPLE          2000
+/* amount of queries of large tree */
+#define QUERIES         20
+
+
+/** test tree */
+static const char *PEOPLE_XML =
+        "<people version=\"1\">"
+        "<person name=\"Alice\" age=\"30\"/>"
+        "<person name=\"Bob\" age=\"40\"/>"
+        "<person name=\"Carol\" age=\"50\" email=\"carol@example.com\"/>"
+        "<group name=\"Bob\"/>"
+        "<settings><color value=\"red\">crimson</color></settings>"
+        "</people>";
+
+
+/** query & expected result (NULL if nothing should match) */
+static const char *QUERIES_EXPECTED[][2] = {
+        {"people/person[@name='Bob']/@age", "40"},
+        {"/people/person[@name=\"Carol\"]/@email", "carol@example.com"},
+        {"people/person[2]/@name", "Bob"},
+        {"people/person[@age][3]/@name", "Carol"},
+        {"people/*[@name='Bob'][2]/@name", "Bob"},
+        {"people/person/@email", "carol@example.com"},
+        {"people/settings/color/@value", "red"},
+        {"people/settings/color", "crimson"},
+        {"@version", "1"},
+        {"people/person[@name='Zed']/@age", NULL},
+        {"people/person[4]/@name", NULL},
+        {"people/person/@unknown", NULL},
+        {"person/@age", NULL},
+};
+
+
+/** invalid queries */
+static const char *INVALID[] = {
+        "people//person",
+        "people/person[@name='Bob'",
+        "people/person[0]",
+        "people/person/",
+        "people/@age/person",
+        "people/person[@name=Bob]",
+        "people/person[-18446744073709551614]/@name",
+        "people/person[-1]",
+        "people/person[+2]",
+        "people/person[\n2]",
+        "people/person[99999999999999999999999999]",
+};
+
+
+
+/** check all queries */
+static bool _test_queries(NftPrefs * p, NftPrefsNode * root)
+{
+        for(size_t i = 0; i < sizeof(QUERIES_EXPECTED) / sizeof(QUERIES_EXPECTED[0]); i++)
+        {
+                const char *path = QUERIES_EXPECTED[i][0];
+                const char *expected = QUERIES_EXPECTED[i][1];
+
+                /* twice to use the cached query */
+                for(int run = 0; run < 2; run++)
+                {
+                        char *value = nft_prefs_node_query(p, root, path);
+                        bool ok = expected ? (value && strcmp(value, expected) == 0) : !value;
+                        if(!ok)
+                        {
+                                NFT_LOG(L_ERROR, "\"%s\": expected \"%s\", got \"%s\"",
+                                        path, expected ? expected : "(null)",
+                                        value ? value : "(null)");
+                                nft_prefs_free(value);
+                                return false;
+                        }
+                        nft_prefs_free(value);
+                }
+        }
+
+        for(size_t i = 0; i < sizeof(INVALID) / sizeof(INVALID[0]); i++)
+        {
+                if(nft_prefs_node_query_node(p, root, INVALID[i]))
+                {
+                        NFT_LOG(L_ERROR, "invalid query \"%s\" succeeded", INVALID[i]);
+                        return false;
+                }
+        }
+
+        /* relative to a subtree */
+        NftPrefsNode *bob;
+        char *age = NULL;
+        if(!(bob = nft_prefs_node_query_node(p, root, "people/person[@name='Bob']")) ||
+           strcmp(nft_prefs_node_get_name(bob), "person") != 0 ||
+           !(age = nft_prefs_node_query(p, bob, "person/@age")) ||
+           strcmp(age, "40") != 0)
+        {
+                NFT_LOG(L_ERROR, "query relative to subtree failed");
+                nft_prefs_free(age);
+                return false;
+        }
+        nft_prefs_free(age);
+
+        return true;
+}
+
+
+/** query people near the end of a large tree */
+static bool _test_large(NftPrefs * p)
+{
+        bool result = false;
+
+        size_t size = PEOPLE * 64 + 64;
+        char *xml;
+        if(!(xml = malloc(size)))
+                return false;
+
+        size_t l = (size_t) snprintf(xml, size, "<people>");
+        for(int i = 0; i < PEOPLE; i++)
+                l += (size_t) snprintf(xml + l, size - l,
+                                       "<person name=\"p%d\" age=\"%d\"/>", i, i);
+        snprintf(xml + l, size - l, "</people>");
+
+        NftPrefsNode *root = nft_prefs_node_from_buffer(p, xml, strlen(xml));
+        free(xml);
+        if(!root)
+                return false;
+
+        char path[128];
+        for(int i = 0; i < QUERIES; i++)
+        {
+                snprintf(path, sizeof(path), "people/person[@name='p%d']/@age",
+                         PEOPLE - 1 - (i % 10));
+                char *age = nft_prefs_node_query(p, root, path);
+                bool ok = age && atoi(age) == PEOPLE - 1 - (i % 10);
+                nft_prefs_free(age);
+                if(!ok)
+                {
+                        NFT_LOG(L_ERROR, "\"%s\" failed", path);
+                        goto _tl_exit;
+                }
+        }
+
+        result = true;
+
+_tl_exit:
+        nft_prefs_node_free(root);
+        return result;
+}
+
+
+/** query a small and a large tree */
+int main(int argc, char *argv[])
+{
+        /* do preliminary version checks */
+        if(!NFT_PREFS_CHECK_VERSION)
+                return EXIT_FAILURE;
+
+        /* fail per default */
+        int result = EXIT_FAILURE;
+
+        /* initialize libniftyprefs */
+        NftPrefs *prefs;
+        if(!(prefs = nft_prefs_init(0)))
+                return EXIT_FAILURE;
+
+        NftPrefsNode *root;
+        if(!(root = nft_prefs_node_from_buffer(prefs, (char *) PEOPLE_XML,
+                                               strlen(PEOPLE_XML))))
+                goto _deinit;
+
+        bool ok = _test_queries(prefs, root);
+        nft_prefs_node_free(root);
+        if(!ok || !_test_large(prefs))
+                goto _deinit;
+
+        result = EXIT_SUCCESS;
+
+_deinit:
+        nft_prefs_deinit(prefs);
+
+        return result;
+}
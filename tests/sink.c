@@ -0,0 +1,185 @@
+/*
+ * libniftyprefs - lightweight modelless preferences management library
+ * Copyright (C) 2006-2014 Daniel Hiepler <daniel@niftylight.de>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <niftylog.h>
+#include <niftyprefs.h>
+
+
+/* amount of children (enough for several chunks) */
+#define ITEMS           2000
+
+
+/** sink that collects all chunks in a growing buffer */
+struct Sink
+{
+        char *buffer;
+        size_t length;
+        /** amount of write calls */
+        int writes;
+        /** fail after this many writes (0 never fails) */
+        int fail_after;
+        bool closed;
+};
+
+
+
+/** NftPrefsSinkWriteFunc that appends a chunk to our Sink */
+static int _sink_write(void *ctx, const char *buffer, int len)
+{
+        struct Sink *s = ctx;
+
+        if(s->fail_after && s->writes >= s->fail_after)
+                return -1;
+        s->writes++;
+
+        char *tmp;
+        if(!(tmp = realloc(s->buffer, s->length + len + 1)))
+                return -1;
+
+        memcpy(&tmp[s->length], buffer, len);
+        s->buffer = tmp;
+        s->length += len;
+        s->buffer[s->length] = '\0';
+
+        return len;
+}
+
+
+/** NftPrefsSinkCloseFunc */
+static int _sink_close(void *ctx)
+{
+        struct Sink *s = ctx;
+
+        s->closed = true;
+        return 0;
+}
+
+
+/** build tree with ITEMS children */
+static NftPrefsNode *_tree(void)
+{
+        NftPrefsNode *root;
+        if(!(root = nft_prefs_node_alloc("items")))
+                return NULL;
+
+        for(int i = 0; i < ITEMS; i++)
+        {
+                NftPrefsNode *n;
+                char name[32];
+                snprintf(name, sizeof(name), "item-%d", i);
+                if(!(n = nft_prefs_node_alloc("item")) ||
+                   !nft_prefs_node_prop_string_set(n, "name", name) ||
+                   !nft_prefs_node_prop_int_set(n, "id", i) ||
+                   !nft_prefs_node_add_child(root, n))
+                {
+                        nft_prefs_node_free(n);
+                        nft_prefs_node_free(root);
+                        return NULL;
+                }
+        }
+
+        return root;
+}
+
+
+/** streamed output matches nft_prefs_node_to_buffer(), failing writes are 
+    reported & the sink is closed in any case */
+int main(int argc, char *argv[])
+{
+        /* do preliminary version checks */
+        if(!NFT_PREFS_CHECK_VERSION)
+                return EXIT_FAILURE;
+
+        /* fail per default */
+        int result = EXIT_FAILURE;
+
+        /* initialize libniftyprefs */
+        NftPrefs *prefs;
+        if(!(prefs = nft_prefs_init(0)))
+                return EXIT_FAILURE;
+
+        char *buffer = NULL;
+        struct Sink sink = { .buffer = NULL };
+        NftPrefsNode *n;
+        if(!(n = _tree()))
+                goto _deinit;
+
+        if(!nft_prefs_node_to_sink(prefs, n, _sink_write, _sink_close, &sink) ||
+           !(buffer = nft_prefs_node_to_buffer(prefs, n)))
+                goto _deinit;
+
+        if(!sink.closed || sink.writes < 2 || !sink.buffer ||
+           strcmp(sink.buffer, buffer) != 0)
+        {
+                NFT_LOG(L_ERROR, "output of nft_prefs_node_to_sink() doesn't "
+                        "match nft_prefs_node_to_buffer()");
+                goto _deinit;
+        }
+
+        /* sink that stops accepting data */
+        free(sink.buffer);
+        sink = (struct Sink) { .fail_after = 1 };
+        if(nft_prefs_node_to_sink(prefs, n, _sink_write, _sink_close, &sink) ||
+           !sink.closed)
+        {
+                NFT_LOG(L_ERROR, "failing sink wasn't reported or not closed");
+                goto _deinit;
+        }
+
+        result = EXIT_SUCCESS;
+
+_deinit:
+        free(sink.buffer);
+        nft_prefs_free(buffer);
+        if(n)
+                nft_prefs_node_free(n);
+        nft_prefs_deinit(prefs);
+
+        return result;
+}
@@ -0,0 +1,431 @@
+/*
+ * libniftyprefs - lightweight modelless preferences management library
+ * Copyright (C) 2006-2014 Daniel Hiepler <daniel@niftylight.de>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <niftylog.h>
+#include <niftyprefs.h>
+
+
+/** nested struct */
+struct Point
+{
+        int x;
+        int y;
+        double weight;
+};
+
+/** struct with nested struct & array */
+struct Shape
+{
+        char name[16];
+        char *label;
+        bool closed;
+        struct Point origin;
+        struct Point *points;
+        size_t points_count;
+};
+
+/** flat struct (also converted by hand-written callbacks) */
+struct Vertex
+{
+        int x;
+        int y;
+        int z;
+        double u;
+        double v;
+        long int id;
+};
+
+
+/** descriptors of Point */
+static const NftPrefsFieldDesc POINT[] =
+{
+        NFT_PREFS_FIELD("x", NFT_PREFS_PROP_INT, struct Point, x, NULL),
+        NFT_PREFS_FIELD("y", NFT_PREFS_PROP_INT, struct Point, y, NULL),
+        NFT_PREFS_FIELD("weight", NFT_PREFS_PROP_DOUBLE, struct Point, weight, "1.5"),
+};
+
+/** descriptors of Shape (first <point> is the origin, the others are 
+    elements of the array) */
+static const NftPrefsFieldDesc SHAPE[] =
+{
+        NFT_PREFS_FIELD("name", NFT_PREFS_PROP_STRING, struct Shape, name, NULL),
+        NFT_PREFS_FIELD("label", NFT_PREFS_PROP_STRING_ALLOC, struct Shape, label, "none"),
+        NFT_PREFS_FIELD("closed", NFT_PREFS_PROP_BOOLEAN, struct Shape, closed, "true"),
+        NFT_PREFS_FIELD_CHILD(struct Shape, origin, "point"),
+        NFT_PREFS_FIELD_ARRAY(struct Shape, points, points_count, "point"),
+};
+
+/** descriptors of Vertex */
+static const NftPrefsFieldDesc VERTEX[] =
+{
+        NFT_PREFS_FIELD("x", NFT_PREFS_PROP_INT, struct Vertex, x, NULL),
+        NFT_PREFS_FIELD("y", NFT_PREFS_PROP_INT, struct Vertex, y, NULL),
+        NFT_PREFS_FIELD("z", NFT_PREFS_PROP_INT, struct Vertex, z, NULL),
+        NFT_PREFS_FIELD("u", NFT_PREFS_PROP_DOUBLE, struct Vertex, u, NULL),
+        NFT_PREFS_FIELD("v", NFT_PREFS_PROP_DOUBLE, struct Vertex, v, NULL),
+        NFT_PREFS_FIELD("id", NFT_PREFS_PROP_LONG_INT, struct Vertex, id, NULL),
+};
+
+/** amount of descriptors */
+#define COUNT(a)        (sizeof(a) / sizeof(a[0]))
+
+
+
+/** hand-written prefsFromObj() of Vertex */
+static NftResult _vertex_from_obj(NftPrefs * p, NftPrefsNode * n, void *obj,
+                                  void *userptr)
+{
+        struct Vertex *v = obj;
+        return nft_prefs_node_prop_int_set(n, "x", v->x) &&
+                nft_prefs_node_prop_int_set(n, "y", v->y) &&
+                nft_prefs_node_prop_int_set(n, "z", v->z) &&
+                nft_prefs_node_prop_double_set(n, "u", v->u) &&
+                nft_prefs_node_prop_double_set(n, "v", v->v) &&
+                nft_prefs_node_prop_long_int_set(n, "id", v->id);
+}
+
+
+/** hand-written prefsToObj() of Vertex */
+static NftResult _vertex_to_obj(NftPrefs * p, void **newObj, NftPrefsNode * n,
+                                void *userptr)
+{
+        struct Vertex *v;
+        if(!(v = calloc(1, sizeof(struct Vertex))))
+                return NFT_FAILURE;
+
+        nft_prefs_node_prop_int_get(n, "x", &v->x);
+        nft_prefs_node_prop_int_get(n, "y", &v->y);
+        nft_prefs_node_prop_int_get(n, "z", &v->z);
+        nft_prefs_node_prop_double_get(n, "u", &v->u);
+        nft_prefs_node_prop_double_get(n, "v", &v->v);
+        nft_prefs_node_prop_long_int_get(n, "id", &v->id);
+
+        *newObj = v;
+        return NFT_SUCCESS;
+}
+
+
+/** compare two shapes */
+static bool _equal(const struct Shape *a, const struct Shape *b)
+{
+        if(strcmp(a->name, b->name) != 0 || strcmp(a->label, b->label) != 0 ||
+           a->closed != b->closed || a->points_count != b->points_count ||
+           memcmp(&a->origin, &b->origin, sizeof(struct Point)) != 0)
+                return false;
+
+        for(size_t i = 0; i < a->points_count; i++)
+        {
+                if(memcmp(&a->points[i], &b->points[i], sizeof(struct Point)) != 0)
+                        return false;
+        }
+
+        return true;
+}
+
+
+/** convert shape to node, to text, back to node and to shape */
+static bool _test_roundtrip(NftPrefs * prefs)
+{
+        struct Point points[] = { {1, 2, 0.25}, {-3, 4, 1.5}, {5, -6, 100} };
+        struct Shape shape =
+        {
+                .name = "triangle",
+                .label = "a shape",
+                .closed = false,
+                .origin = {7, 8, 0.5},
+                .points = points,
+                .points_count = COUNT(points),
+        };
+
+        bool ok = false;
+        char *buffer = NULL;
+        struct Shape *copy = NULL, *reparsed = NULL;
+        NftPrefsNode *n, *m = NULL;
+        if(!(n = nft_prefs_obj_to_node(prefs, "shape", &shape, NULL)))
+        {
+                NFT_LOG(L_ERROR, "failed to create node from shape");
+                return false;
+        }
+
+        /* origin + array elements */
+        size_t children = 0;
+        for(NftPrefsNode * c = nft_prefs_node_get_first_child(n); c;
+            c = nft_prefs_node_get_next(c))
+                children++;
+        if(children != 1 + COUNT(points))
+        {
+                NFT_LOG(L_ERROR, "node has %zu children", children);
+                goto _tr_exit;
+        }
+
+        if(!(copy = nft_prefs_obj_from_node(prefs, n, NULL)) ||
+           !_equal(&shape, copy))
+        {
+                NFT_LOG(L_ERROR, "shape changed while converting node");
+                goto _tr_exit;
+        }
+
+        if(!(buffer = nft_prefs_node_to_buffer(prefs, n)) ||
+           !(m = nft_prefs_node_from_buffer(prefs, buffer, strlen(buffer))) ||
+           !(reparsed = nft_prefs_obj_from_node(prefs, m, NULL)) ||
+           !_equal(&shape, reparsed))
+        {
+                NFT_LOG(L_ERROR, "shape changed while converting text");
+                goto _tr_exit;
+        }
+
+        ok = true;
+
+_tr_exit:
+        nft_prefs_class_free_struct(prefs, "shape", copy);
+        nft_prefs_class_free_struct(prefs, "shape", reparsed);
+        nft_prefs_free(buffer);
+        nft_prefs_node_free(m);
+        nft_prefs_node_free(n);
+        return ok;
+}
+
+
+/** missing members get defaults */
+static bool _test_defaults(NftPrefs * prefs)
+{
+        const char *xml = "<shape name=\"empty\"><point x=\"3\"/></shape>";
+        NftPrefsNode *n;
+        if(!(n = nft_prefs_node_from_buffer(prefs, (char *) xml, strlen(xml))))
+                return false;
+
+        struct Shape *s;
+        bool ok = (s = nft_prefs_obj_from_node(prefs, n, NULL)) &&
+                strcmp(s->name, "empty") == 0 && strcmp(s->label, "none") == 0 &&
+                s->closed && s->origin.x == 3 && s->origin.y == 0 &&
+                s->origin.weight == 1.5 && !s->points && s->points_count == 0;
+        nft_prefs_class_free_struct(prefs, "shape", s);
+        nft_prefs_node_free(n);
+
+        if(!ok)
+                NFT_LOG(L_ERROR, "defaults weren't applied as expected");
+
+        return ok;
+}
+
+
+/** invalid descriptors & objects are rejected */
+static bool _test_invalid(NftPrefs * prefs)
+{
+        NftPrefsFieldDesc wrong[] =
+        {
+                NFT_PREFS_FIELD("x", NFT_PREFS_PROP_DOUBLE, struct Point, x, NULL),
+        };
+        NftPrefsFieldDesc twice[] =
+        {
+                NFT_PREFS_FIELD("x", NFT_PREFS_PROP_INT, struct Point, x, NULL),
+                NFT_PREFS_FIELD("x", NFT_PREFS_PROP_INT, struct Point, y, NULL),
+        };
+        NftPrefsFieldDesc def[] =
+        {
+                NFT_PREFS_FIELD("x", NFT_PREFS_PROP_INT, struct Point, x, "one"),
+        };
+        NftPrefsFieldDesc unbound[] =
+        {
+                NFT_PREFS_FIELD_CHILD(struct Shape, origin, "vertex-cb"),
+        };
+
+        if(nft_prefs_class_register_struct(prefs, "wrong", sizeof(struct Point), wrong, COUNT(wrong)) ||
+           nft_prefs_class_register_struct(prefs, "twice", sizeof(struct Point), twice, COUNT(twice)) ||
+           nft_prefs_class_register_struct(prefs, "def", sizeof(struct Point), def, COUNT(def)) ||
+           nft_prefs_class_register_struct(prefs, "point", sizeof(struct Point), POINT, COUNT(POINT)))
+        {
+                NFT_LOG(L_ERROR, "invalid class was registered");
+                return false;
+        }
+
+        /* nested class isn't bound to a struct */
+        struct Shape shape;
+        memset(&shape, 0, sizeof(shape));
+        NftPrefsNode *n;
+        if(!nft_prefs_class_register_struct(prefs, "unbound", sizeof(struct Shape), unbound, COUNT(unbound)) ||
+           (n = nft_prefs_obj_to_node(prefs, "unbound", &shape, NULL)))
+        {
+                NFT_LOG(L_ERROR, "child of unbound class was converted");
+                return false;
+        }
+        nft_prefs_class_unregister(prefs, "unbound");
+
+        /* array without elements */
+        shape.label = "label";
+        shape.points_count = 2;
+        if((n = nft_prefs_obj_to_node(prefs, "shape", &shape, NULL)))
+        {
+                nft_prefs_node_free(n);
+                NFT_LOG(L_ERROR, "NULL array was converted");
+                return false;
+        }
+
+        return true;
+}
+
+
+/** nested members lose their class when it's unregistered and find it 
+    again when it's registered again */
+static bool _test_rebind(NftPrefs * prefs)
+{
+        const char *xml = "<shape name=\"rebound\"><point x=\"3\"/></shape>";
+        NftPrefsNode *n;
+        if(!(n = nft_prefs_node_from_buffer(prefs, (char *) xml, strlen(xml))))
+                return false;
+
+        bool ok = false;
+        struct Shape *s;
+        nft_prefs_class_unregister(prefs, "point");
+        if((s = nft_prefs_obj_from_node(prefs, n, NULL)))
+        {
+                NFT_LOG(L_ERROR, "shape converted without class of <point>");
+                goto _trb_exit;
+        }
+
+        if(!nft_prefs_class_register_struct(prefs, "point", sizeof(struct Point), POINT, COUNT(POINT)) ||
+           !(s = nft_prefs_obj_from_node(prefs, n, NULL)) || s->origin.x != 3)
+        {
+                NFT_LOG(L_ERROR, "nested class wasn't rebound");
+                goto _trb_exit;
+        }
+
+        ok = true;
+
+_trb_exit:
+        nft_prefs_class_free_struct(prefs, "shape", s);
+        nft_prefs_node_free(n);
+        return ok;
+}
+
+
+/** bound struct and hand-written callbacks agree */
+static bool _test_callbacks(NftPrefs * prefs)
+{
+        struct Vertex vertex = { 1, -2, 3, 0.5, -0.25, 1234567890123 };
+        const char *classes[] = { "vertex", "vertex-cb" };
+        char *props[2] = { NULL, NULL };
+        bool result = true;
+
+        for(int c = 0; c < 2; c++)
+        {
+                NftPrefsNode *n;
+                if(!(n = nft_prefs_obj_to_node(prefs, classes[c], &vertex, NULL)))
+                        return false;
+
+                struct Vertex *v = nft_prefs_obj_from_node(prefs, n, NULL);
+                char *dump = nft_prefs_node_to_buffer(prefs, n);
+                nft_prefs_node_free(n);
+
+                /* properties without the element name */
+                char *tag = dump ? strstr(dump, "<vertex") : NULL;
+                char *space = tag ? strchr(tag, ' ') : NULL;
+                props[c] = space ? strdup(space) : NULL;
+                free(dump);
+
+                if(!v || !props[c] || v->x != vertex.x || v->y != vertex.y ||
+                   v->z != vertex.z || v->u != vertex.u || v->v != vertex.v ||
+                   v->id != vertex.id)
+                        result = false;
+                free(v);
+        }
+
+        if(!result || strcmp(props[0], props[1]) != 0)
+        {
+                NFT_LOG(L_ERROR, "bound struct differs from callbacks");
+                result = false;
+        }
+
+        free(props[0]);
+        free(props[1]);
+        return result;
+}
+
+
+/** convert structs bound to classes with nodes from the heap and from 
+    arenas and with deferred formatting of values */
+int main(int argc, char *argv[])
+{
+        /* do preliminary version checks */
+        if(!NFT_PREFS_CHECK_VERSION)
+                return EXIT_FAILURE;
+
+        /* fail per default */
+        int result = EXIT_FAILURE;
+
+        /* initialize libniftyprefs */
+        NftPrefs *prefs;
+        if(!(prefs = nft_prefs_init(0)))
+                return EXIT_FAILURE;
+
+        /* nested class is registered after its parent */
+        if(!nft_prefs_class_register_struct(prefs, "shape", sizeof(struct Shape), SHAPE, COUNT(SHAPE)) ||
+           !nft_prefs_class_register_struct(prefs, "point", sizeof(struct Point), POINT, COUNT(POINT)) ||
+           !nft_prefs_class_register_struct(prefs, "vertex", sizeof(struct Vertex), VERTEX, COUNT(VERTEX)) ||
+           !nft_prefs_class_register(prefs, "vertex-cb", _vertex_to_obj, _vertex_from_obj))
+                goto _deinit;
+
+        for(int mode = 0; mode < 4; mode++)
+        {
+                nft_prefs_set_deferred_values(prefs, mode & 2);
+                if(!nft_prefs_set_arena(prefs, mode & 1) ||
+                   !_test_roundtrip(prefs) || !_test_defaults(prefs) ||
+                   !_test_callbacks(prefs))
+                        goto _deinit;
+        }
+
+        if(!_test_invalid(prefs) || !_test_rebind(prefs))
+                goto _deinit;
+
+        result = EXIT_SUCCESS;
+
+_deinit:
+        nft_prefs_deinit(prefs);
+
+        return result;
+}
@@ -0,0 +1,306 @@
+/*
+ * libniftyprefs - lightweight modelless preferences management library
+ * Copyright (C) 2006-2014 Daniel Hiepler <daniel@niftylight.de>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <niftylog.h>
+#include <niftyprefs.h>
+
+
+/** one row */
+struct Led
+{
+        int x;
+        double gain;
+        char *label;
+};
+
+
+
+/** create XML with runs of similar nodes */
+static char *_xml(size_t leds)
+{
+        char *xml;
+        if(!(xml = malloc(leds * 160 + 4096)))
+                return NULL;
+
+        size_t length = sprintf(xml, "<setup name=\"test\">\n");
+        for(size_t i = 0; i < leds; i++)
+                length += sprintf(xml + length,
+                                  "  <led x=\"%zu\" y=\"%d\" r=\"%zu\" g=\"0\" "
+                                  "b=\"255\" gain=\"%.1f\" label=\"led %zu &amp; &lt;%zu&gt;\"/>\n",
+                                  i * 3, -(int) (i % 7) * 100000, i % 256,
+                                  (i % 10) / 10.0, i, leds - i);
+
+        /* too short runs, other shapes, nested runs */
+        length += sprintf(xml + length, "  <!-- comment -->\n"
+                          "  <led x=\"1\"/><led x=\"2\"/>\n"
+                          "  <group>\n");
+        for(int i = 0; i < 20; i++)
+                length += sprintf(xml + length,
+                                  "    <item id=\"%d\" value=\"%s\"/>\n", i,
+                                  i % 2 ? "yes" : "");
+        sprintf(xml + length, "    <item id=\"20\"><sub/></item>\n  </group>\n"
+                "</setup>\n");
+
+        return xml;
+}
+
+
+/** write tables, read them and compare the result */
+static bool _test_roundtrip(NftPrefs * p, NftPrefsNode * n)
+{
+        bool result = false;
+        char *plain = NULL, *tables = NULL, *minimal = NULL, *again = NULL;
+        NftPrefsNode *m = NULL, *m2 = NULL;
+
+        nft_prefs_set_columnar(p, false);
+        if(!(plain = nft_prefs_node_to_buffer_minimal(p, n)))
+                goto _tr_exit;
+
+        nft_prefs_set_columnar(p, true);
+        if(!(tables = nft_prefs_node_to_buffer(p, n)) ||
+           !(minimal = nft_prefs_node_to_buffer_minimal(p, n)))
+                goto _tr_exit;
+
+        /* the long run of <led> nodes and the run of <item> nodes */
+        char *t = strstr(tables, "<nft:table");
+        if(!t || !(t = strstr(t + 1, "<nft:table")) ||
+           strstr(t + 1, "<nft:table") || !strstr(minimal, "<nft:table"))
+        {
+                NFT_LOG(L_ERROR, "unexpected tables:\n%s", tables);
+                goto _tr_exit;
+        }
+
+        nft_prefs_set_columnar(p, false);
+        if(!(m = nft_prefs_node_from_buffer(p, tables, strlen(tables))) ||
+           !(m2 = nft_prefs_node_from_buffer(p, minimal, strlen(minimal))) ||
+           !(again = nft_prefs_node_to_buffer_minimal(p, m)) ||
+           strcmp(plain, again) != 0)
+        {
+                NFT_LOG(L_ERROR, "tree changed after reading tables");
+                goto _tr_exit;
+        }
+
+        nft_prefs_free(again);
+        if(!(again = nft_prefs_node_to_buffer_minimal(p, m2)) ||
+           strcmp(plain, again) != 0)
+        {
+                NFT_LOG(L_ERROR, "tree changed after reading minimal tables");
+                goto _tr_exit;
+        }
+
+        result = true;
+
+_tr_exit:
+        nft_prefs_set_columnar(p, false);
+        free(plain);
+        free(tables);
+        free(minimal);
+        free(again);
+        nft_prefs_node_free(m);
+        nft_prefs_node_free(m2);
+        return result;
+}
+
+
+/** read columns of children */
+static bool _test_column(NftPrefsNode * n, size_t leds)
+{
+        static const NftPrefsPropDesc x =
+                NFT_PREFS_PROP_DESC("x", NFT_PREFS_PROP_INT, struct Led, x, NULL);
+        static const NftPrefsPropDesc gain =
+                NFT_PREFS_PROP_DESC("gain", NFT_PREFS_PROP_DOUBLE, struct Led, gain, NULL);
+        static const NftPrefsPropDesc label =
+                NFT_PREFS_PROP_DESC("label", NFT_PREFS_PROP_STRING_ALLOC, struct Led, label, NULL);
+        static const NftPrefsPropDesc plain =
+                { "x", NFT_PREFS_PROP_INT, 0, sizeof(int), NULL };
+        static const NftPrefsPropDesc y =
+                { "y", NFT_PREFS_PROP_INT, 0, sizeof(int), "-1" };
+
+        /* amount of children */
+        size_t count = 0;
+        if(!nft_prefs_node_column_get(n, "led", &x, NULL, 0, &count) ||
+           count != leds + 2)
+        {
+                NFT_LOG(L_ERROR, "wrong amount of children: %zu", count);
+                return false;
+        }
+
+        struct Led *rows;
+        int *ints;
+        if(!(rows = calloc(count, sizeof(struct Led))) ||
+           !(ints = calloc(count, sizeof(int))))
+        {
+                free(rows);
+                return false;
+        }
+
+        bool ok = nft_prefs_node_column_get(n, "led", &x, rows, sizeof(struct Led), &count) &&
+                nft_prefs_node_column_get(n, "led", &plain, ints, sizeof(int), &count);
+        for(size_t i = 0; ok && i < leds; i++)
+                ok = rows[i].x == (int) i * 3 && ints[i] == rows[i].x;
+
+        /* last two nodes have no gain, no label and no y */
+        if(!ok ||
+           nft_prefs_node_column_get(n, "led", &gain, rows, sizeof(struct Led), &count) ||
+           nft_prefs_node_column_get(n, "led", &label, rows, sizeof(struct Led), &count) ||
+           !nft_prefs_node_column_get(n, "led", &y, ints, sizeof(int), &count) ||
+           ints[1] != -100000 || ints[leds + 1] != -1)
+        {
+                NFT_LOG(L_ERROR, "column not read as expected");
+                ok = false;
+        }
+
+        /* copies were freed */
+        for(size_t i = 0; ok && i < count; i++)
+                ok = !rows[i].label;
+
+        /* array too small */
+        count = leds;
+        if(ok && nft_prefs_node_column_get(n, "led", &x, rows, sizeof(struct Led), &count))
+        {
+                NFT_LOG(L_ERROR, "too small array wasn't rejected");
+                ok = false;
+        }
+
+        free(rows);
+        free(ints);
+        return ok;
+}
+
+
+/** malformed tables are rejected */
+static bool _test_invalid(NftPrefs * p)
+{
+        static const char *invalid[] =
+        {
+                /* more values than rows */
+                "<a><nft:table xmlns:nft=\"http://wiki.niftylight.de/libniftyprefs/table\" "
+                "name=\"b\" rows=\"1\"><nft:column name=\"x\" type=\"int\">AgI=</nft:column>"
+                "</nft:table></a>",
+                /* fewer values than rows */
+                "<a><nft:table xmlns:nft=\"http://wiki.niftylight.de/libniftyprefs/table\" "
+                "name=\"b\" rows=\"3\"><nft:column name=\"x\" type=\"int\">AgI=</nft:column>"
+                "</nft:table></a>",
+                /* unterminated string */
+                "<a><nft:table xmlns:nft=\"http://wiki.niftylight.de/libniftyprefs/table\" "
+                "name=\"b\" rows=\"1\"><nft:column name=\"x\" type=\"string\">YQ==</nft:column>"
+                "</nft:table></a>",
+                /* invalid base64 */
+                "<a><nft:table xmlns:nft=\"http://wiki.niftylight.de/libniftyprefs/table\" "
+                "name=\"b\" rows=\"1\"><nft:column name=\"x\" type=\"int\">A</nft:column>"
+                "</nft:table></a>",
+                /* duplicate column */
+                "<a><nft:table xmlns:nft=\"http://wiki.niftylight.de/libniftyprefs/table\" "
+                "name=\"b\" rows=\"1\"><nft:column name=\"x\" type=\"int\">AA==</nft:column>"
+                "<nft:column name=\"x\" type=\"int\">AA==</nft:column></nft:table></a>",
+                /* invalid name */
+                "<a><nft:table xmlns:nft=\"http://wiki.niftylight.de/libniftyprefs/table\" "
+                "name=\"b c\" rows=\"1\"/></a>",
+                /* unknown type */
+                "<a><nft:table xmlns:nft=\"http://wiki.niftylight.de/libniftyprefs/table\" "
+                "name=\"b\" rows=\"1\"><nft:column name=\"x\" type=\"float\">AA==</nft:column>"
+                "</nft:table></a>",
+        };
+
+        for(size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++)
+        {
+                NftPrefsNode *n;
+                if((n = nft_prefs_node_from_buffer(p, (char *) invalid[i],
+                                                   strlen(invalid[i]))))
+                {
+                        NFT_LOG(L_ERROR, "invalid table #%zu was accepted", i);
+                        nft_prefs_node_free(n);
+                        return false;
+                }
+        }
+
+        return true;
+}
+
+
+/** columnar tables of trees allocated from the heap and from arenas */
+int main(int argc, char *argv[])
+{
+        /* do preliminary version checks */
+        if(!NFT_PREFS_CHECK_VERSION)
+                return EXIT_FAILURE;
+
+        /* fail per default */
+        int result = EXIT_FAILURE;
+
+        /* initialize libniftyprefs */
+        NftPrefs *prefs;
+        if(!(prefs = nft_prefs_init(0)))
+                return EXIT_FAILURE;
+
+        char *xml;
+        if(!(xml = _xml(100)))
+                goto _deinit;
+
+        for(int arena = 0; arena < 2; arena++)
+        {
+                NftPrefsNode *n;
+                if(!nft_prefs_set_arena(prefs, arena) ||
+                   !(n = nft_prefs_node_from_buffer(prefs, xml, strlen(xml))))
+                        goto _deinit;
+
+                bool ok = _test_roundtrip(prefs, n) && _test_column(n, 100) &&
+                        _test_invalid(prefs);
+                nft_prefs_node_free(n);
+                if(!ok)
+                        goto _deinit;
+        }
+
+        result = EXIT_SUCCESS;
+
+_deinit:
+        free(xml);
+        nft_prefs_deinit(prefs);
+
+        return result;
+}
@@ -0,0 +1,253 @@
+/*
+ * libniftyprefs - lightweight modelless preferences management library
+ * Copyright (C) 2006-2014 Daniel Hiepler <daniel@niftylight.de>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <niftylog.h>
+#include <niftyprefs.h>
+
+
+/** test node */
+static const char *XML =
+        "<led x=\"12\" y=\"-3\" id=\"1234567890123\" gain=\"0.75\" "
+        "on=\"yes\" label=\"front\"/>";
+/* amount of threads reading the same node */
+#define READERS         4
+/* amount of reads per thread */
+#define ROUNDS          1000
+
+
+
+/** read all typed properties */
+static bool _read(NftPrefsNode * n, int x, long int id, double gain, bool on)
+{
+        int i;
+        long int l;
+        double d;
+        bool b;
+        return nft_prefs_node_prop_int_get(n, "x", &i) && i == x &&
+                nft_prefs_node_prop_long_int_get(n, "id", &l) && l == id &&
+                nft_prefs_node_prop_double_get(n, "gain", &d) && d == gain &&
+                nft_prefs_node_prop_boolean_get(n, "on", &b) && b == on;
+}
+
+
+/** cached values are returned until their property changes */
+static bool _test_cache(NftPrefsNode * n)
+{
+        if(nft_prefs_node_get_value_cache(n) ||
+           !nft_prefs_node_set_value_cache(n, true) ||
+           !nft_prefs_node_get_value_cache(n))
+        {
+                NFT_LOG(L_ERROR, "failed to enable value cache");
+                return false;
+        }
+
+        /* first read parses, second read hits */
+        if(!_read(n, 12, 1234567890123, 0.75, true) ||
+           !_read(n, 12, 1234567890123, 0.75, true))
+        {
+                NFT_LOG(L_ERROR, "cached values differ");
+                return false;
+        }
+
+        /* same property read as other type */
+        double d;
+        if(!nft_prefs_node_prop_double_get(n, "x", &d) || d != 12)
+        {
+                NFT_LOG(L_ERROR, "int property read as double differs");
+                return false;
+        }
+
+        /* setters replace values */
+        if(!nft_prefs_node_prop_int_set(n, "x", 13) ||
+           !nft_prefs_node_prop_string_set(n, "id", "-5") ||
+           !nft_prefs_node_prop_double_set(n, "gain", 0.5) ||
+           !nft_prefs_node_prop_boolean_set(n, "on", false) ||
+           !_read(n, 13, -5, 0.5, false) ||
+           !nft_prefs_node_prop_double_get(n, "x", &d) || d != 13)
+        {
+                NFT_LOG(L_ERROR, "values weren't updated by setters");
+                return false;
+        }
+
+        /* unset properties aren't found anymore */
+        int i;
+        if(!nft_prefs_node_prop_unset(n, "x") ||
+           nft_prefs_node_prop_int_get(n, "x", &i) ||
+           !nft_prefs_node_prop_int_set(n, "x", 12))
+        {
+                NFT_LOG(L_ERROR, "value of unset property still cached");
+                return false;
+        }
+
+        /* invalid values aren't cached */
+        if(!nft_prefs_node_prop_string_set(n, "y", "high") ||
+           nft_prefs_node_prop_int_get(n, "y", &i) ||
+           nft_prefs_node_prop_int_get(n, "y", &i))
+        {
+                NFT_LOG(L_ERROR, "invalid value was cached");
+                return false;
+        }
+
+        if(!nft_prefs_node_set_value_cache(n, false) ||
+           nft_prefs_node_get_value_cache(n) ||
+           !nft_prefs_node_prop_boolean_set(n, "on", true) ||
+           !_read(n, 12, -5, 0.5, true))
+        {
+                NFT_LOG(L_ERROR, "failed to disable value cache");
+                return false;
+        }
+
+        return true;
+}
+
+
+/** read node over and over again (thread) */
+static void *_read_thread(void *arg)
+{
+        NftPrefsNode *n = arg;
+        for(int i = 0; i < ROUNDS; i++)
+        {
+                if(!_read(n, 12, 1234567890123, 0.75, true))
+                        return NULL;
+        }
+
+        return n;
+}
+
+
+/** several threads fill & read the cache of the same node at once */
+static bool _test_readers(NftPrefsNode * n)
+{
+        if(!nft_prefs_node_set_value_cache(n, true))
+                return false;
+
+        pthread_t threads[READERS];
+        int started = 0;
+        for(; started < READERS; started++)
+        {
+                if(pthread_create(&threads[started], NULL, _read_thread, n) != 0)
+                        break;
+        }
+
+        bool result = started == READERS;
+        for(int i = 0; i < started; i++)
+        {
+                void *r;
+                if(pthread_join(threads[i], &r) != 0 || r != n)
+                        result = false;
+        }
+
+        if(!result)
+                NFT_LOG(L_ERROR, "concurrent reads of cached values failed");
+
+        return result;
+}
+
+
+/** value cache of nodes allocated from the heap and from arenas */
+int main(int argc, char *argv[])
+{
+        /* do preliminary version checks */
+        if(!NFT_PREFS_CHECK_VERSION)
+                return EXIT_FAILURE;
+
+        /* fail per default */
+        int result = EXIT_FAILURE;
+
+        /* initialize libniftyprefs */
+        NftPrefs *prefs;
+        if(!(prefs = nft_prefs_init(0)))
+                return EXIT_FAILURE;
+
+        for(int arena = 0; arena < 2; arena++)
+        {
+                NftPrefsNode *n;
+                if(!nft_prefs_set_arena(prefs, arena) ||
+                   !(n = nft_prefs_node_from_buffer(prefs, (char *) XML, strlen(XML))))
+                        goto _deinit;
+
+                bool ok = _test_cache(n);
+                nft_prefs_node_free(n);
+                if(!ok)
+                        goto _deinit;
+
+                if(!(n = nft_prefs_node_from_buffer(prefs, (char *) XML, strlen(XML))))
+                        goto _deinit;
+
+                ok = _test_readers(n);
+                nft_prefs_node_free(n);
+                if(!ok)
+                        goto _deinit;
+        }
+
+        /* nodes without dictionary */
+        nft_prefs_set_parse_options(prefs, NFT_PREFS_PARSE_NODICT);
+        NftPrefsNode *n;
+        if(!(n = nft_prefs_node_from_buffer(prefs, (char *) XML, strlen(XML))))
+                goto _deinit;
+        bool ok = _test_cache(n);
+        nft_prefs_node_free(n);
+        if(!ok)
+                goto _deinit;
+
+        /* nodes that don't belong to a document can't cache values */
+        if(!(n = nft_prefs_node_alloc("led")))
+                goto _deinit;
+        ok = !nft_prefs_node_set_value_cache(n, true);
+        nft_prefs_node_free(n);
+        if(!ok)
+                goto _deinit;
+
+        result = EXIT_SUCCESS;
+
+_deinit:
+        nft_prefs_deinit(prefs);
+
+        return result;
+}
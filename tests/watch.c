@@ -0,0 +1,290 @@
+/*
+ * libniftyprefs - lightweight modelless preferences management library
+ * Copyright (C) 2006-2014 Daniel Hiepler <daniel@niftylight.de>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <niftylog.h>
+#include <niftyprefs.h>
+
+
+/* watched file */
+#define FILE_NAME       "test-watch.xml"
+/* file renamed to FILE_NAME */
+#define TMP_NAME        "test-watch.xml.tmp"
+/* maximum time to wait for a callback */
+#define TIMEOUT_MS      5000
+/* time to wait for callbacks that shouldn't happen */
+#define QUIET_MS        500
+
+
+/** state shared with watcher callback */
+typedef struct
+{
+        pthread_mutex_t mutex;
+        pthread_cond_t cond;
+        /** amount of callbacks */
+        int calls;
+        /** changes of last callback */
+        char changes[1024];
+} WatchState;
+
+
+
+/** append "name[key]" of node to string */
+static void _describe(char *s, size_t size, NftPrefsNode * n)
+{
+        char *key = nft_prefs_node_prop_string_get(n, "name");
+        size_t l = strlen(s);
+        if(key)
+                snprintf(s + l, size - l, "%s[%s]", nft_prefs_node_get_name(n), key);
+        else
+                snprintf(s + l, size - l, "%s", nft_prefs_node_get_name(n));
+        nft_prefs_free(key);
+}
+
+
+/** NftPrefsWatchFunc */
+static void _changed(NftPrefs * p, NftPrefsNode * previous,
+                     NftPrefsNode * current, NftPrefsDiff * diff,
+                     void *userptr)
+{
+        WatchState *s = userptr;
+
+        char changes[sizeof(s->changes)] = "";
+        for(size_t i = 0; diff && i < nft_prefs_diff_length(diff); i++)
+        {
+                const NftPrefsDiffEntry *e = nft_prefs_diff_get(diff, i);
+                size_t l = strlen(changes);
+                switch (e->op)
+                {
+                        case NFT_PREFS_DIFF_ADD:
+                                snprintf(changes + l, sizeof(changes) - l, "add ");
+                                _describe(changes, sizeof(changes), e->to);
+                                break;
+                        case NFT_PREFS_DIFF_REMOVE:
+                                snprintf(changes + l, sizeof(changes) - l, "remove ");
+                                _describe(changes, sizeof(changes), e->from);
+                                break;
+                        case NFT_PREFS_DIFF_MOVE:
+                                snprintf(changes + l, sizeof(changes) - l, "move ");
+                                _describe(changes, sizeof(changes), e->to);
+                                break;
+                        case NFT_PREFS_DIFF_REPLACE:
+                                snprintf(changes + l, sizeof(changes) - l, "replace ");
+                                _describe(changes, sizeof(changes), e->to);
+                                break;
+                        case NFT_PREFS_DIFF_PROP_SET:
+                        case NFT_PREFS_DIFF_PROP_UNSET:
+                                snprintf(changes + l, sizeof(changes) - l,
+                                         e->op == NFT_PREFS_DIFF_PROP_SET ? "set " : "unset ");
+                                _describe(changes, sizeof(changes), e->to);
+                                l = strlen(changes);
+                                snprintf(changes + l, sizeof(changes) - l, ".%s", e->prop);
+                                break;
+                }
+                l = strlen(changes);
+                snprintf(changes + l, sizeof(changes) - l, ";");
+        }
+
+        pthread_mutex_lock(&s->mutex);
+        if(!previous || !current || !diff)
+                snprintf(s->changes, sizeof(s->changes), "invalid callback");
+        else
+                snprintf(s->changes, sizeof(s->changes), "%s", changes);
+        s->calls++;
+        pthread_cond_broadcast(&s->cond);
+        pthread_mutex_unlock(&s->mutex);
+}
+
+
+/** write people to file */
+static bool _write(const char *filename, const char *people)
+{
+        FILE *f;
+        if(!(f = fopen(filename, "w")))
+                return false;
+
+        fprintf(f, "<people>%s</people>\n", people);
+
+        return fclose(f) == 0;
+}
+
+
+/** wait until callback was called calls times (or timeout passed) and 
+    compare last changes */
+static bool _expect(WatchState * s, int calls, int timeout_ms, const char *changes)
+{
+        struct timespec until;
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_sec += timeout_ms / 1000;
+        until.tv_nsec += (timeout_ms % 1000) * 1000000L;
+        if(until.tv_nsec >= 1000000000L)
+        {
+                until.tv_sec++;
+                until.tv_nsec -= 1000000000L;
+        }
+
+        pthread_mutex_lock(&s->mutex);
+        while(s->calls < calls)
+        {
+                if(pthread_cond_timedwait(&s->cond, &s->mutex, &until) == ETIMEDOUT)
+                        break;
+        }
+        int got = s->calls;
+        bool match = (strcmp(s->changes, changes) == 0);
+        char last[sizeof(s->changes)];
+        strcpy(last, s->changes);
+        pthread_mutex_unlock(&s->mutex);
+
+        if(got != calls || !match)
+        {
+                NFT_LOG(L_ERROR, "expected %d callbacks with \"%s\", got %d with \"%s\"",
+                        calls, changes, got, last);
+                return false;
+        }
+
+        return true;
+}
+
+
+/** sleep some milliseconds */
+static void _sleep(int ms)
+{
+        struct timespec t = {.tv_sec = ms / 1000,.tv_nsec = (ms % 1000) * 1000000L };
+        nanosleep(&t, NULL);
+}
+
+
+/** watch a file while it's modified in various ways */
+int main(int argc, char *argv[])
+{
+        /* do preliminary version checks */
+        if(!NFT_PREFS_CHECK_VERSION)
+                return EXIT_FAILURE;
+
+        /* fail per default */
+        int result = EXIT_FAILURE;
+
+        NftPrefsWatch *w = NULL;
+        WatchState s = {
+                .mutex = PTHREAD_MUTEX_INITIALIZER,
+                .cond = PTHREAD_COND_INITIALIZER,
+        };
+
+
+        /* initialize libniftyprefs */
+        NftPrefs *prefs;
+        if(!(prefs = nft_prefs_init(0)))
+                return EXIT_FAILURE;
+
+        const char *v1 =
+                "<person name=\"Alice\" age=\"30\"/><person name=\"Bob\" age=\"40\"/>"
+                "<settings><color value=\"red\"/></settings>";
+        if(!_write(FILE_NAME, v1) ||
+           !(w = nft_prefs_watch(prefs, FILE_NAME, _changed, &s)))
+                goto _deinit;
+
+        /* changed property */
+        if(!_write(FILE_NAME,
+                   "<person name=\"Alice\" age=\"30\"/><person name=\"Bob\" age=\"41\"/>"
+                   "<settings><color value=\"red\"/></settings>") ||
+           !_expect(&s, 1, TIMEOUT_MS, "set person[Bob].age;"))
+                goto _deinit;
+
+        /* rapid writes cause one reload */
+        const char *v3 =
+                "<person name=\"Alice\" age=\"30\"/><person name=\"Bob\" age=\"41\"/>"
+                "<settings/><person name=\"Carol\" age=\"50\"/>";
+        for(int i = 0; i < 5; i++)
+        {
+                char people[512];
+                snprintf(people, sizeof(people), "<person name=\"Tmp\" age=\"%d\"/>", i);
+                if(!_write(FILE_NAME, people))
+                        goto _deinit;
+        }
+        if(!_write(FILE_NAME, v3) ||
+           !_expect(&s, 2, TIMEOUT_MS, "remove color;add person[Carol];"))
+                goto _deinit;
+        _sleep(QUIET_MS);
+        if(!_expect(&s, 2, 0, "remove color;add person[Carol];"))
+                goto _deinit;
+
+        /* same content or formatting only don't cause callbacks */
+        if(!_write(FILE_NAME, v3))
+                goto _deinit;
+        _sleep(QUIET_MS);
+        FILE *f;
+        if(!(f = fopen(FILE_NAME, "a")))
+                goto _deinit;
+        fprintf(f, "<!-- comment -->\n\n");
+        fclose(f);
+        _sleep(QUIET_MS);
+        if(!_expect(&s, 2, 0, "remove color;add person[Carol];"))
+                goto _deinit;
+
+        /* file replaced by another one */
+        if(!_write(TMP_NAME,
+                   "<person name=\"Alice\" age=\"31\"/><person name=\"Bob\" age=\"41\"/>"
+                   "<settings/><person name=\"Carol\" age=\"50\"/>") ||
+           rename(TMP_NAME, FILE_NAME) != 0 ||
+           !_expect(&s, 3, TIMEOUT_MS, "set person[Alice].age;"))
+                goto _deinit;
+
+        result = EXIT_SUCCESS;
+
+_deinit:
+        if(w)
+                nft_prefs_watch_stop(w);
+        unlink(FILE_NAME);
+        unlink(TMP_NAME);
+        nft_prefs_deinit(prefs);
+
+        return result;
+}
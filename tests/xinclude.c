@@ -0,0 +1,310 @@
+/*
+ * libniftyprefs - lightweight modelless preferences management library
+ * Copyright (C) 2006-2014 Daniel Hiepler <daniel@niftylight.de>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <niftylog.h>
+#include <niftyprefs.h>
+
+
+/* amount of files including the same fragments */
+#define FILES           16
+/* amount of distinct fragments included by every file */
+#define FRAGMENTS       8
+/* amount of items per fragment */
+#define ITEMS           100
+/* directory of fragments */
+#define DIR_NAME        "test-xinclude.d"
+/* fragment that includes another one */
+#define NESTED_NAME     DIR_NAME "/nested.xml"
+
+
+
+/** name of fragment f */
+static void _fragment_name(char *name, size_t size, int f)
+{
+        snprintf(name, size, DIR_NAME "/fragment-%d.xml", f);
+}
+
+
+/** name of including file */
+static void _file_name(char *name, size_t size, int i)
+{
+        snprintf(name, size, "test-xinclude-%d.xml", i);
+}
+
+
+/** write fragment f with a revision attribute */
+static bool _write_fragment(int f, int revision)
+{
+        char name[64];
+        _fragment_name(name, sizeof(name), f);
+
+        FILE *fp;
+        if(!(fp = fopen(name, "w")))
+                return false;
+
+        fprintf(fp, "<?xml version=\"1.0\"?>\n<!-- fragment %d -->\n"
+                "<fragment id=\"%d\" revision=\"%d\">\n", f, f, revision);
+        for(int i = 0; i < ITEMS; i++)
+                fprintf(fp, "  <item name=\"item-%d-%d\" id=\"%d\"/>\n", f, i, i);
+        fprintf(fp, "</fragment>\n");
+
+        return fclose(fp) == 0;
+}
+
+
+/** write all files */
+static bool _write_files(void)
+{
+        mkdir(DIR_NAME, 0755);
+
+        for(int f = 0; f < FRAGMENTS; f++)
+        {
+                if(!_write_fragment(f, 0))
+                        return false;
+        }
+
+        /* fragment including another fragment of the same directory */
+        FILE *fp;
+        if(!(fp = fopen(NESTED_NAME, "w")))
+                return false;
+        fprintf(fp, "<nested xmlns:xi=\"http://www.w3.org/2001/XInclude\">"
+                "<xi:include href=\"fragment-0.xml\"/></nested>\n");
+        if(fclose(fp) != 0)
+                return false;
+
+        for(int i = 0; i < FILES; i++)
+        {
+                char name[64];
+                _file_name(name, sizeof(name), i);
+                if(!(fp = fopen(name, "w")))
+                        return false;
+
+                fprintf(fp, "<file xmlns:xi=\"http://www.w3.org/2001/XInclude\" id=\"%d\">\n", i);
+                for(int f = 0; f < FRAGMENTS; f++)
+                        fprintf(fp, "  <xi:include href=\"" DIR_NAME "/fragment-%d.xml\"/>\n", f);
+
+                /* same file included twice, relative to xml:base and 
+                   nested inclusion */
+                fprintf(fp, "  <copy><xi:include href=\"" DIR_NAME "/fragment-0.xml\"/></copy>\n"
+                        "  <based xml:base=\"" DIR_NAME "/\"><xi:include href=\"fragment-1.xml\"/></based>\n"
+                        "  <xi:include href=\"" NESTED_NAME "\"/>\n");
+
+                /* fallback is left to libxml2 */
+                if(i == 0)
+                        fprintf(fp, "  <xi:include href=\"" DIR_NAME "/missing.xml\"><xi:fallback><missing/></xi:fallback></xi:include>\n");
+
+                fprintf(fp, "</file>\n");
+
+                if(fclose(fp) != 0)
+                        return false;
+        }
+
+        return true;
+}
+
+
+/** remove all files */
+static void _remove_files(void)
+{
+        char name[64];
+        for(int i = 0; i < FILES; i++)
+        {
+                _file_name(name, sizeof(name), i);
+                unlink(name);
+        }
+
+        for(int f = 0; f < FRAGMENTS; f++)
+        {
+                _fragment_name(name, sizeof(name), f);
+                unlink(name);
+        }
+
+        unlink(NESTED_NAME);
+        rmdir(DIR_NAME);
+}
+
+
+/** load all files and dump them */
+static bool _load(NftPrefs * prefs, char *dumps[])
+{
+        for(int i = 0; i < FILES; i++)
+        {
+                char name[64];
+                _file_name(name, sizeof(name), i);
+
+                NftPrefsNode *n;
+                if(!(n = nft_prefs_node_from_file(prefs, name)))
+                        return false;
+
+                /* every inclusion must be a copy of its own */
+                if(!nft_prefs_node_prop_string_set(nft_prefs_node_get_first_child(n),
+                                                   "modified", "yes"))
+                {
+                        nft_prefs_node_free(n);
+                        return false;
+                }
+
+                dumps[i] = nft_prefs_node_to_buffer(prefs, n);
+                nft_prefs_node_free(n);
+                if(!dumps[i])
+                        return false;
+        }
+
+        return true;
+}
+
+
+/** compare dumps with expected dumps */
+static bool _compare(char *expected[], char *dumps[], const char *what)
+{
+        for(int i = 0; i < FILES; i++)
+        {
+                if(strcmp(expected[i], dumps[i]) != 0)
+                {
+                        NFT_LOG(L_ERROR, "file %d differs (%s)", i, what);
+                        return false;
+                }
+        }
+
+        return true;
+}
+
+
+/** free dumps */
+static void _free_dumps(char *dumps[])
+{
+        for(int i = 0; i < FILES; i++)
+        {
+                free(dumps[i]);
+                dumps[i] = NULL;
+        }
+}
+
+
+/** compare XInclude processing with & without include cache */
+int main(int argc, char *argv[])
+{
+        /* do preliminary version checks */
+        if(!NFT_PREFS_CHECK_VERSION)
+                return EXIT_FAILURE;
+
+        /* fail per default */
+        int result = EXIT_FAILURE;
+
+        char *expected[FILES] = { NULL }, *dumps[FILES] = { NULL };
+
+
+        /* initialize libniftyprefs */
+        NftPrefs *prefs;
+        if(!(prefs = nft_prefs_init(0)))
+                return EXIT_FAILURE;
+
+        if(!_write_files())
+                goto _deinit;
+
+        for(int arena = 0; arena <= 1; arena++)
+        {
+                if(!nft_prefs_set_arena(prefs, arena))
+                        goto _deinit;
+
+                /* libxml2 only */
+                nft_prefs_set_include_cache(prefs, false);
+                if(!_load(prefs, expected))
+                        goto _deinit;
+
+                /* fill cache, then use it */
+                nft_prefs_set_include_cache(prefs, true);
+                if(!_load(prefs, dumps) ||
+                   !_compare(expected, dumps, "parsing included files"))
+                        goto _deinit;
+                _free_dumps(dumps);
+
+                if(!_load(prefs, dumps) ||
+                   !_compare(expected, dumps, "cached included files"))
+                        goto _deinit;
+                _free_dumps(dumps);
+
+                /* modified fragment replaces cached one */
+                if(!_write_fragment(0, 1 + arena))
+                        goto _deinit;
+
+                _free_dumps(expected);
+                nft_prefs_set_include_cache(prefs, false);
+                if(!_load(prefs, expected))
+                        goto _deinit;
+
+                nft_prefs_set_include_cache(prefs, true);
+                if(!_load(prefs, dumps) ||
+                   !_compare(expected, dumps, "modified included file"))
+                        goto _deinit;
+                _free_dumps(dumps);
+
+                char revision[32];
+                snprintf(revision, sizeof(revision), "revision=\"%d\"", 1 + arena);
+                if(!strstr(expected[0], revision))
+                {
+                        NFT_LOG(L_ERROR, "modified fragment wasn't loaded");
+                        goto _deinit;
+                }
+
+                _free_dumps(expected);
+        }
+
+        result = EXIT_SUCCESS;
+
+_deinit:
+        _free_dumps(expected);
+        _free_dumps(dumps);
+        _remove_files();
+        nft_prefs_deinit(prefs);
+
+        return result;
+}